@@ -10,8 +10,29 @@
 // Enables dns.resolve API but requires additional library c-ares
 #define LOW_INCLUDE_CARES_RESOLVER 1
 
+// Enables zlib module and HTTP response compression, requires library zlib
+#define LOW_INCLUDE_ZLIB 1
+
+// Enables worker_threads module, each worker has its own Duktape heap
+#define LOW_INCLUDE_WORKER_THREADS 1
+
+// Enables child_process.fork and the cluster module, requires posix_spawn
+#define LOW_INCLUDE_CHILD_PROCESS 1
+
 #define LOW_USE_SYSTEM_ALLOC 1
 
+// Small blocks of the JavaScript heap come from size class slabs instead
+// of malloc, without size header
+#define LOW_USE_SLAB_ALLOC 1
+
+// Above the soft watermark (in percent of the memory limit) the event loop
+// collects garbage when idle, but spends at most LOW_GC_IDLE_BUDGET percent
+// of the time doing so. Only above the hard watermark an allocation
+// collects garbage itself
+#define LOW_GC_SOFT_WATERMARK   50
+#define LOW_GC_HARD_WATERMARK   90
+#define LOW_GC_IDLE_BUDGET      10
+
 // Poll is superior to select because not limited to FD_SETSIZE sockets
 #define LOW_HAS_POLL 1
 
@@ -23,6 +44,44 @@
 
 #define LOW_HAS_UNIX_SOCKET 1
 
+// Socket reads land in slices of arena chunks of this size and JavaScript
+// gets views into them. The memory of chunks without views left is reused,
+// up to LOW_READ_ARENA_KEEP chunks are kept for that
+#define LOW_READ_ARENA_SIZE (64 * 1024)
+#define LOW_READ_ARENA_KEEP 4
+
+// Batch datagram I/O with recvmmsg/sendmmsg
+#ifdef __linux__
+#define LOW_HAS_MMSG 1
+#else
+#define LOW_HAS_MMSG 0
+#endif /* __linux__ */
+
+// Datagrams received/sent per system call and the largest datagram received
+// without truncation (64 KB covers jumbo frames and GRO/GSO sized datagrams)
+#define LOW_DGRAM_BATCH 16
+#define LOW_DGRAM_MAX_SIZE 65536
+
+// Memory of the receive ring of each bound socket. Limits the datagrams
+// received per system call further, keep it small on embedded builds
+#define LOW_DGRAM_RECV_BUFFER (256 * 1024)
+
+// Files of native HTTP routes and native pipes go from the page cache to the
+// socket with sendfile, without copying through a buffer (not with TLS)
+#ifdef __linux__
+#define LOW_HAS_SENDFILE 1
+#else
+#define LOW_HAS_SENDFILE 0
+#endif /* __linux__ */
+
+// Native pipes between sockets move the data with splice through a kernel
+// pipe, so it does not come to user space
+#ifdef __linux__
+#define LOW_HAS_SPLICE 1
+#else
+#define LOW_HAS_SPLICE 0
+#endif /* __linux__ */
+
 #define LOW_ESP32_LWIP_SPECIALITIES 0
 
 #ifndef LOW_LIB_PATH
@@ -11,10 +11,12 @@
 #include "low_main.h"
 #include "low_module.h"
 #include "low_loop.h"
+#include "low_profiler.h"
 #include "low_system.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 
 #ifndef __APPLE__
 #include <string.h>
@@ -110,12 +112,40 @@ static void usage(const char *prog_name)
     printf("                            This is slow! Use only for testing.\n");
     printf("  --transpile-output        Output the transpiled main file\n");
     printf("  --max-old-space-size=...  Memory limit of JavaScript objects in MB\n");
+    printf("  --cpu-prof                Write a CPU profile (.cpuprofile) on exit\n");
+    printf("  --cpu-prof-dir=...        Directory of the CPU profile\n");
+    printf("  --cpu-prof-name=...       File name of the CPU profile\n");
+    printf("  --cpu-prof-interval=...   Sampling interval in us (default: 1000)\n");
     printf("\n");
     printf("  -h, --help                Show this message (no other arg allowed)\n");
     printf("  -v, --version             Show low.js version (no other arg allowed)\n");
 }
 
 
+// -----------------------------------------------------------------------------
+//  write_cpu_profile - writes the profile started by --cpu-prof, named as
+//  Node.js does it if no name is given
+// -----------------------------------------------------------------------------
+
+static void write_cpu_profile(low_t *low, const char *dir, const char *name)
+{
+    char defName[80], path[1024];
+    if(!name)
+    {
+        time_t t = time(NULL);
+        strftime(defName, sizeof(defName), "CPU.%Y%m%d.%H%M%S", localtime(&t));
+        sprintf(defName + strlen(defName), ".%d.0.001.cpuprofile", (int)getpid());
+        name = defName;
+    }
+    if(dir)
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+    else
+        snprintf(path, sizeof(path), "%s", name);
+
+    low_profiler_write(low, path);
+}
+
+
 // -----------------------------------------------------------------------------
 //  main - program entry point
 // -----------------------------------------------------------------------------
@@ -142,12 +172,18 @@ int main(int argc, char *argv[])
     }
 
     bool optTranspile = false, optTranspileOutput = false;
+    bool optCpuProf = false;
+    const char *cpuProfDir = NULL, *cpuProfName = NULL;
+    int cpuProfInterval = 0;
     char **restArgv = NULL;
     int maxMemSize = 0;
 
     for(int i = 1; i < argc; i++)
     {
         char maxOldSpaceSize[] = "--max-old-space-size=";
+        char cpuProfDirOpt[] = "--cpu-prof-dir=";
+        char cpuProfNameOpt[] = "--cpu-prof-name=";
+        char cpuProfIntervalOpt[] = "--cpu-prof-interval=";
 
         if(argv[i][0] != '-')
         {
@@ -176,6 +212,24 @@ int main(int argc, char *argv[])
             if(maxMemSize < 4)
                 maxMemSize = 4;     // needed for init
         }
+        else if(strcmp(argv[i], "--cpu-prof") == 0)
+            optCpuProf = true;
+        else if(strlen(argv[i]) > sizeof(cpuProfDirOpt) - 1
+        && memcmp(argv[i], cpuProfDirOpt, sizeof(cpuProfDirOpt) - 1) == 0)
+            cpuProfDir = argv[i] + sizeof(cpuProfDirOpt) - 1;
+        else if(strlen(argv[i]) > sizeof(cpuProfNameOpt) - 1
+        && memcmp(argv[i], cpuProfNameOpt, sizeof(cpuProfNameOpt) - 1) == 0)
+            cpuProfName = argv[i] + sizeof(cpuProfNameOpt) - 1;
+        else if(strlen(argv[i]) > sizeof(cpuProfIntervalOpt) - 1
+        && memcmp(argv[i], cpuProfIntervalOpt, sizeof(cpuProfIntervalOpt) - 1) == 0)
+        {
+            cpuProfInterval = atoi(argv[i] + sizeof(cpuProfIntervalOpt) - 1);
+            if(cpuProfInterval <= 0)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
         else
         {
             usage(argv[0]);
@@ -189,6 +243,12 @@ int main(int argc, char *argv[])
         usage(argv[0]);
         return EXIT_SUCCESS;
     }
+    if(!optCpuProf && (cpuProfDir || cpuProfName || cpuProfInterval))
+    {
+        // As with Node.js, only valid together with --cpu-prof
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
 
     if(!low_system_init(argc, (const char **)(restArgv ? restArgv : argv)))
         return EXIT_FAILURE;
@@ -219,17 +279,23 @@ int main(int argc, char *argv[])
         if(!init_transpile(low, optTranspileOutput))
             goto err;
     }
+    if(optCpuProf)
+        low_profiler_start(low, cpuProfInterval);
 
     if(!low_module_main(low, argc > 1 ? argv[1] : NULL))
         goto err;
     if(!low_loop_run(low))
         goto err;
 
+    if(optCpuProf)
+        write_cpu_profile(low, cpuProfDir, cpuProfName);
     low_destroy(low);
     low_system_destroy();
     return EXIT_SUCCESS;
 
 err:
+    if(optCpuProf)
+        write_cpu_profile(low, cpuProfDir, cpuProfName);
     low_destroy(low);
     low_system_destroy();
     return EXIT_FAILURE;
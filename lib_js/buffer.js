@@ -1,18 +1,71 @@
+const native = require('native');
+const {
+    ERR_INVALID_ARG_TYPE,
+    ERR_OUT_OF_RANGE,
+    ERR_UNKNOWN_ENCODING
+} = require('internal/errors').codes;
+
+// The encodings low_buffer.cpp converts natively, in their canonical name
+function normalizeEncoding(encoding) {
+    if (encoding === undefined || encoding === null || encoding === '')
+        return 'utf8';
+
+    switch (('' + encoding).toLowerCase()) {
+        case 'utf8':
+        case 'utf-8':
+            return 'utf8';
+        case 'hex':
+            return 'hex';
+        case 'base64':
+            return 'base64';
+        case 'base64url':
+            return 'base64url';
+        case 'latin1':
+        case 'binary':
+            return 'latin1';
+        case 'ascii':
+            return 'ascii';
+        case 'ucs2':
+        case 'ucs-2':
+        case 'utf16le':
+        case 'utf-16le':
+            return 'utf16le';
+    }
+    return undefined;
+}
+
+function requireEncoding(encoding) {
+    const normalized = normalizeEncoding(encoding);
+    if (normalized === undefined)
+        throw new ERR_UNKNOWN_ENCODING(encoding);
+    return normalized;
+}
+
 Buffer = ((oldFunc) => {
     let newBuffer = function (...args) {
-        if(typeof args[0] === 'string' && (args[1] == 'hex' || args[1] == 'base64'))
-            return oldFunc.call(this, Duktape.dec(args[1], args[0]));
+        if(typeof args[0] === 'string')
+            return native.bufferFromString(args[0], requireEncoding(args[1]));
         else if(args[0].slice && typeof args[1] !== 'string' && args[2] !== undefined)
 	    // Workaround: DukTape does not allow slicing in constructor
             return oldFunc.call(this, args[0].slice(args[1], args[1] + args[2]));
 	else
             return oldFunc.call(this, ...args);
     }
-    newBuffer.byteLength = oldFunc.byteLength;
-    newBuffer.compare = oldFunc.compare;
+    newBuffer.byteLength = (value, encoding) => {
+        if (typeof value === 'string')
+            return native.bufferByteLength(value, normalizeEncoding(encoding) || 'utf8');
+        return oldFunc.byteLength(value);
+    }
+    newBuffer.compare = (a, b) => {
+        if (!(a instanceof Uint8Array) || !(b instanceof Uint8Array))
+            throw new ERR_INVALID_ARG_TYPE('buf', ['Buffer', 'Uint8Array'], a);
+        return native.compare(a, b);
+    }
     newBuffer.concat = oldFunc.concat;
     newBuffer.isBuffer = oldFunc.isBuffer;
-    newBuffer.isEncoding = oldFunc.isEncoding;
+    newBuffer.isEncoding = (encoding) => {
+        return typeof encoding === 'string' && encoding !== '' && normalizeEncoding(encoding) !== undefined;
+    }
     newBuffer.poolSize = oldFunc.poolSize;
     newBuffer.prototype = oldFunc.prototype;
 
@@ -22,13 +75,73 @@ Buffer = ((oldFunc) => {
     return newBuffer;
 })(Buffer);
 
-Buffer.prototype.toString = ((oldFunc) => {
-    return function (encoding, b, c) {
-        if (encoding == 'hex' || encoding == 'base64')
-            return Duktape.enc(encoding, this);
-        else
-            return oldFunc.call(this, encoding, b, c);
+Buffer.prototype.toString = function (encoding, start, end) {
+    return native.bufferToString(this, requireEncoding(encoding), start, end);
+}
+
+// write(string[, offset[, length]][, encoding])
+Buffer.prototype.write = function (string, offset, length, encoding) {
+    if (typeof string !== 'string')
+        throw new ERR_INVALID_ARG_TYPE('argument', 'string', string);
+
+    if (typeof offset === 'string') {
+        encoding = offset;
+        offset = length = undefined;
+    } else if (typeof length === 'string') {
+        encoding = length;
+        length = undefined;
+    }
+    return native.bufferWrite(this, string, offset === undefined ? 0 : offset >>> 0,
+        length === undefined ? undefined : length >>> 0, requireEncoding(encoding));
+}
+
+// Search in native code, see low_buffer.cpp
+function bidirectionalIndexOf(buffer, value, byteOffset, encoding, last) {
+    if (typeof byteOffset === 'string') {
+        encoding = byteOffset;
+        byteOffset = undefined;
     }
-})(Buffer.prototype.toString);
+    if (typeof value === 'string')
+        encoding = requireEncoding(encoding);
+    else if (typeof value !== 'number' && !(value instanceof Uint8Array))
+        throw new ERR_INVALID_ARG_TYPE('value', ['string', 'Buffer', 'Uint8Array'], value);
+
+    return native.bufferIndexOf(buffer, value, byteOffset === undefined ? undefined : +byteOffset,
+        encoding, last);
+}
+
+Buffer.prototype.indexOf = function (value, byteOffset, encoding) {
+    return bidirectionalIndexOf(this, value, byteOffset, encoding, false);
+}
+Buffer.prototype.lastIndexOf = function (value, byteOffset, encoding) {
+    return bidirectionalIndexOf(this, value, byteOffset, encoding, true);
+}
+Buffer.prototype.includes = function (value, byteOffset, encoding) {
+    return bidirectionalIndexOf(this, value, byteOffset, encoding, false) !== -1;
+}
+
+Buffer.prototype.compare = function (target, targetStart, targetEnd, sourceStart, sourceEnd) {
+    if (!(target instanceof Uint8Array))
+        throw new ERR_INVALID_ARG_TYPE('target', ['Buffer', 'Uint8Array'], target);
+
+    targetStart = targetStart === undefined ? 0 : +targetStart;
+    targetEnd = targetEnd === undefined ? target.length : +targetEnd;
+    sourceStart = sourceStart === undefined ? 0 : +sourceStart;
+    sourceEnd = sourceEnd === undefined ? this.length : +sourceEnd;
+    if (targetStart < 0 || targetEnd > target.length || sourceStart < 0 || sourceEnd > this.length)
+        throw new ERR_OUT_OF_RANGE();
+
+    if (sourceStart >= sourceEnd)
+        return targetStart >= targetEnd ? 0 : -1;
+    if (targetStart >= targetEnd)
+        return 1;
+    return native.compare(this, target, sourceStart, sourceEnd, targetStart, targetEnd);
+}
+
+Buffer.prototype.equals = function (other) {
+    if (!(other instanceof Uint8Array))
+        throw new ERR_INVALID_ARG_TYPE('otherBuffer', ['Buffer', 'Uint8Array'], other);
+    return this === other || (this.length === other.length && native.compare(this, other) === 0);
+}
 
 exports.Buffer = Buffer;
@@ -1,17 +1,275 @@
 'use strict';
 
-export function exec() {
-    throw new Error('Not supported.');
+const { ChildProcess, normalizeStdio } = require('internal/child_process');
+const native = require('native');
+const {
+    ERR_CHILD_PROCESS_IPC_REQUIRED,
+    ERR_CHILD_PROCESS_STDIO_MAXBUFFER,
+    ERR_INVALID_ARG_TYPE,
+    ERR_IPC_SYNC_FORK
+} = require('internal/errors').codes;
+
+const MAX_BUFFER = 1024 * 1024;
+
+export { ChildProcess };
+
+function envPairs(env) {
+    let pairs = [];
+    for (let key in env)
+        if (env[key] !== undefined)
+            pairs.push(key + '=' + env[key]);
+    return pairs;
+}
+
+// Returns what ChildProcess.spawn and native.childSpawnSync need
+function normalizeSpawnArguments(file, args, options) {
+    if (typeof file !== 'string' || file.length == 0)
+        throw new ERR_INVALID_ARG_TYPE('file', 'string', file);
+
+    if (Array.isArray(args))
+        args = args.slice();
+    else if (args !== undefined && args !== null && typeof args === 'object') {
+        options = args;
+        args = [];
+    } else
+        args = [];
+    options = Object.assign({}, options);
+
+    if (options.uid !== undefined || options.gid !== undefined)
+        throw new Error('options.uid and options.gid are not supported');
+
+    if (options.shell) {
+        const command = [file].concat(args).join(' ');
+        file = typeof options.shell === 'string' ? options.shell : '/bin/sh';
+        args = ['-c', command];
+    }
+    args.unshift(typeof options.argv0 === 'string' ? options.argv0 : file);
+
+    return {
+        file,
+        args,
+        envPairs: envPairs(options.env || process.env),
+        cwd: options.cwd,
+        detached: !!options.detached,
+        stdio: options.stdio,
+        options
+    };
+}
+
+function decode(buffer, encoding) {
+    if (buffer && encoding && encoding !== 'buffer' && Buffer.isEncoding(encoding))
+        return buffer.toString(encoding);
+    return buffer;
+}
+
+// Starts a new low.js process running modulePath, with an IPC channel
+export function fork(modulePath, args, options) {
+    if (args !== undefined && args !== null && !Array.isArray(args)) {
+        options = args;
+        args = [];
+    }
+    args = args || [];
+    options = Object.assign({}, options);
+
+    let stdio = options.stdio;
+    if (stdio === undefined) {
+        stdio = options.silent ? ['pipe', 'pipe', 'pipe', 'ipc']
+            : ['inherit', 'inherit', 'inherit', 'ipc'];
+    } else if (!Array.isArray(stdio) || stdio.indexOf('ipc') < 0)
+        throw new ERR_CHILD_PROCESS_IPC_REQUIRED('options.stdio');
+
+    const execPath = options.execPath || process.execPath;
+    const child = new ChildProcess();
+    child.spawn({
+        file: execPath,
+        args: [execPath].concat(options.execArgv || [], [String(modulePath)], args),
+        envPairs: envPairs(options.env || process.env),
+        cwd: options.cwd,
+        stdio
+    });
+    return child;
+}
+
+export function spawn(file, args, options) {
+    const opts = normalizeSpawnArguments(file, args, options);
+    if (opts.stdio === undefined)
+        opts.stdio = 'pipe';
+    const child = new ChildProcess();
+
+    child.spawn(opts);
+    if (opts.options.timeout > 0) {
+        let timer = setTimeout(() => {
+            timer = null;
+            child.kill(opts.options.killSignal);
+        }, opts.options.timeout);
+        child.once('exit', () => {
+            if (timer)
+                clearTimeout(timer);
+        });
+    }
+    return child;
+}
+
+export function execFile(file, args, options, callback) {
+    if (typeof args === 'function') {
+        callback = args;
+        args = options = undefined;
+    } else if (typeof options === 'function') {
+        callback = options;
+        options = undefined;
+    }
+    if (args && !Array.isArray(args)) {
+        options = args;
+        args = undefined;
+    }
+    options = Object.assign({
+        encoding: 'utf8',
+        maxBuffer: MAX_BUFFER,
+        killSignal: 'SIGTERM',
+        timeout: 0
+    }, options, { stdio: 'pipe' });
+
+    const child = spawn(file, args, options);
+    const stdout = [], stderr = [];
+    let stdoutLen = 0, stderrLen = 0;
+    let error = null, killed = false;
+
+    function kill(err) {
+        if (!error)
+            error = err;
+        if (child.kill(options.killSignal))
+            killed = true;
+    }
+    function collect(stream, chunks, name) {
+        stream.on('data', (chunk) => {
+            chunks.push(chunk);
+            let len = name == 'stdout' ? (stdoutLen += chunk.length) : (stderrLen += chunk.length);
+            if (options.maxBuffer && len > options.maxBuffer)
+                kill(new ERR_CHILD_PROCESS_STDIO_MAXBUFFER(name));
+        });
+    }
+    if (child.stdout)
+        collect(child.stdout, stdout, 'stdout');
+    if (child.stderr)
+        collect(child.stderr, stderr, 'stderr');
+
+    let timer = null;
+    if (options.timeout > 0)
+        timer = setTimeout(() => {
+            timer = null;
+            kill(null);
+        }, options.timeout);
+
+    let done = false;
+    function exithandler(code, signal) {
+        if (done)
+            return;
+        done = true;
+        if (timer)
+            clearTimeout(timer);
+
+        let out = decode(Buffer.concat(stdout), options.encoding);
+        let err = decode(Buffer.concat(stderr), options.encoding);
+        if (!callback)
+            return;
+
+        const cmd = [file].concat(args || []).join(' ');
+        if (!error && code === 0 && signal === null) {
+            callback(null, out, err);
+            return;
+        }
+        if (!error)
+            error = new Error('Command failed: ' + cmd + '\n' + err);
+        if (error.code === undefined)
+            error.code = code;
+        error.killed = child.killed || killed;
+        error.signal = signal;
+        error.cmd = cmd;
+        callback(error, out, err);
+    }
+
+    child.on('close', exithandler);
+    child.on('error', (err) => {
+        error = err;
+        exithandler(null, null);
+    });
+    return child;
 }
 
-export function execSync() {
-    throw new Error('Not supported.');
+export function exec(command, options, callback) {
+    if (typeof options === 'function') {
+        callback = options;
+        options = undefined;
+    }
+    return execFile(command, [], Object.assign({}, options, { shell: (options && options.shell) || true }), callback);
 }
 
-export function spawn() {
-    throw new Error('Not supported.');
+export function spawnSync(file, args, options) {
+    const opts = normalizeSpawnArguments(file, args, options);
+    options = opts.options;
+
+    const { stdio, ipc } = normalizeStdio(opts.stdio === undefined ? 'pipe' : opts.stdio);
+    if (ipc >= 0)
+        throw new ERR_IPC_SYNC_FORK();
+
+    let input = options.input;
+    if (typeof input === 'string')
+        input = Buffer.from(input, options.encoding && options.encoding !== 'buffer' ? options.encoding : 'utf8');
+
+    let result;
+    try {
+        result = native.childSpawnSync(opts.file, opts.args, opts.envPairs, opts.cwd || null, stdio,
+            input || null, options.timeout | 0, options.maxBuffer === undefined ? MAX_BUFFER : options.maxBuffer,
+            options.killSignal, opts.detached);
+    } catch (err) {
+        err.syscall = 'spawnSync ' + opts.file;
+        err.path = opts.file;
+        err.spawnargs = opts.args.slice(1);
+        return { pid: 0, output: null, stdout: null, stderr: null, status: null, signal: null, error: err };
+    }
+
+    result.output = result.output.map((buf) => decode(buf, options.encoding));
+    result.stdout = result.output[1];
+    result.stderr = result.output[2];
+    if (result.error) {
+        result.error.syscall = 'spawnSync ' + opts.file;
+        result.error.path = opts.file;
+        result.error.spawnargs = opts.args.slice(1);
+    }
+    return result;
+}
+
+function checkExecSyncError(result, cmd) {
+    let err = result.error;
+    if (!err && result.status === 0)
+        return;
+
+    if (!err) {
+        err = new Error('Command failed: ' + cmd + (result.stderr ? '\n' + result.stderr.toString() : ''));
+        err.status = result.status;
+        err.signal = result.signal;
+    }
+    Object.assign(err, result);
+    throw err;
 }
 
-export function spawnSync() {
-    throw new Error('Not supported.');
+export function execFileSync(file, args, options) {
+    if (args && !Array.isArray(args)) {
+        options = args;
+        args = undefined;
+    }
+    options = Object.assign({ stdio: ['pipe', 'pipe', 'inherit'] }, options);
+
+    const result = spawnSync(file, args, options);
+    checkExecSyncError(result, [file].concat(args || []).join(' '));
+    return result.stdout;
+}
+
+export function execSync(command, options) {
+    options = Object.assign({ stdio: ['pipe', 'pipe', 'inherit'] }, options);
+    options.shell = options.shell || true;
+
+    const result = spawnSync(command, [], options);
+    checkExecSyncError(result, command);
+    return result.stdout;
 }
@@ -0,0 +1,260 @@
+'use strict';
+
+// Unlike Node.js, the primary does not hand out connections. All workers
+// listen on the port themselves with SO_REUSEPORT, and the kernel balances
+// the connections between them (schedulingPolicy is always SCHED_NONE)
+
+const EventEmitter = require('events').EventEmitter;
+
+const SCHED_NONE = 1;
+const SCHED_RR = 2;
+
+// A worker which crashes sooner than this after being forked is restarted
+// only after this delay, so a broken program does not fork in a loop
+const RESTART_THROTTLE = 1000;
+
+class Worker extends EventEmitter {
+    constructor(options) {
+        super();
+
+        this.id = options.id;
+        this.process = options.process;
+        this.state = options.state || 'none';
+        this.exitedAfterDisconnect = undefined;
+
+        this.process.on('message', (message, handle) => this.emit('message', message, handle));
+    }
+
+    send(message, handle, options, callback) {
+        return this.process.send(message, handle, options, callback);
+    }
+
+    isDead() {
+        return this.process.exitCode != null || this.process.signalCode != null;
+    }
+    isConnected() {
+        return this.process.connected;
+    }
+}
+
+const cluster = new EventEmitter();
+module.exports = cluster;
+
+cluster.Worker = Worker;
+cluster.SCHED_NONE = SCHED_NONE;
+cluster.SCHED_RR = SCHED_RR;
+cluster.schedulingPolicy = SCHED_NONE;
+
+cluster.isWorker = process.env.NODE_UNIQUE_ID !== undefined && typeof process.send === 'function';
+cluster.isPrimary = cluster.isMaster = !cluster.isWorker;
+
+function sendInternal(target, message) {
+    message.cmd = 'NODE_CLUSTER';
+    target.send(message);
+}
+
+// ***** PRIMARY *****
+
+function setupPrimary() {
+    const childProcess = require('child_process');
+    let ids = 0;
+
+    cluster.workers = {};
+    cluster.settings = {};
+
+    cluster.setupPrimary = cluster.setupMaster = function (options) {
+        cluster.settings = Object.assign({
+            args: process.argv.slice(2),
+            exec: process.argv[1],
+            execArgv: process.execArgv || [],
+            silent: false,
+            restart: false      // low.js specific: fork again if a worker crashes
+        }, cluster.settings, options);
+
+        const settings = cluster.settings;
+        process.nextTick(() => cluster.emit('setup', settings));
+    };
+
+    function removeWorker(worker) {
+        if (cluster.workers[worker.id] === worker && worker.isDead() && !worker.isConnected()) {
+            delete cluster.workers[worker.id];
+            if (Object.keys(cluster.workers).length == 0)
+                cluster.emit('_allGone');
+        }
+    }
+
+    function onInternalMessage(worker, message) {
+        if (message.cmd !== 'NODE_CLUSTER')
+            return;
+
+        switch (message.act) {
+            case 'online':
+                worker.state = 'online';
+                worker.emit('online');
+                cluster.emit('online', worker);
+                break;
+
+            case 'listening': {
+                const address = {
+                    address: message.address,
+                    port: message.port,
+                    addressType: message.addressType
+                };
+                worker.state = 'listening';
+                worker.emit('listening', address);
+                cluster.emit('listening', worker, address);
+                break;
+            }
+
+            case 'exitedAfterDisconnect':
+                worker.exitedAfterDisconnect = true;
+                break;
+        }
+    }
+
+    cluster.fork = function (env) {
+        cluster.setupPrimary();
+        const settings = cluster.settings;
+
+        const id = ++ids;
+        const child = childProcess.fork(settings.exec, settings.args, {
+            cwd: settings.cwd,
+            env: Object.assign({}, process.env, env, { NODE_UNIQUE_ID: '' + id }),
+            execArgv: settings.execArgv,
+            silent: settings.silent,
+            stdio: settings.stdio
+        });
+
+        const worker = new Worker({ id, process: child });
+        const forkedAt = Date.now();
+
+        worker.disconnect = function () {
+            this.exitedAfterDisconnect = true;
+            if (this.isConnected()) {
+                this.state = 'disconnecting';
+                sendInternal(this.process, { act: 'disconnect' });
+            }
+            return this;
+        };
+        worker.kill = worker.destroy = function (signal) {
+            this.exitedAfterDisconnect = true;
+            if (this.isConnected()) {
+                this.process.once('disconnect', () => this.process.kill(signal));
+                this.process.disconnect();
+            } else
+                this.process.kill(signal);
+        };
+
+        child.on('internalMessage', (message) => onInternalMessage(worker, message));
+        child.on('error', (err) => worker.emit('error', err));
+        child.once('disconnect', () => {
+            worker.state = 'disconnected';
+            worker.emit('disconnect');
+            cluster.emit('disconnect', worker);
+            removeWorker(worker);
+        });
+        child.once('exit', (code, signal) => {
+            worker.state = 'dead';
+            worker.emit('exit', code, signal);
+            cluster.emit('exit', worker, code, signal);
+            removeWorker(worker);
+
+            if (settings.restart && !worker.exitedAfterDisconnect && (code !== 0 || signal)) {
+                let delay = Date.now() - forkedAt < RESTART_THROTTLE ? RESTART_THROTTLE : 0;
+                setTimeout(() => cluster.fork(env), delay);
+            }
+        });
+
+        cluster.workers[id] = worker;
+        process.nextTick(() => cluster.emit('fork', worker));
+        return worker;
+    };
+
+    cluster.disconnect = function (callback) {
+        const workers = Object.keys(cluster.workers);
+        if (callback) {
+            if (workers.length)
+                cluster.once('_allGone', callback);
+            else
+                process.nextTick(callback);
+        }
+
+        for (const id of workers)
+            cluster.workers[id].disconnect();
+    };
+}
+
+// ***** WORKER *****
+
+function setupWorker() {
+    const id = parseInt(process.env.NODE_UNIQUE_ID, 10);
+    delete process.env.NODE_UNIQUE_ID;  // children of the worker are no workers
+
+    const worker = new Worker({ id, process, state: 'online' });
+    const servers = [];
+    cluster.worker = worker;
+
+    worker.disconnect = function () {
+        if (this.state == 'disconnecting' || !this.isConnected())
+            return this;
+        this.state = 'disconnecting';
+        this.exitedAfterDisconnect = true;
+        sendInternal(process, { act: 'exitedAfterDisconnect' });
+
+        // Running connections are served to their end, new ones go to
+        // the other workers
+        let waiting = servers.length + 1;
+        function closed() {
+            if (--waiting == 0 && process.connected)
+                process.disconnect();
+        }
+        for (const server of servers.slice()) {
+            server.once('close', closed);
+            server.close();
+        }
+        closed();
+        return this;
+    };
+    worker.kill = worker.destroy = function () {
+        this.exitedAfterDisconnect = true;
+        if (this.isConnected()) {
+            sendInternal(process, { act: 'exitedAfterDisconnect' });
+            process.disconnect();
+        }
+        process.exit(0);
+    };
+
+    process.on('internalMessage', (message) => {
+        if (message.cmd === 'NODE_CLUSTER' && message.act === 'disconnect')
+            worker.disconnect();
+    });
+    process.once('disconnect', () => {
+        worker.emit('disconnect');
+        if (!worker.exitedAfterDisconnect)
+            process.exit(0);    // the primary is gone
+    });
+
+    // Called by net.Server
+    cluster._onListening = function (server, options, family, address, port) {
+        servers.push(server);
+        server.once('close', () => {
+            let pos = servers.indexOf(server);
+            if (pos >= 0)
+                servers.splice(pos, 1);
+        });
+
+        sendInternal(process, {
+            act: 'listening',
+            address,
+            port: family ? port : undefined,
+            addressType: family || -1
+        });
+    };
+
+    sendInternal(process, { act: 'online' });
+}
+
+if (cluster.isWorker)
+    setupWorker();
+else
+    setupPrimary();
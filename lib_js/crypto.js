@@ -1,14 +1,21 @@
 'use script';
 
 let native = require('native');
+let stream = require('stream');
 
-// TODO: make Hash a transform stream
-class Hash {
-    constructor(type, key) {
+// Chunks of this size and larger are hashed on a data thread, below that
+// the thread switch costs more than hashing directly
+const HASH_ASYNC_MIN = 16 * 1024;
+
+class Hash extends stream.Transform {
+    constructor(type, key, options) {
+        super(options);
         this._native = native.createCryptoHash(this, type, key);
     }
 
     update(data, encoding) {
+        if (this._digested)
+            throw new Error('Digest already called');
         if (typeof data === 'string')
             data = Buffer.from(data, encoding);
 
@@ -17,22 +24,218 @@ class Hash {
     }
 
     digest(encoding) {
+        if (this._digested)
+            throw new Error('Digest already called');
+        this._digested = true;
+
         let val = native.cryptoHashDigest(this._native);
         if (encoding)
             return val.toString(encoding);
         else
             return val;
     }
+
+    _transform(chunk, encoding, callback) {
+        if (typeof chunk === 'string')
+            chunk = Buffer.from(chunk, encoding);
+
+        if (chunk.length >= HASH_ASYNC_MIN)
+            native.cryptoHashUpdate(this._native, chunk, callback);
+        else {
+            native.cryptoHashUpdate(this._native, chunk);
+            callback();
+        }
+    }
+
+    _flush(callback) {
+        this.push(this.digest());
+        this.push(null);
+        callback();
+    }
+}
+
+class Hmac extends Hash {
+    constructor(type, key, options) {
+        super(type, key, options);
+    }
+}
+
+// Same for ciphers
+const CIPHER_ASYNC_MIN = 16 * 1024;
+
+// Room the native side needs beyond the input length (MBEDTLS_MAX_BLOCK_LENGTH)
+const CIPHER_MAX_BLOCK = 16;
+
+class CipherBase extends stream.Transform {
+    constructor(encrypt, type, key, iv, options) {
+        super(options);
+
+        this._native = native.createCryptoCipher(this, type, encrypt, key, iv);
+        this._authTagLength = options && options.authTagLength ? options.authTagLength : 16;
+    }
+
+    update(data, inputEncoding, outputEncoding) {
+        if (typeof data === 'string')
+            data = Buffer.from(data, inputEncoding);
+
+        let out = Buffer.allocUnsafe(data.length + CIPHER_MAX_BLOCK);
+        out = out.slice(0, native.cryptoCipherUpdate(this._native, data, 0, data.length, out, 0));
+        if (outputEncoding && outputEncoding !== 'buffer')
+            return out.toString(outputEncoding);
+        else
+            return out;
+    }
+
+    // low.js specific: en/decrypts the buffer in place, without allocating
+    // new buffers. Only for stream modes (CTR, GCM, ChaCha20-Poly1305), with
+    // GCM only the last call may have a length which is not a multiple of 16.
+    // With callback, the work is done on a data thread
+    updateInPlace(buffer, offset, length, callback) {
+        if (typeof offset === 'function') {
+            callback = offset;
+            offset = undefined;
+        }
+        if (offset === undefined)
+            offset = 0;
+        if (length === undefined)
+            length = buffer.length - offset;
+
+        if (callback)
+            native.cryptoCipherUpdate(this._native, buffer, offset, length, null, 0, (err) => {
+                callback(err, err ? undefined : buffer);
+            });
+        else {
+            native.cryptoCipherUpdate(this._native, buffer, offset, length, null, 0);
+            return buffer;
+        }
+    }
+
+    final(outputEncoding) {
+        let out = native.cryptoCipherFinal(this._native);
+        if (outputEncoding && outputEncoding !== 'buffer')
+            return out.toString(outputEncoding);
+        else
+            return out;
+    }
+
+    setAutoPadding(autoPadding) {
+        native.cryptoCipherSetAutoPadding(this._native, autoPadding !== false);
+        return this;
+    }
+
+    setAAD(buffer, options) {
+        native.cryptoCipherSetAAD(this._native, buffer);
+        return this;
+    }
+
+    _transform(chunk, encoding, callback) {
+        if (typeof chunk === 'string')
+            chunk = Buffer.from(chunk, encoding);
+
+        let out = Buffer.allocUnsafe(chunk.length + CIPHER_MAX_BLOCK);
+        if (chunk.length >= CIPHER_ASYNC_MIN) {
+            native.cryptoCipherUpdate(this._native, chunk, 0, chunk.length, out, 0, (err, len) => {
+                if (!err && len)
+                    this.push(out.slice(0, len));
+                callback(err);
+            });
+            return;
+        }
+
+        let len;
+        try {
+            len = native.cryptoCipherUpdate(this._native, chunk, 0, chunk.length, out, 0);
+        } catch (err) {
+            callback(err);
+            return;
+        }
+        if (len)
+            this.push(out.slice(0, len));
+        callback();
+    }
+
+    _flush(callback) {
+        let out;
+        try {
+            out = this.final();
+        } catch (err) {
+            callback(err);
+            return;
+        }
+
+        if (out.length)
+            this.push(out);
+        this.push(null);
+        callback();
+    }
+}
+
+class Cipheriv extends CipherBase {
+    constructor(type, key, iv, options) {
+        super(true, type, key, iv, options);
+    }
+
+    getAuthTag() {
+        return native.cryptoCipherGetAuthTag(this._native, this._authTagLength);
+    }
+}
+
+class Decipheriv extends CipherBase {
+    constructor(type, key, iv, options) {
+        super(false, type, key, iv, options);
+    }
+
+    setAuthTag(tag) {
+        native.cryptoCipherSetAuthTag(this._native, tag);
+        return this;
+    }
 }
 
 exports.randomBytes = native.randomBytes;
 
-exports.createHash = function (type) {
-    return new Hash(type);
+exports.Hash = Hash;
+exports.Hmac = Hmac;
+
+exports.createHash = function (type, options) {
+    return new Hash(type, undefined, options);
+}
+
+exports.createHmac = function (type, key, options) {
+    return new Hmac(type, key, options);
+}
+
+exports.Cipheriv = Cipheriv;
+exports.Decipheriv = Decipheriv;
+
+exports.createCipheriv = function (type, key, iv, options) {
+    return new Cipheriv(type, key, iv, options);
+}
+
+exports.createDecipheriv = function (type, key, iv, options) {
+    return new Decipheriv(type, key, iv, options);
+}
+
+exports.getCiphers = function () {
+    return ['aes-128-cbc', 'aes-192-cbc', 'aes-256-cbc',
+            'aes-128-ctr', 'aes-192-ctr', 'aes-256-ctr',
+            'aes-128-gcm', 'aes-192-gcm', 'aes-256-gcm',
+            'chacha20-poly1305'];
 }
 
-exports.createHmac = function (type, key) {
-    return new Hash(type, key);
+// low.js specific: hashes a file without going through JavaScript for every
+// chunk. Calls callback(err, digest), digest is a string if encoding is given
+exports.hashFile = function (path, type, encoding, callback) {
+    if (typeof encoding === 'function') {
+        callback = encoding;
+        encoding = undefined;
+    }
+
+    native.cryptoHashFile(path, type, (err, digest) => {
+        if (err)
+            callback(err);
+        else
+            callback(null, encoding ? digest.toString(encoding) : digest);
+    });
 }
 
 exports.randomFillSync = function(buffer, offset, size) {
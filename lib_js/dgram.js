@@ -110,12 +110,13 @@ class Socket extends events.EventEmitter {
         if (this._socketFD === undefined && !this._tryConnect)
             this.bind(0);
 
-        if (this._tryConnect || this._writing) {
+        // Sends are queued natively and sent in batches, so we only need to
+        // wait until we are bound
+        if (this._tryConnect) {
             enqueue(this, this.send.bind(this, buffer, port, address, callback));
             return;
         }
 
-        this._writing = true;
         if (!address || native.isIP(address))
             this._send(buffer,
                 address ? address : (this._options.type == 'udp4' ? '127.0.0.1' : '::1'),
@@ -127,9 +128,6 @@ class Socket extends events.EventEmitter {
     }
     _send(buffer, address, port, callback) {
         native.send(this._socketFD, buffer, address, port, (err) => {
-            this._writing = false;
-            if (!this.destroyed)
-                onCanWrite.bind(this)();
             if(callback)
                 callback(err);
         });
@@ -306,8 +304,11 @@ function enqueue(self, toEnqueue) {
   }
   
   function onCanWrite() {
-    if(this._queue && this._queue.length)
-        this._queue.shift()();
+    let queue = this._queue;
+    this._queue = undefined;
+    if(queue)
+        for(let i = 0; i < queue.length; i++)
+            queue[i]();
   }
   
   function onListenError(err) {
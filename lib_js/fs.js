@@ -342,7 +342,7 @@ class ReadStream extends stream.Readable {
             highWaterMark: options && options.highWaterMark !== undefined ? options.highWaterMark : 64 * 1024,
             encoding: options ? options.encoding : null,
             read(size) {
-                if (this._fd === undefined) {
+                if (this._fd === undefined || this._pipeNativeActive) {
                     this._readSize = size;
                     return;
                 }
@@ -428,7 +428,8 @@ class ReadStream extends stream.Readable {
             this.once('close', callback);
 
         this._closed = true;
-        if (!this._fd)
+        // While piped natively, closed when the pipe is done
+        if (!this._fd || this._pipeNativeActive)
             return;
 
         native.close(this._fd, (err) => {
@@ -440,6 +441,11 @@ class ReadStream extends stream.Readable {
         });
         delete this._fd;
     }
+
+    // low.js specific: piped into sockets natively, see net.js
+    _pipeNative(destination, options) {
+        return require('net')._pipeNative(this, destination, options);
+    }
 }
 
 exports.ReadStream = ReadStream;
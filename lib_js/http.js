@@ -2,7 +2,9 @@
 
 // todo: keepAlive and keepAliveMsecs not used everywhere
 
+let native = require('native');
 let httpInternal = require('internal/http');
+let websocket = require('internal/websocket');
 
 let url = require('url');
 let net = require('net');
@@ -35,13 +37,25 @@ function calculateServerName(options, req) {
     return servername;
 }*/
 
+// Idle sockets of all agents by file descriptor. The native pool does the
+// bookkeeping, this is only to find the socket objects again. Not per agent,
+// as the function in the pool would keep the agent alive
+let poolSockets = new Map();
+native.httpPoolSetEvict((fd) => {
+    let socket = poolSockets.get(fd);
+    if (socket) {
+        poolSockets.delete(fd);
+        socket.destroy();
+    }
+});
+
+// low.js specific: the sockets are counted, queued for and kept idle by a
+// native pool, see LowHTTPPool. Idle sockets keep their HTTP parser, the web
+// thread closes them after timeout or if the server closes them. So there
+// are no sockets, freeSockets and requests lists
 class Agent {
     defaultPort = 80;
 
-    requests = {};
-    sockets = {};
-    freeSockets = {};
-
     constructor(options) {
         this.options = Object.assign({}, options);
         // don't confuse net and make it think that we're connecting to a pipe
@@ -52,66 +66,49 @@ class Agent {
         this.maxSockets = options && options.maxSockets !== undefined ? options.maxSockets : Infinity;
         this.maxFreeSockets = options && options.maxFreeSockets !== undefined ? options.maxFreeSockets : 256;
         this.timeout = options && options.timeout !== undefined ? options.timeout : 120000;
+
+        this._pool = null;
     }
 
-    removeSocket(socket, options, name) {
-        if (!name)
-            name = this.getName(options);
-        var sets = [this.sockets, this.freeSockets];
-        for (var sk = 0; sk < sets.length; sk++) {
-            var sockets = sets[sk];
-            if (sockets[name]) {
-                var index = sockets[name].indexOf(socket);
-                if (index !== -1) {
-                    sockets[name].splice(index, 1);
-                    // Don't leak
-                    if (sockets[name].length === 0)
-                        delete sockets[name];
-                }
-            }
-        }
+    // Created with the first request, so the options may still be changed
+    // after the constructor
+    _getPool() {
+        if (!this._pool)
+            this._pool = native.httpPoolCreate(this.maxSockets,
+                this.keepAlive ? this.maxFreeSockets : 0,
+                this.keepAlive ? this.timeout : 0);
+        return this._pool;
+    }
 
-        if (this.requests[name] && this.requests[name].length) {
-            var req = this.requests[name][0];
-            // If we are under maxSockets create a new one.
-            let socket = this.createConnection(options);
-            req._onSocket(socket, options);
-            this.sockets[name].push(socket);
-        }
+    removeSocket(socket, options) {
+        // Counted only once, also if closed after the response
+        let name = socket._agentName;
+        if (name === undefined)
+            return;
+        socket._agentName = undefined;
+
+        native.httpPoolRemove(this._getPool(), name);
     }
 
     freeSocket(socket, options) {
         socket.setTimeout(0);
 
-        var name = this.getName(options);
-        if (this.requests[name] && this.requests[name].length) {
-            this.requests[name].shift()._onSocket(socket, options);
-            if (this.requests[name].length === 0) {
-                // don't leak
-                delete this.requests[name];
-            }
-        } else {
-            if (this.keepAlive) {
-                var freeSockets = this.freeSockets[name];
-                var freeLen = freeSockets ? freeSockets.length : 0;
-                var count = freeLen;
-                if (this.sockets[name])
-                    count += this.sockets[name].length;
-
-                if (count > this.maxSockets || freeLen >= this.maxFreeSockets) {
-                    socket.destroy();
-                } else if (this.keepSocketAlive(socket)) {
-                    freeSockets = freeSockets || [];
-                    this.freeSockets[name] = freeSockets;
-                    freeSockets.push(socket);
-                } else {
-                    // Implementation doesn't want to keep socket alive
-                    socket.destroy();
-                }
-            } else {
-                // Implementation doesn't want to keep socket alive
-                socket.destroy();
-            }
+        let name = socket._agentName;
+        let result = name === undefined ? 0 : native.httpPoolRelease(this._getPool(), name, socket._socketFD);
+        if (result == 0) {
+            socket._agentName = undefined;
+            socket.destroy();
+            return;
+        }
+
+        // Idle (1) or handed to a queued request (2), which gets the socket
+        // from the list
+        poolSockets.set(socket._socketFD, socket);
+        if (result == 1 && !this.keepSocketAlive(socket)) {
+            // Implementation doesn't want to keep socket alive, the pool
+            // notices when it is closed
+            poolSockets.delete(socket._socketFD);
+            socket.destroy();
         }
     }
 
@@ -128,18 +125,10 @@ class Agent {
         return net.createConnection(options, cb);
     }
 
+    // Closes the idle sockets, and no more are kept
     destroy() {
-        var sets = [this.freeSockets, this.sockets];
-        for (var s = 0; s < sets.length; s++) {
-            var set = sets[s];
-            var keys = Object.keys(set);
-            for (var v = 0; v < keys.length; v++) {
-                var setName = set[keys[v]];
-                for (var n = 0; n < setName.length; n++) {
-                    setName[n].destroy();
-                }
-            }
-        }
+        if (this._pool)
+            native.httpPoolClose(this._pool);
     }
 
     getName(options) {
@@ -172,34 +161,36 @@ class Agent {
         //        if (!options.servername)        // todo: is this even used?
         //            options.servername = calculateServerName(options, request);
 
-        var name = this.getName(options);
-        if (!this.sockets[name]) {
-            this.sockets[name] = [];
-        }
-        var freeLen = this.freeSockets[name] ? this.freeSockets[name].length : 0;
-        var sockLen = freeLen + this.sockets[name].length;
+        let name = this.getName(options);
+        let fd = native.httpPoolLease(this._getPool(), name, (fd) => {
+            this._onLease(request, options, name, fd);
+        });
+        // Otherwise over maxSockets, queued natively
+        if (fd != -2)
+            this._onLease(request, options, name, fd);
+    }
 
-        if (freeLen) {
-            // we have a free socket, so use that.
-            var socket = this.freeSockets[name].shift();
-            if (!this.freeSockets[name].length)
-                delete this.freeSockets[name];
+    // fd is an idle socket, or -1 if a new one is to be created
+    _onLease(request, options, name, fd) {
+        let socket = fd >= 0 ? poolSockets.get(fd) : null;
+        if (socket)
+            poolSockets.delete(fd);
+
+        if (request.aborted || request.destroyed) {
+            // Aborted while queued
+            if (socket)
+                this.freeSocket(socket, options);
+            else
+                native.httpPoolRemove(this._getPool(), name);
+            return;
+        }
 
+        if (socket)
             this.reuseSocket(socket, request);
-            request._onSocket(socket, options);
-            this.sockets[name].push(socket);
-        } else if (sockLen < this.maxSockets) {
-            // If we are under maxSockets create a new one.
-            let socket = this.createConnection(options);
-            request._onSocket(socket, options);
-            this.sockets[name].push(socket);
-        } else {
-            // We are over limit so we'll add it to the queue.
-            if (!this.requests[name]) {
-                this.requests[name] = [];
-            }
-            this.requests[name].push(request);
-        }
+        else
+            socket = this.createConnection(options);
+        socket._agentName = name;
+        request._onSocket(socket, options);
     }
 }
 let globalAgent = new Agent();
@@ -247,6 +238,8 @@ function get(options, cb) {
 
 class Server extends net.Server {
     keepAliveTimeout = 5000;
+    headersTimeout = 60000;
+    maxRequestsPerSocket = 0;
     timeout = 120000;
     maxHeadersCount = 2000;
 
@@ -266,11 +259,36 @@ class Server extends net.Server {
         this._serverIncomingMessage = options && options.IncomingMessage ? options.IncomingMessage : httpInternal.IncomingMessage;
         this._serverServerResponse = options && options.ServerResponse ? options.ServerResponse : httpInternal.ServerResponse;
 
+        // low.js specific: reuse connections for further requests. Off on
+        // embedded systems, which cannot handle many sockets
+        this.httpKeepAlive = options && options.httpKeepAlive !== undefined ? !!options.httpKeepAlive : process.platform != 'esp32';
+        if (options && options.keepAliveTimeout !== undefined)
+            this.keepAliveTimeout = options.keepAliveTimeout;
+        if (options && options.headersTimeout !== undefined)
+            this.headersTimeout = options.headersTimeout;
+        if (options && options.maxRequestsPerSocket !== undefined)
+            this.maxRequestsPerSocket = options.maxRequestsPerSocket;
+
         this._httpServer = true;
         this.on('connection', (socket) => {
             httpInternal.handleServerConn(this, socket);
         });
     }
+
+    // low.js specific: routes which the web thread looks up before a request
+    // reaches JavaScript. handler is either a function, called instead of
+    // the 'request' event listeners, or a response the web thread sends by
+    // itself: { status, headers, body }, { file, status, headers } or
+    // { redirect, status }. Requests with a body are not answered natively.
+    // A path ending with * matches all paths starting with it, method * all
+    // methods
+    route(method, path, handler) {
+        return httpInternal.serverRoute(this, method, path, handler);
+    }
+
+    unroute(method, path) {
+        return httpInternal.serverUnroute(this, method, path);
+    }
 }
 
 function createServer(options, acceptCallback) {
@@ -288,5 +306,10 @@ module.exports = {
     Server,
     createServer,
     get,
-    request
+    request,
+
+    // low.js specific, see internal/websocket.js
+    WebSocket: websocket.WebSocket,
+    WebSocketGroup: websocket.WebSocketGroup,
+    acceptWebSocket: websocket.acceptWebSocket
 }
\ No newline at end of file
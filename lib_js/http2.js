@@ -0,0 +1,368 @@
+'use strict';
+
+// HTTP/2 server, compatibility API only (request events with req and res).
+// low.js specific: the client chooses h2 with ALPN during the TLS handshake,
+// then the web thread parses the frames, decodes the headers with HPACK and
+// does flow control for all streams of the connection. JavaScript only sees
+// requests, body data and resets per stream.
+// Not supported: server push, priorities, HTTP/2 without TLS (h2c), clients
+
+let native = require('native');
+let tls = require('tls');
+let stream = require('stream');
+let httpInternal = require('internal/http');
+
+// What the native side calls us with, see LowHTTP2Direct.h
+const EVENT_REQUEST = 1;
+const EVENT_DATA = 2;
+const EVENT_END = 3;
+const EVENT_RESET = 4;
+const EVENT_DRAIN = 5;
+const EVENT_CLOSE = 6;
+const EVENT_ERROR = 7;
+
+const constants = {
+    NGHTTP2_NO_ERROR: 0,
+    NGHTTP2_PROTOCOL_ERROR: 1,
+    NGHTTP2_INTERNAL_ERROR: 2,
+    NGHTTP2_FLOW_CONTROL_ERROR: 3,
+    NGHTTP2_STREAM_CLOSED: 5,
+    NGHTTP2_REFUSED_STREAM: 7,
+    NGHTTP2_CANCEL: 8,
+    NGHTTP2_ENHANCE_YOUR_CALM: 11,
+
+    HTTP2_HEADER_STATUS: ':status',
+    HTTP2_HEADER_METHOD: ':method',
+    HTTP2_HEADER_AUTHORITY: ':authority',
+    HTTP2_HEADER_SCHEME: ':scheme',
+    HTTP2_HEADER_PATH: ':path',
+    HTTP2_HEADER_CONTENT_TYPE: 'content-type',
+    HTTP2_HEADER_CONTENT_LENGTH: 'content-length',
+
+    HTTP2_METHOD_GET: 'GET',
+    HTTP2_METHOD_POST: 'POST',
+    HTTP2_METHOD_HEAD: 'HEAD'
+};
+
+class Http2ServerRequest extends stream.Readable {
+    // event "aborted"
+    aborted = false;
+    complete = false;
+    httpVersion = '2.0';
+    httpVersionMajor = 2;
+    httpVersionMinor = 0;
+
+    // rawHeaders as the native side gives them, lower case names
+    constructor(socket, streamID, rawHeaders) {
+        // Data is pushed as it arrives, the web thread does flow control
+        super({
+            read(size) { }
+        });
+
+        this.socket = this.connection = socket;
+        this.stream = { id: streamID };
+        this.rawHeaders = rawHeaders;
+        this.headers = {};
+        for (let i = 0; i + 1 < rawHeaders.length; i += 2) {
+            let name = rawHeaders[i], value = rawHeaders[i + 1];
+            let old = this.headers[name];
+            if (name == 'set-cookie')
+                this.headers[name] = old === undefined ? [value] : old.concat(value);
+            else if (old === undefined)
+                this.headers[name] = value;
+            else
+                this.headers[name] = old + (name == 'cookie' ? '; ' : ', ') + value;
+        }
+        this.rawTrailers = [];
+        this.trailers = {};
+
+        this.method = this.headers[':method'];
+        this.url = this.headers[':path'];
+        this.authority = this.headers[':authority'];
+        this.scheme = this.headers[':scheme'];
+    }
+
+    setTimeout(msecs, callback) { }
+}
+
+class Http2ServerResponse extends stream.Writable {
+    finished = false;
+    statusCode = 200;
+    sendDate = true;
+    headersSent = false;
+
+    _httpHeadersLowerCase = {};
+
+    constructor(socket, streamID) {
+        super({
+            write(chunk, encoding, callback) {
+                if (!this.headersSent)
+                    this._sendHeaders(false);
+
+                // Above the high water mark the native side tells us when
+                // the stream has room again
+                let result = native.http2Write(this.socket._socketFD, this.stream.id, chunk, false);
+                if (result > 0)
+                    this._drainCallback = callback;
+                else
+                    callback();
+            },
+            final(callback) {
+                this.finished = true;
+                if (!this.headersSent)
+                    this._sendHeaders(true);
+                else
+                    native.http2Write(this.socket._socketFD, this.stream.id, undefined, true);
+                callback();
+            }
+        });
+
+        this.socket = this.connection = socket;
+        this.stream = { id: streamID };
+        this._drainCallback = null;
+    }
+
+    _sendHeaders(end) {
+        this.headersSent = true;
+
+        // Added natively from the cached date, LOW_HTTP_HEAD_DATE
+        let flags = 0;
+        if (this.sendDate && this._httpHeadersLowerCase['date'] === undefined)
+            flags |= 8;
+
+        let headers = [];
+        for (let name in this._httpHeadersLowerCase) {
+            let value = this._httpHeadersLowerCase[name];
+            if (Array.isArray(value)) {
+                for (let i = 0; i < value.length; i++)
+                    headers.push(name, String(value[i]));
+            } else
+                headers.push(name, String(value));
+        }
+        native.http2Respond(this.socket._socketFD, this.stream.id, this.statusCode | 0, headers, end, flags);
+    }
+
+    _onDrain() {
+        let callback = this._drainCallback;
+        this._drainCallback = null;
+        if (callback)
+            callback();
+    }
+
+    _implicitHeader() {
+        return this.writeHead(this.statusCode);
+    }
+
+    setHeader(name, value) {
+        if (this.headersSent)
+            return;
+
+        this._httpHeadersLowerCase[name.toLowerCase()] = value;
+    }
+
+    hasHeader(name) {
+        return this._httpHeadersLowerCase[name.toLowerCase()] !== undefined;
+    }
+
+    removeHeader(name) {
+        if (this.headersSent)
+            return;
+
+        delete this._httpHeadersLowerCase[name.toLowerCase()];
+    }
+
+    getHeader(name) {
+        return this._httpHeadersLowerCase[name.toLowerCase()];
+    }
+
+    getHeaders() {
+        return this._httpHeadersLowerCase;
+    }
+
+    getHeaderNames() {
+        return Object.keys(this._httpHeadersLowerCase);
+    }
+
+    addTrailers(headers) { }
+    setTimeout(msecs, callback) { }
+    writeContinue() { }
+
+    // HTTP/2 has no status messages, statusMessage is ignored
+    writeHead(statusCode, statusMessage, headers) {
+        if (this.headersSent)
+            return this;
+
+        if (!headers && typeof statusMessage !== 'string')
+            headers = statusMessage;
+        if (statusCode)
+            this.statusCode = statusCode;
+
+        if (headers) {
+            for (let name in headers)
+                this.setHeader(name, headers[name]);
+        }
+        return this;
+    }
+
+    // Resets the stream, the client sees the request as failed
+    destroy(err) {
+        if (!this.finished) {
+            this.finished = true;
+            native.http2Reset(this.socket._socketFD, this.stream.id, constants.NGHTTP2_INTERNAL_ERROR);
+        }
+        return super.destroy(err);
+    }
+}
+
+// Streams of one connection
+function handleSession(server, socket) {
+    let streams = new Map();
+
+    // A stream is forgotten once both sides are done
+    function done(id) {
+        let entry = streams.get(id);
+        if (entry && entry.req.complete && entry.res.finished)
+            streams.delete(id);
+    }
+
+    function abort(id) {
+        let entry = streams.get(id);
+        if (!entry)
+            return;
+        streams.delete(id);
+
+        entry.res.finished = true;
+        entry.res._drainCallback = null;
+        if (!entry.req.complete) {
+            entry.req.aborted = true;
+            entry.req.emit('aborted');
+            entry.req.destroy();
+        }
+        entry.res.emit('close');
+    }
+
+    let attached = native.http2Attach(socket._socketFD, (type, id, arg, end) => {
+        let entry = id ? streams.get(id) : null;
+        switch (type) {
+            case EVENT_REQUEST: {
+                let req = new server._http2ServerRequest(socket, id, arg);
+                let res = new server._http2ServerResponse(socket, id);
+                req.response = res;
+                streams.set(id, { req, res });
+                res.on('finish', () => {
+                    done(id);
+                });
+
+                if (end) {
+                    req.complete = true;
+                    req.push(null);
+                }
+                server.emit('request', req, res);
+                break;
+            }
+
+            case EVENT_DATA:
+                if (entry)
+                    entry.req.push(arg);
+                break;
+
+            case EVENT_END:
+                if (entry) {
+                    entry.req.complete = true;
+                    entry.req.push(null);
+                    done(id);
+                }
+                break;
+
+            case EVENT_RESET:
+                abort(id);
+                break;
+
+            case EVENT_DRAIN:
+                if (entry)
+                    entry.res._onDrain();
+                break;
+
+            case EVENT_CLOSE:
+            case EVENT_ERROR:
+                for (let id of Array.from(streams.keys()))
+                    abort(id);
+                if (type == EVENT_ERROR)
+                    server.emit('sessionError', arg);
+                socket.destroy();
+                break;
+        }
+    });
+    if (!attached)
+        return false;
+
+    // The web thread reads for us, keep the process alive meanwhile
+    socket._socketReading = true;
+    socket._updateRef();
+    socket.on('error', () => { });
+    socket.on('close', () => {
+        for (let id of Array.from(streams.keys()))
+            abort(id);
+    });
+    return true;
+}
+
+class Http2SecureServer extends tls.Server {
+    // Used for HTTP/1 connections with allowHTTP1, see https.Server
+    keepAliveTimeout = 5000;
+    headersTimeout = 60000;
+    timeout = 120000;
+
+    // event unknownProtocol
+    // event sessionError
+
+    // options as tls.createServer, and allowHTTP1, Http1IncomingMessage,
+    // Http1ServerResponse, Http2ServerRequest, Http2ServerResponse
+    constructor(options, onRequest) {
+        if (!onRequest && typeof options === 'function') {
+            onRequest = options;
+            options = {};
+        }
+        options = Object.assign({}, options);
+        let allowHTTP1 = !!options.allowHTTP1;
+        options.ALPNProtocols = allowHTTP1 ? ['h2', 'http/1.1'] : ['h2'];
+        super(options);
+
+        if (onRequest)
+            this.on('request', onRequest);
+        this._http2ServerRequest = options.Http2ServerRequest || Http2ServerRequest;
+        this._http2ServerResponse = options.Http2ServerResponse || Http2ServerResponse;
+        this._serverIncomingMessage = options.Http1IncomingMessage || httpInternal.IncomingMessage;
+        this._serverServerResponse = options.Http1ServerResponse || httpInternal.ServerResponse;
+        this.httpKeepAlive = process.platform != 'esp32';
+
+        // Accepted sockets are HTTP/1 directs, which hand over to HTTP/2
+        // after the handshake if the client chose h2
+        this._httpServer = true;
+        this.on('connection', (socket) => {
+            if (handleSession(this, socket))
+                return;
+            if (allowHTTP1)
+                httpInternal.handleServerConn(this, socket);
+            else if (!this.emit('unknownProtocol', socket))
+                socket.destroy();
+        });
+    }
+}
+
+function createSecureServer(options, onRequest) {
+    return new Http2SecureServer(options, onRequest);
+}
+
+function createServer() {
+    throw new Error('HTTP/2 is only supported over TLS, use http2.createSecureServer()');
+}
+
+module.exports = {
+    constants,
+    createServer,
+    createSecureServer,
+    Http2SecureServer,
+    Http2ServerRequest,
+    Http2ServerResponse
+};
@@ -5,6 +5,7 @@ let httpInternal = require('internal/http');
 
 let url = require('url');
 let tls = require('tls');
+let http = require('http');
 
 /*
 function calculateServerName(options, req) {
@@ -30,171 +31,43 @@ function calculateServerName(options, req) {
     return servername;
 }*/
 
-class Agent {
+class Agent extends http.Agent {
     defaultPort = 443;
 
-    requests = {};
-    sockets = {};
-    freeSockets = {};
-
     constructor(options) {
-        this.options = Object.assign({}, options);
-        // don't confuse net and make it think that we're connecting to a pipe
-        this.options.path = null;
-
-        this.keepAlive = options && options.keepAlive !== undefined ? options.keepAlive : false;
-        this.keepAliveMsecs = options && options.keepAliveMsecs !== undefined ? options.keepAliveMsecs : 1000;
-        this.maxSockets = options && options.maxSockets !== undefined ? options.maxSockets : Infinity;
-        this.maxFreeSockets = options && options.maxFreeSockets !== undefined ? options.maxFreeSockets : 256;
-        this.timeout = options && options.timeout !== undefined ? options.timeout : 120000;
-    }
-
-    removeSocket(socket, options, name) {
-        if (!name)
-            name = this.getName(options);
-        var sets = [this.sockets, this.freeSockets];
-        for (var sk = 0; sk < sets.length; sk++) {
-            var sockets = sets[sk];
-            if (sockets[name]) {
-                var index = sockets[name].indexOf(socket);
-                if (index !== -1) {
-                    sockets[name].splice(index, 1);
-                    // Don't leak
-                    if (sockets[name].length === 0)
-                        delete sockets[name];
-                }
-            }
-        }
-
-        if (this.requests[name] && this.requests[name].length) {
-            var req = this.requests[name][0];
-            // If we are under maxSockets create a new one.
-            let socket = this.createConnection(options);
-            req._onSocket(socket, options);
-            this.sockets[name].push(socket);
-        }
-    }
-
-    freeSocket(socket, options) {
-        socket.setTimeout(0);
-
-        var name = this.getName(options);
-        if (this.requests[name] && this.requests[name].length) {
-            this.requests[name].shift()._onSocket(socket, options);
-            if (this.requests[name].length === 0) {
-                // don't leak
-                delete this.requests[name];
-            }
-        } else {
-            if (this.keepAlive) {
-                var freeSockets = this.freeSockets[name];
-                var freeLen = freeSockets ? freeSockets.length : 0;
-                var count = freeLen;
-                if (this.sockets[name])
-                    count += this.sockets[name].length;
-
-                if (count > this.maxSockets || freeLen >= this.maxFreeSockets) {
-                    socket.destroy();
-                } else if (this.keepSocketAlive(socket)) {
-                    freeSockets = freeSockets || [];
-                    this.freeSockets[name] = freeSockets;
-                    freeSockets.push(socket);
-                } else {
-                    // Implementation doesn't want to keep socket alive
-                    socket.destroy();
-                }
-            } else {
-                // Implementation doesn't want to keep socket alive
-                socket.destroy();
-            }
-        }
-    }
-
-    keepSocketAlive(socket) {
-        socket.setKeepAlive(true, this.keepAliveMsecs);
-        socket.unref();
-        return true;
-    }
-    reuseSocket(socket) {
-        socket.ref();
-    }
-
-    createConnection(options, cb) {
-        return tls.connect(options, cb);
+        super(options);
+        this._secureContexts = {};
     }
 
-    destroy() {
-        var sets = [this.freeSockets, this.sockets];
-        for (var s = 0; s < sets.length; s++) {
-            var set = sets[s];
-            var keys = Object.keys(set);
-            for (var v = 0; v < keys.length; v++) {
-                var setName = set[keys[v]];
-                for (var n = 0; n < setName.length; n++) {
-                    setName[n].destroy();
-                }
-            }
+    // One context per set of TLS options, so they are not parsed again for
+    // every connection. Part of the name, so the pool never gives a socket
+    // with other certificates
+    _getSecureContext(options) {
+        if (options.secureContext)
+            return options.secureContext;
+
+        let key = (options.ca || '') + '|' + (options.cert || '') + '|' + (options.key || '') + '|' + (options.ALPNProtocols || '');
+        let context = this._secureContexts[key];
+        if (!context) {
+            context = native.createTLSContext({
+                ca: options.ca || tls.rootCertificates,
+                cert: options.cert,
+                key: options.key,
+                ALPNProtocols: options.ALPNProtocols
+            }, false);
+            this._secureContexts[key] = context;
         }
+        return context;
     }
 
     getName(options) {
-        var name = options.host || 'localhost';
-
-        name += ':';
-        if (options.port)
-            name += options.port;
-
-        name += ':';
-        if (options.localAddress)
-            name += options.localAddress;
-
-        // Pacify parallel/test-http-agent-getname by only appending
-        // the ':' when options.family is set.
-        if (options.family === 4 || options.family === 6)
-            name += `:${options.family}`;
-
-        if (options.socketPath)
-            name += `:${options.socketPath}`;
-
-        return name;
+        return super.getName(options) + ':' + this._getSecureContext(options)._index;
     }
 
-    addRequest(request, options) {
+    createConnection(options, cb) {
         options = Object.assign({}, options);
-        Object.assign(options, this.options);
-        if (options.socketPath)
-            options.path = options.socketPath;
-        //        if (!options.servername)        // todo: is this even used?
-        //            options.servername = calculateServerName(options, request);
-
-        var name = this.getName(options);
-        if (!this.sockets[name]) {
-            this.sockets[name] = [];
-        }
-        var freeLen = this.freeSockets[name] ? this.freeSockets[name].length : 0;
-        var sockLen = freeLen + this.sockets[name].length;
-
-        if (freeLen) {
-            // we have a free socket, so use that.
-            var socket = this.freeSockets[name].shift();
-            if (!this.freeSockets[name].length)
-                delete this.freeSockets[name];
-
-            this.reuseSocket(socket, request);
-            request._onSocket(socket, options);
-            this.sockets[name].push(socket);
-        } else if (sockLen < this.maxSockets) {
-            // If we are under maxSockets create a new one.
-            let socket = this.createConnection(options);
-            request._onSocket(socket, options);
-            this.sockets[name].push(socket);
-        } else {
-            // We are over limit so we'll add it to the queue.
-            if (!this.requests[name]) {
-                this.requests[name] = [];
-            }
-            this.requests[name].push(request);
-        }
+        options.secureContext = this._getSecureContext(options);
+        return tls.connect(options, cb);
     }
 }
 let globalAgent = new Agent();
@@ -226,6 +99,15 @@ class Server extends tls.Server {
             httpInternal.handleServerConn(this, socket);
         });
     }
+
+    // low.js specific, see http.Server
+    route(method, path, handler) {
+        return httpInternal.serverRoute(this, method, path, handler);
+    }
+
+    unroute(method, path) {
+        return httpInternal.serverUnroute(this, method, path);
+    }
 }
 
 function createServer(options, acceptCallback) {
@@ -896,8 +896,60 @@ process.hrtime = function hrtime(time) {
     ];
 };
 
+// low.js specific: size of the JavaScript heap and, if enabled, usage and
+// fragmentation of the slab allocator behind it
+process.heapStats = native.heapStats;
+
+// low.js specific: event loop utilization and lag, pending callbacks, queue
+// depth and wait time of the data threads and open handles. Cheap enough to
+// be polled by a monitoring timer
+process.metrics = native.metrics;
+
+// low.js specific: sampling CPU profiler, also started by --cpu-prof. The
+// profile is in the .cpuprofile format of V8, so Chrome DevTools and other
+// tools for Node.js can show it
+process.startCpuProfile = function (interval) {
+    native.cpuProfileStart(interval);
+};
+process.stopCpuProfile = function () {
+    var json = native.cpuProfileStop();
+    return json === undefined ? null : JSON.parse(json);
+};
+
+// low.js specific: heap snapshot in the .heapsnapshot format and sampling of
+// allocations in the .heapprofile format, both for Chrome DevTools. While
+// sampling runs, snapshots include the allocation stacks of sampled objects
+process.writeHeapSnapshot = function (filename) {
+    if (filename === undefined) {
+        var d = new Date();
+        var pad = function (n) { return (n < 10 ? '0' : '') + n; };
+        filename = 'Heap-' + d.getFullYear() + pad(d.getMonth() + 1) + pad(d.getDate())
+            + '-' + pad(d.getHours()) + pad(d.getMinutes()) + pad(d.getSeconds())
+            + '-' + process.pid + '-0.heapsnapshot';
+    }
+    native.heapSnapshot(filename);
+    return filename;
+};
+process.startHeapSampling = function (interval) {
+    native.heapSamplingStart(interval);
+};
+process.stopHeapSampling = function () {
+    var json = native.heapSamplingStop();
+    return json === undefined ? null : JSON.parse(json);
+};
+
 native.processInfo(process);
 
+// Started by child_process.fork, talk to the parent
+if (process.env.NODE_CHANNEL_FD !== undefined && native.childChannel) {
+    const fd = parseInt(process.env.NODE_CHANNEL_FD, 10);
+    delete process.env.NODE_CHANNEL_FD;
+
+    require('internal/child_process').setupChannel(process, native.childChannel(fd));
+    if (process.env.NODE_UNIQUE_ID !== undefined)
+        require('cluster');
+}
+
 exports.console = require('console');
 
 
@@ -924,7 +976,7 @@ Buffer = require('buffer').Buffer;
 // DukTape push_buffer does not create a Node.JS buffer, make toString work
 Uint8Array.prototype.toString = ((oldFunc) => {
     return function (encoding, b, c) {
-        return new Buffer(this).toString(encoding);
+        return new Buffer(this).toString(encoding, b, c);
     }
 })(Uint8Array.prototype.toString);
 
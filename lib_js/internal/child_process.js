@@ -0,0 +1,282 @@
+'use strict';
+
+const EventEmitter = require('events').EventEmitter;
+const { StringDecoder } = require('string_decoder');
+const native = require('native');
+
+const {
+    ERR_IPC_CHANNEL_CLOSED,
+    ERR_IPC_DISCONNECTED,
+    ERR_IPC_ONE_PIPE,
+    ERR_INVALID_OPT_VALUE
+} = require('internal/errors').codes;
+
+// Must match LOWCHILDPROCESS_STDIO_*
+const STDIO_INHERIT = -1;
+const STDIO_IGNORE = -2;
+const STDIO_IPC = -3;
+const STDIO_PIPE = -4;
+
+// Messages are JSON, one per line, as with serialization 'json' of Node.js.
+// Messages with a cmd starting with NODE_ are internal (cluster) and emitted
+// as 'internalMessage'
+function setupChannel(target, fd) {
+    const net = require('net');
+    const channel = new net.Socket({ fd, readable: true, writable: true });
+    const decoder = new StringDecoder('utf8');
+    let pending = '';
+
+    target.channel = channel;
+    target.connected = true;
+
+    // Only keeps the loop alive while somebody listens
+    let refed = true;
+    function updateRef() {
+        let ref = target.connected && (target.listenerCount('message') > 0 ||
+            target.listenerCount('disconnect') > 0 || target.listenerCount('internalMessage') > 0);
+        if (ref != refed) {
+            refed = ref;
+            if (ref)
+                channel.ref();
+            else
+                channel.unref();
+        }
+    }
+    target.on('newListener', () => process.nextTick(updateRef));
+    target.on('removeListener', () => process.nextTick(updateRef));
+    updateRef();
+
+    channel.on('data', (chunk) => {
+        pending += decoder.write(chunk);
+
+        let pos;
+        while (target.connected && (pos = pending.indexOf('\n')) >= 0) {
+            let line = pending.slice(0, pos);
+            pending = pending.slice(pos + 1);
+
+            let message;
+            try {
+                message = JSON.parse(line);
+            } catch (e) {
+                target.emit('error', e);
+                continue;
+            }
+            if (message !== null && typeof message === 'object' && typeof message.cmd === 'string'
+                && message.cmd.startsWith('NODE_'))
+                target.emit('internalMessage', message);
+            else
+                target.emit('message', message);
+        }
+    });
+    // The other side went away, that is the normal way of disconnecting
+    channel.on('error', () => { });
+    channel.on('close', () => target._disconnect());
+
+    target.send = function (message, handle, options, callback) {
+        if (typeof handle === 'function') {
+            callback = handle;
+            handle = undefined;
+        } else if (typeof options === 'function')
+            callback = options;
+
+        if (message === undefined)
+            throw new TypeError('"message" argument is required');
+        if (handle)
+            throw new Error('sending handles is not supported');
+
+        if (!this.connected) {
+            const err = new ERR_IPC_CHANNEL_CLOSED();
+            if (callback)
+                process.nextTick(callback, err);
+            else
+                process.nextTick(() => this.emit('error', err));
+            return false;
+        }
+
+        return channel.write(JSON.stringify(message) + '\n', callback ? (err) => callback(err || null) : undefined);
+    };
+
+    target.disconnect = function () {
+        if (!this.connected) {
+            this.emit('error', new ERR_IPC_DISCONNECTED());
+            return;
+        }
+        channel.end();
+        this._disconnect();
+    };
+
+    target._disconnect = function () {
+        if (!this.connected)
+            return;
+
+        this.connected = false;
+        updateRef();
+        process.nextTick(() => this.emit('disconnect'));
+    };
+}
+
+// Maps the stdio option to the values native.childSpawn understands
+function normalizeStdio(stdio) {
+    if (stdio === undefined || stdio === null)
+        stdio = 'inherit';
+    if (typeof stdio === 'string')
+        stdio = [stdio, stdio, stdio];
+    if (!Array.isArray(stdio))
+        throw new ERR_INVALID_OPT_VALUE('stdio', stdio);
+
+    let result = [];
+    let ipc = -1;
+    for (let i = 0; i < stdio.length || i < 3; i++) {
+        let value = stdio[i];
+        if (value === undefined || value === null)
+            value = i < 3 ? 'inherit' : 'ignore';
+
+        if (value === 'ipc') {
+            if (ipc >= 0)
+                throw new ERR_IPC_ONE_PIPE();
+            ipc = i;
+            result.push(STDIO_IPC);
+        } else if (value === 'inherit')
+            result.push(i < 3 ? STDIO_INHERIT : STDIO_IGNORE);
+        else if (value === 'ignore')
+            result.push(STDIO_IGNORE);
+        else if (value === 'pipe' || value === 'overlapped')
+            result.push(STDIO_PIPE);
+        else if (typeof value === 'number' && value >= 0)
+            result.push(value | 0);
+        else if (value === process.stdin || value === process.stdout || value === process.stderr)
+            result.push(value === process.stdin ? 0 : (value === process.stdout ? 1 : 2));
+        else
+            throw new ERR_INVALID_OPT_VALUE('stdio', value);
+    }
+    return { stdio: result, ipc };
+}
+
+class ChildProcess extends EventEmitter {
+    constructor() {
+        super();
+
+        this.pid = undefined;
+        this.exitCode = null;
+        this.signalCode = null;
+        this.killed = false;
+        this.connected = false;
+        this.spawnfile = null;
+        this.spawnargs = [];
+
+        this.stdin = null;
+        this.stdout = null;
+        this.stderr = null;
+        this.stdio = [null, null, null];
+
+        this._closesNeeded = 1;
+        this._closesGot = 0;
+        this._ref = true;
+    }
+
+    // options: file, args (including argv[0]), envPairs, cwd, stdio, detached
+    spawn(options) {
+        const { stdio, ipc } = normalizeStdio(options.stdio);
+
+        // Tells the child where its end of the channel is
+        let envPairs = options.envPairs;
+        if (ipc >= 0)
+            envPairs = envPairs.concat(['NODE_CHANNEL_FD=' + ipc]);
+
+        this.spawnfile = options.file;
+        this.spawnargs = options.args;
+        try {
+            this._native = native.childSpawn(this, options.file, options.args, envPairs,
+                options.cwd || null, stdio, this._onExit.bind(this), !!options.detached);
+        } catch (err) {
+            err.syscall = 'spawn ' + options.file;
+            err.path = options.file;
+            err.spawnargs = options.args.slice(1);
+            process.nextTick(() => {
+                this.emit('error', err);
+                this._maybeClose();
+            });
+            return err;
+        }
+
+        // Our ends of the pipes, the child exiting does not mean that all
+        // its output has been read, so 'close' waits for them
+        for (let i = 0; i < stdio.length; i++) {
+            if (i == ipc || stdio[i] < 0)
+                continue;
+
+            const net = require('net');
+            const socket = new net.Socket({ fd: stdio[i], readable: i != 0, writable: i == 0 || i > 2 });
+            if (i == 0)
+                socket.on('finish', () => socket.destroy());
+            else {
+                if (i <= 2)
+                    socket.on('end', () => socket.destroy());
+                this._closesNeeded++;
+                socket.once('close', () => this._maybeClose());
+            }
+            this.stdio[i] = socket;
+        }
+        this.stdin = this.stdio[0];
+        this.stdout = this.stdio[1];
+        this.stderr = this.stdio[2];
+
+        if (ipc >= 0) {
+            this._closesNeeded++;
+            setupChannel(this, stdio[ipc]);
+            this.once('disconnect', () => this._maybeClose());
+        }
+        if (!this._ref)
+            native.childRef(this._native, false);
+        return null;
+    }
+
+    _onExit(code, signal) {
+        this.exitCode = code;
+        this.signalCode = signal;
+
+        this.emit('exit', code, signal);
+        this._maybeClose();
+    }
+
+    _maybeClose() {
+        if (++this._closesGot == this._closesNeeded)
+            this.emit('close', this.exitCode, this.signalCode);
+    }
+
+    kill(signal) {
+        if (this._native === undefined || this.exitCode !== null || this.signalCode !== null)
+            return false;
+
+        try {
+            native.childKill(this._native, signal === undefined ? 'SIGTERM' : signal);
+        } catch (err) {
+            if (err.code == 'ESRCH')
+                return false;
+            if (err instanceof TypeError)
+                throw err;
+            this.emit('error', err);
+            return false;
+        }
+
+        this.killed = true;
+        return true;
+    }
+
+    ref() {
+        this._ref = true;
+        if (this._native !== undefined)
+            native.childRef(this._native, true);
+    }
+    unref() {
+        this._ref = false;
+        if (this._native !== undefined)
+            native.childRef(this._native, false);
+    }
+}
+
+module.exports = {
+    ChildProcess,
+    setupChannel,
+    normalizeStdio
+};
@@ -7,7 +7,11 @@ let stream = require('stream');
 let url = require('url');
 
 const {
-    ERR_UNESCAPED_CHARACTERS
+    ERR_UNESCAPED_CHARACTERS,
+    ERR_INVALID_ARG_TYPE,
+    ERR_INVALID_HTTP_TOKEN,
+    ERR_HTTP_INVALID_HEADER_VALUE,
+    ERR_HTTP_INVALID_STATUS_CODE
 } = require('internal/errors').codes;
 
 const INVALID_PATH_REGEX = /[^\u0021-\u00ff]/;
@@ -120,8 +124,31 @@ const STATUS_CODES = {
     511: 'Network Authentication Required' // RFC 6585
 };
 
+// Well-known header names, header blocks refer to them by index
+const headerNames = native.httpHeaderNames();
+
 const discard2headers = { 'age': 1, 'authorization': 1, 'content-length': 1, 'content-type': 1, 'etag': 1, 'expires': 1, 'from': 1, 'host': 1, 'if-modified-since': 1, 'if-unmodified-since': 1, 'last-modified': 1, 'location': 1, 'max-forwards': 1, 'proxy-authorization': 1, 'referer': 1, 'retry-after': 1, 'user-agent': 1 };
 
+// Names are lower case already, the parser does this
+function headersFromRaw(raw) {
+    let headers = {};
+    for (let i = 0; i + 1 < raw.length; i += 2) {
+        let key = raw[i];
+        let value = raw[i + 1];
+
+        if (headers[key]) {
+            if (key == 'set-cookie')
+                headers[key].push(value);
+            else if (!discard2headers[key])
+                headers[key] += ',' + value;
+        } else if (key == 'set-cookie')
+            headers[key] = [value];
+        else
+            headers[key] = value;
+    }
+    return headers;
+}
+
 class IncomingMessage extends stream.Readable {
     // event "aborted"
     aborted = false;
@@ -129,7 +156,7 @@ class IncomingMessage extends stream.Readable {
     constructor() {
         super({
             read(size) {
-                if (!this.connection || this.connection.destroyed)
+                if (!this.connection || this.connection.destroyed || this._piping)
                     return;
 
                 let buf = new Buffer(size);
@@ -149,45 +176,9 @@ class IncomingMessage extends stream.Readable {
 
                     if (this.connection._timeout)
                         this.connection._timeout.refresh();
-                    if (bytesRead == 0) {
-                        this.rawTrailers = trailers;
-                        this.trailers = {};
-
-                        for (let i = 0; i + 1 < trailers.length; i += 2) {
-                            let key = trailers[i];
-                            let value = trailers[i + 1];
-
-                            key = key.toLowerCase();
-                            if (this.trailers[key]) {
-                                if (key == 'set-cookie')
-                                    this.trailers[key] = [value];
-                                else if (!discard2headers[key])
-                                    this.trailers[key] += ',' + value;
-                            } else if (key == 'set-cookie')
-                                this.trailers[key] = [value];
-                            else
-                                this.trailers[key] = value;
-                        }
-
-                        this.push(null);
-                        if (!this._isServer) {
-                            if(this._httpMain.agent) {
-                                let socket = this.socket;
-                                this.connection = this.socket = null;
-                                this._httpMain.connection = this._httpMain.socket = null;
-
-                                delete socket._httpSetup;
-                                if (reuse) {
-                                    socket._socketHTTPWrapped = false;
-                                    this._httpMain.agent.freeSocket(socket, this._httpMain._agentOptions);
-                                } else {
-                                    this._httpMain.agent.removeSocket(socket, this._httpMain._agentOptions);
-                                    socket.destroy();
-                                }
-                            }
-                            this._httpMain.destroy();
-                        }
-                } else {
+                    if (bytesRead == 0)
+                        this._bodyDone(trailers, reuse);
+                    else {
                         this.connection.bytesRead += bytesReadSocket;
                         this.push(bytesRead != size ? buf.slice(0, bytesRead) : buf);
                     }
@@ -200,6 +191,92 @@ class IncomingMessage extends stream.Readable {
         });
     }
 
+    // The headers come as compact block from the parser, they are only
+    // converted to strings when used
+    get rawHeaders() {
+        if (this._rawHeaders === undefined)
+            this._rawHeaders = this._headerBlock ? native.httpRawHeaders(this._headerBlock, headerNames) : [];
+        return this._rawHeaders;
+    }
+    set rawHeaders(value) {
+        this._rawHeaders = value;
+    }
+
+    get headers() {
+        if (this._headers === undefined)
+            this._headers = headersFromRaw(this.rawHeaders);
+        return this._headers;
+    }
+    set headers(value) {
+        this._headers = value;
+    }
+
+    // low.js specific: writes the rest of the body to fd of fs.open without
+    // handing the data to JavaScript, then calls callback(err, bytesWritten)
+    // and ends the stream. Meanwhile pipedBytes are the bytes written so far
+    pipeToFile(fd, callback) {
+        if (!this.connection || this.connection.destroyed || this._piping) {
+            process.nextTick(callback, new Error('body is not readable'));
+            return;
+        }
+
+        let socket = this.connection;
+        this._piping = true;
+        this._pipedBytes = 0;
+        socket._socketReading = true;
+        socket._updateRef();
+
+        native.httpPipeBody(socket._socketFD, fd, (err, bytesWritten, bytesReadSocket, trailers, reuse) => {
+            this._piping = false;
+            socket._socketReading = false;
+            socket._updateRef();
+            if (err) {
+                callback(err);
+                return;
+            }
+
+            this._pipedBytes = bytesWritten;
+            socket.bytesRead += bytesReadSocket;
+            if (socket._timeout)
+                socket._timeout.refresh();
+
+            // Nothing was read, so end is only emitted when flowing
+            this._bodyDone(trailers, reuse);
+            this.resume();
+            callback(null, bytesWritten);
+        });
+    }
+
+    get pipedBytes() {
+        if (this._piping && this.connection)
+            return native.httpPipeProgress(this.connection._socketFD) || 0;
+        return this._pipedBytes || 0;
+    }
+
+    _bodyDone(trailers, reuse) {
+        this.rawTrailers = trailers;
+        this.trailers = headersFromRaw(trailers);
+
+        this.push(null);
+        if (!this._isServer) {
+            if(this._httpMain.agent) {
+                let socket = this.socket;
+                this.connection = this.socket = null;
+                this._httpMain.connection = this._httpMain.socket = null;
+
+                delete socket._httpSetup;
+                if (reuse) {
+                    socket._socketHTTPWrapped = false;
+                    this._httpMain.agent.freeSocket(socket, this._httpMain._agentOptions);
+                } else {
+                    this._httpMain.agent.removeSocket(socket, this._httpMain._agentOptions);
+                    socket.destroy();
+                }
+            }
+            this._httpMain.destroy();
+        }
+    }
+
     setTimeout(msecs, callback) { }
 }
 
@@ -208,6 +285,7 @@ class ServerResponse extends stream.Writable {
     statusCode = "200";
     sendDate = true;
     headersSent = false;
+    shouldKeepAlive = false;
 
     _httpHeadersLowerCase = {};
     _httpHeadersLower2Name = {};
@@ -280,35 +358,81 @@ class ServerResponse extends stream.Writable {
         let contentLen = this._httpHeadersLowerCase['content-length'];
         let chunked = false;
 
-        /*
-                // Duktape seems to return 2018-08-09 21:27:43.806Z
-                // instead of the string which ends with GMT
-                // But in any case, we have to think about this because with ESP32
-                // the date is not always set correctly...
-                if (this.sendDate) {
-                    this._httpHeadersLower2Name["date"] = "Date";
-                    this._httpHeadersLowerCase["date"] = new Date().toUTCString();
-                }
-        */
-        if(!this._httpHeadersLower2Name["connection"]) {
-            // Close by default, as embedded system cannot handle many sockets
-            this._httpHeadersLower2Name["connection"] = "Connection";
-            this._httpHeadersLowerCase["connection"] = "close";
+        // Headers added natively from pre-encoded lines, LOW_HTTP_HEAD_*
+        // The date is cached there and left out if the clock is not set,
+        // as it happens on ESP32
+        let flags = 0;
+        if (this.sendDate && this._httpHeadersLowerCase['date'] === undefined)
+            flags |= 8;
+
+        // Compressed bodies have an unknown length, so we need chunked encoding.
+        // Responses without body keep their headers as they are
+        let compressMode = 0;
+        let statusCode = this.statusCode | 0;
+        if (this._compression && this._httpMessage.httpVersion == '1.1'
+         && this._httpMessage.method != 'HEAD'
+         && statusCode >= 200 && statusCode != 204 && statusCode != 304
+         && this._httpHeadersLowerCase['content-encoding'] === undefined) {
+            compressMode = this._compression == 'gzip' ? 3 : 1;     // LowZlibMode
+            contentLen = undefined;
+            delete this._httpHeadersLower2Name["content-length"];
+            delete this._httpHeadersLowerCase["content-length"];
+            this._httpHeadersLower2Name["content-encoding"] = "Content-Encoding";
+            this._httpHeadersLowerCase["content-encoding"] = this._compression;
+            if (!this._httpHeadersLower2Name["vary"]) {
+                this._httpHeadersLower2Name["vary"] = "Vary";
+                this._httpHeadersLowerCase["vary"] = "Accept-Encoding";
+            }
         }
+
         if (contentLen !== undefined)
             len = contentLen | 0;  // to int
         else if (this._httpMessage.httpVersion == '1.1') {
-            this._httpHeadersLower2Name["transfer-encoding"] = "Transfer-Encoding";
-            this._httpHeadersLowerCase["transfer-encoding"] = "chunked";
+            if (this._httpHeadersLowerCase["transfer-encoding"] === undefined)
+                flags |= 4;
+            else
+                this._httpHeadersLowerCase["transfer-encoding"] = "chunked";
             chunked = true;
         }
 
-        let headersAsTxt = 'HTTP/1.1 ' + this.statusCode + ' ' + this.statusMessage + '\r\n';
+        // Without length the end of the body is the end of the connection
+        if (len < 0 && !chunked)
+            this.shouldKeepAlive = false;
+        // Close if the server does not do keep-alive, as embedded systems
+        // cannot handle many sockets
+        if (this._httpHeadersLowerCase["connection"] === undefined)
+            flags |= this.shouldKeepAlive ? 1 : 2;
+
+        let headers = [];
         for (let name in this._httpHeadersLowerCase)
-            headersAsTxt += this._httpHeadersLower2Name[name] + ': ' + this._httpHeadersLowerCase[name] + '\r\n';
-        headersAsTxt += '\r\n';
+            headers.push(this._httpHeadersLower2Name[name], this._httpHeadersLowerCase[name]);
+
+        // Standard status lines are pre-encoded natively
+        let status = this.statusMessage === STATUS_CODES[this.statusCode]
+            ? this.statusCode | 0
+            : 'HTTP/1.1 ' + this.statusCode + ' ' + this.statusMessage;
+        native.httpWriteHead(this.connection._socketFD, status, headers, len, chunked, compressMode, flags);
+    }
 
-        native.httpWriteHead(this.connection._socketFD, headersAsTxt, len, chunked);
+    // low.js specific: compresses the response body natively while it is
+    // written. Without encoding, picks gzip or deflate from the
+    // Accept-Encoding header of the request. Returns the encoding used or null
+    setCompression(encoding) {
+        if (this.headersSent || !native.zlibCreate)
+            return null;
+
+        if (encoding === undefined) {
+            let accept = this._httpMessage.headers['accept-encoding'] || '';
+            let allowed = (name) => {
+                let match = accept.match(new RegExp('(?:^|,)\\s*' + name + '\\s*(?:;\\s*q=([0-9.]+))?\\s*(?:,|$)', 'i'));
+                return match && (match[1] === undefined || parseFloat(match[1]) > 0);
+            };
+            encoding = allowed('gzip') ? 'gzip' : allowed('deflate') ? 'deflate' : null;
+        } else if (encoding !== null && encoding !== 'gzip' && encoding !== 'deflate')
+            throw new TypeError('compression encoding must be gzip, deflate or null');
+
+        this._compression = encoding;
+        return encoding;
     }
 
     _implicitHeader() {
@@ -395,25 +519,44 @@ function handleServerConn(server, socket) {
         }
         inError = true;
 
-        if (!server.emit('clientError', err, socket))
-            socket.end('HTTP/1.1 400 Bad Request\r\n\r\n');
+        if (!server.emit('clientError', err, socket)) {
+            if (err.code == 'ERR_HTTP_REQUEST_TIMEOUT')
+                socket.end('HTTP/1.1 408 Request Timeout\r\nConnection: close\r\n\r\n');
+            else
+                socket.end('HTTP/1.1 400 Bad Request\r\n\r\n');
+        }
     }
     socket.on('error', handleError);
 
     socket.on('timeout', () => {
         socket.destroy();
     });
-    socket.setTimeout(server.timeout);
-
-    native.httpGetRequest(socket._socketFD, (error, data, bytesRead) => {
+    // Until a request reaches us the web thread enforces headersTimeout.
+    // Requests answered by native routes never reach us
+    if (!(server.headersTimeout > 0))
+        socket.setTimeout(server.timeout);
+
+    // Called for every request on the connection. Between requests the
+    // connection is watched by the web thread with keepAliveTimeout and
+    // headersTimeout, which calls us without data when it is over. route is
+    // the handler id of a matching JavaScript route, or -1
+    let requests = 0;
+    native.httpGetRequest(socket._socketFD, (error, data, bytesRead, headerBlock, route) => {
         if (error) {
             socket.emit('error', error);
             return;
         }
+        if (!data) {
+            socket._socketHTTPWrapped = false;
+            socket.destroy();
+            return;
+        }
 
         socket.bytesRead += bytesRead;
         socket._socketReading = false;
         socket._updateRef();
+        requests++;
+        socket.setTimeout(server.timeout);
 
         let message = new server._serverIncomingMessage();
         let response = new server._serverServerResponse();
@@ -429,28 +572,24 @@ function handleServerConn(server, socket) {
         message.httpVersion = data[2];
         message.httpVersionMajor = data[2].charAt(0) | 0;
         message.httpVersionMinor = data[2].charAt(2) | 0;
-
-        message.rawHeaders = data.slice(3);
-        message.headers = {};
-
-        let upgrade = false;
-        for (let i = 3; i + 1 < data.length; i += 2) {
-            let key = data[i];
-            let value = data[i + 1];
-
-            key = key.toLowerCase();
-            if (key == 'upgrade')
-                upgrade = true;
-            if (message.headers[key]) {
-                if (key == 'set-cookie')
-                    message.headers[key] = [value];
-                else if (!discard2headers[key])
-                    message.headers[key] += ',' + value;
-            } else if (key == 'set-cookie')
-                message.headers[key] = [value];
-            else
-                message.headers[key] = value;
-        }
+        message._headerBlock = headerBlock;
+
+        let upgrade = native.httpHeader(headerBlock, 'upgrade') !== undefined;
+        let connection = native.httpHeader(headerBlock, 'connection') || '';
+        response.shouldKeepAlive = server.httpKeepAlive &&
+            !(server.maxRequestsPerSocket > 0 && requests >= server.maxRequestsPerSocket) &&
+            (message.httpVersion == '1.1' ? !/(^|,)\s*close\s*(,|$)/i.test(connection)
+                                          : /(^|,)\s*keep-alive\s*(,|$)/i.test(connection));
+
+        // Once both are done, the connection waits for the next request
+        // without a timer in JavaScript
+        let request = requests, pending = 2;
+        let park = () => {
+            if (--pending == 0 && request == requests && !socket.destroyed)
+                socket.setTimeout(0);
+        };
+        message.once('end', park);
+        response.once('finish', park);
 
         message.on('error', handleError);
         response.on('error', handleError);
@@ -462,8 +601,12 @@ function handleServerConn(server, socket) {
             if (server.emit('upgrade', message, socket, buffer))
                 return;
         }
-        server.emit('request', message, response);
-    });
+        let handler = route >= 0 && server._routeHandlers ? server._routeHandlers[route] : undefined;
+        if (handler)
+            handler.call(server, message, response);
+        else
+            server.emit('request', message, response);
+    }, server.headersTimeout | 0, server.keepAliveTimeout | 0);
 }
 
 const tokenRegExp = /^[\^_`a-zA-Z\-0-9!#$%&'*+.|~]+$/;
@@ -476,6 +619,103 @@ function checkIsHttpToken(val) {
   return tokenRegExp.test(val);
 }
 
+// Status line and headers of a native route. Content-Length, Connection and
+// Date are added by the web thread for every response
+const routeSkipHeaders = /^(content-length|connection|date|transfer-encoding)$/i;
+
+function routeHead(status, headers) {
+    status = status === undefined ? 200 : status | 0;
+    if (status < 100 || status > 999)
+        throw new ERR_HTTP_INVALID_STATUS_CODE(status);
+
+    let head = 'HTTP/1.1 ' + status + ' ' + (STATUS_CODES[status] || 'unknown') + '\r\n';
+    for (let name in headers) {
+        if (!checkIsHttpToken(name))
+            throw new ERR_INVALID_HTTP_TOKEN('Header name', name);
+        if (routeSkipHeaders.test(name))
+            continue;
+
+        let values = Array.isArray(headers[name]) ? headers[name] : [headers[name]];
+        for (let i = 0; i < values.length; i++) {
+            let value = String(values[i]);
+            if (/[\r\n]/.test(value))
+                throw new ERR_HTTP_INVALID_HEADER_VALUE(value, name);
+            head += name + ': ' + value + '\r\n';
+        }
+    }
+    return head;
+}
+
+// The web thread always gets the whole table, so it never sees a half one
+function syncRoutes(server) {
+    if (server.listening)
+        native.httpRoutes(server._serverFD, !!server.httpKeepAlive, server._routes);
+}
+
+function removeRoute(server, method, path) {
+    let routes = server._routes || [];
+    for (let i = 0; i < routes.length; i++) {
+        if (routes[i][0] == method && routes[i][1] == path) {
+            if (routes[i][2] == 0)
+                delete server._routeHandlers[routes[i][3]];
+            routes.splice(i, 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Server.prototype.route, see lib_js/http.js
+function serverRoute(server, method, path, handler) {
+    if (typeof method !== 'string')
+        throw new ERR_INVALID_ARG_TYPE('method', 'string', method);
+    if (typeof path !== 'string')
+        throw new ERR_INVALID_ARG_TYPE('path', 'string', path);
+    method = method.toUpperCase();
+
+    if (!server._routes) {
+        server._routes = [];
+        server._routeHandlers = {};
+        server._routeNextID = 0;
+        server.on('listening', () => {
+            syncRoutes(server);
+        });
+    }
+
+    let entry;
+    if (typeof handler === 'function') {
+        let id = server._routeNextID++;
+        server._routeHandlers[id] = handler;
+        entry = [method, path, 0, id];
+    } else if (handler && typeof handler === 'object') {
+        let headers = Object.assign({}, handler.headers);
+        let status = handler.status;
+        if (handler.redirect !== undefined) {
+            headers['Location'] = String(handler.redirect);
+            if (status === undefined)
+                status = 302;
+        }
+
+        if (handler.file !== undefined)
+            entry = [method, path, 2, String(handler.file), routeHead(status, headers)];
+        else
+            entry = [method, path, 1, handler.body === undefined ? '' : handler.body, routeHead(status, headers)];
+    } else
+        throw new ERR_INVALID_ARG_TYPE('handler', ['Function', 'Object'], handler);
+
+    removeRoute(server, method, path);
+    server._routes.push(entry);
+    syncRoutes(server);
+    return server;
+}
+
+// Server.prototype.unroute
+function serverUnroute(server, method, path) {
+    if (removeRoute(server, String(method).toUpperCase(), path))
+        syncRoutes(server);
+    return server;
+}
+
 class ClientRequest extends stream.Writable {
     constructor(options, cb) {
         super({
@@ -722,7 +962,8 @@ class ClientRequest extends stream.Writable {
         this.connection = this.socket = socket;
         socket.setTimeout(this.timeout);
 
-        native.httpGetRequest(socket._socketFD, (error, data, bytesRead) => {
+        // With agent, the parser stays on the socket for the next request
+        native.httpGetRequest(socket._socketFD, (error, data, bytesRead, headerBlock) => {
             if (error) {
                 socket.emit('error', error);
                 return;
@@ -744,28 +985,9 @@ class ClientRequest extends stream.Writable {
             message.httpVersionMinor = data[0].charAt(2) | 0;
             message.statusCode = data[1] | 0;
             message.statusMessage = data[2];
+            message._headerBlock = headerBlock;
 
-            message.rawHeaders = data.slice(3);
-            message.headers = {};
-
-            let upgrade = false;
-            for (let i = 3; i + 1 < data.length; i += 2) {
-                let key = data[i];
-                let value = data[i + 1];
-
-                key = key.toLowerCase();
-                if (key == 'upgrade')
-                    upgrade = true;
-                if (message.headers[key]) {
-                    if (key == 'set-cookie')
-                        message.headers[key] = [value];
-                    else if (!discard2headers[key])
-                        message.headers[key] += ',' + value;
-                } else if (key == 'set-cookie')
-                    message.headers[key] = [value];
-                else
-                    message.headers[key] = value;
-            }
+            let upgrade = native.httpHeader(headerBlock, 'upgrade') !== undefined;
 
             if (upgrade && this.listenerCount('upgrade')) {
                 let buffer = native.httpDetach(socket._socketFD);
@@ -775,7 +997,7 @@ class ClientRequest extends stream.Writable {
                     return;
             }
             this.emit('response', message);
-        });
+        }, !!this.agent);
 
         this.uncork();
         if (this._delayedEOFCallback) {
@@ -809,12 +1031,11 @@ class ClientRequest extends stream.Writable {
             chunked = true;
         }
 
-        let headersAsTxt = this.method + ' ' + this.path + ' HTTP/1.1\r\n';
+        let headers = [];
         for (let name in this._httpHeadersLowerCase)
-            headersAsTxt += this._httpHeadersLower2Name[name] + ': ' + this._httpHeadersLowerCase[name] + '\r\n';
-        headersAsTxt += '\r\n';
+            headers.push(this._httpHeadersLower2Name[name], this._httpHeadersLowerCase[name]);
 
-        native.httpWriteHead(this.connection._socketFD, headersAsTxt, len, chunked);
+        native.httpWriteHead(this.connection._socketFD, this.method + ' ' + this.path + ' HTTP/1.1', headers, len, chunked);
     }
 
     abort() {
@@ -838,5 +1059,7 @@ module.exports = {
     IncomingMessage,
     ServerResponse,
     handleServerConn,
+    serverRoute,
+    serverUnroute,
     ClientRequest
 }
\ No newline at end of file
@@ -0,0 +1,254 @@
+'use strict';
+
+// low.js specific: WebSockets (RFC 6455) on upgraded HTTP server sockets.
+// Frames are parsed, unmasked and put together by the web thread, ping and
+// close are answered there, JavaScript only sees whole messages
+
+let native = require('native');
+let events = require('events');
+let crypto = require('crypto');
+
+// What the native side calls us with, see LowWebSocketDirect.h
+const OPCODE_CONTINUATION = 0;
+const OPCODE_TEXT = 1;
+const OPCODE_BINARY = 2;
+const OPCODE_CLOSE = 8;
+const OPCODE_PING = 9;
+const OPCODE_PONG = 10;
+const EVENT_DRAIN = -1;
+const EVENT_ERROR = -2;
+
+const GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11';
+
+// How long we wait for the answer to our close frame
+const CLOSE_TIMEOUT = 30000;
+
+const MAX_PAYLOAD = process.platform == 'esp32' ? 64 * 1024 : 100 * 1024 * 1024;
+
+class WebSocket extends events.EventEmitter {
+    static CONNECTING = 0;
+    static OPEN = 1;
+    static CLOSING = 2;
+    static CLOSED = 3;
+
+    readyState = WebSocket.OPEN;
+    bufferedAmount = 0;
+    protocol = '';
+
+    constructor(socket) {
+        super();
+
+        this._socket = socket;
+        this._socketFD = socket._socketFD;
+        this._groups = null;
+        this._fragmented = false;
+
+        socket.on('error', (err) => {
+            this.emit('error', err);
+        });
+        socket.on('close', () => {
+            this._closed(1006, '');
+        });
+    }
+
+    // options: binary (default: true unless data is a string), fin
+    send(data, options, callback) {
+        if (typeof options === 'function') {
+            callback = options;
+            options = undefined;
+        }
+        if (typeof data === 'number')
+            data = data.toString();
+
+        let binary = options && options.binary !== undefined ? options.binary : typeof data !== 'string';
+        let fin = !options || options.fin === undefined || !!options.fin;
+        let opcode = this._fragmented ? OPCODE_CONTINUATION : (binary ? OPCODE_BINARY : OPCODE_TEXT);
+
+        let queued = this.readyState == WebSocket.OPEN ? native.wsSend(this._socketFD, opcode, data, fin) : -1;
+        let err = queued < 0 ? new Error('WebSocket is not open') : null;
+        if (!err) {
+            this._fragmented = !fin;
+            this.bufferedAmount = queued;
+        }
+
+        if (callback)
+            process.nextTick(callback, err);
+        else if (err)
+            throw err;
+    }
+
+    ping(data, callback) {
+        if (data === undefined)
+            data = '';
+        else if (typeof data === 'number')
+            data = data.toString();
+        if (Buffer.byteLength(data) > 125)
+            throw new RangeError('The data size must not be greater than 125 bytes');
+
+        let queued = this.readyState == WebSocket.OPEN ? native.wsSend(this._socketFD, OPCODE_PING, data) : -1;
+        let err = queued < 0 ? new Error('WebSocket is not open') : null;
+        if (callback)
+            process.nextTick(callback, err);
+    }
+
+    close(code, reason) {
+        if (this.readyState != WebSocket.OPEN)
+            return;
+        this.readyState = WebSocket.CLOSING;
+
+        if (native.wsClose(this._socketFD, code | 0, reason === undefined ? '' : String(reason)) < 0) {
+            this.terminate();
+            return;
+        }
+        this._closeTimer = setTimeout(() => {
+            this.terminate();
+        }, CLOSE_TIMEOUT);
+    }
+
+    terminate() {
+        this._socket.destroy();
+    }
+
+    _onEvent(type, data, code) {
+        switch (type) {
+            case OPCODE_TEXT:
+                this.emit('message', data, false);
+                break;
+
+            case OPCODE_BINARY:
+                this.emit('message', data, true);
+                break;
+
+            case OPCODE_PONG:
+                this.emit('pong', data);
+                break;
+
+            case OPCODE_CLOSE:
+                // Handshake done, the native side sent or echoed the close
+                // frame already
+                this._closed(code, data);
+                break;
+
+            case EVENT_DRAIN:
+                this.bufferedAmount = 0;
+                this.emit('drain');
+                break;
+
+            case EVENT_ERROR:
+                this.emit('error', data);
+                this._closed(1006, '');
+                break;
+        }
+    }
+
+    _closed(code, reason) {
+        if (this.readyState == WebSocket.CLOSED)
+            return;
+        this.readyState = WebSocket.CLOSED;
+
+        if (this._closeTimer) {
+            clearTimeout(this._closeTimer);
+            this._closeTimer = null;
+        }
+        if (this._groups) {
+            for (let group of this._groups)
+                group.delete(this);
+        }
+
+        this._socket.destroy();
+        this.emit('close', code, reason);
+    }
+}
+
+// Sockets which get the same messages. broadcast() frames the message once
+// and queues it to all sockets without calling into JavaScript per socket
+class WebSocketGroup {
+    constructor() {
+        this.clients = new Set();
+        this._fds = null;
+    }
+
+    get size() {
+        return this.clients.size;
+    }
+
+    add(ws) {
+        if (ws.readyState != WebSocket.OPEN || this.clients.has(ws))
+            return this;
+
+        this.clients.add(ws);
+        if (!ws._groups)
+            ws._groups = new Set();
+        ws._groups.add(this);
+        this._fds = null;
+        return this;
+    }
+
+    delete(ws) {
+        if (!this.clients.delete(ws))
+            return false;
+
+        ws._groups.delete(this);
+        this._fds = null;
+        return true;
+    }
+
+    has(ws) {
+        return this.clients.has(ws);
+    }
+
+    // options: binary, except (a WebSocket which does not get the message).
+    // Returns the number of sockets the message was queued to
+    broadcast(data, options) {
+        if (typeof data === 'number')
+            data = data.toString();
+        if (!this._fds) {
+            this._fds = [];
+            for (let ws of this.clients)
+                this._fds.push(ws._socketFD);
+        }
+
+        let binary = options && options.binary !== undefined ? options.binary : typeof data !== 'string';
+        return native.wsBroadcast(this._fds, binary ? OPCODE_BINARY : OPCODE_TEXT, data,
+            options && options.except ? options.except._socketFD : -1);
+    }
+}
+
+// Answers the upgrade request and hands the socket to the web thread.
+// Returns the WebSocket, or null if the request is not a valid WebSocket
+// handshake, in which case the socket is closed with 400 Bad Request.
+// options: maxPayload (bytes, per message), protocol
+function acceptWebSocket(req, socket, head, options) {
+    let key = req.headers['sec-websocket-key'];
+    let upgrade = req.headers['upgrade'];
+    if (req.method != 'GET' || !upgrade || upgrade.toLowerCase() != 'websocket'
+     || req.headers['sec-websocket-version'] != '13'
+     || !key || !/^[+/0-9A-Za-z]{22}==$/.test(key)) {
+        socket.end('HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n');
+        return null;
+    }
+
+    let accept = crypto.createHash('sha1').update(key + GUID).digest('base64');
+    let response = 'HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ' + accept + '\r\n';
+    if (options && options.protocol)
+        response += 'Sec-WebSocket-Protocol: ' + options.protocol + '\r\n';
+    response += '\r\n';
+
+    let ws = new WebSocket(socket);
+    if (options && options.protocol)
+        ws.protocol = options.protocol;
+
+    socket.setTimeout(0);
+    native.wsAttach(socket._socketFD, response, head && head.length ? head : undefined,
+        options && options.maxPayload ? options.maxPayload : MAX_PAYLOAD,
+        (type, data, code) => {
+            ws._onEvent(type, data, code);
+        });
+    return ws;
+}
+
+module.exports = {
+    WebSocket,
+    WebSocketGroup,
+    acceptWebSocket
+};
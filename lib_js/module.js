@@ -2,6 +2,8 @@
 exports.builtinModules = [
     'assert',
     'buffer',
+    'child_process',
+    'cluster',
     'console',
     'crypto',
     'dgram',
@@ -9,6 +11,7 @@ exports.builtinModules = [
     'events',
     'fs',
     'http',
+    'http2',
     'https',
     'module',
     'net',
@@ -24,6 +27,7 @@ exports.builtinModules = [
     'url',
     'util',
     'vm',
+    'worker_threads',
     'zlib'
 ]
 if (process.platform == 'esp32') {
@@ -22,40 +22,26 @@ class Socket extends stream.Duplex {
                 if (this._socketHTTPWrapped)
                     throw new Error("socket is an http stream, writing not allowed");
 
+                if (this._socketPipe) {
+                    this._waitPipe = size;
+                    return;
+                }
                 if (this._socketFD === undefined || this.connecting) {
                     this._waitConnect = size;
                     this._updateRef();
                     return;
                 }
 
-                let buf = new Buffer(size);
-                this._socketReading = true;
-                this._updateRef();
-                native.read(this._socketFD, buf, 0, size, null, (err, bytesRead) => {
-                    this._socketReading = false;
-                    this._updateRef();
-                    if (err) {
-                        this.destroy(err);
-                        return;
-                    }
-
-                    if (this._timeout)
-                        this._timeout.refresh();
-                    if (bytesRead == 0) {
-                        if (this._writableEOF)
-                            this.destroy();
-                        else
-                            this.push(null);
-                        return;
-                    }
-                    this.bytesRead += bytesRead;
-                    this.push(bytesRead != size ? buf.slice(0, bytesRead) : buf);
-                });
+                this._socketRead(size);
             },
             write(chunk, encoding, callback) {
                 if (this._socketHTTPWrapped)
                     throw new Error("socket is an http stream, reading not allowed");
 
+                if (this._socketPipe) {
+                    this._waitPipeWrite = [chunk, encoding, callback];
+                    return;
+                }
                 this.bufferSize = this.writableLength;
                 this._socketWriting = true;
                 this._updateRef();
@@ -81,6 +67,10 @@ class Socket extends stream.Duplex {
                     this._updateRef();
                     return;
                 }
+                if (this._socketPipeIn) {
+                    this._waitPipeFinal = callback;
+                    return;
+                }
 
                 if (this._readableEOF) {
                     this.destroy();
@@ -224,14 +214,8 @@ class Socket extends stream.Duplex {
                         callback();
                     } else if(this._socketFD)
                         native.shutdown(this._socketFD, callback);
-                } else {
-                    this._socketReading = true;
-
-                    let buf = new Buffer(size);
-                    native.read(this._socketFD, buf, 0, size, null, (err, bytesRead) => {
-                        this.push(bytesRead != size ? buf.slice(0, bytesRead) : buf);
-                    });
-                }
+                } else
+                    this._socketRead(size);
             }
 
             this.emit('connect');
@@ -244,6 +228,59 @@ class Socket extends stream.Duplex {
         });
     }
 
+    _socketRead(size) {
+        // The data lands in the native read arena, we get a view into it
+        this._socketReading = true;
+        this._updateRef();
+        native.socketRead(this._socketFD, size, (err, bytesRead, buf) => {
+            this._socketReading = false;
+            this._updateRef();
+            if (err) {
+                this.destroy(err);
+                return;
+            }
+
+            if (this._timeout)
+                this._timeout.refresh();
+            if (bytesRead == 0) {
+                if (this._writableEOF)
+                    this.destroy();
+                else
+                    this.push(null);
+                return;
+            }
+            this.bytesRead += bytesRead;
+            this.push(buf);
+        });
+    }
+
+    // low.js specific, see pipeNative
+    _pipeNative(destination, options) {
+        return pipeNative(this, destination, options);
+    }
+    _pipeResume() {
+        this._updateRef();
+        if (this.destroyed)
+            return;
+
+        if (!this._socketPipe && this._waitPipe !== undefined) {
+            let size = this._waitPipe;
+            delete this._waitPipe;
+            if (!this._readableEOF)
+                this._socketRead(size);
+        }
+        if (!this._socketPipe && this._waitPipeWrite) {
+            let args = this._waitPipeWrite;
+            delete this._waitPipeWrite;
+            this._write(args[0], args[1], args[2]);
+        }
+        if (!this._socketPipeIn && this._waitPipeFinal) {
+            let callback = this._waitPipeFinal;
+            delete this._waitPipeFinal;
+            this._final(callback);
+        }
+    }
+
     address() {
         return { port: this.localPort, family: this.remoteFamily, address: this.localAddress };
     }
@@ -293,7 +330,7 @@ class Socket extends stream.Duplex {
         return this;
     }
     _updateRef() {
-        if (this._ref && !this.destroyed && (this.connecting || this._waitConnect !== undefined || this._socketReading || this._socketWriting)) {
+        if (this._ref && !this.destroyed && (this.connecting || this._waitConnect !== undefined || this._socketReading || this._socketWriting || this._socketPipe)) {
             if (!this._refSet) {
                 native.runRef(1);
                 this._refSet = true;
@@ -416,6 +453,11 @@ class Server extends events.EventEmitter {
         return this;
     }
     _listen(options, family, address, callback) {
+        // Cluster workers all listen on the same port themselves, the kernel
+        // balances the connections between them
+        let cluster = process.send ? require('cluster') : null;
+        let reusePort = !!options.reusePort || (cluster && cluster.isWorker && !options.exclusive);
+
         this.ref();
         native.listen(family, address, options.port | 0, !!this._httpServer, this._secureContext, (err, fd, port) => {
             this._tryListen = false;
@@ -439,6 +481,9 @@ class Server extends events.EventEmitter {
             else
                 this._address = address;
 
+            if (cluster && cluster.isWorker)
+                cluster._onListening(this, options, family, address, port);
+
             setImmediate(() => {    // required for test ...test/parallel/test-http-1.0.js, and maybe others
                 this.emit('listening');
                 if (callback)
@@ -480,7 +525,7 @@ class Server extends events.EventEmitter {
     
             this.emit('connection', socket);
             socket.emit('ready');
-        });
+        }, reusePort);
     }
 
     ref() {
@@ -564,6 +609,100 @@ function createServer(options, connectionListener) {
     return new Server(options, connectionListener);
 }
 
+// low.js specific: pipes into sockets are done by the web thread if both
+// sides allow it, see src/LowFDPipe.h. JavaScript only gets the result.
+// Used for Socket and fs.ReadStream sources, returns false if
+// stream.Readable has to pipe
+function pipeNative(source, destination, options) {
+    let file = !(source instanceof Socket);
+    if (!(destination instanceof Socket) || destination === source
+     || destination.destroyed || destination._writableEOF || destination._socketHTTPWrapped
+     || destination._socketPipeIn || destination._socketWriting || destination.writableLength
+     || source.destroyed || source._readableEOF || source._readableReading || source.readableLength
+     || source._pipeNativeActive || source.listenerCount('data') || Object.keys(source._readablePipes).length
+     || (file ? source._closed : source._socketHTTPWrapped))
+        return false;
+
+    // Tried again when both are ready
+    let wait = null;
+    if (destination.connecting)
+        wait = [destination, 'connect'];
+    else if (!file && source.connecting)
+        wait = [source, 'connect'];
+    else if (file && source._fd === undefined)
+        wait = [source, 'open'];
+    if (wait) {
+        wait[0].once(wait[1], () => {
+            if (!pipeNative(source, destination, options))
+                source._readablePipe(destination, options);
+        });
+        return true;
+    }
+
+    let srcFD = file ? source._fd : source._socketFD;
+    if (srcFD === undefined || destination._socketFD === undefined)
+        return false;
+
+    // A file is read from the position of the stream up to its end
+    let pos = -1, len = -1;
+    if (file && !source._posSet)
+        pos = source._pos;
+    if (file && source._end !== undefined)
+        len = Math.max(source._end - source._pos, 0);
+
+    let end = !options || options.end === undefined || options.end;
+    if (!native.netPipe(srcFD, destination._socketFD, pos, len, (err, side, bytes, released) => {
+        source._pipeNativeActive = false;
+        destination._socketPipeIn = false;
+        destination.bytesWritten += bytes;
+        if (released) {
+            destination._socketPipe = false;
+            if (!file)
+                source._socketPipe = false;
+        }
+
+        if (err)
+            (side ? destination : source).destroy(err);
+        else {
+            // Flowing, so 'end' is emitted
+            source.readableFlowing = true;
+            source.bytesRead += bytes;
+            if (file) {
+                source._posSet = true;
+                source._pos += bytes;
+                source.push(null);
+            } else if (source._writableState.finished)
+                source.destroy();
+            else
+                source.push(null);
+        }
+        if (file && (source._closed || (!err && source._autoClose)))
+            source.close();
+
+        destination._pipeResume();
+        if (!file)
+            source._pipeResume();
+        if (!err && end)
+            destination.end();
+    }))
+        return false;
+
+    if (source._readableCalling) {
+        clearImmediate(source._readableCalling);
+        source._readableCalling = null;
+    }
+    source._pipeNativeActive = true;
+    destination._socketPipe = destination._socketPipeIn = true;
+    destination._updateRef();
+    if (!file) {
+        source._socketPipe = true;
+        source._updateRef();
+    }
+
+    destination.emit('pipe', source);
+    return true;
+}
+
 module.exports = {
     Socket,
     Server,
@@ -571,6 +710,7 @@ module.exports = {
     connect: createConnection,
     createConnection,
     createServer,
+    _pipeNative: pipeNative,
     isIP: native.isIP,
     isIPv4: (input) => { return native.isIP(input) == 4; },
     isIPv6: (input) => { return native.isIP(input) == 6; }
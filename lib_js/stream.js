@@ -10,6 +10,10 @@ const {
     ERR_MISSING_ARGS
 } = require('internal/errors').codes;
 
+// Sources which fill every read get larger reads, up to this many times the
+// high water mark. Memory is short on the microcontroller
+const READ_SIZE_FACTOR = process.platform == 'esp32' ? 1 : 4;
+
 class Readable extends EventEmitter {
     readable = true;
     destroyed = false;
@@ -23,6 +27,8 @@ class Readable extends EventEmitter {
     _readableEncoding = null;
     _readableBuf = [];
     _readableReading = false;
+    _readablePushing = false;
+    _readableReadSize = 0;
     _readableEOF = false;
     _readablePipes = {};
 
@@ -99,13 +105,28 @@ class Readable extends EventEmitter {
     }
 
     _reconsiderRead() {
-        this._readableCalling = null;
+        if (this._readableCalling) {
+            clearImmediate(this._readableCalling);
+            this._readableCalling = null;
+        }
         if (!this._readableEOF && !this._readableReading && this.readableLength < this.readableHighWaterMark) {
             this._readableReading = true;
-            this._read(1024);
+            this._read(this._readableReadSize || this.readableHighWaterMark || 1024);
         }
     }
 
+    // Doubles the read size if the source filled the last read, halves it
+    // down to the high water mark if the source gives much less
+    _readableAdapt(len) {
+        let min = this.readableHighWaterMark || 1024;
+        let size = this._readableReadSize || min;
+        if (len >= size)
+            size = Math.min(size * 2, min * READ_SIZE_FACTOR);
+        else if (len < size / 4)
+            size = Math.max(size / 2, min);
+        this._readableReadSize = size;
+    }
+
     resume() {
         this.emit('resume');
         this.readableFlowing = true;
@@ -179,15 +200,33 @@ class Readable extends EventEmitter {
             this._readableEOF = true;
             this.readable = false;
         }
+        if (!this._readableObjectMode && chunk !== null && chunk.length)
+            this._readableAdapt(chunk.length);
         if (this._readableObjectMode || chunk === null || chunk.length) {
-            if (this.readableFlowing === true) {
+            if (this.readableFlowing === true && !this._readablePushing) {
                 if (chunk === null) {
                     this._readableState.finished = true;
                     this.emit('end');
                 } else {
                     if (this._readableEncoding)
                         chunk = chunk.toString(this._readableEncoding);
+
+                    // The next read is started before the data is handled,
+                    // so native sources fill it meanwhile. Synchronous
+                    // sources push into the buffer, so the order is kept
+                    this._readableReading = false;
+                    this._readablePushing = true;
+                    this._reconsiderRead();
+                    this._readablePushing = false;
+
                     this.emit('data', chunk);
+                    while (this.readableFlowing === true && this._readableBuf.length)
+                        this.emit('data', this.read());
+                    if (this.readableFlowing === true && this._readableEOF && !this._readableState.finished) {
+                        this._readableState.finished = true;
+                        this.emit('end');
+                    }
+                    return !this._readableEOF && this.readableLength < this.readableHighWaterMark;
                 }
             } else {
                 if (chunk !== null) {
@@ -197,7 +236,8 @@ class Readable extends EventEmitter {
                     this._readableBuf.push(chunk);
                     this.readableLength += this._readableObjectMode ? 1 : chunk.length;
                 }
-                this.emit('readable');
+                if (!this._readablePushing)
+                    this.emit('readable');
             }
         }
 
@@ -212,6 +252,13 @@ class Readable extends EventEmitter {
     }
 
     pipe(destination, options) {
+        // Native streams may be connected without JavaScript seeing the data
+        if (this._pipeNative && this._pipeNative(destination, options))
+            return destination;
+        return this._readablePipe(destination, options);
+    }
+
+    _readablePipe(destination, options) {
         let end = options && options.end !== undefined ? options.end : true;
 
         let pipe = this._readablePipes[destination] = [
@@ -28,10 +28,16 @@ class TLSSocket extends net.Socket {
         }
         if (!options)
             options = {};
-        if(!options.ca)
-            options.ca = module.exports.rootCertificates;
-
-        options.secureContext = native.createTLSContext(options, false);
+        // Given by https.Agent, which shares it between its connections.
+        // Otherwise not stored in the options of the caller, so they may be
+        // changed for the next connection
+        if (!options.secureContext) {
+            options = Object.assign({}, options);
+            if(!options.ca)
+                options.ca = module.exports.rootCertificates;
+
+            options.secureContext = native.createTLSContext(options, false);
+        }
         super(options);
     }
 }
@@ -0,0 +1,157 @@
+'use strict';
+
+const EventEmitter = require('events').EventEmitter;
+const path = require('path');
+const native = require('native');
+
+// Must match LOWWORKER_EVENT_*
+const EVENT_ONLINE = 0;
+const EVENT_MESSAGE = 1;
+const EVENT_MESSAGEERROR = 2;
+const EVENT_ERROR = 3;
+const EVENT_EXIT = 4;
+
+const info = native.workerInfo();
+
+class Worker extends EventEmitter {
+    constructor(filename, options) {
+        super();
+        options = options || {};
+        if (options.eval)
+            throw new Error('the eval option of Worker is not supported');
+
+        this._exitCode = null;
+        this._native = native.workerCreate(this, path.resolve(String(filename)),
+            options.workerData, options.transferList, this._onEvent.bind(this));
+    }
+
+    _onEvent(event, value) {
+        switch (event) {
+            case EVENT_ONLINE:
+                this.emit('online');
+                break;
+
+            case EVENT_MESSAGE:
+                this.emit('message', value);
+                break;
+
+            case EVENT_MESSAGEERROR:
+                this.emit('messageerror', value);
+                break;
+
+            case EVENT_ERROR:
+                if (!(value instanceof Error))
+                    value = new Error('worker ' + this.threadId + ' exited with uncaught exception');
+                this.emit('error', value);
+                break;
+
+            case EVENT_EXIT:
+                this._exitCode = value;
+                this.threadId = -1;
+                this.emit('exit', value);
+                break;
+        }
+    }
+
+    postMessage(value, transferList) {
+        if (this._exitCode === null)
+            native.workerPostMessage(this._native, value, transferList);
+    }
+
+    terminate(callback) {
+        return new Promise((resolve) => {
+            if (this._exitCode !== null) {
+                if (callback)
+                    callback(null, this._exitCode);
+                resolve(this._exitCode);
+                return;
+            }
+
+            this.once('exit', (code) => {
+                if (callback)
+                    callback(null, code);
+                resolve(code);
+            });
+            native.workerTerminate(this._native);
+        });
+    }
+
+    ref() {
+        native.workerRef(this._native, true);
+    }
+    unref() {
+        native.workerRef(this._native, false);
+    }
+}
+
+// The port of a worker to its parent. Messages which arrive before a
+// 'message' listener is added are held back, as with Node.js
+class MessagePort extends EventEmitter {
+    constructor() {
+        super();
+
+        this._queue = [];
+        this._closed = false;
+        this._refed = false;
+
+        this.on('newListener', (event) => {
+            if (event != 'message' || this._closed)
+                return;
+
+            this.ref();
+            if (this._queue.length)
+                process.nextTick(() => {
+                    while (this._queue.length && this.listenerCount('message'))
+                        this.emit('message', this._queue.shift());
+                });
+        });
+        this.on('removeListener', (event) => {
+            if (event == 'message' && !this.listenerCount('message'))
+                this.unref();
+        });
+
+        native.workerSetReceiver((event, value) => {
+            if (event == EVENT_MESSAGEERROR)
+                this.emit('messageerror', value);
+            else if (this.listenerCount('message') && !this._queue.length)
+                this.emit('message', value);
+            else
+                this._queue.push(value);
+        });
+    }
+
+    postMessage(value, transferList) {
+        if (!this._closed)
+            native.workerPost(value, transferList);
+    }
+
+    close() {
+        if (this._closed)
+            return;
+
+        this._closed = true;
+        this._queue = [];
+        this.unref();
+        native.workerSetReceiver(null);
+        process.nextTick(() => this.emit('close'));
+    }
+
+    ref() {
+        if (!this._refed && !this._closed) {
+            this._refed = true;
+            native.workerPortRef(true);
+        }
+    }
+    unref() {
+        if (this._refed) {
+            this._refed = false;
+            native.workerPortRef(false);
+        }
+    }
+}
+
+exports.Worker = Worker;
+exports.isMainThread = !info;
+exports.threadId = info ? info.threadId : 0;
+exports.workerData = info ? info.workerData : null;
+exports.parentPort = info ? new MessagePort() : null;
@@ -0,0 +1,341 @@
+'use strict';
+
+const stream = require('stream');
+const native = require('native');
+const {
+    ERR_METHOD_NOT_IMPLEMENTED
+} = require('internal/errors').codes;
+
+const constants = {
+    Z_NO_FLUSH: 0,
+    Z_PARTIAL_FLUSH: 1,
+    Z_SYNC_FLUSH: 2,
+    Z_FULL_FLUSH: 3,
+    Z_FINISH: 4,
+    Z_BLOCK: 5,
+
+    Z_OK: 0,
+    Z_STREAM_END: 1,
+    Z_NEED_DICT: 2,
+    Z_ERRNO: -1,
+    Z_STREAM_ERROR: -2,
+    Z_DATA_ERROR: -3,
+    Z_MEM_ERROR: -4,
+    Z_BUF_ERROR: -5,
+    Z_VERSION_ERROR: -6,
+
+    Z_NO_COMPRESSION: 0,
+    Z_BEST_SPEED: 1,
+    Z_BEST_COMPRESSION: 9,
+    Z_DEFAULT_COMPRESSION: -1,
+
+    Z_FILTERED: 1,
+    Z_HUFFMAN_ONLY: 2,
+    Z_RLE: 3,
+    Z_FIXED: 4,
+    Z_DEFAULT_STRATEGY: 0,
+
+    ZLIB_VERNUM: 4784,
+
+    // Same numbering as LowZlibMode in LowZlib.h
+    DEFLATE: 1,
+    INFLATE: 2,
+    GZIP: 3,
+    GUNZIP: 4,
+    DEFLATERAW: 5,
+    INFLATERAW: 6,
+    UNZIP: 7,
+
+    Z_MIN_WINDOWBITS: 8,
+    Z_MAX_WINDOWBITS: 15,
+    Z_DEFAULT_WINDOWBITS: 15,
+    Z_MIN_CHUNK: 64,
+    Z_MAX_CHUNK: Infinity,
+    Z_DEFAULT_CHUNK: 16 * 1024,
+    Z_MIN_MEMLEVEL: 1,
+    Z_MAX_MEMLEVEL: 9,
+    Z_DEFAULT_MEMLEVEL: 8,
+    Z_MIN_LEVEL: -1,
+    Z_MAX_LEVEL: 9,
+    Z_DEFAULT_LEVEL: -1
+};
+
+function checkRange(name, value, min, max, def) {
+    if (value === undefined)
+        return def;
+    if (typeof value !== 'number' || value < min || value > max) {
+        let err = new RangeError('The value of "options.' + name + '" is out of range. It must be >= '
+            + min + ' and <= ' + max + '. Received ' + value);
+        err.code = 'ERR_OUT_OF_RANGE';
+        throw err;
+    }
+    return value;
+}
+
+// The work is done on a data thread by LowZlib, so compressing a large body
+// does not block the event loop. Output is produced into chunkSize large
+// buffers which are handed to the reader as slices
+class Zlib extends stream.Transform {
+    constructor(opts, mode) {
+        if (!native.zlibCreate)
+            throw new Error('low.js was built without zlib support');
+
+        opts = opts || {};
+        super(opts);
+
+        this._chunkSize = checkRange('chunkSize', opts.chunkSize, constants.Z_MIN_CHUNK,
+            constants.Z_MAX_CHUNK, constants.Z_DEFAULT_CHUNK);
+        this._flushFlag = checkRange('flush', opts.flush, constants.Z_NO_FLUSH,
+            constants.Z_BLOCK, constants.Z_NO_FLUSH);
+        this._finishFlushFlag = checkRange('finishFlush', opts.finishFlush, constants.Z_NO_FLUSH,
+            constants.Z_BLOCK, constants.Z_FINISH);
+
+        let level = checkRange('level', opts.level, constants.Z_MIN_LEVEL,
+            constants.Z_MAX_LEVEL, constants.Z_DEFAULT_COMPRESSION);
+        let windowBits = checkRange('windowBits', opts.windowBits, constants.Z_MIN_WINDOWBITS,
+            constants.Z_MAX_WINDOWBITS, constants.Z_DEFAULT_WINDOWBITS);
+        let memLevel = checkRange('memLevel', opts.memLevel, constants.Z_MIN_MEMLEVEL,
+            constants.Z_MAX_MEMLEVEL, constants.Z_DEFAULT_MEMLEVEL);
+        let strategy = checkRange('strategy', opts.strategy, constants.Z_DEFAULT_STRATEGY,
+            constants.Z_FIXED, constants.Z_DEFAULT_STRATEGY);
+
+        this._native = native.zlibCreate(this, mode, level, windowBits, memLevel, strategy);
+        this._outBuf = Buffer.allocUnsafe(this._chunkSize);
+        this._outOffset = 0;
+        this.bytesWritten = 0;
+    }
+
+    _transform(chunk, encoding, callback) {
+        if (typeof chunk === 'string')
+            chunk = Buffer.from(chunk, encoding);
+        this._processChunk(chunk, this._flushFlag, callback);
+    }
+
+    _flush(callback) {
+        this._processChunk(Buffer.alloc(0), this._finishFlushFlag, (err) => {
+            if (!err)
+                this.push(null);
+            callback(err);
+        });
+    }
+
+    _processChunk(chunk, flushFlag, callback) {
+        if (this._native < 0) {
+            let err = new Error('zlib binding closed');
+            err.code = 'ERR_ZLIB_BINDING_CLOSED';
+            process.nextTick(callback, err);
+            return;
+        }
+
+        let inOffset = 0, inLen = chunk.length;
+        let next = () => {
+            let outLen = this._chunkSize - this._outOffset;
+            native.zlibWrite(this._native, flushFlag, chunk, inOffset, inLen,
+                this._outBuf, this._outOffset, outLen, (err, availOut, availIn) => {
+                    if (err) {
+                        this.close();
+                        callback(err);
+                        return;
+                    }
+
+                    let have = outLen - availOut;
+                    this.bytesWritten += inLen - availIn;
+                    inOffset += inLen - availIn;
+                    inLen = availIn;
+
+                    if (have) {
+                        this.push(this._outBuf.slice(this._outOffset, this._outOffset + have));
+                        this._outOffset += have;
+                    }
+                    // The pushed slices still reference the old buffer
+                    if (availOut === 0 || this._outOffset >= this._chunkSize) {
+                        this._outBuf = Buffer.allocUnsafe(this._chunkSize);
+                        this._outOffset = 0;
+                    }
+
+                    // A full output buffer means zlib may have more for us
+                    if (availOut === 0)
+                        next();
+                    else
+                        callback();
+                });
+        };
+        next();
+    }
+
+    params(level, strategy, callback) {
+        // Changing parameters mid-stream needs deflateParams, which is not
+        // exposed natively
+        throw new ERR_METHOD_NOT_IMPLEMENTED('params()');
+    }
+
+    reset() {
+        if (this._native >= 0)
+            native.zlibReset(this._native);
+    }
+
+    flush(kind, callback) {
+        if (typeof kind === 'function' || kind === undefined) {
+            callback = kind;
+            kind = constants.Z_FULL_FLUSH;
+        }
+        this._processChunk(Buffer.alloc(0), kind, (err) => {
+            if (err)
+                this.emit('error', err);
+            if (callback)
+                callback();
+        });
+    }
+
+    close(callback) {
+        if (callback)
+            process.nextTick(callback);
+        if (this._native < 0)
+            return;
+
+        native.zlibClose(this._native);
+        this._native = -1;
+        process.nextTick(() => { this.emit('close'); });
+    }
+
+    _destroy(err, callback) {
+        this.close();
+        callback(err);
+    }
+}
+
+class Deflate extends Zlib {
+    constructor(opts) {
+        super(opts, constants.DEFLATE);
+    }
+}
+class Inflate extends Zlib {
+    constructor(opts) {
+        super(opts, constants.INFLATE);
+    }
+}
+class Gzip extends Zlib {
+    constructor(opts) {
+        super(opts, constants.GZIP);
+    }
+}
+class Gunzip extends Zlib {
+    constructor(opts) {
+        super(opts, constants.GUNZIP);
+    }
+}
+class DeflateRaw extends Zlib {
+    constructor(opts) {
+        super(opts, constants.DEFLATERAW);
+    }
+}
+class InflateRaw extends Zlib {
+    constructor(opts) {
+        super(opts, constants.INFLATERAW);
+    }
+}
+class Unzip extends Zlib {
+    constructor(opts) {
+        super(opts, constants.UNZIP);
+    }
+}
+
+function zlibBuffer(engine, buffer, callback) {
+    if (typeof buffer === 'string')
+        buffer = Buffer.from(buffer);
+
+    let buffers = [], length = 0;
+    engine.on('data', (chunk) => {
+        buffers.push(chunk);
+        length += chunk.length;
+    });
+    engine.once('error', (err) => {
+        engine.removeAllListeners('end');
+        callback(err);
+    });
+    engine.once('end', () => {
+        engine.close();
+        callback(null, Buffer.concat(buffers, length));
+    });
+    engine.end(buffer);
+}
+
+function zlibBufferSync(engine, buffer) {
+    if (typeof buffer === 'string')
+        buffer = Buffer.from(buffer);
+
+    let buffers = [], length = 0;
+    let inOffset = 0, inLen = buffer.length;
+    try {
+        while (true) {
+            let out = Buffer.allocUnsafe(engine._chunkSize);
+            let [availOut, availIn] = native.zlibWriteSync(engine._native,
+                engine._finishFlushFlag, buffer, inOffset, inLen, out, 0, out.length);
+
+            let have = out.length - availOut;
+            if (have) {
+                buffers.push(have == out.length ? out : out.slice(0, have));
+                length += have;
+            }
+            inOffset += inLen - availIn;
+            inLen = availIn;
+
+            if (availOut !== 0)
+                break;
+        }
+    } finally {
+        engine.close();
+    }
+
+    return Buffer.concat(buffers, length);
+}
+
+function createConvenienceMethods(name, ctor) {
+    exports[name] = function (buffer, opts, callback) {
+        if (typeof opts === 'function') {
+            callback = opts;
+            opts = {};
+        }
+        zlibBuffer(new ctor(opts), buffer, callback);
+    };
+    exports[name + 'Sync'] = function (buffer, opts) {
+        return zlibBufferSync(new ctor(opts), buffer);
+    };
+}
+
+exports.constants = constants;
+exports.codes = {
+    Z_OK: constants.Z_OK,
+    Z_STREAM_END: constants.Z_STREAM_END,
+    Z_NEED_DICT: constants.Z_NEED_DICT,
+    Z_ERRNO: constants.Z_ERRNO,
+    Z_STREAM_ERROR: constants.Z_STREAM_ERROR,
+    Z_DATA_ERROR: constants.Z_DATA_ERROR,
+    Z_MEM_ERROR: constants.Z_MEM_ERROR,
+    Z_BUF_ERROR: constants.Z_BUF_ERROR,
+    Z_VERSION_ERROR: constants.Z_VERSION_ERROR
+};
+
+exports.Deflate = Deflate;
+exports.Inflate = Inflate;
+exports.Gzip = Gzip;
+exports.Gunzip = Gunzip;
+exports.DeflateRaw = DeflateRaw;
+exports.InflateRaw = InflateRaw;
+exports.Unzip = Unzip;
+
+exports.createDeflate = (opts) => new Deflate(opts);
+exports.createInflate = (opts) => new Inflate(opts);
+exports.createGzip = (opts) => new Gzip(opts);
+exports.createGunzip = (opts) => new Gunzip(opts);
+exports.createDeflateRaw = (opts) => new DeflateRaw(opts);
+exports.createInflateRaw = (opts) => new InflateRaw(opts);
+exports.createUnzip = (opts) => new Unzip(opts);
+
+createConvenienceMethods('deflate', Deflate);
+createConvenienceMethods('inflate', Inflate);
+createConvenienceMethods('gzip', Gzip);
+createConvenienceMethods('gunzip', Gunzip);
+createConvenienceMethods('deflateRaw', DeflateRaw);
+createConvenienceMethods('inflateRaw', InflateRaw);
+createConvenienceMethods('unzip', Unzip);
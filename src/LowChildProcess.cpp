@@ -0,0 +1,346 @@
+// -----------------------------------------------------------------------------
+//  LowChildProcess.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_config.h"
+#if LOW_INCLUDE_CHILD_PROCESS
+
+#include "LowChildProcess.h"
+#include "LowSocket.h"
+
+#include "low_system.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 29)
+#define LOW_HAS_SPAWN_CHDIR 1
+#elif defined(__APPLE__)
+#define LOW_HAS_SPAWN_CHDIR 1
+#else
+#define LOW_HAS_SPAWN_CHDIR 0
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 34)
+#define LOW_HAS_SPAWN_CLOSEFROM 1
+#else
+#define LOW_HAS_SPAWN_CLOSEFROM 0
+#endif
+
+
+// -----------------------------------------------------------------------------
+//  LowChildProcess::LowChildProcess
+// -----------------------------------------------------------------------------
+
+LowChildProcess::LowChildProcess(low_t *low) :
+    mLow(low), mIndex(-1), mPID(-1), mExited(false), mExitCallID(0),
+    mRef(true), mHoldsRef(false)
+{
+}
+
+// -----------------------------------------------------------------------------
+//  LowChildProcess::~LowChildProcess
+// -----------------------------------------------------------------------------
+
+LowChildProcess::~LowChildProcess()
+{
+    if(mIndex >= 0)
+        mLow->childProcesses[mIndex] = NULL;
+    if(mHoldsRef)
+        mLow->run_ref--;
+    if(mExitCallID && mLow->duk_ctx)
+        low_remove_stash(mLow->duk_ctx, mExitCallID);
+}
+
+// -----------------------------------------------------------------------------
+//  LowChildProcess::Spawn
+// -----------------------------------------------------------------------------
+
+bool LowChildProcess::Spawn(const char *file, char *const argv[],
+                            char *const envp[], const char *cwd, int flags,
+                            int *stdio, int numStdio, int exitCallID,
+                            int &err, const char *&syscall)
+{
+    int parentFDs[numStdio], childFDs[numStdio];
+    for(int i = 0; i < numStdio; i++)
+        parentFDs[i] = childFDs[i] = -1;
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    bool haveActions = false, haveAttr = false;
+    int res;
+
+    mExitCallID = exitCallID;    // removed by destructor if we fail
+    for(int i = 0; i < numStdio; i++)
+    {
+        if(stdio[i] != LOWCHILDPROCESS_STDIO_IPC &&
+           stdio[i] != LOWCHILDPROCESS_STDIO_PIPE)
+            continue;
+
+        // Socket pairs instead of pipes, so LowSocket handles them as any
+        // other stream, including shutdown
+        int pair[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+        {
+            err = errno;
+            syscall = "socketpair";
+            goto err;
+        }
+        parentFDs[i] = pair[0];
+        childFDs[i] = pair[1];
+
+        // Our end must not go to children spawned later, they would keep
+        // the pipe open. The child's end must not be overwritten by the
+        // dup2 calls below
+        fcntl(pair[0], F_SETFD, FD_CLOEXEC);
+        if(childFDs[i] < numStdio)
+        {
+            int fd = fcntl(childFDs[i], F_DUPFD, numStdio);
+            if(fd < 0)
+            {
+                err = errno;
+                syscall = "fcntl";
+                goto err;
+            }
+            close(childFDs[i]);
+            childFDs[i] = fd;
+        }
+    }
+
+    res = posix_spawn_file_actions_init(&actions);
+    if(res)
+    {
+        err = res;
+        syscall = "posix_spawn_file_actions_init";
+        goto err;
+    }
+    haveActions = true;
+
+    for(int i = 0; i < numStdio && !res; i++)
+    {
+        if(childFDs[i] >= 0)
+            res = posix_spawn_file_actions_adddup2(&actions, childFDs[i], i);
+        else if(stdio[i] == LOWCHILDPROCESS_STDIO_IGNORE)
+            res = posix_spawn_file_actions_addopen(&actions, i, "/dev/null",
+                                                   O_RDWR, 0);
+        else if(stdio[i] >= 0)
+            res = posix_spawn_file_actions_adddup2(&actions, stdio[i], i);
+        else if(stdio[i] == LOWCHILDPROCESS_STDIO_INHERIT && i >= 3)
+            res = posix_spawn_file_actions_addclose(&actions, i);
+    }
+#if LOW_HAS_SPAWN_CLOSEFROM
+    // Do not leak our sockets and files into the child
+    if(!res)
+        res = posix_spawn_file_actions_addclosefrom_np(&actions, numStdio);
+#else
+    for(int i = 0; i < numStdio && !res; i++)
+        if(childFDs[i] >= 0)
+            res = posix_spawn_file_actions_addclose(&actions, childFDs[i]);
+#endif /* LOW_HAS_SPAWN_CLOSEFROM */
+    if(!res && cwd)
+    {
+#if LOW_HAS_SPAWN_CHDIR
+        res = posix_spawn_file_actions_addchdir_np(&actions, cwd);
+#else
+        res = ENOSYS;
+#endif /* LOW_HAS_SPAWN_CHDIR */
+    }
+    if(res)
+    {
+        err = res;
+        syscall = "posix_spawn_file_actions";
+        goto err;
+    }
+
+    // Our threads may block signals, the child starts with a clean state
+    res = posix_spawnattr_init(&attr);
+    if(!res)
+    {
+        haveAttr = true;
+
+        sigset_t mask;
+        sigemptyset(&mask);
+        res = posix_spawnattr_setsigmask(&attr, &mask);
+
+        short spawnFlags = POSIX_SPAWN_SETSIGMASK;
+        if(flags & LOWCHILDPROCESS_FLAG_DETACHED)
+        {
+#ifdef POSIX_SPAWN_SETSID
+            spawnFlags |= POSIX_SPAWN_SETSID;
+#else
+            // At least not in our process group, so it does not get our ^C
+            spawnFlags |= POSIX_SPAWN_SETPGROUP;
+            if(!res)
+                res = posix_spawnattr_setpgroup(&attr, 0);
+#endif /* POSIX_SPAWN_SETSID */
+        }
+        if(!res)
+            res = posix_spawnattr_setflags(&attr, spawnFlags);
+    }
+    if(res)
+    {
+        err = res;
+        syscall = "posix_spawnattr";
+        goto err;
+    }
+
+    res = posix_spawnp(&mPID, file, &actions, &attr, argv, envp);
+    if(res)
+    {
+        err = res;
+        syscall = "posix_spawn";
+        goto err;
+    }
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    for(int i = 0; i < numStdio; i++)
+    {
+        if(childFDs[i] >= 0)
+            close(childFDs[i]);
+
+        stdio[i] = -1;
+        if(parentFDs[i] >= 0)
+        {
+            // Becomes a LowFD polled by the web thread, so net.Socket can
+            // use it
+            if(!(flags & LOWCHILDPROCESS_FLAG_SYNC))
+                new LowSocket(mLow, parentFDs[i], LOWSOCKET_TYPE_PIPE);
+            stdio[i] = parentFDs[i];
+        }
+    }
+
+    Ref(mRef);
+    return true;
+
+err:
+    if(haveActions)
+        posix_spawn_file_actions_destroy(&actions);
+    if(haveAttr)
+        posix_spawnattr_destroy(&attr);
+    for(int i = 0; i < numStdio; i++)
+    {
+        if(parentFDs[i] >= 0)
+            close(parentFDs[i]);
+        if(childFDs[i] >= 0)
+            close(childFDs[i]);
+    }
+
+    mPID = -1;
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+//  LowChildProcess::Kill
+// -----------------------------------------------------------------------------
+
+bool LowChildProcess::Kill(int signal, int &err)
+{
+    if(mPID < 0 || mExited)
+    {
+        err = ESRCH;
+        return false;
+    }
+    if(kill(mPID, signal) < 0)
+    {
+        err = errno;
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowChildProcess::Ref
+// -----------------------------------------------------------------------------
+
+void LowChildProcess::Ref(bool ref)
+{
+    mRef = ref;
+    if(mPID < 0 || mExited || mHoldsRef == ref)
+        return;
+
+    mHoldsRef = ref;
+    if(ref)
+        mLow->run_ref++;
+    else
+        mLow->run_ref--;
+}
+
+// -----------------------------------------------------------------------------
+//  LowChildProcess::Reap
+// -----------------------------------------------------------------------------
+
+bool LowChildProcess::Reap()
+{
+    if(mPID < 0 || mExited)
+        return false;
+
+    int status;
+    pid_t pid = waitpid(mPID, &status, WNOHANG);
+    if(pid == 0 || (pid < 0 && errno == EINTR))
+        return false;
+
+    mExited = true;
+    if(mHoldsRef)
+    {
+        mHoldsRef = false;
+        mLow->run_ref--;
+    }
+
+    // Called in the next tick, so an exception in one callback does not
+    // keep us from reaping the other children
+    duk_context *ctx = mLow->duk_ctx;
+    low_push_stash(ctx, mExitCallID, true);
+    mExitCallID = 0;
+
+    if(pid > 0 && WIFEXITED(status))
+    {
+        duk_push_int(ctx, WEXITSTATUS(status));
+        duk_push_null(ctx);
+    }
+    else if(pid > 0 && WIFSIGNALED(status))
+    {
+        const char *name = low_signal_name(WTERMSIG(status));
+
+        duk_push_null(ctx);
+        if(name)
+            duk_push_string(ctx, name);
+        else
+            duk_push_int(ctx, WTERMSIG(status));
+    }
+    else
+    {
+        // Reaped by someone else, status is lost
+        duk_push_null(ctx);
+        duk_push_null(ctx);
+    }
+    low_call_next_tick(ctx, 2);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowChildProcess::Wait
+// -----------------------------------------------------------------------------
+
+bool LowChildProcess::Wait(int &status)
+{
+    if(mPID < 0 || mExited)
+        return false;
+
+    pid_t pid;
+    do
+    {
+        pid = waitpid(mPID, &status, 0);
+    } while(pid < 0 && errno == EINTR);
+
+    mExited = true;
+    return pid == mPID;
+}
+
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
@@ -0,0 +1,63 @@
+// -----------------------------------------------------------------------------
+//  LowChildProcess.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWCHILDPROCESS_H__
+#define __LOWCHILDPROCESS_H__
+
+#include "low_main.h"
+
+#include <sys/types.h>
+
+// What the child gets as fd i, values >= 0 are fds of ours to pass on
+enum
+{
+    LOWCHILDPROCESS_STDIO_INHERIT = -1,
+    LOWCHILDPROCESS_STDIO_IGNORE = -2,
+    LOWCHILDPROCESS_STDIO_IPC = -3,
+    LOWCHILDPROCESS_STDIO_PIPE = -4
+};
+
+enum
+{
+    LOWCHILDPROCESS_FLAG_DETACHED = 1,  // child gets its own session
+    LOWCHILDPROCESS_FLAG_SYNC = 2       // our pipe ends stay plain fds
+};
+
+// A process started with posix_spawn. Owned by the code thread, which
+// accesses it by index in low->childProcesses. Exited children are reaped
+// on SIGCHLD, see low_child_process_reap
+class LowChildProcess
+{
+  public:
+    LowChildProcess(low_t *low);
+    ~LowChildProcess(); // does not kill the child
+
+    void SetIndex(int index) { mIndex = index; }
+    pid_t PID() { return mPID; }
+
+    // stdio has numStdio entries, on success those set to IPC or PIPE are
+    // replaced with our end of the socket pair, all others with -1. Our
+    // ends are LowSockets, unless LOWCHILDPROCESS_FLAG_SYNC is set
+    bool Spawn(const char *file, char *const argv[], char *const envp[],
+               const char *cwd, int flags, int *stdio, int numStdio,
+               int exitCallID, int &err, const char *&syscall);
+    bool Kill(int signal, int &err);
+    void Ref(bool ref);
+
+    // Calls the exit callback if the child has exited
+    bool Reap();
+    // For spawnSync, blocks until the child has exited
+    bool Wait(int &status);
+
+  private:
+    low_t *mLow;
+    int mIndex;
+
+    pid_t mPID;
+    bool mExited;
+    int mExitCallID;
+    bool mRef, mHoldsRef;
+};
+
+#endif /* __LOWCHILDPROCESS_H__ */
@@ -0,0 +1,391 @@
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher.cpp
+// -----------------------------------------------------------------------------
+
+#include "LowCryptoCipher.h"
+
+#include "low_data_thread.h"
+#include "low_loop.h"
+#include "low_system.h"
+
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::LowCryptoCipher
+// -----------------------------------------------------------------------------
+
+LowCryptoCipher::LowCryptoCipher(low_t *low,
+                                 const mbedtls_cipher_info_t *info,
+                                 bool encrypt) :
+    LowDataCallback(low), LowLoopCallback(low), mLow(low), mIndex(-1),
+    mInfo(info), mEncrypt(encrypt), mStarted(false), mFinal(false), mPendingLen(0),
+    mUnaligned(false), mTagLen(encrypt ? 16 : 0),
+    mInID(0), mOutID(0), mCallID(0)
+{
+    mbedtls_cipher_init(&mContext);
+
+    mGCM = info->mode == MBEDTLS_MODE_GCM;
+    mAEAD = mGCM;
+#if defined(MBEDTLS_CHACHAPOLY_C)
+    if(info->type == MBEDTLS_CIPHER_CHACHA20_POLY1305)
+        mAEAD = true;
+#endif /* MBEDTLS_CHACHAPOLY_C */
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::~LowCryptoCipher
+// -----------------------------------------------------------------------------
+
+LowCryptoCipher::~LowCryptoCipher()
+{
+    low_data_clear_callback(mLow, this);
+    low_loop_clear_callback(mLow, this);
+
+    // Key material must not stay in memory
+    mbedtls_cipher_free(&mContext);
+    memset(mPending, 0, sizeof(mPending));
+
+    if(mInID)
+        low_remove_stash(mLow->duk_ctx, mInID);
+    if(mOutID)
+        low_remove_stash(mLow->duk_ctx, mOutID);
+    if(mCallID)
+    {
+        low_remove_stash(mLow->duk_ctx, mCallID);
+        mLow->run_ref--;
+    }
+
+    if(mIndex >= 0)
+    {
+        if(mIndex >= mLow->cryptoCiphers.size() ||
+           mLow->cryptoCiphers[mIndex] != this)
+            printf("assertion error at LowCryptoCipher\n");
+
+        mLow->cryptoCiphers[mIndex] = NULL;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::Init
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::Init(unsigned char *key, int keyLen,
+                          unsigned char *iv, int ivLen)
+{
+    int res = mbedtls_cipher_setup(&mContext, mInfo);
+    if(res != 0)
+        return res;
+
+    res = mbedtls_cipher_setkey(&mContext, key, keyLen * 8,
+                                    mEncrypt ? MBEDTLS_ENCRYPT
+                                             : MBEDTLS_DECRYPT);
+    if(res != 0)
+        return res;
+
+    if(ivLen)
+    {
+        res = mbedtls_cipher_set_iv(&mContext, iv, ivLen);
+        if(res != 0)
+            return res;
+    }
+
+    return mbedtls_cipher_reset(&mContext);
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::StartAEAD
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::StartAEAD(unsigned char *aad, int len)
+{
+    // mbedtls starts GCM and ChaCha20-Poly1305 with the additional data,
+    // so this has to be called exactly once before the first update
+    mStarted = true;
+    return mbedtls_cipher_update_ad(&mContext, aad, len);
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::SetAAD
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::SetAAD(unsigned char *data, int len)
+{
+    if(!mAEAD || mStarted)
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+
+    return StartAEAD(data, len);
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::SetAutoPadding
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::SetAutoPadding(bool autoPadding)
+{
+    if(mFinal)
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+
+    // Stream modes have no padding, nothing to do
+    if(mbedtls_cipher_get_cipher_mode(&mContext) != MBEDTLS_MODE_CBC)
+        return 0;
+
+    return mbedtls_cipher_set_padding_mode(&mContext,
+                                           autoPadding ? MBEDTLS_PADDING_PKCS7
+                                                       : MBEDTLS_PADDING_NONE);
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::SetAuthTag
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::SetAuthTag(unsigned char *data, int len)
+{
+    if(!mAEAD || mEncrypt || mFinal)
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+    if(len < 4 || len > 16 || (!mGCM && len != 16))
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+
+    memcpy(mTag, data, len);
+    mTagLen = len;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::GetAuthTag
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::GetAuthTag(unsigned char *data, int len)
+{
+    if(!mAEAD || !mEncrypt || !mFinal || len < 4 || len > mTagLen)
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+
+    // Shorter GCM tags are the start of the full tag
+    memcpy(data, mTag, len);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::Update
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::Update(unsigned char *in, int len,
+                            unsigned char *out, int &outLen)
+{
+    int res;
+    size_t olen;
+
+    outLen = 0;
+    if(mFinal)
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+    if(mAEAD && !mStarted)
+    {
+        res = StartAEAD(NULL, 0);
+        if(res != 0)
+            return res;
+    }
+    if(!len)
+        return 0;
+
+    if(in == out)
+    {
+        // Block modes hold back data, so the output may be ahead of the
+        // input. With GCM, only the last in-place update may be unaligned
+        if(mbedtls_cipher_get_cipher_mode(&mContext) == MBEDTLS_MODE_CBC
+        || mbedtls_cipher_get_cipher_mode(&mContext) == MBEDTLS_MODE_ECB)
+            return MBEDTLS_ERR_CIPHER_FEATURE_UNAVAILABLE;
+        if(mGCM)
+        {
+            if(mPendingLen || mUnaligned)
+                return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+            mUnaligned = (len & 15) != 0;
+        }
+
+        res = mbedtls_cipher_update(&mContext, in, len, out, &olen);
+        outLen = olen;
+        return res;
+    }
+
+    if(!mGCM)
+    {
+        res = mbedtls_cipher_update(&mContext, in, len, out, &olen);
+        outLen = olen;
+        return res;
+    }
+    if(mUnaligned)
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+
+    if(mPendingLen)
+    {
+        int fill = 16 - mPendingLen;
+        if(fill > len)
+            fill = len;
+
+        memcpy(mPending + mPendingLen, in, fill);
+        mPendingLen += fill;
+        in += fill;
+        len -= fill;
+        if(mPendingLen < 16)
+            return 0;
+
+        res = mbedtls_cipher_update(&mContext, mPending, 16, out, &olen);
+        if(res != 0)
+            return res;
+        mPendingLen = 0;
+        out += 16;
+        outLen += 16;
+    }
+
+    int full = len & ~15;
+    if(full)
+    {
+        res = mbedtls_cipher_update(&mContext, in, full, out, &olen);
+        if(res != 0)
+            return res;
+        outLen += full;
+    }
+
+    mPendingLen = len - full;
+    memcpy(mPending, in + full, mPendingLen);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::UpdateAsync
+// -----------------------------------------------------------------------------
+
+void LowCryptoCipher::UpdateAsync(unsigned char *in, int len, int inIndex,
+                                  unsigned char *out, int outIndex,
+                                  int callIndex)
+{
+    mIn = in;
+    mLen = len;
+    mOut = out;
+
+    // The buffers must stay alive while the data thread works on them
+    mInID = low_add_stash(mLow->duk_ctx, inIndex);
+    mOutID = in == out ? 0 : low_add_stash(mLow->duk_ctx, outIndex);
+    mCallID = low_add_stash(mLow->duk_ctx, callIndex);
+    mLow->run_ref++;
+
+    low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_MODIFY);
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::Final
+// -----------------------------------------------------------------------------
+
+int LowCryptoCipher::Final(unsigned char *out, int &outLen)
+{
+    int res;
+    size_t olen;
+
+    outLen = 0;
+    if(mFinal)
+        return MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA;
+    if(mAEAD && !mStarted)
+    {
+        res = StartAEAD(NULL, 0);
+        if(res != 0)
+            return res;
+    }
+    mFinal = true;
+
+    if(mPendingLen)
+    {
+        res = mbedtls_cipher_update(&mContext, mPending, mPendingLen,
+                                    out, &olen);
+        if(res != 0)
+            return res;
+        mPendingLen = 0;
+        outLen = olen;
+    }
+
+    res = mbedtls_cipher_finish(&mContext, out + outLen, &olen);
+    if(res != 0)
+        return res;
+    outLen += olen;
+
+    if(!mAEAD)
+        return 0;
+    if(mEncrypt)
+        return mbedtls_cipher_write_tag(&mContext, mTag, mTagLen);
+    if(!mTagLen)
+        return MBEDTLS_ERR_CIPHER_AUTH_FAILED;
+    return mbedtls_cipher_check_tag(&mContext, mTag, mTagLen);
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::OnData
+// -----------------------------------------------------------------------------
+
+bool LowCryptoCipher::OnData()
+{
+    mResult = Update(mIn, mLen, mOut, mOutLen);
+    low_loop_set_callback(mLow, this);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowCryptoCipher::OnLoop()
+{
+    if(!mCallID)
+        return true;
+
+    low_remove_stash(mLow->duk_ctx, mInID);
+    if(mOutID)
+        low_remove_stash(mLow->duk_ctx, mOutID);
+    mInID = mOutID = 0;
+
+    int callID = mCallID;
+    mCallID = 0;
+    mLow->run_ref--;
+
+    low_push_stash(mLow->duk_ctx, callID, true);
+    if(mResult != 0)
+    {
+        PushError(mLow->duk_ctx, mResult);
+        duk_call(mLow->duk_ctx, 1);
+    }
+    else
+    {
+        duk_push_null(mLow->duk_ctx);
+        duk_push_int(mLow->duk_ctx, mOutLen);
+        duk_call(mLow->duk_ctx, 2);
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher::PushError
+// -----------------------------------------------------------------------------
+
+void LowCryptoCipher::PushError(duk_context *ctx, int err)
+{
+    // Same messages as Node.JS, where there is an equivalent
+    switch(err)
+    {
+    case MBEDTLS_ERR_CIPHER_AUTH_FAILED:
+        duk_push_error_object(ctx, DUK_ERR_ERROR,
+                              "Unsupported state or unable to authenticate data");
+        break;
+    case MBEDTLS_ERR_CIPHER_INVALID_PADDING:
+        duk_push_error_object(ctx, DUK_ERR_ERROR, "bad decrypt");
+        break;
+    case MBEDTLS_ERR_CIPHER_FULL_BLOCK_EXPECTED:
+        duk_push_error_object(ctx, DUK_ERR_ERROR, "wrong final block length");
+        break;
+    case MBEDTLS_ERR_CIPHER_FEATURE_UNAVAILABLE:
+        duk_push_error_object(ctx, DUK_ERR_ERROR,
+                              "operation not supported by this cipher mode");
+        break;
+    case MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA:
+        duk_push_error_object(ctx, DUK_ERR_ERROR, "Unsupported state");
+        break;
+    default:
+        duk_push_error_object(ctx, DUK_ERR_ERROR,
+                              "mbedtls error code #%d", err);
+    }
+}
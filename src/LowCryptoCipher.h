@@ -0,0 +1,78 @@
+// -----------------------------------------------------------------------------
+//  LowCryptoCipher.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWCRYPTOCIPHER_H__
+#define __LOWCRYPTOCIPHER_H__
+
+#include "LowDataCallback.h"
+#include "LowLoopCallback.h"
+
+#include "low_main.h"
+
+#include "mbedtls/cipher.h"
+
+using namespace std;
+
+class LowCryptoCipher
+    : public LowDataCallback
+    , public LowLoopCallback
+{
+  public:
+    LowCryptoCipher(low_t *low, const mbedtls_cipher_info_t *info,
+                    bool encrypt);
+    virtual ~LowCryptoCipher();
+
+    void SetIndex(int index) { mIndex = index; }
+
+    // All return 0 or an mbedtls error code
+    int Init(unsigned char *key, int keyLen, unsigned char *iv, int ivLen);
+    int SetAAD(unsigned char *data, int len);
+    int SetAutoPadding(bool autoPadding);
+    int SetAuthTag(unsigned char *data, int len);
+    int GetAuthTag(unsigned char *data, int len);
+
+    // out must have room for len + MBEDTLS_MAX_BLOCK_LENGTH bytes. With
+    // out == in the data is en/decrypted in place, which only works with
+    // stream modes
+    int Update(unsigned char *in, int len, unsigned char *out, int &outLen);
+    // Same on a data thread, calls callback(err, outLen) when done
+    void UpdateAsync(unsigned char *in, int len, int inIndex,
+                     unsigned char *out, int outIndex, int callIndex);
+    int Final(unsigned char *out, int &outLen);
+
+    bool IsAEAD() { return mAEAD; }
+    bool IsBusy() { return mCallID != 0; }
+
+    static void PushError(duk_context *ctx, int err);
+
+  protected:
+    virtual bool OnData();
+    virtual bool OnLoop();
+
+  private:
+    int StartAEAD(unsigned char *aad, int len);
+
+  private:
+    low_t *mLow;
+    int mIndex;
+
+    const mbedtls_cipher_info_t *mInfo;
+    mbedtls_cipher_context_t mContext;
+    bool mEncrypt, mAEAD, mGCM, mStarted, mFinal;
+
+    // GCM in mbedtls only allows a partial block as the last update, so we
+    // keep partial blocks back ourselves
+    unsigned char mPending[16];
+    int mPendingLen;
+    bool mUnaligned;
+
+    unsigned char mTag[16];
+    int mTagLen;
+
+    unsigned char *mIn, *mOut;
+    int mLen, mOutLen, mResult;
+    int mInID, mOutID, mCallID;
+};
+
+#endif /* __LOWCRYPTOCIPHER_H__ */
@@ -4,8 +4,26 @@
 
 #include "LowCryptoHash.h"
 
+#include "low_alloc.h"
+#include "low_config.h"
+#include "low_data_thread.h"
+#include "low_fs.h"
+#include "low_loop.h"
+#include "low_system.h"
+
 #include "mbedtls/md_internal.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#if defined(LOWJS_SERV)
+#define NOT_ESP32_ADD_1     + 1
+#else
+#define NOT_ESP32_ADD_1
+#endif /* __XTENSA__ */
+
 
 // -----------------------------------------------------------------------------
 //  LowCryptoHash::LowCryptoHash
@@ -15,8 +33,10 @@ LowCryptoHash::LowCryptoHash(low_t *low,
                              const mbedtls_md_info_t *info,
                              unsigned char *key,
                              int key_len) :
-    mLow(low),
-    mIndex(-1), mHMAC(key ? true : false), mOutputSize(info->size)
+    LowDataCallback(low), LowLoopCallback(low), mLow(low),
+    mIndex(-1), mHMAC(key ? true : false), mOutputSize(info->size),
+    mData(NULL), mLen(0), mBufferID(0), mCallID(0),
+    mPath(NULL), mFD(-1), mError(0), mSyscall(NULL)
 {
     mbedtls_md_init(&mContext);
 
@@ -36,8 +56,28 @@ LowCryptoHash::LowCryptoHash(low_t *low,
 
 LowCryptoHash::~LowCryptoHash()
 {
+    low_data_clear_callback(mLow, this);
+    low_loop_clear_callback(mLow, this);
+
     mbedtls_md_free(&mContext);
 
+    if(mFD >= 0)
+        close(mFD);
+    if(mPath)
+    {
+        // Only with HashFile the data is ours
+        low_free(mPath);
+        low_free(mData);
+    }
+
+    if(mBufferID)
+        low_remove_stash(mLow->duk_ctx, mBufferID);
+    if(mCallID)
+    {
+        low_remove_stash(mLow->duk_ctx, mCallID);
+        mLow->run_ref--;
+    }
+
     if(mIndex >= 0)
     {
         if(mIndex >= mLow->cryptoHashes.size() ||
@@ -54,6 +94,9 @@ LowCryptoHash::~LowCryptoHash()
 
 void LowCryptoHash::Update(unsigned char *data, int len)
 {
+    if(mCallID)
+        duk_generic_error(mLow->duk_ctx, "hash is busy with an asynchronous update");
+
     int res = mHMAC ? mbedtls_md_hmac_update(&mContext, data, len)
                     : mbedtls_md_update(&mContext, data, len);
     if(res != 0)
@@ -66,8 +109,204 @@ void LowCryptoHash::Update(unsigned char *data, int len)
 
 void LowCryptoHash::Digest(unsigned char *data, int len)
 {
+    if(mCallID)
+        duk_generic_error(mLow->duk_ctx, "hash is busy with an asynchronous update");
+
     int res = mHMAC ? mbedtls_md_hmac_finish(&mContext, data)
                     : mbedtls_md_finish(&mContext, data);
     if(res != 0)
         duk_generic_error(mLow->duk_ctx, "mbedtls error code #%d", res);
-}
\ No newline at end of file
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoHash::UpdateAsync
+// -----------------------------------------------------------------------------
+
+void LowCryptoHash::UpdateAsync(unsigned char *data, int len,
+                                int bufferIndex, int callIndex)
+{
+    if(mCallID)
+        duk_generic_error(mLow->duk_ctx, "hash is busy with an asynchronous update");
+
+    mData = data;
+    mLen = len;
+    mError = 0;
+
+    // The buffer must stay alive while the data thread works on it
+    mBufferID = low_add_stash(mLow->duk_ctx, bufferIndex);
+    mCallID = low_add_stash(mLow->duk_ctx, callIndex);
+    mLow->run_ref++;
+
+    low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_MODIFY);
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoHash::HashFile
+// -----------------------------------------------------------------------------
+
+bool LowCryptoHash::HashFile(const char *path, int callIndex)
+{
+#if LOW_ESP32_LWIP_SPECIALITIES || defined(LOWJS_SERV)
+    int len = 32 + strlen(path) + strlen(mLow->cwd);
+
+    mPath = (char *)low_alloc(len);
+    if(mPath)
+        if(!low_fs_resolve(mPath, len, mLow->cwd, path))
+        {
+            low_free(mPath);
+            mPath = NULL;
+
+            mError = ENOENT;
+            return false;
+        }
+#else
+    mPath = low_strdup(path);
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+    if(!mPath)
+    {
+        mError = ENOMEM;
+        return false;
+    }
+    mData = (unsigned char *)low_alloc(LOW_CRYPTO_HASH_FILE_BLOCK);
+    if(!mData)
+    {
+        mError = ENOMEM;
+        return false;
+    }
+
+    mCallID = low_add_stash(mLow->duk_ctx, callIndex);
+    mLow->run_ref++;
+
+    low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_READ);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoHash::OnData
+// -----------------------------------------------------------------------------
+
+bool LowCryptoHash::OnData()
+{
+    int res;
+
+    if(!mPath)
+    {
+        res = mHMAC ? mbedtls_md_hmac_update(&mContext, mData, mLen)
+                    : mbedtls_md_update(&mContext, mData, mLen);
+        if(res != 0)
+        {
+            mError = res;
+            mSyscall = NULL;
+        }
+
+        low_loop_set_callback(mLow, this);
+        return true;
+    }
+
+    if(mFD < 0)
+    {
+        mFD = open(mPath NOT_ESP32_ADD_1, O_RDONLY);
+        if(mFD < 0)
+        {
+            mError = errno;
+            mSyscall = "open";
+
+            low_loop_set_callback(mLow, this);
+            return true;
+        }
+    }
+
+    int len = read(mFD, mData, LOW_CRYPTO_HASH_FILE_BLOCK);
+    if(len < 0)
+    {
+        if(errno == EINTR)
+        {
+            low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_READ);
+            return true;
+        }
+
+        mError = errno;
+        mSyscall = "read";
+    }
+    else if(len > 0)
+    {
+        res = mHMAC ? mbedtls_md_hmac_update(&mContext, mData, len)
+                    : mbedtls_md_update(&mContext, mData, len);
+        if(res == 0)
+        {
+            // Queue up again behind the other file operations
+            low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_READ);
+            return true;
+        }
+
+        mError = res;
+        mSyscall = NULL;
+    }
+    else
+    {
+        res = mHMAC ? mbedtls_md_hmac_finish(&mContext, mDigest)
+                    : mbedtls_md_finish(&mContext, mDigest);
+        if(res != 0)
+        {
+            mError = res;
+            mSyscall = NULL;
+        }
+    }
+
+    close(mFD);
+    mFD = -1;
+
+    low_loop_set_callback(mLow, this);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowCryptoHash::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowCryptoHash::OnLoop()
+{
+    if(!mCallID)
+        return true;
+
+    bool isFile = mPath != NULL;
+    if(!isFile)
+    {
+        low_remove_stash(mLow->duk_ctx, mBufferID);
+        mBufferID = 0;
+        mData = NULL;
+    }
+
+    int callID = mCallID;
+    mCallID = 0;
+    mLow->run_ref--;
+
+    low_push_stash(mLow->duk_ctx, callID, true);
+    if(mError && mSyscall)
+    {
+        low_push_error(mLow->duk_ctx, mError, mSyscall);
+        duk_call(mLow->duk_ctx, 1);
+    }
+    else if(mError)
+    {
+        duk_push_error_object(mLow->duk_ctx, DUK_ERR_ERROR,
+                              "mbedtls error code #%d", mError);
+        duk_call(mLow->duk_ctx, 1);
+    }
+    else if(isFile)
+    {
+        duk_push_null(mLow->duk_ctx);
+        unsigned char *digest =
+          (unsigned char *)low_push_buffer(mLow->duk_ctx, mOutputSize);
+        memcpy(digest, mDigest, mOutputSize);
+        duk_call(mLow->duk_ctx, 2);
+    }
+    else
+    {
+        duk_push_null(mLow->duk_ctx);
+        duk_call(mLow->duk_ctx, 1);
+    }
+
+    // File hashes are not referenced by JavaScript, we are done with them
+    return !isFile;
+}
@@ -5,28 +5,53 @@
 #ifndef __LOWCRYPTOHASH_H__
 #define __LOWCRYPTOHASH_H__
 
+#include "LowDataCallback.h"
+#include "LowLoopCallback.h"
+
 #include "low_main.h"
 
 #include "mbedtls/md.h"
 
+// Size of the blocks HashFile reads. Every block is one data thread job,
+// so other file operations are not starved by large files
+#ifndef LOW_CRYPTO_HASH_FILE_BLOCK
+#define LOW_CRYPTO_HASH_FILE_BLOCK (32 * 1024)
+#endif /* LOW_CRYPTO_HASH_FILE_BLOCK */
+
 using namespace std;
 
 class LowCryptoHash
+    : public LowDataCallback
+    , public LowLoopCallback
 {
   public:
     LowCryptoHash(low_t *low,
                   const mbedtls_md_info_t *info,
                   unsigned char *key,
                   int key_len);
-    ~LowCryptoHash();
+    virtual ~LowCryptoHash();
 
     void SetIndex(int index) { mIndex = index; }
 
     void Update(unsigned char *data, int len);
     void Digest(unsigned char *data, int len);
 
+    // Runs the update on a data thread and calls callback(err) when done
+    void UpdateAsync(unsigned char *data, int len, int bufferIndex,
+                     int callIndex);
+    // Hashes the whole file on the data threads and calls
+    // callback(err, digest). The object deletes itself afterwards.
+    // Returns false if out of memory or the path cannot be resolved, the
+    // caller then deletes the object and throws Error()
+    bool HashFile(const char *path, int callIndex);
+    int Error() { return mError; }
+
     int OutputSize() { return mOutputSize; }
 
+  protected:
+    virtual bool OnData();
+    virtual bool OnLoop();
+
   private:
     low_t *mLow;
     int mIndex;
@@ -35,6 +60,14 @@ class LowCryptoHash
 
     bool mHMAC;
     int mOutputSize;
+
+    unsigned char *mData;
+    int mLen, mBufferID, mCallID;
+
+    char *mPath;
+    int mFD, mError;
+    const char *mSyscall;
+    unsigned char mDigest[MBEDTLS_MD_MAX_SIZE];
 };
 
-#endif /* __LOWCRYPTOHASH_H__ */
\ No newline at end of file
+#endif /* __LOWCRYPTOHASH_H__ */
@@ -5,6 +5,8 @@
 #ifndef __LOWDATACALLBACK_H__
 #define __LOWDATACALLBACK_H__
 
+#include "duktape.h"
+
 struct low_t;
 
 class LowDataCallback
@@ -15,10 +17,13 @@ class LowDataCallback
                                       LowDataCallback *callback, int priority);
     friend void low_data_clear_callback(low_t *low,
                                         LowDataCallback *callback);
+    friend void low_data_clear_heap(low_t *low);
+    friend duk_ret_t low_metrics(duk_context *ctx);
 
 public:
     LowDataCallback(low_t *low)
-        : mLow(low), mNext(nullptr), mInDataThread(false), mDataClearOnReset(true)
+        : mLow(low), mNext(nullptr), mQueuedAt(0), mInDataThread(false),
+          mDataClearOnReset(true)
     {
     }
     virtual ~LowDataCallback() { low_data_clear_callback(mLow, this); }
@@ -29,6 +34,7 @@ protected:
 private:
     low_t *mLow;
     LowDataCallback *mNext;
+    long long mQueuedAt;    // in us, for low_metrics
 
     bool mInDataThread;
 
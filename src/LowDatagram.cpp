@@ -5,6 +5,7 @@
 #include "LowDatagram.h"
 
 #include "low_system.h"
+#include "low_alloc.h"
 
 #if LOW_ESP32_LWIP_SPECIALITIES
 #include <lwip/sockets.h>
@@ -22,8 +23,10 @@
 // -----------------------------------------------------------------------------
 
 LowDatagram::LowDatagram(low_t *low)
-    : LowFD(low, LOWFD_TYPE_DATAGRAM), LowLoopCallback(low), mLow(low), mMessageCallID(0), mSendBufferID(0), mSendCallID(0), mHasRecv(false)
+    : LowFD(low, LOWFD_TYPE_DATAGRAM), LowLoopCallback(low), mLow(low), mMessageCallID(0), mCloseCallID(0), mInLoop(false),
+      mSendDone(0), mRecvData(NULL), mRecvRead(0), mRecvWrite(0), mRecvUsed(0), mRecvErr(0)
 {
+    pthread_mutex_init(&mMutex, NULL);
 }
 
 
@@ -40,10 +43,16 @@ LowDatagram::~LowDatagram()
 
     if (mMessageCallID)
         low_remove_stash(mLow->duk_ctx, mMessageCallID);
-    if (mSendCallID)
-        low_remove_stash(mLow->duk_ctx, mSendCallID);
-    if (mSendBufferID)
-        low_remove_stash(mLow->duk_ctx, mSendBufferID);
+    if (mCloseCallID)
+        low_remove_stash(mLow->duk_ctx, mCloseCallID);
+    for(int i = 0; i < mSendQueue.size(); i++)
+    {
+        low_remove_stash(mLow->duk_ctx, mSendQueue[i].callID);
+        low_remove_stash(mLow->duk_ctx, mSendQueue[i].bufferID);
+    }
+
+    low_free(mRecvData);
+    pthread_mutex_destroy(&mMutex);
 }
 
 
@@ -79,6 +88,7 @@ bool LowDatagram::Bind(struct sockaddr *addr, int addrLen, int callIndex, int &e
         close(fd);
         return false;
     }
+    mode = 1;
     if (ioctl(fd, FIONBIO, &mode) < 0)
     {
         err = errno;
@@ -97,6 +107,28 @@ bool LowDatagram::Bind(struct sockaddr *addr, int addrLen, int callIndex, int &e
         return false;
     }
 
+    // The receive ring is only needed once we are bound
+    mRecvData = (unsigned char *)low_alloc(LOW_DGRAM_RECV_SLOTS * LOW_DGRAM_MAX_SIZE);
+    if (!mRecvData)
+    {
+        err = ENOMEM;
+        syscall = "malloc";
+
+        close(fd);
+        return false;
+    }
+    for (int i = 0; i < LOW_DGRAM_RECV_SLOTS; i++)
+    {
+        mRecvIOV[i].iov_base = mRecvData + i * LOW_DGRAM_MAX_SIZE;
+        mRecvIOV[i].iov_len = LOW_DGRAM_MAX_SIZE;
+#if LOW_HAS_MMSG
+        memset(&mRecvMsgs[i], 0, sizeof(mRecvMsgs[i]));
+        mRecvMsgs[i].msg_hdr.msg_name = &mRecvAddr[i];
+        mRecvMsgs[i].msg_hdr.msg_iov = &mRecvIOV[i];
+        mRecvMsgs[i].msg_hdr.msg_iovlen = 1;
+#endif /* LOW_HAS_MMSG */
+    }
+
     // Get port, if we called bind with 0
     if ((addr->sa_family == AF_INET && !((struct sockaddr_in *)addr)->sin_port) || (addr->sa_family == AF_INET6 && !((struct sockaddr_in6 *)addr)->sin6_port))
         getsockname(fd, addr, (socklen_t *)&addrLen);
@@ -116,17 +148,12 @@ bool LowDatagram::Bind(struct sockaddr *addr, int addrLen, int callIndex, int &e
 
 void LowDatagram::Send(int bufferIndex, const char *address, int port, int callIndex)
 {
-    if(mSendCallID)
-    {
-        duk_dup(mLow->duk_ctx, callIndex);
-        low_push_error(mLow->duk_ctx, EAGAIN, "write");
-        low_call_next_tick(mLow->duk_ctx, 1);
-        return;
-    }
+    LowDatagramSend send;
+    memset(&send.addr, 0, sizeof(send.addr));
 
     if(mFamily == AF_INET)
     {
-        sockaddr_in *addr_in = (sockaddr_in *)&mSendAddr;
+        sockaddr_in *addr_in = (sockaddr_in *)&send.addr;
 
         addr_in->sin_family = AF_INET;
         if(inet_pton(AF_INET, address, &addr_in->sin_addr) != 1)
@@ -141,7 +168,7 @@ void LowDatagram::Send(int bufferIndex, const char *address, int port, int callI
     }
     else
     {
-        sockaddr_in6 *addr_in6 = (sockaddr_in6 *)&mSendAddr;
+        sockaddr_in6 *addr_in6 = (sockaddr_in6 *)&send.addr;
 
         addr_in6->sin6_family = AF_INET6;
         if(inet_pton(AF_INET6, address, &addr_in6->sin6_addr) != 1)
@@ -156,28 +183,39 @@ void LowDatagram::Send(int bufferIndex, const char *address, int port, int callI
     }
 
     duk_size_t len;
-    mSendData = (unsigned char *)duk_require_buffer_data(mLow->duk_ctx, bufferIndex, &len);
-    mSendLen = len;
+    send.data = (unsigned char *)duk_require_buffer_data(mLow->duk_ctx, bufferIndex, &len);
+    send.len = len;
+    send.err = 0;
 
-    int res = sendto(FD(), mSendData, mSendLen, 0, (struct sockaddr *)&mSendAddr, mFamily == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6));
-    if(res != -1 || (errno != EAGAIN && errno != EINTR))
+    pthread_mutex_lock(&mMutex);
+    if(mSendQueue.empty())
     {
-        int err = errno;
-        mSendData = NULL;
+        // Nothing queued, so we may try to send right away
+        int res = sendto(FD(), send.data, send.len, 0, (struct sockaddr *)&send.addr, mFamily == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6));
+        if(res != -1 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            int err = errno;
+            pthread_mutex_unlock(&mMutex);
 
-        duk_dup(mLow->duk_ctx, callIndex);
-        if(len > 0)
-            duk_push_null(mLow->duk_ctx);
-        else
-            low_push_error(mLow->duk_ctx, err, "sendto");
-        low_call_next_tick(mLow->duk_ctx, 1);
-    }
-    else
-    {
-        mSendBufferID = low_add_stash(mLow->duk_ctx, bufferIndex);
-        mSendCallID = low_add_stash(mLow->duk_ctx, callIndex);
-        low_web_set_poll_events(mLow, this, POLLIN | POLLOUT);
+            duk_dup(mLow->duk_ctx, callIndex);
+            if(res != -1)
+                duk_push_null(mLow->duk_ctx);
+            else
+                low_push_error(mLow->duk_ctx, err, "sendto");
+            low_call_next_tick(mLow->duk_ctx, 1);
+            return;
+        }
     }
+    pthread_mutex_unlock(&mMutex);
+
+    send.bufferID = low_add_stash(mLow->duk_ctx, bufferIndex);
+    send.callID = low_add_stash(mLow->duk_ctx, callIndex);
+
+    pthread_mutex_lock(&mMutex);
+    mSendQueue.push_back(send);
+    pthread_mutex_unlock(&mMutex);
+
+    UpdatePollEvents();
 }
 
 
@@ -187,132 +225,313 @@ void LowDatagram::Send(int bufferIndex, const char *address, int port, int callI
 
 bool LowDatagram::Close(int callIndex = -1)
 {
+    // Called from a callback in OnLoop, we may not be deleted yet
+    if(mInLoop && callIndex >= 0 && !mCloseCallID)
+    {
+        mCloseCallID = low_add_stash(mLow->duk_ctx, callIndex);
+        return true;
+    }
+
     return false;
 }
 
 
 // -----------------------------------------------------------------------------
-//  LowDatagram::OnEvents
+//  LowDatagram::DoRecv - called with mutex locked, from web thread
 // -----------------------------------------------------------------------------
 
-bool LowDatagram::OnEvents(short events)
+bool LowDatagram::DoRecv()
 {
-    bool handled = false;
-    int newEvents = 0;
+    bool received = false;
 
-    if((events & POLLIN) && !mHasRecv)
+    while(mRecvUsed < LOW_DGRAM_RECV_SLOTS && !mRecvErr)
     {
-        mRecvAddrLen = mFamily == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
-        mRecvLen = recvfrom(FD(), mRecvData, sizeof(mRecvData), 0, (struct sockaddr *)&mRecvAddr, &mRecvAddrLen);
-        mRecvErr = errno;
-        mHasRecv = true;
+        // Receive into the free slots, as far as they are in one piece
+        int pos = mRecvWrite;
+        int count = LOW_DGRAM_RECV_SLOTS - mRecvUsed;
+        if(count > LOW_DGRAM_RECV_SLOTS - pos)
+            count = LOW_DGRAM_RECV_SLOTS - pos;
+
+#if LOW_HAS_MMSG
+        for(int i = 0; i < count; i++)
+            mRecvMsgs[pos + i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+
+        int res = recvmmsg(FD(), mRecvMsgs + pos, count, MSG_DONTWAIT, NULL);
+        for(int i = 0; i < res; i++)
+            mRecvLen[pos + i] = mRecvMsgs[pos + i].msg_len;
+#else
+        int res;
+        for(res = 0; res < count; res++)
+        {
+            socklen_t addrLen = sizeof(struct sockaddr_in6);
+            int len = recvfrom(FD(), mRecvIOV[pos + res].iov_base, LOW_DGRAM_MAX_SIZE, 0, (struct sockaddr *)&mRecvAddr[pos + res], &addrLen);
+            if(len < 0)
+            {
+                if(!res)
+                    res = -1;
+                break;
+            }
+            mRecvLen[pos + res] = len;
+        }
+#endif /* LOW_HAS_MMSG */
 
-        if(mRecvLen != -1 || errno != EAGAIN)
-            handled = true;
-        else
-            newEvents |= POLLIN;
-    }
-    if((events & POLLOUT) && mSendCallID)
-    {
-        mSendLen = sendto(FD(), mSendData, mSendLen, 0, (struct sockaddr *)&mSendAddr, mFamily == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6));
-        mSendErr = errno;
-        mSendData = NULL;
+        if(res <= 0)
+        {
+            if(res < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                mRecvErr = errno;
+                received = true;
+            }
+            break;
+        }
 
-        if(mSendLen != -1 || errno != EAGAIN)
-            handled = true;
-        else
-            newEvents |= POLLOUT;
+        mRecvWrite = (pos + res) % LOW_DGRAM_RECV_SLOTS;
+        mRecvUsed += res;
+        received = true;
+
+        if(res != count)
+            break;
     }
 
-    low_web_set_poll_events(mLow, this, newEvents);
-    if(handled)
-        low_loop_set_callback(mLow, this);
-    return true;
+    return received;
 }
 
 
 // -----------------------------------------------------------------------------
-//  LowDatagram::OnLoop
+//  LowDatagram::DoSend - called with mutex locked, from web thread
 // -----------------------------------------------------------------------------
 
-bool LowDatagram::OnLoop()
+bool LowDatagram::DoSend()
 {
-    if(mHasRecv)
+    bool sent = false;
+
+    while(mSendDone < mSendQueue.size())
     {
-        char remoteHost[INET6_ADDRSTRLEN];
-        const char *syscall = "recvfrom";
+        int count = mSendQueue.size() - mSendDone;
+        if(count > LOW_DGRAM_BATCH)
+            count = LOW_DGRAM_BATCH;
 
-        if(mRecvLen != -1)
+#if LOW_HAS_MMSG
+        struct mmsghdr msgs[LOW_DGRAM_BATCH];
+        struct iovec iov[LOW_DGRAM_BATCH];
+
+        memset(msgs, 0, count * sizeof(struct mmsghdr));
+        for(int i = 0; i < count; i++)
         {
-            if(mRecvAddr.sin6_family == AF_INET)
-            {
-                unsigned char *ip = (unsigned char *)&((struct sockaddr_in *)&mRecvAddr)->sin_addr.s_addr;
-                sprintf(remoteHost, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
-            }
-            else
+            LowDatagramSend &send = mSendQueue[mSendDone + i];
+
+            iov[i].iov_base = send.data;
+            iov[i].iov_len = send.len;
+            msgs[i].msg_hdr.msg_name = &send.addr;
+            msgs[i].msg_hdr.msg_namelen = mFamily == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int res = sendmmsg(FD(), msgs, count, MSG_DONTWAIT);
+#else
+        int res;
+        for(res = 0; res < count; res++)
+        {
+            LowDatagramSend &send = mSendQueue[mSendDone + res];
+            if(sendto(FD(), send.data, send.len, 0, (struct sockaddr *)&send.addr, mFamily == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6)) < 0)
             {
-                if(inet_ntop(AF_INET6,
-                            mRecvAddr.sin6_addr.s6_addr,
-                            remoteHost,
-                            sizeof(remoteHost)) == NULL)
-                {
-                    mRecvErr = errno;
-                    mRecvLen = -1;
-                    syscall = "inet_ntop";
-                }
+                if(!res)
+                    res = -1;
+                break;
             }
         }
+#endif /* LOW_HAS_MMSG */
 
-        low_push_stash(mLow->duk_ctx, mMessageCallID, false);
-        if(mRecvLen == -1)
+        if(res < 0)
         {
-            low_push_error(mLow->duk_ctx, mRecvErr, syscall);
-            duk_call(mLow->duk_ctx, 1);
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+
+            // The first datagram failed, report it and go on with the others
+            mSendQueue[mSendDone++].err = errno;
+            sent = true;
+            continue;
         }
-        else
-        {
-            duk_push_null(mLow->duk_ctx);
-            memcpy(low_push_buffer(mLow->duk_ctx, mRecvLen), mRecvData, mRecvLen);
-            duk_push_object(mLow->duk_ctx);
 
-            duk_push_string(mLow->duk_ctx, remoteHost);
-            duk_put_prop_string(mLow->duk_ctx, -2, "address");
-            if(mRecvAddr.sin6_family == AF_INET)
-            {
-                duk_push_int(mLow->duk_ctx, ntohs(((struct sockaddr_in *)&mRecvAddr)->sin_port));
-                duk_put_prop_string(mLow->duk_ctx, -2, "port");
-                duk_push_string(mLow->duk_ctx, "IPv4");
-                duk_put_prop_string(mLow->duk_ctx, -2, "family");
-            }
-            else
-            {
-                duk_push_int(mLow->duk_ctx, ntohs(mRecvAddr.sin6_port));
-                duk_put_prop_string(mLow->duk_ctx, -2, "port");
-                duk_push_string(mLow->duk_ctx, "IPv6");
-                duk_put_prop_string(mLow->duk_ctx, -2, "family");
-            }
-            duk_push_int(mLow->duk_ctx, mRecvLen);
-            duk_put_prop_string(mLow->duk_ctx, -2, "size");
+        mSendDone += res;
+        sent = true;
 
-            duk_call(mLow->duk_ctx, 3);
-        }
+        if(res != count)
+            break;
+    }
+
+    return sent;
+}
 
-        mHasRecv = false;
+
+// -----------------------------------------------------------------------------
+//  LowDatagram::UpdatePollEvents
+// -----------------------------------------------------------------------------
+
+void LowDatagram::UpdatePollEvents()
+{
+    pthread_mutex_lock(&mMutex);
+    short events = (mRecvUsed < LOW_DGRAM_RECV_SLOTS && !mRecvErr ? POLLIN : 0)
+                 | (mSendDone < mSendQueue.size() ? POLLOUT : 0);
+    pthread_mutex_unlock(&mMutex);
+
+    low_web_set_poll_events(mLow, this, events);
+}
+
+
+// -----------------------------------------------------------------------------
+//  LowDatagram::OnEvents
+// -----------------------------------------------------------------------------
+
+bool LowDatagram::OnEvents(short events)
+{
+    bool handled = false;
+
+    pthread_mutex_lock(&mMutex);
+    if(events & POLLIN)
+        handled = DoRecv();
+    if(events & POLLOUT)
+        handled = DoSend() || handled;
+    pthread_mutex_unlock(&mMutex);
+
+    UpdatePollEvents();
+    if(handled)
+        low_loop_set_callback(mLow, this);
+    return true;
+}
+
+
+// -----------------------------------------------------------------------------
+//  LowDatagram::PushMessage - pushes buffer and rinfo of ring slot
+// -----------------------------------------------------------------------------
+
+void LowDatagram::PushMessage(int slot)
+{
+    struct sockaddr_in6 *addr = &mRecvAddr[slot];
+    char remoteHost[INET6_ADDRSTRLEN];
+
+    if(addr->sin6_family == AF_INET)
+    {
+        unsigned char *ip = (unsigned char *)&((struct sockaddr_in *)addr)->sin_addr.s_addr;
+        sprintf(remoteHost, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
     }
-    if(!mSendData && mSendCallID)
+    else if(inet_ntop(AF_INET6, addr->sin6_addr.s6_addr, remoteHost, sizeof(remoteHost)) == NULL)
     {
-        low_push_stash(mLow->duk_ctx, mSendCallID, true);
-        mSendCallID = 0;
-        low_remove_stash(mLow->duk_ctx, mSendBufferID);
-        mSendBufferID = 0;
+        low_push_error(mLow->duk_ctx, errno, "inet_ntop");
+        return;
+    }
+
+    duk_push_null(mLow->duk_ctx);
+    memcpy(low_push_buffer(mLow->duk_ctx, mRecvLen[slot]), mRecvIOV[slot].iov_base, mRecvLen[slot]);
+    duk_push_object(mLow->duk_ctx);
 
-        if(mSendLen == -1)
-            low_push_error(mLow->duk_ctx, mSendErr, "sendto");
+    duk_push_string(mLow->duk_ctx, remoteHost);
+    duk_put_prop_string(mLow->duk_ctx, -2, "address");
+    if(addr->sin6_family == AF_INET)
+    {
+        duk_push_int(mLow->duk_ctx, ntohs(((struct sockaddr_in *)addr)->sin_port));
+        duk_put_prop_string(mLow->duk_ctx, -2, "port");
+        duk_push_string(mLow->duk_ctx, "IPv4");
+        duk_put_prop_string(mLow->duk_ctx, -2, "family");
+    }
+    else
+    {
+        duk_push_int(mLow->duk_ctx, ntohs(addr->sin6_port));
+        duk_put_prop_string(mLow->duk_ctx, -2, "port");
+        duk_push_string(mLow->duk_ctx, "IPv6");
+        duk_put_prop_string(mLow->duk_ctx, -2, "family");
+    }
+    duk_push_int(mLow->duk_ctx, mRecvLen[slot]);
+    duk_put_prop_string(mLow->duk_ctx, -2, "size");
+}
+
+
+// -----------------------------------------------------------------------------
+//  LowDatagram::CallJS
+// -----------------------------------------------------------------------------
+
+void LowDatagram::CallJS(int numArgs)
+{
+    if(duk_pcall(mLow->duk_ctx, numArgs) != DUK_EXEC_SUCCESS)
+    {
+        // Continue with the rest in the next loop iteration
+        mInLoop = false;
+        low_loop_set_callback(mLow, this);
+        duk_throw(mLow->duk_ctx);
+    }
+    duk_pop(mLow->duk_ctx);
+}
+
+
+// -----------------------------------------------------------------------------
+//  LowDatagram::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowDatagram::OnLoop()
+{
+    mInLoop = true;
+
+    // Deliver all datagrams which are in the ring now
+    pthread_mutex_lock(&mMutex);
+    int count = mRecvUsed, recvErr = mRecvErr;
+    mRecvErr = 0;
+    pthread_mutex_unlock(&mMutex);
+
+    for(int i = 0; i < count && !mCloseCallID; i++)
+    {
+        low_push_stash(mLow->duk_ctx, mMessageCallID, false);
+        PushMessage(mRecvRead);
+        int numArgs = duk_get_top(mLow->duk_ctx) - 1;
+
+        // Slot is copied, give it back before calling JavaScript
+        pthread_mutex_lock(&mMutex);
+        mRecvRead = (mRecvRead + 1) % LOW_DGRAM_RECV_SLOTS;
+        mRecvUsed--;
+        pthread_mutex_unlock(&mMutex);
+
+        CallJS(numArgs);
+    }
+    if(recvErr && !mCloseCallID)
+    {
+        low_push_stash(mLow->duk_ctx, mMessageCallID, false);
+        low_push_error(mLow->duk_ctx, recvErr, "recvfrom");
+        CallJS(1);
+    }
+
+    // Call callbacks of finished sends
+    while(true)
+    {
+        pthread_mutex_lock(&mMutex);
+        if(!mSendDone)
+        {
+            pthread_mutex_unlock(&mMutex);
+            break;
+        }
+        LowDatagramSend send = mSendQueue.front();
+        mSendQueue.pop_front();
+        mSendDone--;
+        pthread_mutex_unlock(&mMutex);
+
+        low_remove_stash(mLow->duk_ctx, send.bufferID);
+        low_push_stash(mLow->duk_ctx, send.callID, true);
+        if(send.err)
+            low_push_error(mLow->duk_ctx, send.err, "sendto");
         else
             duk_push_null(mLow->duk_ctx);
-        duk_call(mLow->duk_ctx, 1);
+        CallJS(1);
     }
-    low_web_set_poll_events(mLow, this, (mSendCallID ? POLLOUT : 0) | POLLIN);
 
+    mInLoop = false;
+    if(mCloseCallID)
+    {
+        low_push_stash(mLow->duk_ctx, mCloseCallID, true);
+        mCloseCallID = 0;
+        duk_push_null(mLow->duk_ctx);
+        low_call_next_tick(mLow->duk_ctx, 1);
+        return false;
+    }
+
+    UpdatePollEvents();
     return true;
-}
\ No newline at end of file
+}
@@ -8,9 +8,44 @@
 #include "LowFD.h"
 #include "LowLoopCallback.h"
 
+#include "low_config.h"
+
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <pthread.h>
+
+#include <deque>
+
+// Defaults for platforms which do not set these (embedded)
+#ifndef LOW_HAS_MMSG
+#define LOW_HAS_MMSG 0
+#endif /* LOW_HAS_MMSG */
+#ifndef LOW_DGRAM_BATCH
+#define LOW_DGRAM_BATCH 1
+#endif /* LOW_DGRAM_BATCH */
+#ifndef LOW_DGRAM_MAX_SIZE
+#define LOW_DGRAM_MAX_SIZE 1500
+#endif /* LOW_DGRAM_MAX_SIZE */
+#ifndef LOW_DGRAM_RECV_BUFFER
+#define LOW_DGRAM_RECV_BUFFER LOW_DGRAM_MAX_SIZE
+#endif /* LOW_DGRAM_RECV_BUFFER */
+
+// Slots of the receive ring, as many as fit into LOW_DGRAM_RECV_BUFFER but
+// at least one and at most LOW_DGRAM_BATCH
+#define LOW_DGRAM_RECV_SLOTS                                                  \
+    (LOW_DGRAM_RECV_BUFFER / LOW_DGRAM_MAX_SIZE < 1 ? 1                        \
+     : LOW_DGRAM_RECV_BUFFER / LOW_DGRAM_MAX_SIZE > LOW_DGRAM_BATCH            \
+       ? LOW_DGRAM_BATCH                                                       \
+       : LOW_DGRAM_RECV_BUFFER / LOW_DGRAM_MAX_SIZE)
+
+struct LowDatagramSend
+{
+    struct sockaddr_in6 addr;
+    unsigned char *data;
+    int len, err;
+    int bufferID, callID;
+};
 
 class LowDatagram
     : public LowFD
@@ -32,21 +67,37 @@ class LowDatagram
     virtual bool OnEvents(short events);
     virtual bool OnLoop();
 
+  private:
+    bool DoRecv();
+    bool DoSend();
+    void UpdatePollEvents();
+
+    void PushMessage(int slot);
+    void CallJS(int numArgs);
+
   private:
     low_t *mLow;
+    pthread_mutex_t mMutex;
 
     int mMessageCallID, mFamily;
+    int mCloseCallID;
+    bool mInLoop;
 
-    unsigned char *mSendData;
-    struct sockaddr_in6 mSendAddr;
-    int mSendLen, mSendErr;
-    int mSendBufferID, mSendCallID;
+    // Sends which are queued, the first mSendDone are done and wait for
+    // their callbacks to be called
+    std::deque<LowDatagramSend> mSendQueue;
+    int mSendDone;
 
-    unsigned char mRecvData[1500];
-    struct sockaddr_in6 mRecvAddr;
-    socklen_t mRecvAddrLen;
-    int mRecvLen, mRecvErr;
-    bool mHasRecv;
+    // Ring of receive slots, each LOW_DGRAM_MAX_SIZE bytes large, allocated
+    // by Bind. Filled by the web thread, emptied by the code thread
+    unsigned char *mRecvData;
+#if LOW_HAS_MMSG
+    struct mmsghdr mRecvMsgs[LOW_DGRAM_RECV_SLOTS];
+#endif /* LOW_HAS_MMSG */
+    struct iovec mRecvIOV[LOW_DGRAM_RECV_SLOTS];
+    struct sockaddr_in6 mRecvAddr[LOW_DGRAM_RECV_SLOTS];
+    int mRecvLen[LOW_DGRAM_RECV_SLOTS];
+    int mRecvRead, mRecvWrite, mRecvUsed, mRecvErr;
 };
 
-#endif /* __LOWDATAGRAM_H__ */
\ No newline at end of file
+#endif /* __LOWDATAGRAM_H__ */
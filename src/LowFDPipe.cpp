@@ -0,0 +1,508 @@
+// -----------------------------------------------------------------------------
+//  LowFDPipe.cpp
+// -----------------------------------------------------------------------------
+
+#include "LowFDPipe.h"
+#include "LowSocket.h"
+
+#include "low_alloc.h"
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if LOW_HAS_SENDFILE
+#include <sys/sendfile.h>
+#endif /* LOW_HAS_SENDFILE */
+
+// Chunks moved per event, so one busy pipe does not stall the other sockets
+#define LOWFDPIPE_ROUNDS 16
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe_End::SetSocket
+// -----------------------------------------------------------------------------
+
+void LowFDPipe_End::SetSocket(LowSocket *socket)
+{
+    mPipe->SetSocket(mIndex, socket);
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe_End::OnSocketRead
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe_End::OnSocketRead(bool &readMore)
+{
+    readMore = mPipe->OnRead(mIndex);
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe_End::OnSocketWrite
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe_End::OnSocketWrite()
+{
+    return mPipe->OnWrite(mIndex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::Start
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe::Start(low_t *low, int srcFD, int destFD, long long pos,
+                      long long len, int callIndex)
+{
+    auto iter = low->fds.find(destFD);
+    if(iter == low->fds.end() || iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        return false;
+    LowSocket *dest = (LowSocket *)iter->second;
+
+    iter = low->fds.find(srcFD);
+    if(iter == low->fds.end() || srcFD == destFD)
+        return false;
+    bool isFile = iter->second->FDType() == LOWFD_TYPE_FILE;
+    if(!isFile && iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        return false;
+    LowSocket *src = isFile ? NULL : (LowSocket *)iter->second;
+
+    // TLS sockets stay with JavaScript, their mbedTLS context is also used
+    // by the code thread (shutdown). The console is not a real socket on
+    // the microcontroller
+    if(dest->IsSecure() || !dest->IsConnected() || destFD <= 2)
+        return false;
+    if(src && (src->IsSecure() || !src->IsConnected() || srcFD <= 2))
+        return false;
+
+    int destType, srcType = 0;
+    LowSocketDirect *destDirect = dest->GetDirect(destType);
+    LowSocketDirect *srcDirect = src ? src->GetDirect(srcType) : NULL;
+
+    LowFDPipe *pipe;
+    int index;
+    if(!destDirect && !srcDirect)
+    {
+        pipe = new LowFDPipe(low);
+        if(!pipe)
+            return false;
+
+        index = 0;
+        pipe->Attach(0, dest);
+        if(src)
+            pipe->Attach(1, src);
+    }
+    else if(destDirect && srcDirect && destType == LOWFDPIPE_TYPE &&
+            srcType == LOWFDPIPE_TYPE &&
+            ((LowFDPipe_End *)destDirect)->mPipe ==
+              ((LowFDPipe_End *)srcDirect)->mPipe)
+    {
+        // The way back of a proxy
+        pipe = ((LowFDPipe_End *)destDirect)->mPipe;
+        index = ((LowFDPipe_End *)destDirect)->mIndex;
+        if(pipe->mFlows[index].callID)
+            return false;
+    }
+    else
+        return false;
+
+    int callID = low_add_stash(low->duk_ctx, callIndex);
+
+    LowFDPipe_Flow *flow = &pipe->mFlows[index];
+    pthread_mutex_lock(&pipe->mMutex);
+    flow->done = false;
+    flow->fileFD = isFile ? iter->second->FD() : -1;
+    flow->filePos = pos;
+    flow->fileLeft = len;
+    flow->dataPos = flow->dataLen = 0;
+    flow->bytes = 0;
+    flow->error = 0;
+    flow->callID = callID;
+    pthread_mutex_unlock(&pipe->mMutex);
+
+    if(src)
+        src->TriggerDirect(LOWSOCKET_TRIGGER_READ);
+    else
+        dest->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::LowFDPipe
+// -----------------------------------------------------------------------------
+
+LowFDPipe::LowFDPipe(low_t *low) : LowLoopCallback(low), mLow(low)
+{
+    pthread_mutex_init(&mMutex, NULL);
+
+    for(int i = 0; i < 2; i++)
+    {
+        mEnds[i].mPipe = this;
+        mEnds[i].mIndex = i;
+        mSockets[i] = NULL;
+
+        LowFDPipe_Flow *flow = &mFlows[i];
+        flow->callID = 0;
+        flow->done = false;
+        flow->data = NULL;
+        flow->dataPos = flow->dataLen = 0;
+#if LOW_HAS_SPLICE
+        flow->kernelPipe[0] = flow->kernelPipe[1] = -1;
+        flow->kernelLen = 0;
+#endif /* LOW_HAS_SPLICE */
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::~LowFDPipe
+// -----------------------------------------------------------------------------
+
+LowFDPipe::~LowFDPipe()
+{
+    for(int i = 0; i < 2; i++)
+        if(mSockets[i])
+            mSockets[i]->SetDirect(NULL, 0);
+
+    for(int i = 0; i < 2; i++)
+    {
+        LowFDPipe_Flow *flow = &mFlows[i];
+        if(flow->callID)
+            low_remove_stash(mLow->duk_ctx, flow->callID);
+        low_free(flow->data);
+#if LOW_HAS_SPLICE
+        if(flow->kernelPipe[0] >= 0)
+        {
+            close(flow->kernelPipe[0]);
+            close(flow->kernelPipe[1]);
+        }
+#endif /* LOW_HAS_SPLICE */
+    }
+
+    pthread_mutex_destroy(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe::OnLoop()
+{
+    duk_context *ctx = mLow->duk_ctx;
+
+    LowFDPipe_Flow done[2];
+    int count = 0;
+    bool active = false;
+
+    pthread_mutex_lock(&mMutex);
+    for(int i = 0; i < 2; i++)
+    {
+        if(mFlows[i].callID && mFlows[i].done)
+        {
+            done[count++] = mFlows[i];
+            mFlows[i].callID = 0;
+        }
+        else if(mFlows[i].callID)
+            active = true;
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    // Sockets are given back before JavaScript is called, so it may use
+    // them right away
+    if(!active)
+        for(int i = 0; i < 2; i++)
+            if(mSockets[i])
+                mSockets[i]->SetDirect(NULL, 0);
+
+    for(int i = 0; i < count; i++)
+    {
+        low_push_stash(ctx, done[i].callID, true);
+        if(done[i].error)
+            low_push_error(ctx, done[i].error, done[i].errorSyscall);
+        else
+            duk_push_null(ctx);
+        duk_push_int(ctx, done[i].errorSide);
+        duk_push_number(ctx, (double)done[i].bytes);
+        duk_push_boolean(ctx, !active);
+        duk_call(ctx, 4);
+    }
+
+    return active;
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::Attach
+// -----------------------------------------------------------------------------
+
+void LowFDPipe::Attach(int index, LowSocket *socket)
+{
+    socket->SetDirect(&mEnds[index], LOWFDPIPE_TYPE);
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::SetSocket - NULL if the socket is given back or deleted
+// -----------------------------------------------------------------------------
+
+void LowFDPipe::SetSocket(int index, LowSocket *socket)
+{
+    pthread_mutex_lock(&mMutex);
+    mSockets[index] = socket;
+    if(!socket)
+    {
+        // Closed while piping
+        LowFDPipe_Flow *in = &mFlows[index], *out = &mFlows[index ^ 1];
+        if(in->callID && !in->done)
+            Finish(in, ECONNRESET, "write", 1);
+        if(out->callID && !out->done && out->fileFD < 0)
+            Finish(out, ECONNRESET, "read", 0);
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::OnRead - the socket of the end is readable, moves what it has
+//  to the other end. Returns true to be called again when there is more
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe::OnRead(int index)
+{
+    bool readMore = false;
+    pthread_mutex_lock(&mMutex);
+
+    // Nothing is piped out of the socket: not read, JavaScript reads the
+    // data after we are done
+    LowFDPipe_Flow *flow = &mFlows[index ^ 1];
+    LowSocket *src = mSockets[index], *dest = mSockets[index ^ 1];
+    if(flow->callID && !flow->done && flow->fileFD < 0 && src && dest)
+        for(int round = 0;; round++)
+        {
+            // Backpressure: the source waits until the destination took
+            // the last chunk
+            if(!Flush(index ^ 1))
+            {
+                dest->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+                break;
+            }
+            if(flow->done)
+                break;
+            if(round == LOWFDPIPE_ROUNDS)
+            {
+                readMore = true;
+                break;
+            }
+
+#if LOW_HAS_SPLICE
+            if(flow->kernelPipe[0] < 0 && pipe2(flow->kernelPipe, O_NONBLOCK) < 0)
+            {
+                flow->kernelPipe[0] = flow->kernelPipe[1] = -1;
+                Finish(flow, errno, "pipe2", 0);
+                break;
+            }
+
+            int size = splice(src->FD(), NULL, flow->kernelPipe[1], NULL,
+                              LOWFDPIPE_CHUNK,
+                              SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(size > 0)
+                flow->kernelLen = size;
+#else
+            if(!flow->data)
+            {
+                flow->data = (unsigned char *)low_alloc(LOWFDPIPE_CHUNK);
+                if(!flow->data)
+                {
+                    Finish(flow, ENOMEM, "read", 0);
+                    break;
+                }
+            }
+
+            int size = src->read(flow->data, LOWFDPIPE_CHUNK);
+            if(size > 0)
+            {
+                flow->dataPos = 0;
+                flow->dataLen = size;
+            }
+#endif /* LOW_HAS_SPLICE */
+
+            if(size < 0)
+            {
+                if(errno == EAGAIN || errno == EINTR)
+                    readMore = true;
+                else
+                    Finish(flow, errno, LOW_HAS_SPLICE ? "splice" : "read", 0);
+                break;
+            }
+            if(size == 0)
+            {
+                Finish(flow);
+                break;
+            }
+        }
+
+    pthread_mutex_unlock(&mMutex);
+    return readMore;
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::OnWrite - the socket of the end is writable. Returns true to be
+//  called again
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe::OnWrite(int index)
+{
+    bool writeMore = false;
+    pthread_mutex_lock(&mMutex);
+
+    LowFDPipe_Flow *flow = &mFlows[index];
+    if(flow->callID && !flow->done && mSockets[index])
+    {
+        if(flow->fileFD >= 0)
+            writeMore = SendFile(index);
+        else if(!Flush(index))
+            writeMore = true;
+        else if(!flow->done && mSockets[index ^ 1])
+            mSockets[index ^ 1]->TriggerDirect(LOWSOCKET_TRIGGER_READ);
+    }
+
+    pthread_mutex_unlock(&mMutex);
+    return writeMore;
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::Flush - writes what is left of the last chunk into the end.
+//  Returns false if the socket is full
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe::Flush(int index)
+{
+    LowFDPipe_Flow *flow = &mFlows[index];
+    LowSocket *dest = mSockets[index];
+
+#if LOW_HAS_SPLICE
+    while(flow->kernelLen)
+    {
+        int size = splice(flow->kernelPipe[0], NULL, dest->FD(), NULL,
+                          flow->kernelLen, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+                return false;
+
+            Finish(flow, errno, "splice", 1);
+            return true;
+        }
+
+        flow->kernelLen -= size;
+        flow->bytes += size;
+    }
+#endif /* LOW_HAS_SPLICE */
+
+    while(flow->dataPos < flow->dataLen)
+    {
+        int size = dest->write(flow->data + flow->dataPos,
+                               flow->dataLen - flow->dataPos);
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+                return false;
+
+            Finish(flow, errno, "write", 1);
+            return true;
+        }
+
+        flow->dataPos += size;
+        flow->bytes += size;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::SendFile - moves the file of the flow into the end. Returns
+//  true to be called again
+// -----------------------------------------------------------------------------
+
+bool LowFDPipe::SendFile(int index)
+{
+    LowFDPipe_Flow *flow = &mFlows[index];
+    LowSocket *dest = mSockets[index];
+
+    for(int round = 0; round < LOWFDPIPE_ROUNDS; round++)
+    {
+        if(!Flush(index))
+            return true;
+        if(flow->done)
+            return false;
+
+        int size = flow->fileLeft >= 0 && flow->fileLeft < LOWFDPIPE_CHUNK
+                     ? (int)flow->fileLeft
+                     : LOWFDPIPE_CHUNK;
+        if(size == 0)
+        {
+            Finish(flow);
+            return false;
+        }
+
+#if LOW_HAS_SENDFILE
+        // From the page cache directly, without a position the one of the
+        // file is used and moved
+        off_t pos = flow->filePos;
+        ssize_t len = sendfile(dest->FD(), flow->fileFD,
+                               flow->filePos >= 0 ? &pos : NULL, size);
+        if(len < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+                return true;
+
+            Finish(flow, errno, "sendfile", 1);
+            return false;
+        }
+        flow->bytes += len;
+#else
+        if(!flow->data)
+        {
+            flow->data = (unsigned char *)low_alloc(LOWFDPIPE_CHUNK);
+            if(!flow->data)
+            {
+                Finish(flow, ENOMEM, "read", 0);
+                return false;
+            }
+        }
+
+        ssize_t len = flow->filePos >= 0
+                        ? pread(flow->fileFD, flow->data, size, flow->filePos)
+                        : read(flow->fileFD, flow->data, size);
+        if(len < 0)
+        {
+            Finish(flow, errno, "read", 0);
+            return false;
+        }
+        flow->dataPos = 0;
+        flow->dataLen = len;
+#endif /* LOW_HAS_SENDFILE */
+
+        if(len == 0)
+        {
+            Finish(flow);
+            return false;
+        }
+        if(flow->filePos >= 0)
+            flow->filePos += len;
+        if(flow->fileLeft >= 0)
+            flow->fileLeft -= len;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowFDPipe::Finish - the flow is done, JavaScript is told in OnLoop
+// -----------------------------------------------------------------------------
+
+void LowFDPipe::Finish(LowFDPipe_Flow *flow, int error, const char *syscall,
+                       int side)
+{
+    flow->done = true;
+    flow->error = error;
+    flow->errorSyscall = syscall;
+    flow->errorSide = side;
+    low_loop_set_callback(mLow, this);
+}
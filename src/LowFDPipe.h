@@ -0,0 +1,114 @@
+// -----------------------------------------------------------------------------
+//  LowFDPipe.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWFDPIPE_H__
+#define __LOWFDPIPE_H__
+
+#include "LowLoopCallback.h"
+#include "LowSocketDirect.h"
+
+#include <pthread.h>
+
+#include "low_config.h"
+
+// Defaults for platforms which do not set them (embedded)
+#ifndef LOW_HAS_SENDFILE
+#define LOW_HAS_SENDFILE 0
+#endif /* LOW_HAS_SENDFILE */
+#ifndef LOW_HAS_SPLICE
+#define LOW_HAS_SPLICE 0
+#endif /* LOW_HAS_SPLICE */
+
+#define LOWFDPIPE_TYPE 3
+
+// Bytes moved per system call, also the buffer size where the data has to
+// go through user space
+#if LOW_ESP32_LWIP_SPECIALITIES
+#define LOWFDPIPE_CHUNK (4 * 1024)
+#else
+#define LOWFDPIPE_CHUNK (64 * 1024)
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+
+class LowFDPipe;
+class LowSocket;
+
+// Direct of one of the sockets, tells the pipe which one calls
+class LowFDPipe_End : public LowSocketDirect
+{
+    friend class LowFDPipe;
+
+  protected:
+    virtual void SetSocket(LowSocket *socket);
+
+    virtual bool OnSocketRead(bool &readMore);
+    virtual bool OnSocketData(unsigned char *data, int len) { return false; }
+    virtual bool OnSocketWrite();
+
+  private:
+    LowFDPipe *mPipe;
+    int mIndex;
+};
+
+// Data written into one of the ends, from the other end or from a file
+struct LowFDPipe_Flow
+{
+    int callID;
+    bool done;
+
+    int fileFD;                     // -1 if from the other end
+    long long filePos, fileLeft;    // -1 for current position / up to EOF
+
+    unsigned char *data;
+    int dataPos, dataLen;
+#if LOW_HAS_SPLICE
+    int kernelPipe[2];
+    int kernelLen;
+#endif /* LOW_HAS_SPLICE */
+
+    long long bytes;
+    int error, errorSide;           // side 0 is the source, 1 the destination
+    const char *errorSyscall;
+};
+
+// stream.pipe between sockets, or from a file into a socket, done by the web
+// thread. Two sockets may pipe into each other (proxies). JavaScript only
+// gets the result of each flow, the sockets are given back when all are done
+class LowFDPipe : public LowLoopCallback
+{
+    friend class LowFDPipe_End;
+
+  public:
+    // Returns false if the FDs cannot be piped natively
+    static bool Start(low_t *low, int srcFD, int destFD, long long pos,
+                      long long len, int callIndex);
+
+  protected:
+    LowFDPipe(low_t *low);
+    virtual ~LowFDPipe();
+
+    virtual bool OnLoop();
+
+  private:
+    void Attach(int index, LowSocket *socket);
+
+    // Web thread, called by the ends
+    void SetSocket(int index, LowSocket *socket);
+    bool OnRead(int index);
+    bool OnWrite(int index);
+
+    bool Flush(int index);
+    bool SendFile(int index);
+    void Finish(LowFDPipe_Flow *flow, int error = 0,
+                const char *syscall = NULL, int side = 0);
+
+  private:
+    low_t *mLow;
+    pthread_mutex_t mMutex;
+
+    LowFDPipe_End mEnds[2];
+    LowSocket *mSockets[2];
+    LowFDPipe_Flow mFlows[2];       // index of the end written into
+};
+
+#endif /* __LOWFDPIPE_H__ */
@@ -36,7 +36,7 @@ void data_modified(char *filename);
 
 LowFile::LowFile(low_t *low, const char *path, int flags, int callID) :
     LowFD(low, LOWFD_TYPE_FILE), LowDataCallback(low), LowLoopCallback(low),
-    mLow(low), mClose(false)
+    mLow(low), mOwner(NULL), mClose(false)
 {
     if(callID)
     {
@@ -170,6 +170,28 @@ void LowFile::Write(int pos, unsigned char *data, int len, int callIndex)
     low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_MODIFY);
 }
 
+// -----------------------------------------------------------------------------
+//  LowFile::Write
+// -----------------------------------------------------------------------------
+
+bool LowFile::Write(int pos, unsigned char *data, int len,
+                    LowLoopCallback *owner)
+{
+    if(mClose || mPhase != LOWFILE_PHASE_READY)
+        return false;
+
+    mCallID = 0;
+    mOwner = owner;
+
+    mPos = pos;
+    mData = data;
+    mLen = len;
+    mPhase = LOWFILE_PHASE_WRITING;
+    mDataDone = false;
+    low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_MODIFY);
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 //  LowFile::FStat
 // -----------------------------------------------------------------------------
@@ -388,7 +410,13 @@ bool LowFile::FinishPhase()
        phase == LOWFILE_PHASE_CLOSING)
         mClose = true;
 
-    if(mCallID)
+    if(mOwner)
+    {
+        // The owner takes the result with WriteResult
+        low_loop_set_callback(mLow, mOwner);
+        mOwner = NULL;
+    }
+    else if(mCallID)
     {
         int callID = mCallID;
         mCallID = 0;
@@ -36,6 +36,12 @@ class LowFile
 
     void Read(int pos, unsigned char *data, int len, int callIndex);
     void Write(int pos, unsigned char *data, int len, int callIndex);
+    // For native code, owner gets a loop callback when the write is done.
+    // Returns false if the file is closed or busy
+    bool Write(int pos, unsigned char *data, int len, LowLoopCallback *owner);
+    bool Ready() { return mPhase == LOWFILE_PHASE_READY; }
+    // Length written by the last write, or -errno
+    int WriteResult() { return mError ? -mError : mLen; }
     void FStat(int callIndex);
     bool Close(int callIndex);
 
@@ -54,6 +60,7 @@ class LowFile
     int mPos, mLen;
     struct stat mStat;
     int mCallID;
+    LowLoopCallback *mOwner;
 
     int mPhase, mError;
     const char *mSyscall;
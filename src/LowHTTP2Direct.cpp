@@ -0,0 +1,1733 @@
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct.cpp
+// -----------------------------------------------------------------------------
+
+#include "LowHTTP2Direct.h"
+#include "LowSocket.h"
+
+#include "low_alloc.h"
+#include "low_codec.h"
+#include "low_config.h"
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+#include <string.h>
+
+// We keep the default SETTINGS_MAX_FRAME_SIZE, so no frame is bigger
+#define LOWHTTP2DIRECT_MAX_FRAME 16384
+
+// SETTINGS_HEADER_TABLE_SIZE, the default. Each entry costs 32 bytes more
+// than name and value, which limits the number of entries
+#define LOWHTTP2DIRECT_TABLE_SIZE 4096
+#define LOWHTTP2DIRECT_TABLE_SLOTS (LOWHTTP2DIRECT_TABLE_SIZE / 32)
+
+#if LOW_ESP32_LWIP_SPECIALITIES
+#define LOWHTTP2DIRECT_MAX_STREAMS 16
+#define LOWHTTP2DIRECT_STREAM_WINDOW 65535
+#define LOWHTTP2DIRECT_CONN_WINDOW 65535
+#define LOWHTTP2DIRECT_MAX_HEADERS (8 * 1024)
+#define LOWHTTP2DIRECT_MAX_OUT (32 * 1024)
+#define LOWHTTP2DIRECT_SEND_CHUNK (8 * 1024)
+#else
+#define LOWHTTP2DIRECT_MAX_STREAMS 1000
+#define LOWHTTP2DIRECT_STREAM_WINDOW (256 * 1024)
+#define LOWHTTP2DIRECT_CONN_WINDOW (1024 * 1024)
+#define LOWHTTP2DIRECT_MAX_HEADERS (64 * 1024)
+#define LOWHTTP2DIRECT_MAX_OUT (1024 * 1024)
+#define LOWHTTP2DIRECT_SEND_CHUNK (64 * 1024)
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+
+// Response data queued per stream, above this JavaScript waits for the
+// drain event
+#define LOWHTTP2DIRECT_HIGH_WATER (64 * 1024)
+
+#define LOWHTTP2_FLAG_ACK 0x1
+#define LOWHTTP2_FLAG_END_STREAM 0x1
+#define LOWHTTP2_FLAG_END_HEADERS 0x4
+#define LOWHTTP2_FLAG_PADDED 0x8
+#define LOWHTTP2_FLAG_PRIORITY 0x20
+
+#define LOWHTTP2_MAX_WINDOW 0x7FFFFFFF
+
+static const char g_low_http2_preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+#define LOWHTTP2_PREFACE_LEN 24
+
+// Static table of HPACK (RFC 7541, appendix A), index 1 is at 0
+static const char *const g_low_hpack_static[][2] = {
+  {":authority", ""}, {":method", "GET"}, {":method", "POST"},
+  {":path", "/"}, {":path", "/index.html"}, {":scheme", "http"},
+  {":scheme", "https"}, {":status", "200"}, {":status", "204"},
+  {":status", "206"}, {":status", "304"}, {":status", "400"},
+  {":status", "404"}, {":status", "500"}, {"accept-charset", ""},
+  {"accept-encoding", "gzip, deflate"}, {"accept-language", ""},
+  {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+  {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+  {"content-disposition", ""}, {"content-encoding", ""},
+  {"content-language", ""}, {"content-length", ""}, {"content-location", ""},
+  {"content-range", ""}, {"content-type", ""}, {"cookie", ""}, {"date", ""},
+  {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""}, {"host", ""},
+  {"if-match", ""}, {"if-modified-since", ""}, {"if-none-match", ""},
+  {"if-range", ""}, {"if-unmodified-since", ""}, {"last-modified", ""},
+  {"link", ""}, {"location", ""}, {"max-forwards", ""},
+  {"proxy-authenticate", ""}, {"proxy-authorization", ""}, {"range", ""},
+  {"referer", ""}, {"refresh", ""}, {"retry-after", ""}, {"server", ""},
+  {"set-cookie", ""}, {"strict-transport-security", ""},
+  {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+  {"www-authenticate", ""}};
+
+#define LOWHPACK_STATIC_COUNT                                                  \
+    (int)(sizeof(g_low_hpack_static) / sizeof(g_low_hpack_static[0]))
+
+// The Huffman code of HPACK is canonical, so the number of codes per length
+// and the symbols ordered by code are enough to decode it
+static const unsigned char g_low_hpack_huffman_count[31] = {
+  0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+  0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 3};
+
+static const unsigned char g_low_hpack_huffman_symbol[256] = {
+  48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+  52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+  110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+  77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+  119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+  43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+  195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+  179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+  163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+  233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+  158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+  144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+  200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+  212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+  2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+  21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22};
+
+// -----------------------------------------------------------------------------
+//  low_hpack_huffman - decodes to dst, which needs len * 8 / 5 bytes.
+//  Returns the length or -1
+// -----------------------------------------------------------------------------
+
+static int low_hpack_huffman(const unsigned char *src, int len,
+                             unsigned char *dst)
+{
+    unsigned char *out = dst;
+    int code = 0, first = 0, index = 0, bits = 0;
+    bool ones = true;
+
+    for(int i = 0; i < len; i++)
+        for(int shift = 7; shift >= 0; shift--)
+        {
+            int bit = (src[i] >> shift) & 1;
+            code |= bit;
+            ones = ones && bit;
+            bits++;
+
+            int count = g_low_hpack_huffman_count[bits];
+            if(code - first < count)
+            {
+                *out++ = g_low_hpack_huffman_symbol[index + code - first];
+                code = first = index = bits = 0;
+                ones = true;
+                continue;
+            }
+            if(bits == 30)
+                return -1; // EOS or no code
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+    // What is left must be padding, the start of EOS, so all ones
+    if(bits > 7 || !ones)
+        return -1;
+    return out - dst;
+}
+
+// -----------------------------------------------------------------------------
+//  low_hpack_int - integer with prefix of bits, RFC 7541 5.1
+// -----------------------------------------------------------------------------
+
+static bool low_hpack_int(const unsigned char *&pos, const unsigned char *end,
+                          int bits, int &value)
+{
+    if(pos == end)
+        return false;
+
+    int max = (1 << bits) - 1;
+    value = *pos++ & max;
+    if(value < max)
+        return true;
+
+    for(int shift = 0; shift <= 21; shift += 7)
+    {
+        if(pos == end)
+            return false;
+        int byte = *pos++;
+        value += (byte & 0x7F) << shift;
+        if(!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+//  low_hpack_put_int
+// -----------------------------------------------------------------------------
+
+static bool low_hpack_put_int(LowHTTP2Direct_Buffer &buf, int value, int bits,
+                              unsigned char flags)
+{
+    if(!LowHTTP2Direct::Reserve(buf, 6))
+        return false;
+
+    int max = (1 << bits) - 1;
+    if(value < max)
+    {
+        buf.data[buf.len++] = flags | value;
+        return true;
+    }
+
+    buf.data[buf.len++] = flags | max;
+    value -= max;
+    while(value >= 0x80)
+    {
+        buf.data[buf.len++] = 0x80 | (value & 0x7F);
+        value >>= 7;
+    }
+    buf.data[buf.len++] = value;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_hpack_put_string - without Huffman coding
+// -----------------------------------------------------------------------------
+
+static bool low_hpack_put_string(LowHTTP2Direct_Buffer &buf, const char *str,
+                                 int len)
+{
+    if(!low_hpack_put_int(buf, len, 7, 0)
+    || !LowHTTP2Direct::Reserve(buf, len))
+        return false;
+
+    memcpy(buf.data + buf.len, str, len);
+    buf.len += len;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http2_put_list - string of a header list, as the events carry them
+// -----------------------------------------------------------------------------
+
+static bool low_http2_put_list(LowHTTP2Direct_Buffer &list, const char *str,
+                               int len)
+{
+    if(!LowHTTP2Direct::Reserve(list, sizeof(int) + len))
+        return false;
+
+    memcpy(list.data + list.len, &len, sizeof(int));
+    memcpy(list.data + list.len + sizeof(int), str, len);
+    list.len += sizeof(int) + len;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::LowHTTP2Direct
+// -----------------------------------------------------------------------------
+
+LowHTTP2Direct::LowHTTP2Direct(low_t *low)
+    : LowLoopCallback(low), mLow(low), mSocket(NULL), mCallID(0),
+      mPrefacePos(0), mHeadLen(0), mFrame(NULL), mFramePos(0),
+      mBlockStream(0), mBlockEnd(false), mTable(NULL), mTableFirst(0),
+      mTableCount(0), mTableSlots(LOWHTTP2DIRECT_TABLE_SLOTS), mTableSize(0),
+      mTableMaxSize(LOWHTTP2DIRECT_TABLE_SIZE), mLastStreamID(0),
+      mOpenStreams(0), mSendWindow(65535), mInitialSendWindow(65535),
+      mMaxSendFrame(16384), mRecvWindow(LOWHTTP2DIRECT_CONN_WINDOW),
+      mRecvCredit(0), mReadyFirst(NULL), mReadyLast(NULL), mSendPos(0),
+      mEventFirst(NULL), mEventLast(NULL), mReadPaused(false),
+      mSettingsReceived(false), mGoAway(false), mClosed(false)
+{
+    pthread_mutex_init(&mMutex, NULL);
+
+    memset(&mBlock, 0, sizeof(mBlock));
+    memset(&mOut, 0, sizeof(mOut));
+    memset(&mSend, 0, sizeof(mSend));
+
+    mFrame = (unsigned char *)low_alloc(LOWHTTP2DIRECT_MAX_FRAME);
+    mTable = (LowHTTP2Direct_Header **)low_alloc(
+      LOWHTTP2DIRECT_TABLE_SLOTS * sizeof(LowHTTP2Direct_Header *));
+
+    // Our settings go out first, the client may send before it sees them
+    unsigned char settings[18];
+    int values[3][2] = {{3, LOWHTTP2DIRECT_MAX_STREAMS},
+                        {4, LOWHTTP2DIRECT_STREAM_WINDOW},
+                        {6, LOWHTTP2DIRECT_MAX_HEADERS}};
+    for(int i = 0; i < 3; i++)
+    {
+        settings[i * 6] = 0;
+        settings[i * 6 + 1] = values[i][0];
+        settings[i * 6 + 2] = values[i][1] >> 24;
+        settings[i * 6 + 3] = values[i][1] >> 16;
+        settings[i * 6 + 4] = values[i][1] >> 8;
+        settings[i * 6 + 5] = values[i][1];
+    }
+    Queue(LOWHTTP2_FRAME_SETTINGS, 0, 0, settings, sizeof(settings));
+    if(LOWHTTP2DIRECT_CONN_WINDOW > 65535)
+        QueueWindowUpdate(0, LOWHTTP2DIRECT_CONN_WINDOW - 65535);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::~LowHTTP2Direct
+// -----------------------------------------------------------------------------
+
+LowHTTP2Direct::~LowHTTP2Direct()
+{
+    if(mSocket)
+        mSocket->SetDirect(NULL, 0);
+
+    if(mCallID)
+        low_remove_stash(mLow->duk_ctx, mCallID);
+
+    while(mReadyFirst)
+    {
+        LowHTTP2Direct_Stream *stream = mReadyFirst;
+        mReadyFirst = stream->readyNext;
+        if(stream->closed)
+            Release(stream);
+    }
+    for(auto iter = mStreams.begin(); iter != mStreams.end(); iter++)
+        Release(iter->second);
+
+    while(mEventFirst)
+    {
+        LowHTTP2Direct_Event *event = mEventFirst;
+        mEventFirst = event->next;
+
+        low_free(event->data);
+        low_free(event);
+    }
+
+    if(mTable)
+    {
+        for(int i = 0; i < mTableCount; i++)
+            low_free(mTable[(mTableFirst + i) % mTableSlots]);
+        low_free(mTable);
+    }
+    low_free(mFrame);
+    low_free(mBlock.data);
+    low_free(mOut.data);
+    low_free(mSend.data);
+
+    pthread_mutex_destroy(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::SetSocket
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::SetSocket(LowSocket *socket)
+{
+    mSocket = socket;
+    if(!mSocket)
+        low_loop_set_callback(mLow, this);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::SetCallID - JavaScript is ready for the events
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::SetCallID(int callID)
+{
+    mCallID = callID;
+    low_loop_set_callback(mLow, this);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Reserve - room for len more bytes
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::Reserve(LowHTTP2Direct_Buffer &buf, int len)
+{
+    if(buf.len + len <= buf.size)
+        return true;
+
+    int size = buf.size ? buf.size * 2 : 1024;
+    while(size < buf.len + len)
+        size *= 2;
+
+    unsigned char *data = (unsigned char *)low_realloc(buf.data, size);
+    if(!data)
+        return false;
+    buf.data = data;
+    buf.size = size;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::EncodeHeader
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::EncodeHeader(LowHTTP2Direct_Buffer &buf,
+                                  const char *name, int nameLen,
+                                  const char *value, int valueLen)
+{
+    // Literal without indexing, we keep no dynamic table for the encoder
+    for(int i = 0; i < LOWHPACK_STATIC_COUNT; i++)
+        if((int)strlen(g_low_hpack_static[i][0]) == nameLen
+        && memcmp(g_low_hpack_static[i][0], name, nameLen) == 0)
+            return low_hpack_put_int(buf, i + 1, 4, 0x00)
+                && low_hpack_put_string(buf, value, valueLen);
+
+    return low_hpack_put_int(buf, 0, 4, 0x00)
+        && low_hpack_put_string(buf, name, nameLen)
+        && low_hpack_put_string(buf, value, valueLen);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::EncodeStatus
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::EncodeStatus(LowHTTP2Direct_Buffer &buf, int status)
+{
+    char value[4];
+    sprintf(value, "%03d", status % 1000);
+
+    // :status is at index 8 to 14
+    for(int i = 7; i < 14; i++)
+        if(strcmp(g_low_hpack_static[i][1], value) == 0)
+            return low_hpack_put_int(buf, i + 1, 7, 0x80);
+
+    return low_hpack_put_int(buf, 8, 4, 0x00)
+        && low_hpack_put_string(buf, value, 3);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::OnSocketData
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::OnSocketData(unsigned char *data, int len)
+{
+    if(len <= 0)
+    {
+        pthread_mutex_lock(&mMutex);
+        bool report = !mClosed;
+        mClosed = true;
+        if(report)
+            AddEvent(len == 0 ? LOWHTTP2_EVENT_CLOSE : LOWHTTP2_EVENT_ERROR,
+                     0, 0, NULL, 0);
+        pthread_mutex_unlock(&mMutex);
+
+        if(report)
+            low_loop_set_callback(mLow, this);
+        return false;
+    }
+    if(!mFrame || !mTable)
+    {
+        pthread_mutex_lock(&mMutex);
+        bool report = !mClosed;
+        mClosed = true;
+        if(report)
+            AddEvent(LOWHTTP2_EVENT_ERROR, 0, 0, NULL, 0);
+        pthread_mutex_unlock(&mMutex);
+
+        if(report)
+            low_loop_set_callback(mLow, this);
+        return false;
+    }
+
+    pthread_mutex_lock(&mMutex);
+    bool wasEmpty = !mEventFirst, more = !mGoAway && !mClosed;
+    while(more)
+    {
+        if(mPrefacePos < LOWHTTP2_PREFACE_LEN)
+        {
+            if(!len)
+                break;
+            if(*data++ != (unsigned char)g_low_http2_preface[mPrefacePos++])
+            {
+                Fail(LOWHTTP2_PROTOCOL_ERROR);
+                more = false;
+            }
+            len--;
+            continue;
+        }
+
+        if(mHeadLen < 9)
+        {
+            int size = 9 - mHeadLen;
+            if(size > len)
+                size = len;
+            memcpy(mHead + mHeadLen, data, size);
+            mHeadLen += size;
+            data += size;
+            len -= size;
+            if(mHeadLen < 9)
+                break;
+
+            mFrameLen = (mHead[0] << 16) | (mHead[1] << 8) | mHead[2];
+            mFrameType = mHead[3];
+            mFrameFlags = mHead[4];
+            mFrameStream = ((mHead[5] & 0x7F) << 24) | (mHead[6] << 16)
+                         | (mHead[7] << 8) | mHead[8];
+            mFramePos = 0;
+            if(mFrameLen > LOWHTTP2DIRECT_MAX_FRAME)
+            {
+                Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+                break;
+            }
+        }
+
+        int size = mFrameLen - mFramePos;
+        if(size > len)
+            size = len;
+        memcpy(mFrame + mFramePos, data, size);
+        mFramePos += size;
+        data += size;
+        len -= size;
+        if(mFramePos < mFrameLen)
+            break;
+
+        mHeadLen = 0;
+        more = Frame();
+    }
+
+    // Do not read more if the client does not take what we send, as the
+    // answers to PING or SETTINGS would pile up
+    if(more && mOut.len > LOWHTTP2DIRECT_MAX_OUT)
+    {
+        mReadPaused = true;
+        more = false;
+    }
+    bool notify = wasEmpty && mEventFirst;
+    bool write = mOut.len || (mReadyFirst && mSendWindow > 0);
+    pthread_mutex_unlock(&mMutex);
+
+    if(notify)
+        low_loop_set_callback(mLow, this);
+    if(write)
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+    return more;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Frame - handles the frame in mFrame, with the lock held.
+//  Returns false on connection errors
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::Frame()
+{
+    int type = mFrameType;
+
+    if(!mSettingsReceived && type != LOWHTTP2_FRAME_SETTINGS)
+    {
+        Fail(LOWHTTP2_PROTOCOL_ERROR);
+        return false;
+    }
+    if(mBlockStream && (type != LOWHTTP2_FRAME_CONTINUATION
+                     || mFrameStream != mBlockStream))
+    {
+        Fail(LOWHTTP2_PROTOCOL_ERROR);
+        return false;
+    }
+
+    LowHTTP2Direct_Stream *stream = NULL;
+    if(mFrameStream)
+    {
+        auto iter = mStreams.find(mFrameStream);
+        if(iter != mStreams.end())
+            stream = iter->second;
+    }
+
+    switch(type)
+    {
+    case LOWHTTP2_FRAME_DATA:
+        return FrameData(stream);
+
+    case LOWHTTP2_FRAME_HEADERS:
+    case LOWHTTP2_FRAME_CONTINUATION:
+        return FrameHeaders(stream);
+
+    case LOWHTTP2_FRAME_PRIORITY:
+        // We do not prioritize, all streams get their turn
+        if(!mFrameStream || mFrameLen != 5)
+        {
+            Fail(mFrameStream ? LOWHTTP2_FRAME_SIZE_ERROR
+                              : LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        return true;
+
+    case LOWHTTP2_FRAME_RST_STREAM:
+        if(!mFrameStream || mFrameStream > mLastStreamID)
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        if(mFrameLen != 4)
+        {
+            Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+            return false;
+        }
+        if(stream)
+        {
+            int code = (mFrame[0] << 24) | (mFrame[1] << 16)
+                     | (mFrame[2] << 8) | mFrame[3];
+            AddEvent(LOWHTTP2_EVENT_RESET, stream->id, code, NULL, 0);
+            Close(stream);
+        }
+        return true;
+
+    case LOWHTTP2_FRAME_SETTINGS:
+        return FrameSettings();
+
+    case LOWHTTP2_FRAME_PING:
+        if(mFrameStream)
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        if(mFrameLen != 8)
+        {
+            Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+            return false;
+        }
+        if(!(mFrameFlags & LOWHTTP2_FLAG_ACK))
+            Queue(LOWHTTP2_FRAME_PING, LOWHTTP2_FLAG_ACK, 0, mFrame, 8);
+        return true;
+
+    case LOWHTTP2_FRAME_GOAWAY:
+        // The client closes the connection when it is done with its streams
+        if(mFrameStream)
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        return true;
+
+    case LOWHTTP2_FRAME_WINDOW_UPDATE:
+        return FrameWindowUpdate(stream);
+
+    case LOWHTTP2_FRAME_PUSH_PROMISE:
+        // Only servers push
+        Fail(LOWHTTP2_PROTOCOL_ERROR);
+        return false;
+
+    default:
+        // Unknown frames are ignored
+        return true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::FrameHeaders - HEADERS or CONTINUATION
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::FrameHeaders(LowHTTP2Direct_Stream *stream)
+{
+    unsigned char *data = mFrame;
+    int len = mFrameLen;
+
+    if(mFrameType == LOWHTTP2_FRAME_HEADERS)
+    {
+        if(!mFrameStream || !(mFrameStream & 1))
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+
+        int pad = 0;
+        if(mFrameFlags & LOWHTTP2_FLAG_PADDED)
+        {
+            if(!len)
+            {
+                Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+                return false;
+            }
+            pad = data[0];
+            data++;
+            len--;
+        }
+        if(mFrameFlags & LOWHTTP2_FLAG_PRIORITY)
+        {
+            if(len < 5)
+            {
+                Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+                return false;
+            }
+            data += 5;
+            len -= 5;
+        }
+        if(pad > len)
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        len -= pad;
+
+        mBlock.len = 0;
+        mBlockStream = mFrameStream;
+        mBlockEnd = mFrameFlags & LOWHTTP2_FLAG_END_STREAM;
+    }
+    else if(!mBlockStream)
+    {
+        Fail(LOWHTTP2_PROTOCOL_ERROR);
+        return false;
+    }
+
+    if(mBlock.len + len > LOWHTTP2DIRECT_MAX_HEADERS)
+    {
+        Fail(LOWHTTP2_ENHANCE_YOUR_CALM);
+        return false;
+    }
+    if(!Reserve(mBlock, len))
+    {
+        Fail(LOWHTTP2_INTERNAL_ERROR);
+        return false;
+    }
+    memcpy(mBlock.data + mBlock.len, data, len);
+    mBlock.len += len;
+
+    if(!(mFrameFlags & LOWHTTP2_FLAG_END_HEADERS))
+        return true;
+    mBlockStream = 0;
+
+    // The block is always decoded, so the dynamic table stays in sync
+    LowHTTP2Direct_Buffer list;
+    memset(&list, 0, sizeof(list));
+    int result = Decode(list, !stream);
+    if(result < 0)
+    {
+        low_free(list.data);
+        Fail(LOWHTTP2_COMPRESSION_ERROR);
+        return false;
+    }
+
+    int id = mFrameStream;
+    if(stream)
+    {
+        // Trailers, which we do not pass on
+        low_free(list.data);
+        if(stream->endReceived || !mBlockEnd)
+        {
+            int code = stream->endReceived ? LOWHTTP2_STREAM_CLOSED
+                                           : LOWHTTP2_PROTOCOL_ERROR;
+            QueueReset(id, code);
+            AddEvent(LOWHTTP2_EVENT_RESET, id, code, NULL, 0);
+            Close(stream);
+            return true;
+        }
+
+        stream->endReceived = true;
+        AddEvent(LOWHTTP2_EVENT_END, id, 0, NULL, 0);
+        if(stream->endSent)
+            Close(stream);
+        return true;
+    }
+    if(id <= mLastStreamID)
+    {
+        low_free(list.data);
+        QueueReset(id, LOWHTTP2_STREAM_CLOSED);
+        return true;
+    }
+    mLastStreamID = id;
+
+    if(result > 0 || mOpenStreams >= LOWHTTP2DIRECT_MAX_STREAMS)
+    {
+        low_free(list.data);
+        QueueReset(id, result > 0 ? LOWHTTP2_PROTOCOL_ERROR
+                                  : LOWHTTP2_REFUSED_STREAM);
+        return true;
+    }
+
+    stream = (LowHTTP2Direct_Stream *)low_alloc(sizeof(LowHTTP2Direct_Stream));
+    if(!stream)
+    {
+        low_free(list.data);
+        QueueReset(id, LOWHTTP2_REFUSED_STREAM);
+        return true;
+    }
+    memset(stream, 0, sizeof(LowHTTP2Direct_Stream));
+    stream->id = id;
+    stream->sendWindow = mInitialSendWindow;
+    stream->recvWindow = LOWHTTP2DIRECT_STREAM_WINDOW;
+    stream->endReceived = mBlockEnd;
+
+    mStreams[id] = stream;
+    mOpenStreams++;
+
+    AddEvent(LOWHTTP2_EVENT_REQUEST, id, mBlockEnd, list.data, list.len);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::FrameData
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::FrameData(LowHTTP2Direct_Stream *stream)
+{
+    unsigned char *data = mFrame;
+    int len = mFrameLen;
+
+    if(!mFrameStream || mFrameStream > mLastStreamID)
+    {
+        Fail(LOWHTTP2_PROTOCOL_ERROR);
+        return false;
+    }
+    if(mFrameFlags & LOWHTTP2_FLAG_PADDED)
+    {
+        if(!len || data[0] >= len)
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        len -= data[0] + 1;
+        data++;
+    }
+
+    // Padding counts for flow control, too
+    if(mFrameLen > mRecvWindow)
+    {
+        Fail(LOWHTTP2_FLOW_CONTROL_ERROR);
+        return false;
+    }
+    mRecvWindow -= mFrameLen;
+
+    if(!stream || stream->endReceived || mFrameLen > stream->recvWindow)
+    {
+        // Frames in flight for streams we closed are expected, others not
+        if(stream)
+        {
+            int code = stream->endReceived ? LOWHTTP2_STREAM_CLOSED
+                                           : LOWHTTP2_FLOW_CONTROL_ERROR;
+            QueueReset(stream->id, code);
+            AddEvent(LOWHTTP2_EVENT_RESET, stream->id, code, NULL, 0);
+            Close(stream);
+        }
+        Credit(NULL, mFrameLen);
+        return true;
+    }
+    stream->recvWindow -= mFrameLen;
+
+    // The window of the data is given back once JavaScript has it
+    Credit(stream, mFrameLen - len);
+    if(len)
+    {
+        unsigned char *copy = (unsigned char *)low_alloc(len);
+        if(!copy)
+        {
+            QueueReset(stream->id, LOWHTTP2_INTERNAL_ERROR);
+            AddEvent(LOWHTTP2_EVENT_RESET, stream->id, LOWHTTP2_INTERNAL_ERROR,
+                     NULL, 0);
+            Close(stream);
+            Credit(NULL, len);
+            return true;
+        }
+        memcpy(copy, data, len);
+        AddEvent(LOWHTTP2_EVENT_DATA, stream->id, 0, copy, len);
+    }
+
+    if(mFrameFlags & LOWHTTP2_FLAG_END_STREAM)
+    {
+        stream->endReceived = true;
+        AddEvent(LOWHTTP2_EVENT_END, stream->id, 0, NULL, 0);
+        if(stream->endSent)
+            Close(stream);
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::FrameSettings
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::FrameSettings()
+{
+    if(mFrameStream)
+    {
+        Fail(LOWHTTP2_PROTOCOL_ERROR);
+        return false;
+    }
+    if(mFrameFlags & LOWHTTP2_FLAG_ACK)
+    {
+        if(mFrameLen)
+        {
+            Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+            return false;
+        }
+        return true;
+    }
+    if(mFrameLen % 6)
+    {
+        Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+        return false;
+    }
+
+    for(int i = 0; i < mFrameLen; i += 6)
+    {
+        int id = (mFrame[i] << 8) | mFrame[i + 1];
+        unsigned int value = ((unsigned int)mFrame[i + 2] << 24)
+                           | (mFrame[i + 3] << 16) | (mFrame[i + 4] << 8)
+                           | mFrame[i + 5];
+
+        if(id == 2 && value > 1)
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        else if(id == 4)
+        {
+            // SETTINGS_INITIAL_WINDOW_SIZE changes the windows of all
+            // streams by the difference
+            if(value > LOWHTTP2_MAX_WINDOW)
+            {
+                Fail(LOWHTTP2_FLOW_CONTROL_ERROR);
+                return false;
+            }
+            long long delta = (long long)value - mInitialSendWindow;
+            for(auto iter = mStreams.begin(); iter != mStreams.end(); iter++)
+            {
+                LowHTTP2Direct_Stream *stream = iter->second;
+                if(stream->sendWindow + delta > LOWHTTP2_MAX_WINDOW)
+                {
+                    Fail(LOWHTTP2_FLOW_CONTROL_ERROR);
+                    return false;
+                }
+                stream->sendWindow += delta;
+                if(stream->sendWindow > 0 && stream->dataQueued)
+                    Ready(stream);
+            }
+            mInitialSendWindow = value;
+        }
+        else if(id == 5)
+        {
+            if(value < 16384 || value > 16777215)
+            {
+                Fail(LOWHTTP2_PROTOCOL_ERROR);
+                return false;
+            }
+            mMaxSendFrame = value;
+        }
+        // Header table size: our encoder does not use the dynamic table.
+        // Concurrent streams: we do not push. The rest is advisory
+    }
+
+    mSettingsReceived = true;
+    Queue(LOWHTTP2_FRAME_SETTINGS, LOWHTTP2_FLAG_ACK, 0, NULL, 0);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::FrameWindowUpdate
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::FrameWindowUpdate(LowHTTP2Direct_Stream *stream)
+{
+    if(mFrameLen != 4)
+    {
+        Fail(LOWHTTP2_FRAME_SIZE_ERROR);
+        return false;
+    }
+    int increment = ((mFrame[0] & 0x7F) << 24) | (mFrame[1] << 16)
+                  | (mFrame[2] << 8) | mFrame[3];
+
+    if(!mFrameStream)
+    {
+        if(!increment)
+        {
+            Fail(LOWHTTP2_PROTOCOL_ERROR);
+            return false;
+        }
+        if(mSendWindow > LOWHTTP2_MAX_WINDOW - increment)
+        {
+            Fail(LOWHTTP2_FLOW_CONTROL_ERROR);
+            return false;
+        }
+        mSendWindow += increment;
+        return true;
+    }
+
+    if(!stream)
+        return true;
+    if(!increment || stream->sendWindow > LOWHTTP2_MAX_WINDOW - increment)
+    {
+        int code = increment ? LOWHTTP2_FLOW_CONTROL_ERROR
+                             : LOWHTTP2_PROTOCOL_ERROR;
+        QueueReset(stream->id, code);
+        AddEvent(LOWHTTP2_EVENT_RESET, stream->id, code, NULL, 0);
+        Close(stream);
+        return true;
+    }
+    stream->sendWindow += increment;
+    if(stream->dataQueued || stream->endQueued)
+        Ready(stream);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::DecodeString - string literal, RFC 7541 5.2
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::DecodeString(const unsigned char *&pos,
+                                  const unsigned char *end,
+                                  LowHTTP2Direct_Buffer &list)
+{
+    bool huffman = pos != end && (*pos & 0x80);
+    int len;
+    if(!low_hpack_int(pos, end, 7, len) || len > end - pos)
+        return false;
+
+    if(!huffman)
+    {
+        if(!low_http2_put_list(list, (const char *)pos, len))
+            return false;
+    }
+    else
+    {
+        if(!Reserve(list, sizeof(int) + len * 8 / 5 + 1))
+            return false;
+        int size = low_hpack_huffman(pos, len,
+                                     list.data + list.len + sizeof(int));
+        if(size < 0)
+            return false;
+        memcpy(list.data + list.len, &size, sizeof(int));
+        list.len += sizeof(int) + size;
+    }
+    pos += len;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Decode - HPACK decodes mBlock to a header list. Returns
+//  -1 if the block cannot be decoded, which breaks the connection, 1 if
+//  it is no valid request
+// -----------------------------------------------------------------------------
+
+int LowHTTP2Direct::Decode(LowHTTP2Direct_Buffer &list, bool request)
+{
+    const unsigned char *pos = mBlock.data, *end = mBlock.data + mBlock.len;
+    bool malformed = false, regular = false;
+    int pseudo = 0;
+
+    while(pos < end)
+    {
+        int start = list.len, index;
+        if(*pos & 0x80)
+        {
+            // Indexed
+            if(!low_hpack_int(pos, end, 7, index) || !index
+            || !TableGet(index, list, false))
+                return -1;
+        }
+        else if((*pos & 0xE0) == 0x20)
+        {
+            // Dynamic table size update
+            if(!low_hpack_int(pos, end, 5, index)
+            || index > LOWHTTP2DIRECT_TABLE_SIZE || start)
+                return -1;
+            mTableMaxSize = index;
+            TableEvict(0);
+            continue;
+        }
+        else
+        {
+            // Literal, with incremental indexing or not
+            bool add = (*pos & 0xC0) == 0x40;
+            if(!low_hpack_int(pos, end, add ? 6 : 4, index))
+                return -1;
+            if(index ? !TableGet(index, list, true)
+                     : !DecodeString(pos, end, list))
+                return -1;
+            if(!DecodeString(pos, end, list))
+                return -1;
+
+            if(add)
+            {
+                int nameLen, valueLen;
+                memcpy(&nameLen, list.data + start, sizeof(int));
+                memcpy(&valueLen, list.data + start + sizeof(int) + nameLen,
+                       sizeof(int));
+                if(!TableAdd(list.data + start + sizeof(int), nameLen,
+                             list.data + start + 2 * sizeof(int) + nameLen,
+                             valueLen))
+                    return -1;
+            }
+        }
+
+        // RFC 7540 8.1.2: lower case names, pseudo headers first and only
+        // the ones of requests, no connection specific headers
+        int nameLen, valueLen;
+        memcpy(&nameLen, list.data + start, sizeof(int));
+        const char *name = (const char *)list.data + start + sizeof(int);
+        memcpy(&valueLen, name + nameLen, sizeof(int));
+        const char *value = name + nameLen + sizeof(int);
+
+        for(int i = 0; i < nameLen; i++)
+            if(name[i] >= 'A' && name[i] <= 'Z')
+                malformed = true;
+
+        if(nameLen && name[0] == ':')
+        {
+            static const char *const names[] = {":method", ":scheme", ":path",
+                                                ":authority"};
+            int i;
+            for(i = 0; i < 4; i++)
+                if((int)strlen(names[i]) == nameLen
+                && memcmp(names[i], name, nameLen) == 0)
+                    break;
+            if(!request || regular || i == 4 || (pseudo & (1 << i))
+            || (i == 2 && !valueLen))
+                malformed = true;
+            else
+                pseudo |= 1 << i;
+        }
+        else
+        {
+            regular = true;
+            if((nameLen == 10 && memcmp(name, "connection", 10) == 0)
+            || (nameLen == 10 && memcmp(name, "keep-alive", 10) == 0)
+            || (nameLen == 16 && memcmp(name, "proxy-connection", 16) == 0)
+            || (nameLen == 17 && memcmp(name, "transfer-encoding", 17) == 0)
+            || (nameLen == 7 && memcmp(name, "upgrade", 7) == 0)
+            || (nameLen == 2 && memcmp(name, "te", 2) == 0
+                && (valueLen != 8 || memcmp(value, "trailers", 8) != 0)))
+                malformed = true;
+        }
+    }
+
+    // CONNECT has no :scheme and :path, we do not support it however
+    if(request && (pseudo & 7) != 7)
+        malformed = true;
+    return malformed ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::TableGet - appends name and value of a table entry
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::TableGet(int index, LowHTTP2Direct_Buffer &list,
+                              bool nameOnly)
+{
+    if(index <= LOWHPACK_STATIC_COUNT)
+    {
+        const char *const *entry = g_low_hpack_static[index - 1];
+        return low_http2_put_list(list, entry[0], strlen(entry[0]))
+            && (nameOnly
+             || low_http2_put_list(list, entry[1], strlen(entry[1])));
+    }
+
+    index -= LOWHPACK_STATIC_COUNT + 1;
+    if(index >= mTableCount)
+        return false;
+
+    LowHTTP2Direct_Header *entry = mTable[(mTableFirst + index) % mTableSlots];
+    return low_http2_put_list(list, entry->data, entry->nameLen)
+        && (nameOnly
+         || low_http2_put_list(list, entry->data + entry->nameLen,
+                               entry->valueLen));
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::TableAdd
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::TableAdd(const unsigned char *name, int nameLen,
+                              const unsigned char *value, int valueLen)
+{
+    int size = nameLen + valueLen + 32;
+
+    // Entries too big for the table empty it, which is not an error
+    TableEvict(size);
+    if(size > mTableMaxSize)
+        return true;
+
+    LowHTTP2Direct_Header *entry = (LowHTTP2Direct_Header *)low_alloc(
+      sizeof(LowHTTP2Direct_Header) + nameLen + valueLen);
+    if(!entry)
+        return false;
+    entry->nameLen = nameLen;
+    entry->valueLen = valueLen;
+    memcpy(entry->data, name, nameLen);
+    memcpy(entry->data + nameLen, value, valueLen);
+
+    mTableFirst = (mTableFirst + mTableSlots - 1) % mTableSlots;
+    mTable[mTableFirst] = entry;
+    mTableCount++;
+    mTableSize += size;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::TableEvict - makes room for size bytes
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::TableEvict(int size)
+{
+    while(mTableCount && mTableSize + size > mTableMaxSize)
+    {
+        mTableCount--;
+        LowHTTP2Direct_Header *entry =
+          mTable[(mTableFirst + mTableCount) % mTableSlots];
+        mTableSize -= entry->nameLen + entry->valueLen + 32;
+        low_free(entry);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Queue - appends a frame to mOut, with the lock held
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::Queue(int type, int flags, int id,
+                           const unsigned char *data, int len)
+{
+    if(!Reserve(mOut, 9 + len))
+        return;
+
+    unsigned char *head = mOut.data + mOut.len;
+    head[0] = len >> 16;
+    head[1] = len >> 8;
+    head[2] = len;
+    head[3] = type;
+    head[4] = flags;
+    head[5] = id >> 24;
+    head[6] = id >> 16;
+    head[7] = id >> 8;
+    head[8] = id;
+    if(len)
+        memcpy(head + 9, data, len);
+    mOut.len += 9 + len;
+}
+
+void LowHTTP2Direct::QueueWindowUpdate(int id, int increment)
+{
+    unsigned char data[4] = {(unsigned char)(increment >> 24),
+                             (unsigned char)(increment >> 16),
+                             (unsigned char)(increment >> 8),
+                             (unsigned char)increment};
+    Queue(LOWHTTP2_FRAME_WINDOW_UPDATE, 0, id, data, 4);
+}
+
+void LowHTTP2Direct::QueueReset(int id, int code)
+{
+    unsigned char data[4] = {(unsigned char)(code >> 24),
+                             (unsigned char)(code >> 16),
+                             (unsigned char)(code >> 8), (unsigned char)code};
+    Queue(LOWHTTP2_FRAME_RST_STREAM, 0, id, data, 4);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Fail - connection error, GOAWAY and we are done once it
+//  is written
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::Fail(int code)
+{
+    if(mGoAway)
+        return;
+    mGoAway = true;
+
+    unsigned char data[8] = {
+      (unsigned char)(mLastStreamID >> 24), (unsigned char)(mLastStreamID >> 16),
+      (unsigned char)(mLastStreamID >> 8), (unsigned char)mLastStreamID,
+      (unsigned char)(code >> 24), (unsigned char)(code >> 16),
+      (unsigned char)(code >> 8), (unsigned char)code};
+    Queue(LOWHTTP2_FRAME_GOAWAY, 0, 0, data, 8);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Credit - received bytes are handled, so the client may
+//  send more. Window updates are collected until half the window is used
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::Credit(LowHTTP2Direct_Stream *stream, int len)
+{
+    if(!len)
+        return;
+
+    mRecvCredit += len;
+    if(mRecvCredit >= LOWHTTP2DIRECT_CONN_WINDOW / 2)
+    {
+        QueueWindowUpdate(0, mRecvCredit);
+        mRecvWindow += mRecvCredit;
+        mRecvCredit = 0;
+    }
+
+    if(!stream || stream->endReceived)
+        return;
+    stream->recvCredit += len;
+    if(stream->recvCredit >= LOWHTTP2DIRECT_STREAM_WINDOW / 2)
+    {
+        QueueWindowUpdate(stream->id, stream->recvCredit);
+        stream->recvWindow += stream->recvCredit;
+        stream->recvCredit = 0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Ready - stream has data to frame
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::Ready(LowHTTP2Direct_Stream *stream)
+{
+    if(stream->ready || stream->closed)
+        return;
+
+    stream->ready = true;
+    stream->readyNext = NULL;
+    if(mReadyLast)
+        mReadyLast->readyNext = stream;
+    else
+        mReadyFirst = stream;
+    mReadyLast = stream;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Fill - frames response data into mSend, round robin over
+//  the streams, within the windows. With the lock held
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::Fill()
+{
+    while(mReadyFirst && mSend.len < LOWHTTP2DIRECT_SEND_CHUNK)
+    {
+        LowHTTP2Direct_Stream *stream = mReadyFirst;
+        mReadyFirst = stream->readyNext;
+        if(!mReadyFirst)
+            mReadyLast = NULL;
+        stream->ready = false;
+
+        if(stream->closed)
+        {
+            Release(stream);
+            continue;
+        }
+
+        int len = stream->dataQueued;
+        if(len > stream->sendWindow)
+            len = stream->sendWindow;
+        if(len > mSendWindow)
+            len = mSendWindow;
+        if(len > mMaxSendFrame)
+            len = mMaxSendFrame;
+        if(len < 0)
+            len = 0;
+        bool end = stream->endQueued && len == stream->dataQueued;
+
+        if(!len && !end)
+        {
+            // Blocked by the connection window, the stream stays first. A
+            // stream blocked by its own window is readied by WINDOW_UPDATE
+            if(stream->dataQueued && stream->sendWindow > 0)
+            {
+                stream->ready = true;
+                stream->readyNext = mReadyFirst;
+                mReadyFirst = stream;
+                if(!mReadyLast)
+                    mReadyLast = stream;
+                break;
+            }
+            continue;
+        }
+
+        if(!Reserve(mSend, 9 + len))
+        {
+            Ready(stream);
+            break;
+        }
+        unsigned char *head = mSend.data + mSend.len;
+        head[0] = len >> 16;
+        head[1] = len >> 8;
+        head[2] = len;
+        head[3] = LOWHTTP2_FRAME_DATA;
+        head[4] = end ? LOWHTTP2_FLAG_END_STREAM : 0;
+        head[5] = stream->id >> 24;
+        head[6] = stream->id >> 16;
+        head[7] = stream->id >> 8;
+        head[8] = stream->id;
+        mSend.len += 9;
+
+        stream->dataQueued -= len;
+        stream->sendWindow -= len;
+        mSendWindow -= len;
+        while(len)
+        {
+            LowHTTP2Direct_Data *data = stream->dataFirst;
+            int size = data->len - data->pos;
+            if(size > len)
+                size = len;
+            memcpy(mSend.data + mSend.len, data->data + data->pos, size);
+            mSend.len += size;
+            data->pos += size;
+            len -= size;
+
+            if(data->pos == data->len)
+            {
+                stream->dataFirst = data->next;
+                if(!stream->dataFirst)
+                    stream->dataLast = NULL;
+                low_free(data);
+            }
+        }
+
+        if(end)
+        {
+            stream->endSent = true;
+            if(stream->endReceived)
+                Close(stream);
+            continue;
+        }
+        if(stream->wantDrain
+        && stream->dataQueued <= LOWHTTP2DIRECT_HIGH_WATER / 2)
+        {
+            stream->wantDrain = false;
+            AddEvent(LOWHTTP2_EVENT_DRAIN, stream->id, 0, NULL, 0);
+        }
+        if(stream->dataQueued || stream->endQueued)
+            Ready(stream);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Close - stream is done, with the lock held
+// -----------------------------------------------------------------------------
+
+void LowHTTP2Direct::Close(LowHTTP2Direct_Stream *stream)
+{
+    if(stream->closed)
+        return;
+    stream->closed = true;
+
+    mStreams.erase(stream->id);
+    mOpenStreams--;
+
+    // Streams in the ready list are released by Fill
+    if(!stream->ready)
+        Release(stream);
+}
+
+void LowHTTP2Direct::Release(LowHTTP2Direct_Stream *stream)
+{
+    while(stream->dataFirst)
+    {
+        LowHTTP2Direct_Data *data = stream->dataFirst;
+        stream->dataFirst = data->next;
+        low_free(data);
+    }
+    low_free(stream);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Respond
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::Respond(int id, const unsigned char *headers, int len,
+                             bool end)
+{
+    pthread_mutex_lock(&mMutex);
+    auto iter = mStreams.find(id);
+    LowHTTP2Direct_Stream *stream = iter == mStreams.end() ? NULL : iter->second;
+    if(!stream || stream->headersSent || mGoAway)
+    {
+        pthread_mutex_unlock(&mMutex);
+        return false;
+    }
+
+    // Blocks bigger than a frame go on in CONTINUATION frames, which are
+    // queued together, so nothing comes in between
+    int type = LOWHTTP2_FRAME_HEADERS;
+    do
+    {
+        int size = len > mMaxSendFrame ? mMaxSendFrame : len;
+        int flags = size == len ? LOWHTTP2_FLAG_END_HEADERS : 0;
+        if(type == LOWHTTP2_FRAME_HEADERS && end)
+            flags |= LOWHTTP2_FLAG_END_STREAM;
+
+        Queue(type, flags, id, headers, size);
+        headers += size;
+        len -= size;
+        type = LOWHTTP2_FRAME_CONTINUATION;
+    } while(len);
+
+    stream->headersSent = true;
+    if(end)
+    {
+        stream->endQueued = stream->endSent = true;
+        if(stream->endReceived)
+            Close(stream);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    if(mSocket)
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Write
+// -----------------------------------------------------------------------------
+
+int LowHTTP2Direct::Write(int id, const unsigned char *data, int len, bool end)
+{
+    LowHTTP2Direct_Data *chunk = NULL;
+    if(len)
+    {
+        chunk = (LowHTTP2Direct_Data *)low_alloc(sizeof(LowHTTP2Direct_Data)
+                                                 + len);
+        if(!chunk)
+            return -1;
+        chunk->next = NULL;
+        chunk->len = len;
+        chunk->pos = 0;
+        memcpy(chunk->data, data, len);
+    }
+
+    pthread_mutex_lock(&mMutex);
+    auto iter = mStreams.find(id);
+    LowHTTP2Direct_Stream *stream = iter == mStreams.end() ? NULL : iter->second;
+    if(!stream || !stream->headersSent || stream->endQueued || mGoAway)
+    {
+        pthread_mutex_unlock(&mMutex);
+        low_free(chunk);
+        return -1;
+    }
+
+    if(chunk)
+    {
+        if(stream->dataLast)
+            stream->dataLast->next = chunk;
+        else
+            stream->dataFirst = chunk;
+        stream->dataLast = chunk;
+        stream->dataQueued += len;
+    }
+    stream->endQueued = end;
+    Ready(stream);
+
+    int result = 0;
+    if(stream->dataQueued > LOWHTTP2DIRECT_HIGH_WATER && !end)
+    {
+        stream->wantDrain = true;
+        result = 1;
+    }
+    bool write = mSendWindow > 0 || !len;
+    pthread_mutex_unlock(&mMutex);
+
+    if(write && mSocket)
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::Reset
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::Reset(int id, int code)
+{
+    pthread_mutex_lock(&mMutex);
+    auto iter = mStreams.find(id);
+    if(iter == mStreams.end())
+    {
+        pthread_mutex_unlock(&mMutex);
+        return false;
+    }
+
+    QueueReset(id, code);
+    Close(iter->second);
+    pthread_mutex_unlock(&mMutex);
+
+    if(mSocket)
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::OnSocketWrite
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::OnSocketWrite()
+{
+    while(true)
+    {
+        if(mSendPos == mSend.len)
+        {
+            pthread_mutex_lock(&mMutex);
+            LowHTTP2Direct_Buffer buf = mSend;
+            mSend = mOut;
+            mOut = buf;
+            mOut.len = 0;
+            mSendPos = 0;
+
+            bool wasEmpty = !mEventFirst;
+            Fill();
+            bool notify = wasEmpty && mEventFirst;
+
+            bool resume = mReadPaused;
+            mReadPaused = false;
+            // After GOAWAY the connection is over once it is written
+            bool done = !mSend.len;
+            if(done && mGoAway && !mClosed)
+            {
+                mClosed = true;
+                notify = AddEvent(LOWHTTP2_EVENT_CLOSE, 0, 0, NULL, 0)
+                      && wasEmpty;
+            }
+            pthread_mutex_unlock(&mMutex);
+
+            if(notify)
+                low_loop_set_callback(mLow, this);
+            if(resume)
+                mSocket->TriggerDirect(LOWSOCKET_TRIGGER_READ);
+            if(done)
+                return false;
+        }
+
+        int size = mSocket->write(mSend.data + mSendPos, mSend.len - mSendPos);
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+                return true;
+
+            pthread_mutex_lock(&mMutex);
+            bool report = !mClosed;
+            mClosed = true;
+            if(report)
+                AddEvent(LOWHTTP2_EVENT_ERROR, 0, 1, NULL, 0);
+            pthread_mutex_unlock(&mMutex);
+
+            if(report)
+                low_loop_set_callback(mLow, this);
+            return false;
+        }
+        mSendPos += size;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::AddEvent - with the lock held. The caller sets the loop
+//  callback if the queue was empty
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::AddEvent(int type, int stream, int code,
+                              unsigned char *data, int len)
+{
+    LowHTTP2Direct_Event *event =
+      (LowHTTP2Direct_Event *)low_alloc(sizeof(LowHTTP2Direct_Event));
+    if(!event)
+    {
+        low_free(data);
+        return false;
+    }
+    event->next = NULL;
+    event->type = type;
+    event->stream = stream;
+    event->code = code;
+    event->data = data;
+    event->len = len;
+
+    if(mEventLast)
+        mEventLast->next = event;
+    else
+        mEventFirst = event;
+    mEventLast = event;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowHTTP2Direct::OnLoop()
+{
+    // Until JavaScript attaches, the events wait
+    if(!mCallID)
+        return mSocket != NULL;
+
+    pthread_mutex_lock(&mMutex);
+    LowHTTP2Direct_Event *event = mEventFirst;
+    mEventFirst = mEventLast = NULL;
+    pthread_mutex_unlock(&mMutex);
+
+    int credit = 0;
+    while(event)
+    {
+        LowHTTP2Direct_Event *next = event->next;
+        if(mSocket)
+        {
+            duk_context *ctx = mLow->duk_ctx;
+
+            low_push_stash(ctx, mCallID, false);
+            duk_push_int(ctx, event->type);
+            duk_push_int(ctx, event->stream);
+            switch(event->type)
+            {
+            case LOWHTTP2_EVENT_REQUEST:
+            {
+                // Flat array of names and values, as rawHeaders
+                duk_push_array(ctx);
+                int pos = 0, i = 0;
+                while(pos < event->len)
+                {
+                    int len;
+                    memcpy(&len, event->data + pos, sizeof(int));
+                    const unsigned char *str = event->data + pos + sizeof(int);
+                    pos += sizeof(int) + len;
+
+                    if(low_utf8_is_internal(str, len))
+                        duk_push_lstring(ctx, (const char *)str, len);
+                    else
+                    {
+                        unsigned char *buf =
+                          (unsigned char *)duk_push_buffer_raw(
+                            ctx, len * 3, DUK_BUF_FLAG_NOZERO);
+                        size_t size = low_utf8_to_internal(str, len, buf);
+                        duk_push_lstring(ctx, (const char *)buf, size);
+                        duk_remove(ctx, -2);
+                    }
+                    duk_put_prop_index(ctx, -2, i++);
+                }
+                duk_push_boolean(ctx, event->code);
+                break;
+            }
+
+            case LOWHTTP2_EVENT_DATA:
+                memcpy(low_push_buffer(ctx, event->len), event->data,
+                       event->len);
+                duk_push_undefined(ctx);
+                break;
+
+            case LOWHTTP2_EVENT_RESET:
+                duk_push_int(ctx, event->code);
+                duk_push_undefined(ctx);
+                break;
+
+            case LOWHTTP2_EVENT_ERROR:
+                mSocket->PushError(event->code);
+                duk_push_undefined(ctx);
+                break;
+
+            default:
+                duk_push_undefined(ctx);
+                duk_push_undefined(ctx);
+            }
+            duk_call(ctx, 4);
+            duk_pop(ctx);
+        }
+
+        if(event->type == LOWHTTP2_EVENT_DATA)
+        {
+            // JavaScript has the data, so the client may send more
+            pthread_mutex_lock(&mMutex);
+            auto iter = mStreams.find(event->stream);
+            Credit(iter == mStreams.end() ? NULL : iter->second, event->len);
+            credit = mOut.len;
+            pthread_mutex_unlock(&mMutex);
+        }
+
+        low_free(event->data);
+        low_free(event);
+        event = next;
+    }
+
+    if(credit && mSocket)
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+    return mSocket != NULL;
+}
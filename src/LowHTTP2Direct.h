@@ -0,0 +1,215 @@
+// -----------------------------------------------------------------------------
+//  LowHTTP2Direct.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWHTTP2DIRECT_H__
+#define __LOWHTTP2DIRECT_H__
+
+#include "LowLoopCallback.h"
+#include "LowSocketDirect.h"
+
+#include <pthread.h>
+
+#include <map>
+
+using namespace std;
+
+// Direct type of the socket, LowHTTPDirect is 0, LowWebSocketDirect 1
+#define LOWHTTP2DIRECT_TYPE 2
+
+// Frame types of RFC 7540
+enum LowHTTP2_FrameType
+{
+    LOWHTTP2_FRAME_DATA = 0,
+    LOWHTTP2_FRAME_HEADERS = 1,
+    LOWHTTP2_FRAME_PRIORITY = 2,
+    LOWHTTP2_FRAME_RST_STREAM = 3,
+    LOWHTTP2_FRAME_SETTINGS = 4,
+    LOWHTTP2_FRAME_PUSH_PROMISE = 5,
+    LOWHTTP2_FRAME_PING = 6,
+    LOWHTTP2_FRAME_GOAWAY = 7,
+    LOWHTTP2_FRAME_WINDOW_UPDATE = 8,
+    LOWHTTP2_FRAME_CONTINUATION = 9
+};
+
+// Error codes of RST_STREAM and GOAWAY
+enum LowHTTP2_Error
+{
+    LOWHTTP2_NO_ERROR = 0,
+    LOWHTTP2_PROTOCOL_ERROR = 1,
+    LOWHTTP2_INTERNAL_ERROR = 2,
+    LOWHTTP2_FLOW_CONTROL_ERROR = 3,
+    LOWHTTP2_STREAM_CLOSED = 5,
+    LOWHTTP2_FRAME_SIZE_ERROR = 6,
+    LOWHTTP2_REFUSED_STREAM = 7,
+    LOWHTTP2_CANCEL = 8,
+    LOWHTTP2_COMPRESSION_ERROR = 9,
+    LOWHTTP2_ENHANCE_YOUR_CALM = 11
+};
+
+// What the callback in JavaScript gets, with the stream ID
+enum LowHTTP2_Event
+{
+    LOWHTTP2_EVENT_REQUEST = 1, // headers as flat array, end of stream
+    LOWHTTP2_EVENT_DATA,        // buffer
+    LOWHTTP2_EVENT_END,         // client is done sending
+    LOWHTTP2_EVENT_RESET,       // error code
+    LOWHTTP2_EVENT_DRAIN,       // the queued response data is written
+    LOWHTTP2_EVENT_CLOSE,       // connection is over
+    LOWHTTP2_EVENT_ERROR        // error object, read or write
+};
+
+// Growing byte buffer, for frames and header lists
+struct LowHTTP2Direct_Buffer
+{
+    unsigned char *data;
+    int len, size;
+};
+
+// Response data of a stream, not yet framed
+struct LowHTTP2Direct_Data
+{
+    LowHTTP2Direct_Data *next;
+    int len, pos;
+    unsigned char data[1];
+};
+
+struct LowHTTP2Direct_Stream
+{
+    int id;
+    int sendWindow, recvWindow, recvCredit;
+
+    LowHTTP2Direct_Data *dataFirst, *dataLast;
+    int dataQueued;
+
+    // endQueued: JavaScript ended the response, END_STREAM goes out after
+    // the queued data
+    bool headersSent, endQueued, endSent, endReceived;
+    bool wantDrain, ready, closed;
+    LowHTTP2Direct_Stream *readyNext;
+};
+
+struct LowHTTP2Direct_Event
+{
+    LowHTTP2Direct_Event *next;
+    int type, stream;
+    int code;           // error code, end of stream with requests
+    int len;
+    unsigned char *data;
+};
+
+// Entry of the HPACK dynamic table, name followed by value
+struct LowHTTP2Direct_Header
+{
+    int nameLen, valueLen;
+    char data[1];
+};
+
+struct low_t;
+class LowSocket;
+class LowHTTP2Direct
+    : public LowSocketDirect
+    , public LowLoopCallback
+{
+  public:
+    LowHTTP2Direct(low_t *low);
+    virtual ~LowHTTP2Direct();
+
+    virtual void SetSocket(LowSocket *socket);
+    void SetCallID(int callID);
+
+    // Called by JavaScript. headers is an HPACK block, see EncodeHeader.
+    // Return false if the stream is gone
+    bool Respond(int id, const unsigned char *headers, int len, bool end);
+    // Returns 1 if the caller should wait for the drain event, -1 if the
+    // stream is gone
+    int Write(int id, const unsigned char *data, int len, bool end);
+    bool Reset(int id, int code);
+
+    // Appends a header as literal without indexing, the name is taken from
+    // the static table if it is there
+    static bool EncodeHeader(LowHTTP2Direct_Buffer &buf, const char *name,
+                             int nameLen, const char *value, int valueLen);
+    static bool EncodeStatus(LowHTTP2Direct_Buffer &buf, int status);
+
+    static bool Reserve(LowHTTP2Direct_Buffer &buf, int len);
+
+  protected:
+    virtual bool OnLoop();
+
+    virtual bool OnSocketData(unsigned char *data, int len);
+    virtual bool OnSocketWrite();
+
+    bool Frame();
+    bool FrameHeaders(LowHTTP2Direct_Stream *stream);
+    bool FrameData(LowHTTP2Direct_Stream *stream);
+    bool FrameSettings();
+    bool FrameWindowUpdate(LowHTTP2Direct_Stream *stream);
+
+    int Decode(LowHTTP2Direct_Buffer &list, bool request);
+    bool DecodeString(const unsigned char *&pos, const unsigned char *end,
+                      LowHTTP2Direct_Buffer &list);
+    bool TableGet(int index, LowHTTP2Direct_Buffer &list, bool nameOnly);
+    bool TableAdd(const unsigned char *name, int nameLen,
+                  const unsigned char *value, int valueLen);
+    void TableEvict(int size);
+
+    void Queue(int type, int flags, int id, const unsigned char *data,
+               int len);
+    void QueueWindowUpdate(int id, int increment);
+    void QueueReset(int id, int code);
+    void Fail(int code);
+    void Credit(LowHTTP2Direct_Stream *stream, int len);
+
+    void Ready(LowHTTP2Direct_Stream *stream);
+    void Fill();
+    void Close(LowHTTP2Direct_Stream *stream);
+    void Release(LowHTTP2Direct_Stream *stream);
+
+    bool AddEvent(int type, int stream, int code, unsigned char *data,
+                  int len);
+
+  private:
+    low_t *mLow;
+    LowSocket *mSocket;
+    int mCallID;
+
+    pthread_mutex_t mMutex;
+
+    // Frame being parsed, only touched by the web thread
+    int mPrefacePos;
+    unsigned char mHead[9];
+    int mHeadLen;
+    int mFrameType, mFrameFlags, mFrameStream, mFrameLen;
+    unsigned char *mFrame;
+    int mFramePos;
+
+    // Header block being put together from HEADERS and CONTINUATION
+    LowHTTP2Direct_Buffer mBlock;
+    int mBlockStream;
+    bool mBlockEnd;
+
+    // HPACK dynamic table of the decoder, ring of entries, newest at
+    // mTableFirst
+    LowHTTP2Direct_Header **mTable;
+    int mTableFirst, mTableCount, mTableSlots, mTableSize, mTableMaxSize;
+
+    // Protected by mMutex
+    map<int, LowHTTP2Direct_Stream *> mStreams;
+    int mLastStreamID, mOpenStreams;
+    int mSendWindow, mInitialSendWindow, mMaxSendFrame;
+    int mRecvWindow, mRecvCredit;
+    LowHTTP2Direct_Stream *mReadyFirst, *mReadyLast;
+
+    // Frames are queued in mOut, the web thread swaps it with mSend and
+    // writes that without holding the lock
+    LowHTTP2Direct_Buffer mOut, mSend;
+    int mSendPos;
+
+    LowHTTP2Direct_Event *mEventFirst, *mEventLast;
+    bool mReadPaused;
+
+    bool mSettingsReceived, mGoAway, mClosed;
+};
+
+#endif /* __LOWHTTP2DIRECT_H__ */
@@ -3,13 +3,33 @@
 // -----------------------------------------------------------------------------
 
 #include "LowHTTPDirect.h"
+#include "LowHTTP2Direct.h"
+#include "LowFile.h"
+#include "LowHTTPPool.h"
+#include "LowHTTPRouter.h"
 #include "LowSocket.h"
 
+#include "low_http.h"
+
 #include "low_alloc.h"
+#include "low_data_thread.h"
 #include "low_system.h"
 #include "low_config.h"
 
 #include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if LOW_HAS_SENDFILE
+#include <sys/sendfile.h>
+#endif /* LOW_HAS_SENDFILE */
+
+// Files of native routes which cannot go through sendfile are sent in
+// pieces of this size
+#if LOW_ESP32_LWIP_SPECIALITIES
+#define LOWHTTPDIRECT_ROUTE_CHUNK 2048
+#else
+#define LOWHTTPDIRECT_ROUTE_CHUNK 16384
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
 
 
 void add_stats(int index, bool add);
@@ -20,13 +40,24 @@ void add_stats(int index, bool add);
 // -----------------------------------------------------------------------------
 
 LowHTTPDirect::LowHTTPDirect(low_t *low, bool isServer) :
-    LowLoopCallback(low), mLow(low), mIsServer(isServer), mSocket(NULL), mRequestCallID(0),
+    LowDataCallback(low), LowLoopCallback(low), mLow(low), mIsServer(isServer), mSocket(NULL), mRequestCallID(0),
     mReadCallID(0), mWriteCallID(0), mBytesRead(0), mBytesWritten(0),
     mShutdown(false), mClosed(false), mEraseNextN(false),
 	mParamFirst(NULL), mParamLast(NULL), mRemainingRead(NULL),
-	mReadData(NULL),
+	mReadData(NULL), mPipeFD(-1), mPipeCallID(0), mPipeData(),
+    mPipeWriting(false), mPipeBytes(0),
     mWriteBufferCount(0), mWriteBufferStashInvalidCount(0),
-    mReadError(false), mWriteError(false), mHTTPError(false)
+    mHeadData(NULL), mHeadDataSize(0),
+#if LOW_INCLUDE_ZLIB
+    mWriteDeflate(NULL), mWriteDeflateData(NULL), mWriteDeflateDataLen(0),
+    mWriteDeflateInID(0), mWriteDeflating(false), mWriteDeflated(false),
+#endif /* LOW_INCLUDE_ZLIB */
+    mReadError(false), mWriteError(false), mHTTPError(false),
+    mHeadersTimeout(0), mKeepAliveTimeout(0),
+    mDeadlineType(LOWHTTPDIRECT_DEADLINE_NONE), mDeadline(0),
+    mDeadlinePrev(NULL), mDeadlineNext(NULL),
+    mPooled(false), mPool(NULL), mPoolHost(NULL),
+    mRouter(NULL), mRoute(NULL), mRouteBufferCount(0), mRouteFileData(NULL)
 {
 #if LOW_ESP32_LWIP_SPECIALITIES
     add_stats(1, true);
@@ -46,8 +77,14 @@ LowHTTPDirect::~LowHTTPDirect()
     add_stats(1, false);
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
 
+    // A data thread might still compress into our buffer
+    low_data_clear_callback(mLow, this);
+
+    SetDeadline(LOWHTTPDIRECT_DEADLINE_NONE);
     if(mSocket)
         mSocket->SetDirect(NULL, 0);
+    if(mPool)
+        mPool->Evict(mPoolHost, this);
 
     if(mRequestCallID)
         low_remove_stash(mLow->duk_ctx, mRequestCallID);
@@ -55,6 +92,10 @@ LowHTTPDirect::~LowHTTPDirect()
         low_remove_stash(mLow->duk_ctx, mReadCallID);
     if(mWriteCallID)
         low_remove_stash(mLow->duk_ctx, mWriteCallID);
+    if(mPipeCallID)
+        low_remove_stash(mLow->duk_ctx, mPipeCallID);
+    low_free(mPipeData[0]);
+    low_free(mPipeData[1]);
 
     while(mParamFirst)
     {
@@ -68,6 +109,24 @@ LowHTTPDirect::~LowHTTPDirect()
         if(mWriteBufferStashID[i])
             low_remove_stash(mLow->duk_ctx, mWriteBufferStashID[i]);
     }
+    low_free(mHeadData);
+
+    if(mRoute)
+        mRouter->Release(mRoute);
+    if(mRouter)
+        mRouter->DecRef();
+    low_free(mRouteFileData);
+
+#if LOW_INCLUDE_ZLIB
+    if(mWriteDeflateInID)
+        low_remove_stash(mLow->duk_ctx, mWriteDeflateInID);
+    if(mWriteDeflate)
+    {
+        deflateEnd(mWriteDeflate);
+        low_free(mWriteDeflate);
+    }
+    low_free(mWriteDeflateData);
+#endif /* LOW_INCLUDE_ZLIB */
 
     pthread_mutex_destroy(&mMutex);
 }
@@ -83,6 +142,33 @@ void LowHTTPDirect::SetSocket(LowSocket *socket)
         low_loop_set_callback(mLow, this);
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::OnSocketConnected - TLS handshake is done. If the client
+//  chose HTTP/2 with ALPN, the connection is handed to LowHTTP2Direct
+//  before anything is read
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::OnSocketConnected()
+{
+    if(!mIsServer || !mSocket)
+        return;
+
+    const char *protocol = mSocket->ALPNProtocol();
+    if(!protocol || strcmp(protocol, "h2") != 0)
+        return;
+
+    LowHTTP2Direct *direct = new LowHTTP2Direct(mLow);
+    if(!direct)
+        return;
+
+    // We are deleted by the loop thread once the socket is unset, so only
+    // locals from here on
+    LowSocket *socket = mSocket;
+    socket->SetDirect(NULL, 0, true);
+    socket->SetDirect(direct, LOWHTTP2DIRECT_TYPE, true);
+    socket->TriggerDirect(LOWSOCKET_TRIGGER_READ | LOWSOCKET_TRIGGER_WRITE);
+}
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::Init
 // -----------------------------------------------------------------------------
@@ -97,6 +183,9 @@ void LowHTTPDirect::Init()
     mDataLen = 0;
     mChunkedEncoding = false;
     mNoBodyDefault = false;
+    mRequestStarted = false;
+    mTimedOut = false;
+    mRouteID = -1;
 
     while(mParamFirst)
     {
@@ -109,6 +198,26 @@ void LowHTTPDirect::Init()
     mWriting = false;
     mWriteDone = false;
 
+#if LOW_INCLUDE_ZLIB
+    if(mWriteDeflate)
+    {
+        if(mWriteDeflating)
+        {
+            low_data_clear_callback(mLow, this);
+            mWriteDeflating = mWriteDeflated = false;
+        }
+        if(mWriteDeflateInID)
+        {
+            low_remove_stash(mLow->duk_ctx, mWriteDeflateInID);
+            mWriteDeflateInID = 0;
+        }
+
+        deflateEnd(mWriteDeflate);
+        low_free(mWriteDeflate);
+        mWriteDeflate = NULL;
+    }
+#endif /* LOW_INCLUDE_ZLIB */
+
     if(mReadCallID)
     {
         low_remove_stash(mLow->duk_ctx, mReadCallID);
@@ -121,12 +230,150 @@ void LowHTTPDirect::Init()
     }
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::NextRequest - server: request and response are done
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::NextRequest()
+{
+    Init();
+    SetDeadline(LOWHTTPDIRECT_DEADLINE_IDLE);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::SetTimeouts
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::SetTimeouts(int headersTimeout, int keepAliveTimeout)
+{
+    mHeadersTimeout = headersTimeout;
+    mKeepAliveTimeout = keepAliveTimeout;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::SetRouter
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::SetRouter(LowHTTPRouter *router)
+{
+    mRouter = router;
+    if(mRouter)
+        mRouter->AddRef();
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::SetDeadline
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::SetDeadline(LowHTTPDirect_Deadline type)
+{
+    int msecs = type == LOWHTTPDIRECT_DEADLINE_IDLE ? mKeepAliveTimeout
+              : type == LOWHTTPDIRECT_DEADLINE_HEADERS ? mHeadersTimeout : 0;
+
+    // The list is kept by the web thread, which might serve several heaps
+    low_t *threads = mLow->threads;
+    pthread_mutex_lock(&threads->web_thread_mutex);
+    if(mDeadlineType != LOWHTTPDIRECT_DEADLINE_NONE)
+    {
+        if(mDeadlinePrev)
+            mDeadlinePrev->mDeadlineNext = mDeadlineNext;
+        else
+            threads->web_deadline_first = mDeadlineNext;
+        if(mDeadlineNext)
+            mDeadlineNext->mDeadlinePrev = mDeadlinePrev;
+        else
+            threads->web_deadline_last = mDeadlinePrev;
+
+        mDeadlinePrev = mDeadlineNext = NULL;
+        mDeadlineType = LOWHTTPDIRECT_DEADLINE_NONE;
+    }
+
+    // Checked with the mutex held, as the web thread clears the deadline
+    // with it when the headers are complete
+    if(msecs <= 0 || mAtTrailer || mClosed || !mSocket)
+    {
+        pthread_mutex_unlock(&threads->web_thread_mutex);
+        return;
+    }
+
+    mDeadlineType = type;
+    mDeadline = low_tick_count() + msecs;
+
+    // Connections of one server share the timeout, so we are mostly last
+    LowHTTPDirect *prev = threads->web_deadline_last;
+    while(prev && prev->mDeadline - mDeadline > 0)
+        prev = prev->mDeadlinePrev;
+
+    mDeadlinePrev = prev;
+    mDeadlineNext = prev ? prev->mDeadlineNext : threads->web_deadline_first;
+    if(mDeadlinePrev)
+        mDeadlinePrev->mDeadlineNext = this;
+    else
+        threads->web_deadline_first = this;
+    if(mDeadlineNext)
+        mDeadlineNext->mDeadlinePrev = this;
+    else
+        threads->web_deadline_last = this;
+
+    // The web thread might be sleeping past our deadline
+    if(!mDeadlinePrev)
+        low_web_thread_break(mLow);
+    pthread_mutex_unlock(&threads->web_thread_mutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::ExpireDeadlines
+// -----------------------------------------------------------------------------
+
+int LowHTTPDirect::ExpireDeadlines(low_t *low)
+{
+    pthread_mutex_lock(&low->web_thread_mutex);
+    int now = low_tick_count();
+    while(low->web_deadline_first)
+    {
+        LowHTTPDirect *direct = low->web_deadline_first;
+
+        int msecs = direct->mDeadline - now;
+        if(msecs > 0)
+        {
+            pthread_mutex_unlock(&low->web_thread_mutex);
+            return msecs;
+        }
+
+        // The code thread locks mMutex before web_thread_mutex, so we may
+        // only try. If it holds mMutex, we try again in a moment
+        if(pthread_mutex_trylock(&direct->mMutex) != 0)
+        {
+            pthread_mutex_unlock(&low->web_thread_mutex);
+            return 1;
+        }
+
+        low->web_deadline_first = direct->mDeadlineNext;
+        if(low->web_deadline_first)
+            low->web_deadline_first->mDeadlinePrev = NULL;
+        else
+            low->web_deadline_last = NULL;
+        direct->mDeadlineNext = NULL;
+        direct->mDeadlineType = LOWHTTPDIRECT_DEADLINE_NONE;
+
+        // Handled by OnLoop like a connection closed by the other side
+        direct->mTimedOut = true;
+        direct->mClosed = true;
+        pthread_mutex_unlock(&direct->mMutex);
+        low_loop_set_callback(direct->mLow, direct);
+    }
+    pthread_mutex_unlock(&low->web_thread_mutex);
+
+    return -1;
+}
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::Detach
 // -----------------------------------------------------------------------------
 
 void LowHTTPDirect::Detach(bool pushRemainingRead)
 {
+    SetDeadline(LOWHTTPDIRECT_DEADLINE_NONE);
     if(pushRemainingRead)
     {
         low_web_clear_poll(mLow, mSocket);
@@ -145,6 +392,81 @@ void LowHTTPDirect::Detach(bool pushRemainingRead)
     }
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::ResponseDone - client: the response is read. Returns true
+//  if the connection can take the next request
+// -----------------------------------------------------------------------------
+
+bool LowHTTPDirect::ResponseDone()
+{
+    if(mIsServer || mClosed || !mWriteDone || mWriteBufferCount)
+        return false;
+
+    if(mPooled)
+    {
+        // We keep reading, so the pool learns if the server closes the
+        // connection. The request callback is no longer needed, also
+        // OnLoop knows by it that we are between requests
+        low_remove_stash(mLow->duk_ctx, mRequestCallID);
+        mRequestCallID = 0;
+    }
+    else
+        Detach();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::SetIdle
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::SetIdle(LowHTTPPool *pool, LowHTTPPool_Host *host,
+                            int msecs)
+{
+    mPool = pool;
+    mPoolHost = host;
+
+    mKeepAliveTimeout = msecs;
+    if(mPool)
+    {
+        // The deadline is not set after the headers otherwise
+        pthread_mutex_lock(&mMutex);
+        mAtTrailer = false;
+        pthread_mutex_unlock(&mMutex);
+        SetDeadline(LOWHTTPDIRECT_DEADLINE_IDLE);
+    }
+    else
+        SetDeadline(LOWHTTPDIRECT_DEADLINE_NONE);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::Evict - the idle connection is closed, by the server or
+//  the deadline. JavaScript destroys the socket
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::Evict()
+{
+    LowHTTPPool *pool = mPool;
+    LowHTTPPool_Host *host = mPoolHost;
+    if(!pool)
+        return;
+
+    SetIdle(NULL, NULL, 0);
+    pool->Evict(host, this);
+
+    if(mSocket)
+    {
+        int fd = mSocket->FD();
+        mSocket->SetDirect(NULL, 0);
+
+        if(mLow->http_evict_call_id)
+        {
+            low_push_stash(mLow->duk_ctx, mLow->http_evict_call_id, false);
+            duk_push_int(mLow->duk_ctx, fd);
+            low_call_next_tick(mLow->duk_ctx, 1);
+        }
+    }
+}
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::SetRequestCallID
 // -----------------------------------------------------------------------------
@@ -152,6 +474,8 @@ void LowHTTPDirect::Detach(bool pushRemainingRead)
 void LowHTTPDirect::SetRequestCallID(int callID)
 {
     mRequestCallID = callID;
+    if(mIsServer)
+        SetDeadline(LOWHTTPDIRECT_DEADLINE_HEADERS);
     if(mParamFirst || mClosed)
         low_loop_set_callback(mLow, this);
 }
@@ -206,40 +530,8 @@ void LowHTTPDirect::Read(unsigned char *data, int len, int callIndex)
 
             if(!mReadPos)
             {
-                duk_push_array(mLow->duk_ctx);
-                int arr_ind = 0;
-
-                while(mParamFirst)
-                {
-                    pthread_mutex_lock(&mMutex);
-                    LowHTTPDirect_ParamData *param = mParamFirst;
-                    mParamFirst = mParamFirst->next;
-                    if(!mParamFirst)
-                        mParamLast = NULL;
-                    pthread_mutex_unlock(&mMutex);
-
-                    int pos = 0;
-                    while(param->data[pos])
-                    {
-                        int len = param->data[pos];
-                        char next = param->data[pos + 1 + len];
-                        param->data[pos + 1 + len] = 0;
-
-                        duk_push_string(mLow->duk_ctx, param->data + pos + 1);
-                        duk_put_prop_index(mLow->duk_ctx, -2, arr_ind++);
-
-                        param->data[pos + 1 + len] = next;
-                        pos += 1 + len;
-                    }
-
-                    low_free(param);
-                }
-
-                if(!mIsServer && !mClosed && mWriteDone && !mWriteBufferCount)
-                    Detach();
-
-                duk_push_boolean(mLow->duk_ctx,
-                    !mIsServer && !mClosed && mWriteDone && !mWriteBufferCount);
+                PushTrailers();
+                duk_push_boolean(mLow->duk_ctx, ResponseDone());
                 low_call_next_tick(mLow->duk_ctx, 5);
             }
             else
@@ -267,19 +559,106 @@ void LowHTTPDirect::Read(unsigned char *data, int len, int callIndex)
         mReadCallID = low_add_stash(mLow->duk_ctx, callIndex);
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::PipeBody
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::PipeBody(int fileFD, int callIndex)
+{
+    if(!mIsRequest || mReadData || mPipeCallID || !mSocket)
+    {
+        duk_dup(mLow->duk_ctx, callIndex);
+        low_push_error(mLow->duk_ctx, EAGAIN, "read");
+        low_call_next_tick(mLow->duk_ctx, 1);
+        return;
+    }
+
+    mPipeData[0] = (unsigned char *)low_alloc(LOWHTTPDIRECT_PIPE_BUFFER_SIZE);
+    mPipeData[1] = (unsigned char *)low_alloc(LOWHTTPDIRECT_PIPE_BUFFER_SIZE);
+    if(!mPipeData[0] || !mPipeData[1])
+    {
+        low_free(mPipeData[0]);
+        low_free(mPipeData[1]);
+        mPipeData[0] = mPipeData[1] = NULL;
+
+        duk_dup(mLow->duk_ctx, callIndex);
+        low_push_error(mLow->duk_ctx, ENOMEM, "malloc");
+        low_call_next_tick(mLow->duk_ctx, 1);
+        return;
+    }
+
+    mPipeFD = fileFD;
+    mPipeCallID = low_add_stash(mLow->duk_ctx, callIndex);
+    mPipeCurrent = 0;
+    mPipeBytes = 0;
+
+    pthread_mutex_lock(&mMutex);
+    mReadPos = 0;
+    mReadLen = LOWHTTPDIRECT_PIPE_BUFFER_SIZE;
+    mReadData = mPipeData[0];
+
+    if(mRemainingRead && !mClosed)
+    {
+        pthread_mutex_unlock(&mMutex);
+
+        unsigned char *data = mRemainingRead;
+        mRemainingRead = NULL;
+        if(SocketData(data, mRemainingReadLen, true))
+            mSocket->TriggerDirect(LOWSOCKET_TRIGGER_READ);
+    }
+    else
+        pthread_mutex_unlock(&mMutex);
+
+    // What is already there, or the end of the body, is handled by OnLoop
+    low_loop_set_callback(mLow, this);
+}
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::WriteHeaders
 // -----------------------------------------------------------------------------
 
-void LowHTTPDirect::WriteHeaders(const char *txt,
+bool LowHTTPDirect::WriteHeaders(const char *txt,
                                  int index,
                                  int len,
-                                 bool isChunked)
+                                 bool isChunked,
+                                 int compressMode)
 {
     if((mIsServer && !mIsRequest) || mWriting)
-        return;
+        return true;
+
+#if LOW_INCLUDE_ZLIB
+    // Compressed body has unknown length, so only with chunked encoding
+    if(compressMode && isChunked)
+    {
+        mWriteDeflate = (z_stream *)low_alloc(sizeof(z_stream));
+        if(!mWriteDeflate)
+            return false;
+        memset(mWriteDeflate, 0, sizeof(z_stream));
+
+        // Mode numbers are the ones of LowZlib, 3 = gzip, otherwise deflate
+        if(deflateInit2(mWriteDeflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        compressMode == 3 ? 15 + 16 : 15, 8,
+                        Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            low_free(mWriteDeflate);
+            mWriteDeflate = NULL;
+            return false;
+        }
+    }
+#endif /* LOW_INCLUDE_ZLIB */
 
     pthread_mutex_lock(&mMutex);
+    // Buffers of the last response on a keep-alive connection
+    while(mWriteBufferStashInvalidCount)
+    {
+        low_remove_stash(mLow->duk_ctx, mWriteBufferStashID[0]);
+        mWriteBufferStashID[0] = mWriteBufferStashID[1];
+        mWriteBufferStashID[1] = mWriteBufferStashID[2];
+        mWriteBufferStashID[2] = 0;
+
+        mWriteBufferStashInvalidCount--;
+    }
+
     mWriting = true;
     mWritePos = 0;
     mWriteLen = len;
@@ -290,13 +669,168 @@ void LowHTTPDirect::WriteHeaders(const char *txt,
     if(isChunked)
         mWriteBuffers[0].iov_len -=
           2; // get rid of last \r\n, will be added with chunks
-    mWriteBufferStashID[0] = low_add_stash(mLow->duk_ctx, index);
+    mWriteBufferStashID[0] = index >= 0 ? low_add_stash(mLow->duk_ctx, index) : 0;
     mWriteBufferCount = 1;
 
     DoWrite();
     pthread_mutex_unlock(&mMutex);
+    return true;
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::HeadBuffer - keeps contents when growing
+// -----------------------------------------------------------------------------
+
+char *LowHTTPDirect::HeadBuffer(int size)
+{
+    if(size <= mHeadDataSize)
+        return mHeadData;
+
+    int newSize = mHeadDataSize ? mHeadDataSize * 2 : 512;
+    if(newSize < size)
+        newSize = size;
+
+    char *data = (char *)low_realloc(mHeadData, newSize);
+    if(!data)
+        return NULL;
+
+    mHeadData = data;
+    mHeadDataSize = newSize;
+    return mHeadData;
+}
+
+#if LOW_INCLUDE_ZLIB
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::Deflate - compresses into mWriteDeflateData, returns length
+// -----------------------------------------------------------------------------
+
+int LowHTTPDirect::Deflate(unsigned char *data, int len, bool finish)
+{
+    // Room for the final chunk, which we append directly to the data
+    const int tail = sizeof("\r\n0\r\n\r\n") - 1;
+    int size = deflateBound(mWriteDeflate, len) + tail;
+    int pos = 0;
+
+    mWriteDeflate->next_in = data;
+    mWriteDeflate->avail_in = len;
+    while(true)
+    {
+        if(size > mWriteDeflateDataLen)
+        {
+            unsigned char *newData =
+              (unsigned char *)low_realloc(mWriteDeflateData, size);
+            if(!newData)
+                return -1;
+            mWriteDeflateData = newData;
+            mWriteDeflateDataLen = size;
+        }
+        mWriteDeflate->next_out = mWriteDeflateData + pos;
+        mWriteDeflate->avail_out = mWriteDeflateDataLen - tail - pos;
+
+        // No flush, zlib decides when output is due, like with the zlib
+        // module
+        int err = deflate(mWriteDeflate, finish ? Z_FINISH : Z_NO_FLUSH);
+        pos = mWriteDeflate->next_out - mWriteDeflateData;
+        if(err == Z_STREAM_ERROR)
+            return -1;
+        if(finish ? err == Z_STREAM_END : mWriteDeflate->avail_out != 0)
+            return pos;
+
+        // What zlib held back from earlier writes did not fit
+        size = mWriteDeflateDataLen * 2;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::WriteDeflated - in the loop thread, writes what the data
+//  thread compressed and calls back if it is sent already
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::WriteDeflated()
+{
+    duk_context *ctx = mLow->duk_ctx;
+
+    if(mWriteDeflateInID)
+    {
+        low_remove_stash(ctx, mWriteDeflateInID);
+        mWriteDeflateInID = 0;
+    }
+
+    pthread_mutex_lock(&mMutex);
+    mWriteDeflating = mWriteDeflated = false;
+
+    int len = mWriteDeflateResult;
+    if(len >= 0)
+    {
+        bool finish = mWriteDeflateInLen == 0;
+
+        // Nothing might come out before the end, but an empty chunk would
+        // end the body
+        if(len)
+        {
+            sprintf(mWriteChunkedHeaderLine, "\r\n%x\r\n", len);
+            mWriteBuffers[mWriteBufferCount].iov_base = mWriteChunkedHeaderLine;
+            mWriteBuffers[mWriteBufferCount].iov_len =
+              strlen(mWriteChunkedHeaderLine);
+            mWriteBufferStashID[mWriteBufferCount] = 0;
+            mWriteBufferCount++;
+        }
+        if(finish)
+        {
+            mWriteDone = true;
+            memcpy(mWriteDeflateData + len, "\r\n0\r\n\r\n", 7);
+            len += 7;
+        }
+        if(len)
+        {
+            // Data is already consumed, so nothing to keep in the stash
+            mWriteBuffers[mWriteBufferCount].iov_base = mWriteDeflateData;
+            mWriteBuffers[mWriteBufferCount].iov_len = len;
+            mWriteBufferStashID[mWriteBufferCount] = 0;
+            mWriteBufferCount++;
+        }
+
+        if(mSocket)
+            DoWrite();
+    }
+    bool pending = len >= 0 && mSocket && mWriteBufferCount && !mWriteError;
+    pthread_mutex_unlock(&mMutex);
+
+    if(pending)
+    {
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+        return;
+    }
+    if(!mWriteCallID)
+        return;
+
+    int callID = mWriteCallID;
+    mWriteCallID = 0;
+    low_push_stash(ctx, callID, true);
+
+    if(len < 0)
+        low_push_error(ctx, ENOMEM, "deflate");
+    else if(!mSocket)
+        low_push_error(ctx, ECONNRESET, "write");
+    else if(mWriteError)
+    {
+        mSocket->PushError(1);
+        mWriteError = false;
+    }
+    else
+    {
+        duk_push_null(ctx);
+        duk_push_int(ctx, mBytesWritten);
+        mBytesWritten = 0;
+        duk_call(ctx, 2);
+        return;
+    }
+    duk_call(ctx, 1);
+}
+
+#endif /* LOW_INCLUDE_ZLIB */
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::Write
 // -----------------------------------------------------------------------------
@@ -326,6 +860,24 @@ void LowHTTPDirect::Write(unsigned char *data,
         mWriteBufferStashInvalidCount--;
     }
 
+#if LOW_INCLUDE_ZLIB
+    if(mWriteDeflate)
+    {
+        // Compressed by a data thread, WriteDeflated goes on from there. The
+        // data must stay alive until then
+        mWritePos += len;
+        mWriteDeflateIn = data;
+        mWriteDeflateInLen = len;
+        mWriteDeflateInID = len ? low_add_stash(mLow->duk_ctx, bufferIndex) : 0;
+        mWriteCallID = low_add_stash(mLow->duk_ctx, callIndex);
+        mWriteDeflating = true;
+        pthread_mutex_unlock(&mMutex);
+
+        low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_MODIFY);
+        return;
+    }
+    else
+#endif /* LOW_INCLUDE_ZLIB */
     if(len == 0)
     {
         mWriteDone = true;
@@ -438,19 +990,50 @@ void LowHTTPDirect::DoWrite()
             }
         }
         else if(mIsServer && mPhase == LOWHTTPDIRECT_PHASE_SENDING_RESPONSE)
-            Init();
+            NextRequest();
     }
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::OnData - compresses the data of Write
+// -----------------------------------------------------------------------------
+
+bool LowHTTPDirect::OnData()
+{
+#if LOW_INCLUDE_ZLIB
+    int len = Deflate(mWriteDeflateIn, mWriteDeflateInLen, mWriteDeflateInLen == 0);
+
+    pthread_mutex_lock(&mMutex);
+    mWriteDeflateResult = len;
+    mWriteDeflated = true;
+    pthread_mutex_unlock(&mMutex);
+
+    low_loop_set_callback(mLow, this);
+#endif /* LOW_INCLUDE_ZLIB */
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::OnLoop
 // -----------------------------------------------------------------------------
 
 bool LowHTTPDirect::OnLoop()
 {
+#if LOW_INCLUDE_ZLIB
+    if(mWriteDeflated)
+        WriteDeflated();
+#endif /* LOW_INCLUDE_ZLIB */
+    if(mPipeCallID)
+        Pipe();
+    // The data thread still writes from our buffer
+    if(mPipeWriting && !mSocket)
+        return true;
+
     if(!mRequestCallID)
     {
-        if(mClosed && mSocket)
+        if(mPool && (mClosed || !mSocket))
+            Evict();
+        else if(mClosed && mSocket)
             mSocket->SetDirect(NULL, 0);
         return mSocket ? true : false;
     }
@@ -459,48 +1042,33 @@ bool LowHTTPDirect::OnLoop()
     {
         low_push_stash(mLow->duk_ctx, mRequestCallID, false);
         duk_push_null(mLow->duk_ctx);
-
-        duk_push_array(mLow->duk_ctx);
-        int arr_ind = 0;
-
-        while(mParamFirst &&
-                mParamFirst->type == LOWHTTPDIRECT_PARAMDATA_HEADER)
-        {
-            pthread_mutex_lock(&mMutex);
-            LowHTTPDirect_ParamData *param = mParamFirst;
-            mParamFirst = mParamFirst->next;
-            if(!mParamFirst)
-                mParamLast = NULL;
-            pthread_mutex_unlock(&mMutex);
-
-            int pos = 0;
-            while(param->data[pos])
-            {
-                int len = (unsigned int)(unsigned char)param->data[pos];
-                char next = param->data[pos + 1 + len];
-                param->data[pos + 1 + len] = 0;
-
-                duk_push_string(mLow->duk_ctx, param->data + pos + 1);
-                duk_put_prop_index(mLow->duk_ctx, -2, arr_ind++);
-
-                param->data[pos + 1 + len] = next;
-                pos += 1 + len;
-            }
-
-            low_free(param);
-        }
+        PushHeaders();
 
         pthread_mutex_lock(&mLow->ref_mutex);
         int read = mBytesRead;
         mBytesRead = 0;
         pthread_mutex_unlock(&mLow->ref_mutex);
         duk_push_int(mLow->duk_ctx, read);
+        duk_insert(mLow->duk_ctx, -2);
+        duk_push_int(mLow->duk_ctx, mRouteID);
 
         mIsRequest = true;
-        duk_call(mLow->duk_ctx, 3);
+        duk_call(mLow->duk_ctx, 5);
     }
 
-    if(!mIsRequest && (mClosed || (mSocket && mReadError) || mHTTPError))
+    if(mIsServer && !mIsRequest && mClosed && !mRequestStarted && !mHTTPError)
+    {
+        // Closed or timed out before the next request started, this is how
+        // keep-alive connections end, so no error
+        low_push_stash(mLow->duk_ctx, mRequestCallID, false);
+        duk_push_null(mLow->duk_ctx);
+        duk_push_null(mLow->duk_ctx);
+        mReadError = false;
+
+        Detach();
+        duk_call(mLow->duk_ctx, 2);
+    }
+    else if(!mIsRequest && (mClosed || (mSocket && mReadError) || mHTTPError))
     {
         low_push_stash(mLow->duk_ctx, mRequestCallID, false);
         if(mSocket && mReadError)
@@ -512,6 +1080,13 @@ bool LowHTTPDirect::OnLoop()
             duk_push_string(mLow->duk_ctx, "ERR_HTTP_PARSER");
             duk_put_prop_string(mLow->duk_ctx, -2, "code");
         }
+        else if(mTimedOut)
+        {
+            duk_push_error_object(
+                mLow->duk_ctx, DUK_ERR_ERROR, "HTTP headers not received in time");
+            duk_push_string(mLow->duk_ctx, "ERR_HTTP_REQUEST_TIMEOUT");
+            duk_put_prop_string(mLow->duk_ctx, -2, "code");
+        }
         else
             low_push_error(mLow->duk_ctx, ECONNRESET, "read");
         mReadError = mHTTPError = false;
@@ -558,49 +1133,15 @@ bool LowHTTPDirect::OnLoop()
             pthread_mutex_unlock(&mMutex);
 
             pthread_mutex_lock(&mLow->ref_mutex);
-            int read = mBytesRead;
-            mBytesRead = 0;
-            pthread_mutex_unlock(&mLow->ref_mutex);
-            duk_push_int(mLow->duk_ctx, read);
-
-            if(!mReadPos)
-            {
-                duk_push_array(mLow->duk_ctx);
-                int arr_ind = 0;
-
-                while(mParamFirst)
-                {
-                    pthread_mutex_lock(&mMutex);
-                    LowHTTPDirect_ParamData *param = mParamFirst;
-                    mParamFirst = mParamFirst->next;
-                    if(!mParamFirst)
-                        mParamLast = NULL;
-                    pthread_mutex_unlock(&mMutex);
-                    if(!param)
-                        break;
-
-                    int pos = 0;
-                    while(param->data[pos])
-                    {
-                        int len = param->data[pos];
-                        char next = param->data[pos + 1 + len];
-                        param->data[pos + 1 + len] = 0;
-
-                        duk_push_string(mLow->duk_ctx, param->data + pos + 1);
-                        duk_put_prop_index(mLow->duk_ctx, -2, arr_ind++);
-
-                        param->data[pos + 1 + len] = next;
-                        pos += 1 + len;
-                    }
-
-                    low_free(param);
-                }
-                    
-                if(!mIsServer && !mClosed && mWriteDone && !mWriteBufferCount)
-                    Detach();
+            int read = mBytesRead;
+            mBytesRead = 0;
+            pthread_mutex_unlock(&mLow->ref_mutex);
+            duk_push_int(mLow->duk_ctx, read);
 
-                duk_push_boolean(mLow->duk_ctx,
-                    !mIsServer && !mClosed && mWriteDone && !mWriteBufferCount);
+            if(!mReadPos)
+            {
+                PushTrailers();
+                duk_push_boolean(mLow->duk_ctx, ResponseDone());
                 duk_call(mLow->duk_ctx, 5);
             }
             else
@@ -609,7 +1150,11 @@ bool LowHTTPDirect::OnLoop()
     }
     if(!mWriteBufferCount || (mSocket && mWriteError))
     {
+#if LOW_INCLUDE_ZLIB
+        if(mWriteCallID && !mWriteDeflating)
+#else
         if(mWriteCallID)
+#endif /* LOW_INCLUDE_ZLIB */
         {
             int callID = mWriteCallID;
             mWriteCallID = 0;
@@ -639,6 +1184,277 @@ bool LowHTTPDirect::OnLoop()
     return mSocket ? true : false;
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::PushHeaders - pushes the first line as array of 3 strings
+//  and the headers as header block, see LOW_HTTP_HEADER_LITERAL
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::PushHeaders()
+{
+    duk_context *ctx = mLow->duk_ctx;
+
+    // Size first. The headers are complete, the web thread only appends
+    // trailers behind them
+    pthread_mutex_lock(&mMutex);
+    int size = 0, num = 0;
+    for(LowHTTPDirect_ParamData *param = mParamFirst;
+        param && param->type == LOWHTTPDIRECT_PARAMDATA_HEADER;
+        param = param->next)
+    {
+        int pos = 0;
+        while(param->data[pos])
+        {
+            int len = (unsigned char)param->data[pos];
+            if(num >= 3 && ((num - 3) & 1))
+                size += 1 + len;
+            else if(num >= 3)
+                size += low_http_header_index(param->data + pos + 1, len) >= 0
+                          ? 1 : 2 + len;
+
+            num++;
+            pos += 1 + len;
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+    if(num > 3 && !((num - 3) & 1))
+        size++;     // header without value, gets an empty one
+
+    duk_push_array(ctx);
+    unsigned char *block = (unsigned char *)duk_push_fixed_buffer(ctx, size);
+    int out = 0;
+
+    num = 0;
+    while(mParamFirst && mParamFirst->type == LOWHTTPDIRECT_PARAMDATA_HEADER)
+    {
+        pthread_mutex_lock(&mMutex);
+        LowHTTPDirect_ParamData *param = mParamFirst;
+        mParamFirst = mParamFirst->next;
+        if(!mParamFirst)
+            mParamLast = NULL;
+        pthread_mutex_unlock(&mMutex);
+
+        int pos = 0;
+        while(param->data[pos])
+        {
+            int len = (unsigned char)param->data[pos];
+            const char *str = param->data + pos + 1;
+
+            if(num < 3)
+            {
+                duk_push_lstring(ctx, str, len);
+                duk_put_prop_index(ctx, -3, num);
+            }
+            else if((num - 3) & 1)
+            {
+                block[out++] = len;
+                memcpy(block + out, str, len);
+                out += len;
+            }
+            else
+            {
+                // Names are already lower case
+                int index = low_http_header_index(str, len);
+                if(index >= 0)
+                    block[out++] = index;
+                else
+                {
+                    block[out++] = LOW_HTTP_HEADER_LITERAL;
+                    block[out++] = len;
+                    memcpy(block + out, str, len);
+                    out += len;
+                }
+            }
+
+            num++;
+            pos += 1 + len;
+        }
+
+        low_free(param);
+    }
+    if(out < size)
+        block[out++] = 0;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::PushTrailers - as array of alternating names and values
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::PushTrailers()
+{
+    duk_push_array(mLow->duk_ctx);
+    int arr_ind = 0;
+
+    while(mParamFirst)
+    {
+        pthread_mutex_lock(&mMutex);
+        LowHTTPDirect_ParamData *param = mParamFirst;
+        mParamFirst = mParamFirst->next;
+        if(!mParamFirst)
+            mParamLast = NULL;
+        pthread_mutex_unlock(&mMutex);
+        if(!param)
+            break;
+
+        int pos = 0;
+        while(param->data[pos])
+        {
+            int len = param->data[pos];
+            char next = param->data[pos + 1 + len];
+            param->data[pos + 1 + len] = 0;
+
+            duk_push_string(mLow->duk_ctx, param->data + pos + 1);
+            duk_put_prop_index(mLow->duk_ctx, -2, arr_ind++);
+
+            param->data[pos + 1 + len] = next;
+            pos += 1 + len;
+        }
+
+        low_free(param);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::Pipe - PipeBody in the loop thread: hands the filled buffer
+//  to the file and lets the web thread go on with the other one
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::Pipe()
+{
+    duk_context *ctx = mLow->duk_ctx;
+
+    auto iter = mLow->fds.find(mPipeFD);
+    LowFile *file = iter != mLow->fds.end() &&
+                    iter->second->FDType() == LOWFD_TYPE_FILE
+                      ? (LowFile *)iter->second : NULL;
+
+    if(mPipeWriting)
+    {
+        // Files are only closed when they are idle
+        if(file && !file->Ready())
+            return;
+        mPipeWriting = false;
+
+        int result = file ? file->WriteResult() : -EBADF;
+        if(result == 0)
+            result = -ENOSPC;
+        if(result > 0)
+        {
+            mPipeBytes += result;
+            mPipeWritePos += result;
+            if(mPipeWritePos < mPipeWriteLen)
+            {
+                // Short write, the rest of the buffer first
+                file->Write(-1, mPipeData[mPipeCurrent ^ 1] + mPipeWritePos,
+                            mPipeWriteLen - mPipeWritePos, this);
+                mPipeWriting = true;
+                return;
+            }
+        }
+        else
+        {
+            PipeDone();
+            low_push_error(ctx, -result, "write");
+            duk_call(ctx, 1);
+            return;
+        }
+    }
+
+    // On the server, the next request might already be parsed
+    bool ended = mPhase == LOWHTTPDIRECT_PHASE_SENDING_RESPONSE || !mIsRequest;
+    if(!ended && (!mSocket || mReadError || mHTTPError || mClosed))
+    {
+        PipeDone();
+        if(mSocket && mReadError)
+            mSocket->PushError(0);
+        else if(mHTTPError)
+        {
+            duk_push_error_object(
+                ctx, DUK_ERR_ERROR, "HTTP data not valid");
+            duk_push_string(ctx, "ERR_HTTP_PARSER");
+            duk_put_prop_string(ctx, -2, "code");
+        }
+        else
+            low_push_error(ctx, ECONNRESET, "read");
+        mReadError = mHTTPError = false;
+
+        Detach();
+        duk_call(ctx, 1);
+        return;
+    }
+
+    // The web thread sets mRemainingRead with the mutex locked, and then
+    // stops reading until we continue
+    pthread_mutex_lock(&mMutex);
+    unsigned char *data = mReadData;
+    int len = mReadPos;
+    unsigned char *remaining = NULL;
+    if(len)
+    {
+        mPipeCurrent ^= 1;
+        mReadData = mPipeData[mPipeCurrent];
+        mReadPos = 0;
+
+        if(mSocket && !mClosed)
+        {
+            remaining = mRemainingRead;
+            mRemainingRead = NULL;
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    if(remaining && SocketData(remaining, mRemainingReadLen, true))
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_READ);
+
+    if(len)
+    {
+        if(!file || !file->Write(-1, data, len, this))
+        {
+            PipeDone();
+            low_push_error(ctx, file ? EALREADY : EBADF, "write");
+            duk_call(ctx, 1);
+            return;
+        }
+        mPipeWritePos = 0;
+        mPipeWriteLen = len;
+        mPipeWriting = true;
+    }
+    else if(ended)
+    {
+        PipeDone();
+        duk_push_null(ctx);
+        duk_push_number(ctx, (double)mPipeBytes);
+
+        pthread_mutex_lock(&mLow->ref_mutex);
+        int read = mBytesRead;
+        mBytesRead = 0;
+        pthread_mutex_unlock(&mLow->ref_mutex);
+        duk_push_int(ctx, read);
+
+        PushTrailers();
+        duk_push_boolean(ctx, ResponseDone());
+        duk_call(ctx, 5);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::PipeDone - pushes the callback of PipeBody
+// -----------------------------------------------------------------------------
+
+void LowHTTPDirect::PipeDone()
+{
+    pthread_mutex_lock(&mMutex);
+    mReadData = NULL;
+    pthread_mutex_unlock(&mMutex);
+
+    low_free(mPipeData[0]);
+    low_free(mPipeData[1]);
+    mPipeData[0] = mPipeData[1] = NULL;
+
+    int callID = mPipeCallID;
+    mPipeCallID = 0;
+    low_push_stash(mLow->duk_ctx, callID, true);
+}
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::OnSocketData
 // -----------------------------------------------------------------------------
@@ -669,6 +1485,13 @@ bool LowHTTPDirect::SocketData(unsigned char *data, int len, bool inLoop)
         goto done;
     }
 
+    if(mIsServer && !mRequestStarted)
+    {
+        // The headers timeout counts from the first byte of the request
+        mRequestStarted = true;
+        SetDeadline(LOWHTTPDIRECT_DEADLINE_HEADERS);
+    }
+
     while(len--)
     {
         unsigned char c = *data++;
@@ -792,7 +1615,7 @@ bool LowHTTPDirect::SocketData(unsigned char *data, int len, bool inLoop)
                 {
                     mPhase = LOWHTTPDIRECT_PHASE_SENDING_RESPONSE;
                     if(mIsServer && mWriteDone && !mWriteBufferCount)
-                        Init();
+                        NextRequest();
                 }
             }
             pthread_mutex_unlock(&mMutex);
@@ -914,15 +1737,41 @@ bool LowHTTPDirect::SocketData(unsigned char *data, int len, bool inLoop)
                         pthread_mutex_lock(&mMutex);
                         mPhase = LOWHTTPDIRECT_PHASE_SENDING_RESPONSE;
                         if(mIsServer && mWriteDone && !mWriteBufferCount)
-                            Init();
+                            NextRequest();
                         pthread_mutex_unlock(&mMutex);
                     }
                     else
                     {
-                        mAtTrailer = true;
                         if(mContentLen == -1 && !mChunkedEncoding &&
                            mNoBodyDefault)
                             mContentLen = 0;
+
+                        // Before mAtTrailer is set, so OnLoop cannot hand
+                        // the request to JavaScript in the meantime
+                        bool routed = mIsServer && mRouter && RouteRequest();
+
+                        mAtTrailer = true;
+                        if(mIsServer)
+                            SetDeadline(LOWHTTPDIRECT_DEADLINE_NONE);
+                        if(routed)
+                        {
+                            pthread_mutex_lock(&mMutex);
+                            mPhase = LOWHTTPDIRECT_PHASE_SENDING_RESPONSE;
+                            pthread_mutex_unlock(&mMutex);
+
+                            if(DoWriteRoute())
+                            {
+                                // Pipelined requests are parsed once the
+                                // response is out
+                                mRemainingRead = len ? data : NULL;
+                                mRemainingReadLen = len;
+                                mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+                                return false;
+                            }
+                            if(mClosed)
+                                return false;
+                            continue;
+                        }
                         if(mChunkedEncoding)
                         {
                             mPhase = LOWHTTPDIRECT_PHASE_CHUNK_HEADER;
@@ -936,7 +1785,7 @@ bool LowHTTPDirect::SocketData(unsigned char *data, int len, bool inLoop)
                             pthread_mutex_lock(&mMutex);
                             mPhase = LOWHTTPDIRECT_PHASE_SENDING_RESPONSE;
                             if(mIsServer && mWriteDone && !mWriteBufferCount)
-                                Init();
+                                NextRequest();
                             pthread_mutex_unlock(&mMutex);
                         }
                     }
@@ -988,20 +1837,289 @@ err:
     mHTTPError = true;
 done:
     mClosed = true;
+    if(mIsServer)
+        SetDeadline(LOWHTTPDIRECT_DEADLINE_NONE);
     low_loop_set_callback(mLow, this);
 
     return false;
 }
 
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::Param - string of the first line (0 - 2) or the headers,
+//  before they are handed to JavaScript
+// -----------------------------------------------------------------------------
+
+const char *LowHTTPDirect::Param(int index, int &len)
+{
+    for(LowHTTPDirect_ParamData *param = mParamFirst;
+        param && param->type == LOWHTTPDIRECT_PARAMDATA_HEADER;
+        param = param->next)
+    {
+        int pos = 0;
+        while(param->data[pos])
+        {
+            len = (unsigned char)param->data[pos];
+            if(!index--)
+                return param->data + pos + 1;
+            pos += 1 + len;
+        }
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::Header - value of header, name in lower case
+// -----------------------------------------------------------------------------
+
+const char *LowHTTPDirect::Header(const char *name, int &len)
+{
+    int nameLen = strlen(name), num = 0;
+    bool found = false;
+    for(LowHTTPDirect_ParamData *param = mParamFirst;
+        param && param->type == LOWHTTPDIRECT_PARAMDATA_HEADER;
+        param = param->next)
+    {
+        int pos = 0;
+        while(param->data[pos])
+        {
+            len = (unsigned char)param->data[pos];
+            const char *str = param->data + pos + 1;
+            if(found)
+                return str;
+
+            found = num >= 3 && !((num - 3) & 1) && len == nameLen &&
+                    memcmp(str, name, len) == 0;
+            num++;
+            pos += 1 + len;
+        }
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::RouteRequest - server, headers complete. Returns true if
+//  the request is answered by a native route
+// -----------------------------------------------------------------------------
+
+bool LowHTTPDirect::RouteRequest()
+{
+    int methodLen, urlLen, versionLen, len;
+    const char *method = Param(0, methodLen);
+    const char *url = Param(1, urlLen);
+    const char *version = Param(2, versionLen);
+    if(!method || !url || !version)
+        return false;
+
+    bool keepAlive;
+    LowHTTPRoute *route =
+      mRouter->Match(method, methodLen, url, urlLen, keepAlive);
+    if(!route)
+        return false;
+    if(route->type == LOWHTTPROUTE_JS)
+    {
+        mRouteID = route->id;
+        mRouter->Release(route);
+        return false;
+    }
+
+    // Request bodies and upgrades need JavaScript, so do files we cannot stat
+    long long size = route->bodyLen;
+    struct stat st;
+    if(mContentLen != 0 || mChunkedEncoding || Header("upgrade", len) ||
+       (route->type == LOWHTTPROUTE_FILE && fstat(route->fd, &st) < 0))
+    {
+        mRouter->Release(route);
+        return false;
+    }
+    if(route->type == LOWHTTPROUTE_FILE)
+        size = st.st_size;
+
+    // Same rules as in JavaScript
+    const char *connection = Header("connection", len);
+    char value[64];
+    if(connection)
+    {
+        if(len > (int)sizeof(value) - 1)
+            len = sizeof(value) - 1;
+        memcpy(value, connection, len);
+    }
+    value[connection ? len : 0] = '\0';
+    if(versionLen == 3 && memcmp(version, "1.1", 3) == 0)
+        keepAlive = keepAlive && !strcasestr(value, "close");
+    else
+        keepAlive = keepAlive && strcasestr(value, "keep-alive");
+
+    bool isHead = methodLen == 4 && memcmp(method, "HEAD", 4) == 0;
+
+    len = sprintf(mRouteLine, "Content-Length: %lld\r\n", size);
+    len += low_http_head_lines(mRouteLine + len,
+        (keepAlive ? LOW_HTTP_HEAD_KEEP_ALIVE : LOW_HTTP_HEAD_CLOSE) |
+        LOW_HTTP_HEAD_DATE);
+    memcpy(mRouteLine + len, "\r\n", 2);
+    len += 2;
+
+    mRoute = route;
+    mRouteClose = !keepAlive;
+    mRouteBuffers[0].iov_base = route->head;
+    mRouteBuffers[0].iov_len = route->headLen;
+    mRouteBuffers[1].iov_base = mRouteLine;
+    mRouteBuffers[1].iov_len = len;
+    mRouteBufferCount = 2;
+    if(route->type == LOWHTTPROUTE_STATIC && route->bodyLen && !isHead)
+    {
+        mRouteBuffers[2].iov_base = route->body;
+        mRouteBuffers[2].iov_len = route->bodyLen;
+        mRouteBufferCount = 3;
+    }
+    mRouteFilePos = 0;
+    mRouteFileLen = route->type == LOWHTTPROUTE_FILE && !isHead ? size : 0;
+
+    // For JavaScript, the connection stays between requests
+    mRequestStarted = false;
+    pthread_mutex_lock(&mMutex);
+    while(mParamFirst)
+    {
+        LowHTTPDirect_ParamData *param = mParamFirst;
+        mParamFirst = mParamFirst->next;
+        low_free(param);
+    }
+    mParamLast = NULL;
+    pthread_mutex_unlock(&mMutex);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPDirect::DoWriteRoute - returns true while the response of a native
+//  route is not completely written
+// -----------------------------------------------------------------------------
+
+bool LowHTTPDirect::DoWriteRoute()
+{
+    while(true)
+    {
+        if(!mRouteBufferCount)
+        {
+            if(mRouteFilePos == mRouteFileLen)
+                break;
+
+#if LOW_HAS_SENDFILE
+            // From the page cache directly, except if we have to encrypt
+            if(!mSocket->IsSecure())
+            {
+                off_t pos = mRouteFilePos;
+                ssize_t size = sendfile(mSocket->FD(), mRoute->fd, &pos,
+                                        mRouteFileLen - mRouteFilePos);
+                if(size < 0 && (errno == EAGAIN || errno == EINTR))
+                    return true;
+                if(size <= 0)   // error or file got shorter
+                    goto err;
+
+                mRouteFilePos += size;
+                continue;
+            }
+#endif /* LOW_HAS_SENDFILE */
+
+            if(!mRouteFileData)
+            {
+                mRouteFileData =
+                  (unsigned char *)low_alloc(LOWHTTPDIRECT_ROUTE_CHUNK);
+                if(!mRouteFileData)
+                    goto err;
+            }
+
+            int size = mRouteFileLen - mRouteFilePos > LOWHTTPDIRECT_ROUTE_CHUNK
+                     ? LOWHTTPDIRECT_ROUTE_CHUNK
+                     : (int)(mRouteFileLen - mRouteFilePos);
+            size = pread(mRoute->fd, mRouteFileData, size, mRouteFilePos);
+            if(size <= 0)
+                goto err;
+
+            mRouteFilePos += size;
+            mRouteBuffers[0].iov_base = mRouteFileData;
+            mRouteBuffers[0].iov_len = size;
+            mRouteBufferCount = 1;
+        }
+
+        int size = mSocket->writev(mRouteBuffers, mRouteBufferCount);
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+                return true;
+            goto err;
+        }
+
+        while(mRouteBufferCount && size >= (int)mRouteBuffers[0].iov_len)
+        {
+            size -= mRouteBuffers[0].iov_len;
+            memmove(mRouteBuffers, mRouteBuffers + 1,
+                    --mRouteBufferCount * sizeof(struct iovec));
+        }
+        if(size)
+        {
+            mRouteBuffers[0].iov_base =
+              ((unsigned char *)mRouteBuffers[0].iov_base) + size;
+            mRouteBuffers[0].iov_len -= size;
+        }
+    }
+
+    mRouter->Release(mRoute);
+    mRoute = NULL;
+    if(mRouteClose)
+    {
+        mRemainingRead = NULL;
+        if(!mShutdown)
+        {
+            mSocket->Shutdown();
+            mShutdown = true;
+        }
+    }
+
+    pthread_mutex_lock(&mMutex);
+    NextRequest();
+    pthread_mutex_unlock(&mMutex);
+    return false;
+
+err:
+    // Handled by OnLoop like a connection closed by the other side
+    mRouter->Release(mRoute);
+    mRoute = NULL;
+    mRouteBufferCount = 0;
+    mRemainingRead = NULL;
+
+    mClosed = true;
+    low_loop_set_callback(mLow, this);
+    return false;
+}
+
 // -----------------------------------------------------------------------------
 //  LowHTTPDirect::OnSocketWrite
 // -----------------------------------------------------------------------------
 
 bool LowHTTPDirect::OnSocketWrite()
 { 
+    if(mRoute)
+    {
+        if(DoWriteRoute())
+            return true;
+        if(mClosed)
+            return false;
+
+        // Continue reading, with what came in while we were writing
+        unsigned char *data = mRemainingRead;
+        mRemainingRead = NULL;
+        if(!data || SocketData(data, mRemainingReadLen, false))
+            mSocket->TriggerDirect(LOWSOCKET_TRIGGER_READ);
+        return mRoute != NULL;
+    }
+
     pthread_mutex_lock(&mMutex);
     DoWrite();
+#if LOW_INCLUDE_ZLIB
+    if(mWriteCallID && !mWriteDeflating && (!mWriteBufferCount || mWriteError))
+#else
     if(mWriteCallID && (!mWriteBufferCount || mWriteError))
+#endif /* LOW_INCLUDE_ZLIB */
         low_loop_set_callback(mLow, this);
     bool res = mWriteBufferCount != 0 && !mWriteError;
     pthread_mutex_unlock(&mMutex);
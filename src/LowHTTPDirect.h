@@ -5,6 +5,7 @@
 #ifndef __LOWHTTPDIRECT_H__
 #define __LOWHTTPDIRECT_H__
 
+#include "LowDataCallback.h"
 #include "LowLoopCallback.h"
 #include "LowSocketDirect.h"
 
@@ -16,6 +17,21 @@
 #else
 #include <sys/uio.h>
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
+#if LOW_INCLUDE_ZLIB
+#include <zlib.h>
+#endif /* LOW_INCLUDE_ZLIB */
+
+// Default for platforms which do not set it (embedded)
+#ifndef LOW_HAS_SENDFILE
+#define LOW_HAS_SENDFILE 0
+#endif /* LOW_HAS_SENDFILE */
+
+// Buffers of PipeBody, two so the socket is read while the file is written
+#if LOW_ESP32_LWIP_SPECIALITIES
+#define LOWHTTPDIRECT_PIPE_BUFFER_SIZE  (4 * 1024)
+#else
+#define LOWHTTPDIRECT_PIPE_BUFFER_SIZE  (64 * 1024)
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
 
 using namespace std;
 
@@ -31,6 +47,13 @@ enum LowHTTPDirect_Phase
     LOWHTTPDIRECT_PHASE_SENDING_RESPONSE
 };
 
+enum LowHTTPDirect_Deadline
+{
+    LOWHTTPDIRECT_DEADLINE_NONE,
+    LOWHTTPDIRECT_DEADLINE_IDLE,    // keep-alive, waiting for the next request
+    LOWHTTPDIRECT_DEADLINE_HEADERS  // request started, headers not complete
+};
+
 enum LowHTTPDirect_ParamDataType
 {
     LOWHTTPDIRECT_PARAMDATA_HEADER = 0,
@@ -46,8 +69,13 @@ struct LowHTTPDirect_ParamData
 };
 
 class LowSocket;
+class LowHTTPRouter;
+struct LowHTTPRoute;
+class LowHTTPPool;
+struct LowHTTPPool_Host;
 class LowHTTPDirect
     : public LowSocketDirect
+    , public LowDataCallback
     , public LowLoopCallback
 {
   public:
@@ -57,21 +85,73 @@ class LowHTTPDirect
     virtual void SetSocket(LowSocket *socket);
     void Detach(bool pushRemainingRead = false);
 
+    void SetTimeouts(int headersTimeout, int keepAliveTimeout);
+    void SetRouter(LowHTTPRouter *router);
     void SetRequestCallID(int callID);
     void Read(unsigned char *data, int len, int callIndex);
-
-    void WriteHeaders(const char *txt, int index, int len, bool isChunked);
+    // Writes the rest of the body to the LowFile fileFD without handing the
+    // data to JavaScript. The callback gets the result once, like the last
+    // call of Read, with the bytes written instead of the bytes read
+    void PipeBody(int fileFD, int callIndex);
+    long long PipeBytes() { return mPipeBytes; }
+
+    // With index -1, txt is the buffer returned by HeadBuffer
+    bool WriteHeaders(const char *txt, int index, int len, bool isChunked,
+                      int compressMode = 0);
+    bool CanWriteHeaders() { return !((mIsServer && !mIsRequest) || mWriting); }
+    char *HeadBuffer(int size);
     void Write(unsigned char *data, int len, int bufferIndex, int callIndex);
 
-  protected:
+    // Called by the web thread. Closes the connections which are over their
+    // deadline and returns the milliseconds until the next one, or -1
+    static int ExpireDeadlines(low_t *low);
+
+    // Client connections of a LowHTTPPool stay attached after the response,
+    // see SetIdle
+    void SetPooled(bool pooled) { mPooled = pooled; }
+    bool IsServer() { return mIsServer; }
+    LowSocket *Socket() { return mSocket; }
+    bool CanPool()
+    {
+        return mPooled && mSocket && !mRequestCallID && !mClosed &&
+               !mHTTPError;
+    }
+    bool IsClosed() { return mClosed || mHTTPError; }
+
+    // With a pool, we are idle in it and the web thread closes us after
+    // msecs or when the server closes or sends something
+    void SetIdle(LowHTTPPool *pool, LowHTTPPool_Host *host, int msecs);
+    void Evict();
+
+    // Also for the next request on a connection of the pool
     void Init();
 
+  protected:
+    void NextRequest();
+    bool ResponseDone();
+    void SetDeadline(LowHTTPDirect_Deadline type);
+
+    virtual bool OnData();
     virtual bool OnLoop();
+    void PushHeaders();
+    void PushTrailers();
+    void Pipe();
+    void PipeDone();
 
+    virtual void OnSocketConnected();
     virtual bool OnSocketData(unsigned char *data, int len);
     bool SocketData(unsigned char *data, int len, bool inLoop);
 
+    const char *Param(int index, int &len);
+    const char *Header(const char *name, int &len);
+    bool RouteRequest();
+    bool DoWriteRoute();
+
     void DoWrite();
+#if LOW_INCLUDE_ZLIB
+    int Deflate(unsigned char *data, int len, bool finish);
+    void WriteDeflated();
+#endif /* LOW_INCLUDE_ZLIB */
     virtual bool OnSocketWrite();
 
   private:
@@ -106,14 +186,62 @@ class LowHTTPDirect
     unsigned char *mReadData;
     int mReadPos, mReadLen;
 
-    char mWriteChunkedHeaderLine[10];
+    // PipeBody: the web thread fills one buffer as mReadData while the data
+    // thread writes the other one to the file
+    int mPipeFD, mPipeCallID;
+    unsigned char *mPipeData[2];
+    int mPipeCurrent, mPipeWritePos, mPipeWriteLen;
+    bool mPipeWriting;
+    long long mPipeBytes;
+
+    char mWriteChunkedHeaderLine[16];
     struct iovec mWriteBuffers[3];
     int mWriteBufferStashID[3];
     int mWritePos, mWriteLen;
     uint8_t mWriteBufferCount, mWriteBufferStashInvalidCount;
     bool mWriting, mWriteDone, mWriteChunkedEncoding;
+    char *mHeadData;
+    int mHeadDataSize;
+
+#if LOW_INCLUDE_ZLIB
+    // Response compression, so the body does not need to go through a zlib
+    // stream in JavaScript. Each write is compressed by a data thread, then
+    // OnLoop hands the result to the socket
+    z_stream *mWriteDeflate;
+    unsigned char *mWriteDeflateData;
+    int mWriteDeflateDataLen;
+    unsigned char *mWriteDeflateIn;
+    int mWriteDeflateInLen, mWriteDeflateInID, mWriteDeflateResult;
+    bool mWriteDeflating, mWriteDeflated;
+#endif /* LOW_INCLUDE_ZLIB */
 
     bool mReadError, mWriteError, mHTTPError;
+
+    // Server connections between requests are closed by the web thread, so
+    // idle sockets do not need a timer in JavaScript
+    int mHeadersTimeout, mKeepAliveTimeout;
+    LowHTTPDirect_Deadline mDeadlineType;
+    int mDeadline;
+    LowHTTPDirect *mDeadlinePrev, *mDeadlineNext;
+    bool mRequestStarted, mTimedOut;
+
+    // Client connection of an agent, mPool is set while it is idle there
+    bool mPooled;
+    LowHTTPPool *mPool;
+    LowHTTPPool_Host *mPoolHost;
+
+    // Requests matching a native route of the server are answered by the web
+    // thread, JavaScript does not see them. mRouteID is the handler of a
+    // JavaScript route, or -1
+    LowHTTPRouter *mRouter;
+    LowHTTPRoute *mRoute;
+    int mRouteID;
+    bool mRouteClose;
+    struct iovec mRouteBuffers[3];
+    int mRouteBufferCount;
+    char mRouteLine[128];
+    long long mRouteFilePos, mRouteFileLen;
+    unsigned char *mRouteFileData;
 };
 
 #endif /* __LOWHTTPDIRECT_H__ */
\ No newline at end of file
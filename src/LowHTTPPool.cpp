@@ -0,0 +1,224 @@
+// -----------------------------------------------------------------------------
+//  LowHTTPPool.cpp
+// -----------------------------------------------------------------------------
+
+#include "LowHTTPPool.h"
+#include "LowHTTPDirect.h"
+#include "LowSocket.h"
+
+#include "low_main.h"
+#include "low_loop.h"
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::LowHTTPPool
+// -----------------------------------------------------------------------------
+
+LowHTTPPool::LowHTTPPool(low_t *low, int maxSockets, int maxFreeSockets,
+                         int idleTimeout) :
+    mLow(low), mIndex(-1), mRef(1), mMaxSockets(maxSockets),
+    mMaxFreeSockets(maxFreeSockets), mIdleTimeout(idleTimeout)
+{
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::~LowHTTPPool
+// -----------------------------------------------------------------------------
+
+LowHTTPPool::~LowHTTPPool()
+{
+    if(mIndex >= 0)
+        mLow->httpPools[mIndex] = NULL;
+
+    // Waiters keep the agent and so us alive, so there are only some left
+    // if the heap is destroyed, and then the stash is gone anyway
+    for(auto iter = mHosts.begin(); iter != mHosts.end(); iter++)
+        for(int i = 0; i < iter->second.idle.size(); i++)
+            iter->second.idle[i]->SetIdle(NULL, NULL, 0);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::DecRef
+// -----------------------------------------------------------------------------
+
+void LowHTTPPool::DecRef()
+{
+    if(!--mRef)
+        delete this;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::Lease
+// -----------------------------------------------------------------------------
+
+int LowHTTPPool::Lease(const char *key, int callIndex)
+{
+    auto iter = mHosts.find(key);
+    if(iter == mHosts.end())
+    {
+        iter = mHosts.insert(make_pair(string(key), LowHTTPPool_Host())).first;
+        iter->second.key = iter->first;
+        iter->second.sockets = 0;
+    }
+    LowHTTPPool_Host *host = &iter->second;
+
+    // Closed ones stay in the list until they are evicted by their direct,
+    // which is already scheduled
+    for(int i = host->idle.size() - 1; i >= 0; i--)
+    {
+        LowHTTPDirect *direct = host->idle[i];
+        if(direct->IsClosed())
+            continue;
+
+        host->idle.erase(host->idle.begin() + i);
+        int fd = direct->Socket()->FD();
+        direct->SetIdle(NULL, NULL, 0);
+        DecRef();
+        return fd;
+    }
+
+    if(host->sockets < mMaxSockets)
+    {
+        host->sockets++;
+        return -1;
+    }
+
+    host->waiters.push_back(low_add_stash(mLow->duk_ctx, callIndex));
+    return -2;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::Release - the response is read, the connection could take
+//  the next request
+// -----------------------------------------------------------------------------
+
+LowHTTPPool_Release LowHTTPPool::Release(const char *key, int fd)
+{
+    auto iter = mHosts.find(key);
+    if(iter == mHosts.end())
+        return LOWHTTPPOOL_RELEASE_CLOSE;
+    LowHTTPPool_Host *host = &iter->second;
+
+    LowHTTPDirect *direct = NULL;
+    auto iterFD = mLow->fds.find(fd);
+    if(iterFD != mLow->fds.end() &&
+       iterFD->second->FDType() == LOWFD_TYPE_SOCKET)
+    {
+        int directType;
+        direct = (LowHTTPDirect *)((LowSocket *)iterFD->second)
+                   ->GetDirect(directType);
+        if(directType != 0 || (direct && !direct->CanPool()))
+            direct = NULL;
+    }
+
+    if(direct && !host->waiters.empty())
+    {
+        int callID = host->waiters.front();
+        host->waiters.pop_front();
+
+        low_push_stash(mLow->duk_ctx, callID, true);
+        duk_push_int(mLow->duk_ctx, fd);
+        low_call_next_tick(mLow->duk_ctx, 1);
+        return LOWHTTPPOOL_RELEASE_HANDED;
+    }
+    if(!direct || host->idle.size() >= mMaxFreeSockets)
+    {
+        host->sockets--;
+        Wake(host);
+        Forget(host);
+        return LOWHTTPPOOL_RELEASE_CLOSE;
+    }
+
+    // The idle connection keeps us alive, it might be evicted after the
+    // agent is gone
+    AddRef();
+    host->idle.push_back(direct);
+    direct->SetIdle(this, host, mIdleTimeout);
+    return LOWHTTPPOOL_RELEASE_IDLE;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::Remove
+// -----------------------------------------------------------------------------
+
+void LowHTTPPool::Remove(const char *key)
+{
+    auto iter = mHosts.find(key);
+    if(iter == mHosts.end())
+        return;
+    LowHTTPPool_Host *host = &iter->second;
+
+    if(host->sockets > 0)
+        host->sockets--;
+    Wake(host);
+    Forget(host);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::Close
+// -----------------------------------------------------------------------------
+
+void LowHTTPPool::Close()
+{
+    mMaxFreeSockets = 0;
+
+    // Evict changes the lists, and might remove the host
+    vector<LowHTTPDirect *> idle;
+    for(auto iter = mHosts.begin(); iter != mHosts.end(); iter++)
+        idle.insert(idle.end(), iter->second.idle.begin(),
+                    iter->second.idle.end());
+    for(int i = 0; i < idle.size(); i++)
+        idle[i]->Evict();
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::Evict
+// -----------------------------------------------------------------------------
+
+void LowHTTPPool::Evict(LowHTTPPool_Host *host, LowHTTPDirect *direct)
+{
+    for(int i = 0; i < host->idle.size(); i++)
+        if(host->idle[i] == direct)
+        {
+            host->idle.erase(host->idle.begin() + i);
+            break;
+        }
+
+    host->sockets--;
+    Wake(host);
+    Forget(host);
+
+    // Might be the last reference
+    DecRef();
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::Wake - a connection is gone, the next queued request may
+//  make a new one
+// -----------------------------------------------------------------------------
+
+void LowHTTPPool::Wake(LowHTTPPool_Host *host)
+{
+    if(host->waiters.empty() || host->sockets >= mMaxSockets)
+        return;
+
+    int callID = host->waiters.front();
+    host->waiters.pop_front();
+    host->sockets++;
+
+    low_push_stash(mLow->duk_ctx, callID, true);
+    duk_push_int(mLow->duk_ctx, -1);
+    low_call_next_tick(mLow->duk_ctx, 1);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPPool::Forget - so hosts which are not used any more do not pile up
+// -----------------------------------------------------------------------------
+
+void LowHTTPPool::Forget(LowHTTPPool_Host *host)
+{
+    if(host->sockets || !host->waiters.empty())
+        return;
+
+    string key = host->key;
+    mHosts.erase(key);
+}
@@ -0,0 +1,74 @@
+// -----------------------------------------------------------------------------
+//  LowHTTPPool.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWHTTPPOOL_H__
+#define __LOWHTTPPOOL_H__
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct low_t;
+class LowHTTPDirect;
+
+// Release results, what JavaScript does with the socket
+enum LowHTTPPool_Release
+{
+    LOWHTTPPOOL_RELEASE_CLOSE = 0,  // not kept, the socket is to be destroyed
+    LOWHTTPPOOL_RELEASE_IDLE,       // waiting for the next request
+    LOWHTTPPOOL_RELEASE_HANDED      // given to a queued request
+};
+
+// Connections to one host, keyed by the name of the agent, which includes
+// port and TLS context
+struct LowHTTPPool_Host
+{
+    string key;
+    int sockets;            // leased, connecting and idle ones
+    vector<LowHTTPDirect *> idle;    // most recently used last
+    deque<int> waiters;     // stash IDs of the callbacks of queued leases
+};
+
+// Client connections of an agent. Idle connections keep their LowHTTPDirect,
+// which reads for them, so the web thread sees the server closing them and
+// closes them itself after the idle timeout. Only used by the loop thread
+class LowHTTPPool
+{
+  public:
+    LowHTTPPool(low_t *low, int maxSockets, int maxFreeSockets, int idleTimeout);
+    ~LowHTTPPool();
+
+    void SetIndex(int index) { mIndex = index; }
+    void AddRef() { mRef++; }
+    void DecRef();
+
+    // Returns the file descriptor of an idle connection, -1 if a new
+    // connection is to be made or -2 if the request is queued. Then the
+    // callback at callIndex gets one of the first two later
+    int Lease(const char *key, int callIndex);
+    LowHTTPPool_Release Release(const char *key, int fd);
+    // A leased connection is closed or not reused
+    void Remove(const char *key);
+    // Closes all idle connections and keeps no more
+    void Close();
+
+    // Called by an idle LowHTTPDirect which is closed
+    void Evict(LowHTTPPool_Host *host, LowHTTPDirect *direct);
+
+  private:
+    void Wake(LowHTTPPool_Host *host);
+    void Forget(LowHTTPPool_Host *host);
+
+  private:
+    low_t *mLow;
+    int mIndex, mRef;
+
+    int mMaxSockets, mMaxFreeSockets, mIdleTimeout;
+    map<string, LowHTTPPool_Host> mHosts;
+};
+
+#endif /* __LOWHTTPPOOL_H__ */
@@ -0,0 +1,335 @@
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter.cpp
+// -----------------------------------------------------------------------------
+
+#include "LowHTTPRouter.h"
+
+#include "low_alloc.h"
+#include "low_main.h"
+
+#include <string.h>
+#include <unistd.h>
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::LowHTTPRouter
+// -----------------------------------------------------------------------------
+
+LowHTTPRouter::LowHTTPRouter(low_t *low)
+    : mLow(low), mRef(1), mRoot(NULL), mKeepAlive(false)
+{
+    pthread_mutex_init(&mMutex, NULL);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::~LowHTTPRouter
+// -----------------------------------------------------------------------------
+
+LowHTTPRouter::~LowHTTPRouter()
+{
+    ReleaseTree(mRoot);
+    pthread_mutex_destroy(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::AddRef
+// -----------------------------------------------------------------------------
+
+void LowHTTPRouter::AddRef()
+{
+    pthread_mutex_lock(&mLow->ref_mutex);
+    mRef++;
+    pthread_mutex_unlock(&mLow->ref_mutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::DecRef
+// -----------------------------------------------------------------------------
+
+void LowHTTPRouter::DecRef()
+{
+    pthread_mutex_lock(&mLow->ref_mutex);
+    if(!--mRef)
+    {
+        pthread_mutex_unlock(&mLow->ref_mutex);
+        delete this;
+        return;
+    }
+    pthread_mutex_unlock(&mLow->ref_mutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::SetRoutes
+// -----------------------------------------------------------------------------
+
+void LowHTTPRouter::SetRoutes(LowHTTPRouterNode *root, bool keepAlive)
+{
+    pthread_mutex_lock(&mMutex);
+    LowHTTPRouterNode *old = mRoot;
+    mRoot = root;
+    mKeepAlive = keepAlive;
+    pthread_mutex_unlock(&mMutex);
+
+    ReleaseTree(old);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::Match
+// -----------------------------------------------------------------------------
+
+LowHTTPRoute *LowHTTPRouter::Match(const char *method, int methodLen,
+                                   const char *url, int urlLen,
+                                   bool &keepAlive)
+{
+    // Query string is not part of the path
+    for(int i = 0; i < urlLen; i++)
+        if(url[i] == '?' || url[i] == '#')
+        {
+            urlLen = i;
+            break;
+        }
+
+    pthread_mutex_lock(&mMutex);
+    LowHTTPRoute *route = NULL;
+    if(mRoot)
+    {
+        route = MatchMethod(method, methodLen, url, urlLen);
+        if(!route && methodLen == 4 && memcmp(method, "HEAD", 4) == 0)
+            route = MatchMethod("GET", 3, url, urlLen);
+        if(!route)
+            route = MatchMethod("*", 1, url, urlLen);
+        if(route)
+            route->ref++;
+    }
+    keepAlive = mKeepAlive;
+    pthread_mutex_unlock(&mMutex);
+
+    return route;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::MatchMethod - with mMutex held
+// -----------------------------------------------------------------------------
+
+LowHTTPRoute *LowHTTPRouter::MatchMethod(const char *method, int methodLen,
+                                         const char *url, int urlLen)
+{
+    // Key is "METHOD /path", put together while walking down
+    int len = methodLen + 1 + urlLen;
+#define LOW_HTTP_ROUTER_KEY(i)                                                 \
+    ((i) < methodLen ? method[i] : (i) == methodLen ? ' ' : url[(i) - methodLen - 1])
+
+    LowHTTPRouterNode *node = mRoot;
+    LowHTTPRoute *best = NULL;
+    int pos = 0;
+    while(true)
+    {
+        if(node->prefix)
+            best = node->prefix;
+        if(pos == len)
+            return node->exact ? node->exact : best;
+
+        char c = LOW_HTTP_ROUTER_KEY(pos);
+        LowHTTPRouterNode *child = node->child;
+        while(child && child->label[0] != c)
+            child = child->next;
+        if(!child || child->len > len - pos)
+            return best;
+
+        for(int i = 1; i < child->len; i++)
+            if(child->label[i] != LOW_HTTP_ROUTER_KEY(pos + i))
+                return best;
+
+        pos += child->len;
+        node = child;
+    }
+#undef LOW_HTTP_ROUTER_KEY
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::Release
+// -----------------------------------------------------------------------------
+
+void LowHTTPRouter::Release(LowHTTPRoute *route)
+{
+    pthread_mutex_lock(&mMutex);
+    bool last = !--route->ref;
+    pthread_mutex_unlock(&mMutex);
+
+    if(last)
+        FreeRoute(route);
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::ReleaseTree
+// -----------------------------------------------------------------------------
+
+void LowHTTPRouter::ReleaseTree(LowHTTPRouterNode *node)
+{
+    while(node)
+    {
+        LowHTTPRouterNode *next = node->next;
+
+        ReleaseTree(node->child);
+        if(node->exact)
+            Release(node->exact);
+        if(node->prefix)
+            Release(node->prefix);
+        low_free(node);
+
+        node = next;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::NewRoute
+// -----------------------------------------------------------------------------
+
+LowHTTPRoute *LowHTTPRouter::NewRoute(LowHTTPRoute_Type type)
+{
+    LowHTTPRoute *route = (LowHTTPRoute *)low_calloc(1, sizeof(LowHTTPRoute));
+    if(!route)
+        return NULL;
+
+    route->type = type;
+    route->ref = 1;         // the one of the tree
+    route->fd = -1;
+    return route;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::FreeRoute
+// -----------------------------------------------------------------------------
+
+void LowHTTPRouter::FreeRoute(LowHTTPRoute *route)
+{
+    if(route->fd >= 0)
+        close(route->fd);
+    low_free(route->head);
+    low_free(route->body);
+    low_free(route);
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_router_node - new node with the given label
+// -----------------------------------------------------------------------------
+
+static LowHTTPRouterNode *low_http_router_node(const char *label, int len)
+{
+    LowHTTPRouterNode *node =
+      (LowHTTPRouterNode *)low_alloc(sizeof(LowHTTPRouterNode) + len);
+    if(!node)
+        return NULL;
+
+    node->child = node->next = NULL;
+    node->exact = node->prefix = NULL;
+    node->len = len;
+    memcpy(node->label, label, len);
+    return node;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::Insert - takes over the route on success
+// -----------------------------------------------------------------------------
+
+bool LowHTTPRouter::Insert(LowHTTPRouterNode *&root, const char *method,
+                           const char *path, LowHTTPRoute *route)
+{
+    if(!root)
+    {
+        root = low_http_router_node("", 0);
+        if(!root)
+            return false;
+    }
+
+    int methodLen = strlen(method), pathLen = strlen(path);
+    bool isPrefix = pathLen && path[pathLen - 1] == '*';
+    if(isPrefix)
+        pathLen--;
+
+    char *key = (char *)low_alloc(methodLen + 1 + pathLen);
+    if(!key)
+        return false;
+    memcpy(key, method, methodLen);
+    key[methodLen] = ' ';
+    memcpy(key + methodLen + 1, path, pathLen);
+    int len = methodLen + 1 + pathLen;
+
+    LowHTTPRouterNode *node = root;
+    int pos = 0;
+    while(pos < len)
+    {
+        LowHTTPRouterNode *child = node->child;
+        while(child && child->label[0] != key[pos])
+            child = child->next;
+        if(!child)
+        {
+            child = low_http_router_node(key + pos, len - pos);
+            if(!child)
+            {
+                low_free(key);
+                return false;
+            }
+
+            child->next = node->child;
+            node->child = child;
+            node = child;
+            break;
+        }
+
+        int common = 1;
+        while(common < child->len && pos + common < len &&
+              child->label[common] == key[pos + common])
+            common++;
+
+        if(common < child->len)
+        {
+            // Split, the rest of the label goes into a new node below
+            LowHTTPRouterNode *rest =
+              low_http_router_node(child->label + common, child->len - common);
+            if(!rest)
+            {
+                low_free(key);
+                return false;
+            }
+
+            rest->child = child->child;
+            rest->exact = child->exact;
+            rest->prefix = child->prefix;
+
+            child->child = rest;
+            child->exact = child->prefix = NULL;
+            child->len = common;
+        }
+
+        node = child;
+        pos += common;
+    }
+    low_free(key);
+
+    LowHTTPRoute *&slot = isPrefix ? node->prefix : node->exact;
+    if(slot)
+        FreeRoute(slot);    // registered twice, the last one wins
+    slot = route;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter::FreeTree - tree which was not given to SetRoutes
+// -----------------------------------------------------------------------------
+
+void LowHTTPRouter::FreeTree(LowHTTPRouterNode *node)
+{
+    while(node)
+    {
+        LowHTTPRouterNode *next = node->next;
+
+        FreeTree(node->child);
+        if(node->exact)
+            FreeRoute(node->exact);
+        if(node->prefix)
+            FreeRoute(node->prefix);
+        low_free(node);
+
+        node = next;
+    }
+}
@@ -0,0 +1,86 @@
+// -----------------------------------------------------------------------------
+//  LowHTTPRouter.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWHTTPROUTER_H__
+#define __LOWHTTPROUTER_H__
+
+#include <pthread.h>
+
+struct low_t;
+
+enum LowHTTPRoute_Type
+{
+    LOWHTTPROUTE_JS,        // handler in JavaScript, by id
+    LOWHTTPROUTE_STATIC,    // head and body, answered by the web thread
+    LOWHTTPROUTE_FILE       // head, body sent from file by the web thread
+};
+
+struct LowHTTPRoute
+{
+    LowHTTPRoute_Type type;
+    int ref;
+
+    int id;                 // LOWHTTPROUTE_JS
+    int fd;                 // LOWHTTPROUTE_FILE
+
+    // Status line and headers, without Content-Length and the empty line
+    char *head;
+    int headLen;
+    char *body;             // LOWHTTPROUTE_STATIC
+    int bodyLen;
+};
+
+// Radix tree over "METHOD /path". The label of a node follows the one of its
+// parent, so every node is a prefix of all keys below it
+struct LowHTTPRouterNode
+{
+    LowHTTPRouterNode *child, *next;
+    LowHTTPRoute *exact, *prefix;
+
+    int len;
+    char label[1];          // allocated with the node
+};
+
+class LowHTTPRouter
+{
+  public:
+    LowHTTPRouter(low_t *low);
+
+    void AddRef();
+    void DecRef();
+
+    // Replaces all routes at once, the old ones stay valid until the
+    // responses which use them are sent
+    void SetRoutes(LowHTTPRouterNode *root, bool keepAlive);
+
+    // Longest match, method specific routes before the ones for any method
+    // and HEAD requests also with GET routes. The route must be released
+    LowHTTPRoute *Match(const char *method, int methodLen,
+                        const char *url, int urlLen, bool &keepAlive);
+    void Release(LowHTTPRoute *route);
+
+    // Building a tree for SetRoutes. A path ending with * matches all paths
+    // which start with it, method * matches all methods
+    static LowHTTPRoute *NewRoute(LowHTTPRoute_Type type);
+    static bool Insert(LowHTTPRouterNode *&root, const char *method,
+                       const char *path, LowHTTPRoute *route);
+    static void FreeRoute(LowHTTPRoute *route);
+    static void FreeTree(LowHTTPRouterNode *root);
+
+  private:
+    ~LowHTTPRouter();
+
+    LowHTTPRoute *MatchMethod(const char *method, int methodLen,
+                              const char *url, int urlLen);
+    void ReleaseTree(LowHTTPRouterNode *node);
+
+    low_t *mLow;
+    int mRef;
+
+    pthread_mutex_t mMutex;
+    LowHTTPRouterNode *mRoot;
+    bool mKeepAlive;
+};
+
+#endif /* __LOWHTTPROUTER_H__ */
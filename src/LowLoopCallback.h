@@ -18,6 +18,7 @@ class LowLoopCallback
     friend duk_ret_t low_fs_open_sync(duk_context *ctx);
     friend duk_ret_t low_fs_close_sync(duk_context *ctx);
     friend duk_ret_t low_fs_waitdone(duk_context *ctx);
+    friend duk_ret_t low_metrics(duk_context *ctx);
 
   public:
     LowLoopCallback(low_t *low)
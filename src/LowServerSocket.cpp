@@ -6,6 +6,7 @@
 #include "LowSocket.h"
 
 #include "LowHTTPDirect.h"
+#include "LowHTTPRouter.h"
 #include "LowTLSContext.h"
 
 #include "low_web_thread.h"
@@ -29,12 +30,16 @@
 
 LowServerSocket::LowServerSocket(low_t *low, bool isHTTP,
                                  LowTLSContext *secureContext)
-    : LowFD(low, LOWFD_TYPE_SERVER), mLow(low), mIsHTTP(isHTTP),
+    : LowFD(low, LOWFD_TYPE_SERVER), mLow(low), mIsHTTP(isHTTP), mRouter(NULL),
       mAcceptCallID(0), mSecureContext(secureContext),
       mWaitForNotTooManyConnections(false), mTrackTooManyConnections(false)
 {
     if (mSecureContext)
         mSecureContext->AddRef();
+
+    // Shared with the connections, which may outlive us
+    if (mIsHTTP)
+        mRouter = new LowHTTPRouter(low);
 }
 
 // -----------------------------------------------------------------------------
@@ -52,6 +57,8 @@ LowServerSocket::~LowServerSocket()
         low_remove_stash(mLow->duk_ctx, mAcceptCallID);
     if (mSecureContext)
         mSecureContext->DecRef();
+    if (mRouter)
+        mRouter->DecRef();
 }
 
 // -----------------------------------------------------------------------------
@@ -59,7 +66,7 @@ LowServerSocket::~LowServerSocket()
 // -----------------------------------------------------------------------------
 
 bool LowServerSocket::Listen(struct sockaddr *addr, int addrLen, int callIndex,
-                             int &err, const char *&syscall)
+                             int &err, const char *&syscall, bool reusePort)
 {
     if (FD() >= 0)
     {
@@ -86,6 +93,19 @@ bool LowServerSocket::Listen(struct sockaddr *addr, int addrLen, int callIndex,
         close(fd);
         return false;
     }
+#ifdef SO_REUSEPORT
+    // Several processes listening on the same port, the kernel distributes
+    // the connections (used by cluster workers)
+    if (reusePort && addr->sa_family != AF_UNIX &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char *)&mode, sizeof(mode)) < 0)
+    {
+        err = errno;
+        syscall = "setsockopt";
+
+        close(fd);
+        return false;
+    }
+#endif /* SO_REUSEPORT */
     if (ioctl(fd, FIONBIO, &mode) < 0)
     {
         err = errno;
@@ -163,6 +183,7 @@ bool LowServerSocket::OnEvents(short events)
                     close(fd);
                     return true;
                 }
+                direct->SetRouter(mRouter);
             }
 
             if(mTrackTooManyConnections)
@@ -195,6 +216,7 @@ bool LowServerSocket::OnEvents(short events)
                     close(fd);
                     return true;
                 }
+                direct->SetRouter(mRouter);
             }
 
             if(mTrackTooManyConnections)
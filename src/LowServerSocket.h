@@ -8,6 +8,7 @@
 #include "LowFD.h"
 
 struct low_t;
+class LowHTTPRouter;
 
 class LowServerSocket : public LowFD
 {
@@ -16,7 +17,7 @@ class LowServerSocket : public LowFD
     virtual ~LowServerSocket();
 
     bool Listen(struct sockaddr *addr, int addrLen, int callIndex, int &err,
-                const char *&syscall);
+                const char *&syscall, bool reusePort = false);
 
     void Read(int pos, unsigned char *data, int len, int callIndex) {}
     void Write(int pos, unsigned char *data, int len, int callIndex) {}
@@ -25,12 +26,15 @@ class LowServerSocket : public LowFD
     void Connections(int count, int max);
     bool WaitForNotTooManyConnections() { return mWaitForNotTooManyConnections; }
 
+    LowHTTPRouter *Router() { return mRouter; }
+
   protected:
     virtual bool OnEvents(short events);
 
   private:
     low_t *mLow;
     bool mIsHTTP;
+    LowHTTPRouter *mRouter;
 
     int mFamily, mAcceptCallID;
 
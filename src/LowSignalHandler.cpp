@@ -18,34 +18,7 @@
 LowSignalHandler::LowSignalHandler(low_t *low, int signal)
     : LowLoopCallback(low), mLow(low), mSignal(signal)
 {
-    const char *name;
-    switch(signal)
-    {
-    case SIGUSR1:
-        name = "SIGUSR1";
-        break;
-    case SIGUSR2:
-        name = "SIGUSR2";
-        break;
-    case SIGPIPE:
-        name = "SIGPIPE";
-        break;
-    case SIGWINCH:
-        name = "SIGWINCH";
-        break;
-    case SIGTERM:
-        name = "SIGTERM";
-        break;
-    case SIGINT:
-        name = "SIGINT";
-        break;
-    case SIGHUP:
-        name = "SIGHUP";
-        break;
-    default:
-        name = NULL;
-    }
-    mName = name;
+    mName = low_signal_name(signal);
 
     low_loop_set_callback(low, this);
 }
@@ -65,12 +38,20 @@ LowSignalHandler::LowSignalHandler(low_t *low, const char *name)
 // -----------------------------------------------------------------------------
 
 #include "low_process.h"
+#if LOW_INCLUDE_CHILD_PROCESS
+#include "low_child_process.h"
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
 
 bool LowSignalHandler::OnLoop()
 {
     if(!mName)
         return false;
 
+#if LOW_INCLUDE_CHILD_PROCESS
+    if(mSignal == SIGCHLD)
+        low_child_process_reap(mLow);
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
+
     low_push_stash(mLow->duk_ctx, mLow->signal_call_id, false);
     duk_push_string(mLow->duk_ctx, "emit");
     duk_push_string(mLow->duk_ctx, mName);
@@ -39,12 +39,13 @@ void add_stats(int index, bool add);
 //  LowSocket::LowSocket
 // -----------------------------------------------------------------------------
 
-LowSocket::LowSocket(low_t *low, int fd) :
+LowSocket::LowSocket(low_t *low, int fd, LowSocketType type) :
     LowFD(low, LOWFD_TYPE_SOCKET, fd), LowLoopCallback(low), mLow(low),
-    mType(LOWSOCKET_TYPE_STDINOUT),
+    mType(type),
     mAcceptConnectCallID(0), mCloseCallID(0), mAcceptConnectError(false),
     mConnected(true), mClosed(false), mDestroyed(false),
     mReadData(NULL), mDirectReadData(NULL), mWriteData(NULL), mReadCallID(0),
+    mReadArenaID(0),
     mWriteCallID(0),
     mDirect(nullptr),
     mDirectReadEnabled(false), mDirectWriteEnabled(false), mTLSContext(NULL),
@@ -76,7 +77,7 @@ LowSocket::LowSocket(low_t *low,
     LowLoopCallback(low), mLow(low), mType(LOWSOCKET_TYPE_ACCEPTED),
     mAcceptConnectCallID(acceptCallID), mCloseCallID(0),  mAcceptConnectError(false),
     mConnected(false), mClosed(false),
-    mDestroyed(false), mReadData(NULL), mDirectReadData(NULL), mWriteData(NULL), mReadCallID(0), mWriteCallID(0),
+    mDestroyed(false), mReadData(NULL), mDirectReadData(NULL), mWriteData(NULL), mReadCallID(0), mReadArenaID(0), mWriteCallID(0),
     mDirect(direct), mDirectType(directType),
     mDirectReadEnabled(direct != NULL), mDirectWriteEnabled(direct != NULL),
     mTLSContext(tlsContext), mSSL(NULL), mHost(NULL)
@@ -133,6 +134,7 @@ LowSocket::LowSocket(low_t *low,
     mAcceptConnectCallID(0), mCloseCallID(0), mAcceptConnectError(false),
     mConnected(false), mClosed(false), mDestroyed(false),
     mReadData(NULL), mDirectReadData(NULL), mWriteData(NULL), mReadCallID(0),
+    mReadArenaID(0),
     mWriteCallID(0),
     mDirect(direct),
     mDirectType(directType), mDirectReadEnabled(direct != NULL),
@@ -183,6 +185,8 @@ LowSocket::~LowSocket()
         else
             low_remove_stash(mLow->duk_ctx, mReadCallID);
     }
+    if(mReadArenaID)
+        low_remove_stash(mLow->duk_ctx, mReadArenaID);
     if(mWriteCallID)
     {
         if(mIsWebThreadOnly)
@@ -387,6 +391,11 @@ void LowSocket::Read(int pos, unsigned char *data, int len, int callIndex)
     if(FD() >= 0 && FD() <= 2)
     {
         // don't call back, we are busy waiting for "input"
+        if(mReadArenaID)
+        {
+            low_remove_stash(mLow->duk_ctx, mReadArenaID);
+            mReadArenaID = 0;
+        }
         return;
     }
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
@@ -414,17 +423,7 @@ void LowSocket::Read(int pos, unsigned char *data, int len, int callIndex)
 
         mReadData = NULL;
         duk_dup(mLow->duk_ctx, callIndex);
-        if(len >= 0)
-        {
-            duk_push_null(mLow->duk_ctx);
-            duk_push_int(mLow->duk_ctx, len);
-            low_call_next_tick(mLow->duk_ctx, 2);
-        }
-        else
-        {
-            PushError(0);
-            low_call_next_tick(mLow->duk_ctx, 1);
-        }
+        low_call_next_tick(mLow->duk_ctx, PushReadResult(len));
     }
     else
     {
@@ -440,6 +439,159 @@ void LowSocket::Read(int pos, unsigned char *data, int len, int callIndex)
     }
 }
 
+// -----------------------------------------------------------------------------
+//  low_read_arena_finalizer - all views into the arena chunk are gone, so its
+//  memory may be reused
+// -----------------------------------------------------------------------------
+
+static duk_ret_t low_read_arena_finalizer(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_get_prop_string(ctx, 0, "\xff" "arenaData");
+    unsigned char *data = (unsigned char *)duk_get_pointer(ctx, -1);
+    if(!data)
+        return 0;
+
+    if(low->destroying || low->read_arena_free.size() >= LOW_READ_ARENA_KEEP)
+        low_free(data);
+    else
+        low->read_arena_free.push_back(data);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_read_arena_reserve - makes sure the current arena chunk has len bytes
+//  left and returns them. A chunk is an ArrayBuffer over memory outside of
+//  the Duktape heap, which the views we hand out keep alive
+// -----------------------------------------------------------------------------
+
+static unsigned char *low_read_arena_reserve(low_t *low, int len)
+{
+    duk_context *ctx = low->duk_ctx;
+
+    if(low->read_arena_id && low->read_arena_pos + len <= LOW_READ_ARENA_SIZE)
+        return low->read_arena_data + low->read_arena_pos;
+
+    unsigned char *data;
+    if(low->read_arena_free.size())
+    {
+        data = low->read_arena_free.back();
+        low->read_arena_free.pop_back();
+    }
+    else
+    {
+        data = (unsigned char *)low_alloc(LOW_READ_ARENA_SIZE);
+        if(!data)
+            return NULL;
+    }
+
+    duk_push_external_buffer(ctx);
+    duk_config_buffer(ctx, -1, data, LOW_READ_ARENA_SIZE);
+    duk_push_buffer_object(
+      ctx, -1, 0, LOW_READ_ARENA_SIZE, DUK_BUFOBJ_ARRAYBUFFER);
+    duk_remove(ctx, -2);
+    duk_push_pointer(ctx, data);
+    duk_put_prop_string(ctx, -2, "\xff" "arenaData");
+    duk_push_c_function(ctx, low_read_arena_finalizer, 1);
+    duk_set_finalizer(ctx, -2);
+
+    // The old chunk now only lives as long as views into it do
+    if(low->read_arena_id)
+        low_remove_stash(ctx, low->read_arena_id);
+    low->read_arena_id = low_add_stash(ctx, -1);
+    duk_pop(ctx);
+
+    low->read_arena_data = data;
+    low->read_arena_pos = 0;
+    return data;
+}
+
+// -----------------------------------------------------------------------------
+//  LowSocket::ReadArena - reads into a slice of the read arena of the heap,
+//  the callback gets a Buffer view into the arena instead of a buffer of its
+//  own
+// -----------------------------------------------------------------------------
+
+void LowSocket::ReadArena(int len, int callIndex)
+{
+    duk_context *ctx = mLow->duk_ctx;
+
+    if(mDirect || mReadData)
+    {
+        duk_dup(ctx, callIndex);
+        low_push_error(ctx, EAGAIN, "read");
+        low_call_next_tick(ctx, 1);
+        return;
+    }
+
+    if(len > LOW_READ_ARENA_SIZE)
+        len = LOW_READ_ARENA_SIZE;
+    unsigned char *data = low_read_arena_reserve(mLow, len);
+    if(!data)
+    {
+        duk_dup(ctx, callIndex);
+        low_push_error(ctx, ENOMEM, "read");
+        low_call_next_tick(ctx, 1);
+        return;
+    }
+
+    // The chunk must survive until the read is done, even if the arena
+    // moves on to the next one
+    mReadArenaPos = mLow->read_arena_pos;
+    mLow->read_arena_pos += len;
+    low_push_stash(ctx, mLow->read_arena_id, false);
+    mReadArenaID = low_add_stash(ctx, -1);
+    duk_pop(ctx);
+
+    Read(0, data, len, callIndex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowSocket::PushReadResult - pushes the arguments of the read callback and
+//  returns their number
+// -----------------------------------------------------------------------------
+
+int LowSocket::PushReadResult(int len)
+{
+    duk_context *ctx = mLow->duk_ctx;
+
+    if(!mReadArenaID)
+    {
+        if(len < 0)
+        {
+            PushError(0);
+            return 1;
+        }
+
+        duk_push_null(ctx);
+        duk_push_int(ctx, len);
+        return 2;
+    }
+
+    low_push_stash(ctx, mReadArenaID, true);
+    mReadArenaID = 0;
+
+    // Give back the part of the slice we did not use, if nobody reserved
+    // after us
+    if(duk_get_buffer_data(ctx, -1, NULL) == mLow->read_arena_data &&
+       mLow->read_arena_pos == mReadArenaPos + mReadLen)
+        mLow->read_arena_pos = mReadArenaPos + (len > 0 ? len : 0);
+
+    if(len < 0)
+    {
+        duk_pop(ctx);
+        PushError(0);
+        return 1;
+    }
+
+    duk_push_null(ctx);
+    duk_push_int(ctx, len);
+    duk_push_buffer_object(ctx, -3, mReadArenaPos, len, DUK_BUFOBJ_NODEJS_BUFFER);
+    duk_remove(ctx, -4);
+    return 3;
+}
+
 // -----------------------------------------------------------------------------
 //  LowSocket::Write
 // -----------------------------------------------------------------------------
@@ -661,6 +813,11 @@ void LowSocket::SetDirect(LowSocketDirect *direct, int type, bool fromWebThread)
             low_remove_stash(mLow->duk_ctx, mReadCallID);
             mReadCallID = 0;
         }
+        if(mReadArenaID)
+        {
+            low_remove_stash(mLow->duk_ctx, mReadArenaID);
+            mReadArenaID = 0;
+        }
         if(mWriteCallID)
         {
             low_remove_stash(mLow->duk_ctx, mWriteCallID);
@@ -837,30 +994,36 @@ bool LowSocket::OnEvents(short events)
         if(((events & (POLLIN | POLLHUP | POLLERR)) || mTLSContext) &&
             mDirectReadEnabled)
         {
-            if(!mDirectReadData)
-                mDirectReadData = (unsigned char *)low_alloc(1024);
-            if(mDirectReadData)
+            bool readMore;
+            if(!mDirect->OnSocketRead(readMore))
+                mDirectReadEnabled = readMore; // the direct read by itself
+            else
             {
-                mDirectReadEnabled = false; // no race conditions
-                while(true) // required with SSL b/c Read might not always
-                            // be retriggered if SSL still has data
+                if(!mDirectReadData)
+                    mDirectReadData = (unsigned char *)low_alloc(1024);
+                if(mDirectReadData)
                 {
-                    int len = DoRead(mDirectReadData, 1024);
-                    if(len < 0 && (mReadErrno == EAGAIN || mReadErrno == EINTR) && !mReadErrnoSSL)
+                    mDirectReadEnabled = false; // no race conditions
+                    while(true) // required with SSL b/c Read might not always
+                                // be retriggered if SSL still has data
                     {
-                        mDirectReadEnabled = true;
-                        break;
-                    }
-
-                    if(len == 0)
-                        mClosed = true;
-                    if(!mDirect->OnSocketData(mDirectReadData, len))
-                        break;
-
-                    if(!mTLSContext)
-                    {
-                        mDirectReadEnabled = true;
-                        break;
+                        int len = DoRead(mDirectReadData, 1024);
+                        if(len < 0 && (mReadErrno == EAGAIN || mReadErrno == EINTR) && !mReadErrnoSSL)
+                        {
+                            mDirectReadEnabled = true;
+                            break;
+                        }
+
+                        if(len == 0)
+                            mClosed = true;
+                        if(!mDirect->OnSocketData(mDirectReadData, len))
+                            break;
+
+                        if(!mTLSContext)
+                        {
+                            mDirectReadEnabled = true;
+                            break;
+                        }
                     }
                 }
             }
@@ -967,17 +1130,7 @@ bool LowSocket::OnLoop()
         mReadData = NULL;
 
         low_push_stash(ctx, callID, true);
-        if(mReadPos >= 0)
-        {
-            duk_push_null(ctx);
-            duk_push_int(ctx, mReadPos);
-            duk_call(ctx, 2);
-        }
-        else
-        {
-            PushError(0);
-            duk_call(ctx, 1);
-        }
+        duk_call(ctx, PushReadResult(mReadPos));
     }
     if(mWriteData && mWritePos)
     {
@@ -1115,7 +1268,7 @@ int LowSocket::DoRead(unsigned char *data, int readLen)
 #if LOW_ESP32_LWIP_SPECIALITIES
                      : lwip_read(FD(), data + len, readLen - len);
 #else
-                     : read(FD(), data + len, readLen - len);
+                     : ::read(FD(), data + len, readLen - len);
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
         if(size < 0)
         {
@@ -1197,6 +1350,19 @@ int LowSocket::DoWrite()
 }
 
 
+// -----------------------------------------------------------------------------
+//  LowSocket::read - 0 is the end of the stream, but unlike the other reads
+//  the socket is not marked closed, so the direct may still write
+// -----------------------------------------------------------------------------
+
+int LowSocket::read(unsigned char *data, int len)
+{
+    int size = DoRead(data, len);
+    if(size < 0)
+        errno = mReadErrnoSSL ? EIO : mReadErrno; // because we are checking this in LowFDPipe
+    return size;
+}
+
 // -----------------------------------------------------------------------------
 //  LowSocket::write
 // -----------------------------------------------------------------------------
@@ -1310,6 +1476,19 @@ void LowSocket::SetError(bool write, int error, bool ssl)
     }
 }
 
+// -----------------------------------------------------------------------------
+//  LowSocket::ALPNProtocol
+// -----------------------------------------------------------------------------
+
+const char *LowSocket::ALPNProtocol()
+{
+#if defined(MBEDTLS_SSL_ALPN)
+    if(mTLSContext && mSSL)
+        return mbedtls_ssl_get_alpn_protocol(mSSL);
+#endif /* MBEDTLS_SSL_ALPN */
+    return NULL;
+}
+
 // -----------------------------------------------------------------------------
 //  LowSocket::PushError
 // -----------------------------------------------------------------------------
@@ -16,6 +16,7 @@
 enum LowSocketType
 {
     LOWSOCKET_TYPE_STDINOUT,
+    LOWSOCKET_TYPE_PIPE,        // like STDINOUT, but the fd is ours to close
     LOWSOCKET_TYPE_ACCEPTED,
     LOWSOCKET_TYPE_CONNECTED
 };
@@ -31,7 +32,7 @@ class LowSocket
     , public LowLoopCallback
 {
   public:
-    LowSocket(low_t *low, int fd); // LOWSOCKET_TYPE_STDINOUT
+    LowSocket(low_t *low, int fd, LowSocketType type = LOWSOCKET_TYPE_STDINOUT);
     LowSocket(low_t *low,
               int fd,
               struct sockaddr *remoteAddr,
@@ -55,6 +56,7 @@ class LowSocket
                  const char *&syscall);
 
     void Read(int pos, unsigned char *data, int len, int callIndex);
+    void ReadArena(int len, int callIndex);
     void Write(int pos, unsigned char *data, int len, int callIndex);
     void Shutdown(int callIndex); // JS version
     int Shutdown();
@@ -70,6 +72,7 @@ class LowSocket
     void TriggerDirect(int trigger);
 
     // for direct
+    int read(unsigned char *data, int len);
     int write(const unsigned char *data, int len);
     int writev(const struct iovec *iov, int iovcnt);
 
@@ -77,6 +80,9 @@ class LowSocket
     void PushError(int call);
 
     bool IsConnected() { return mConnected; }
+    bool IsSecure() { return mTLSContext != NULL; }
+    // Protocol the client chose with ALPN, or NULL
+    const char *ALPNProtocol();
 
   protected:
     virtual bool OnEvents(short events);
@@ -86,6 +92,7 @@ class LowSocket
     bool CallAcceptConnect(int callIndex, bool onStash);
 
     int DoRead(unsigned char *data, int len);
+    int PushReadResult(int len);
     int DoWrite();
 
   private:
@@ -104,6 +111,7 @@ class LowSocket
 
     unsigned char *mReadData, *mDirectReadData, *mWriteData;
     int mReadLen, mReadCallID, mReadPos, mReadErrno;
+    int mReadArenaID, mReadArenaPos;   // stash ID of the arena chunk read into
     int mWriteLen, mWriteCallID, mWritePos, mWriteErrno;
     bool mReadErrnoSSL, mWriteErrnoSSL;
 
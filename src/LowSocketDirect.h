@@ -16,6 +16,9 @@ protected:
     virtual void SetSocket(LowSocket *socket) = 0;
 
     virtual void OnSocketConnected() {}
+    // Return false to read with LowSocket::read instead of getting
+    // OnSocketData, readMore then says whether to poll for more
+    virtual bool OnSocketRead(bool &readMore) { return true; }
     virtual bool OnSocketData(unsigned char *data, int len) = 0;
     virtual bool OnSocketWrite() = 0;
 };
@@ -37,7 +37,8 @@ static void my_debug(void *ctx, int level, const char *file, int line,
 LowTLSContext::LowTLSContext(low_t *low, const char *cert, int certLen,
                              const char *key, int keyLen, const char *ca,
                              int caLen, bool isServer)
-    : mLow(low), mRef(1), mIndex(-1), mIsOK(false), mHasCert(false), mHasCA(false)
+    : mLow(low), mRef(1), mIndex(-1), mALPNProtocols(NULL), mIsOK(false),
+      mHasCert(false), mHasCA(false)
 {
     int ret;
 
@@ -137,6 +138,47 @@ LowTLSContext::~LowTLSContext()
     mbedtls_ssl_config_free(&conf);
     mbedtls_ctr_drbg_free(&ctr_drbg);
     mbedtls_entropy_free(&entropy);
+
+    low_free(mALPNProtocols);
+}
+
+
+// -----------------------------------------------------------------------------
+//  LowTLSContext::SetALPNProtocols
+// -----------------------------------------------------------------------------
+
+bool LowTLSContext::SetALPNProtocols(const char **protocols, int count)
+{
+#if defined(MBEDTLS_SSL_ALPN)
+    // mbedtls keeps the pointers, so list and names go into one block
+    int size = (count + 1) * sizeof(char *);
+    for(int i = 0; i < count; i++)
+        size += strlen(protocols[i]) + 1;
+
+    const char **list = (const char **)low_alloc(size);
+    if(!list)
+        return false;
+
+    char *names = (char *)(list + count + 1);
+    for(int i = 0; i < count; i++)
+    {
+        strcpy(names, protocols[i]);
+        list[i] = names;
+        names += strlen(names) + 1;
+    }
+    list[count] = NULL;
+
+    if(mbedtls_ssl_conf_alpn_protocols(&conf, list) != 0)
+    {
+        low_free(list);
+        return false;
+    }
+    low_free(mALPNProtocols);
+    mALPNProtocols = list;
+    return true;
+#else
+    return count == 0;
+#endif /* MBEDTLS_SSL_ALPN */
 }
 
 
@@ -40,6 +40,10 @@ class LowTLSContext
 
     mbedtls_ssl_config &GetSSLConfig() { return conf; }
 
+    // Protocols offered with ALPN, in order of preference. The names are
+    // copied
+    bool SetALPNProtocols(const char **protocols, int count);
+
   private:
     low_t *mLow;
     int mRef;
@@ -50,6 +54,7 @@ class LowTLSContext
     mbedtls_ssl_config conf;
     mbedtls_x509_crt srvcert, cacert;
     mbedtls_pk_context pkey;
+    const char **mALPNProtocols;
 
     bool mIsOK, mHasCert, mHasCA;
 };
@@ -0,0 +1,807 @@
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect.cpp
+// -----------------------------------------------------------------------------
+
+#include "LowWebSocketDirect.h"
+#include "LowSocket.h"
+
+#include "low_alloc.h"
+#include "low_codec.h"
+#include "low_config.h"
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#if LOW_ESP32_LWIP_SPECIALITIES
+#include <lwip/sockets.h>
+#else
+#include <sys/uio.h>
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif /* __SSE2__ */
+
+// Received messages not yet taken by JavaScript, above this we stop reading
+// from the socket
+#if LOW_ESP32_LWIP_SPECIALITIES
+#define LOWWEBSOCKETDIRECT_MAX_PENDING (64 * 1024)
+#else
+#define LOWWEBSOCKETDIRECT_MAX_PENDING (1024 * 1024)
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+
+// Queued for writing, above this JavaScript gets a drain event when the
+// queue is empty again
+#define LOWWEBSOCKETDIRECT_HIGH_WATER (16 * 1024)
+
+// Frames per writev
+#define LOWWEBSOCKETDIRECT_IOV 16
+
+// -----------------------------------------------------------------------------
+//  low_ws_unmask - copies and unmasks, offset is the position in the payload
+// -----------------------------------------------------------------------------
+
+static void low_ws_unmask(unsigned char *dst, const unsigned char *src,
+                          int len, const unsigned char *mask, int offset)
+{
+    // The mask repeats every 4 bytes, so 16 bytes of it work for all widths
+    unsigned char key[16];
+    for(int i = 0; i < 16; i++)
+        key[i] = mask[(offset + i) & 3];
+
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i k = _mm_loadu_si128((const __m128i *)key);
+    for(; i + 64 <= len; i += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(a, k));
+        _mm_storeu_si128((__m128i *)(dst + i + 16), _mm_xor_si128(b, k));
+        _mm_storeu_si128((__m128i *)(dst + i + 32), _mm_xor_si128(c, k));
+        _mm_storeu_si128((__m128i *)(dst + i + 48), _mm_xor_si128(d, k));
+    }
+    for(; i + 16 <= len; i += 16)
+        _mm_storeu_si128(
+          (__m128i *)(dst + i),
+          _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)), k));
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    uint8x16_t k = vld1q_u8(key);
+    for(; i + 16 <= len; i += 16)
+        vst1q_u8(dst + i, veorq_u8(vld1q_u8(src + i), k));
+#else
+    uint32_t k;
+    memcpy(&k, key, 4);
+    for(; i + 4 <= len; i += 4)
+    {
+        uint32_t word;
+        memcpy(&word, src + i, 4);
+        word ^= k;
+        memcpy(dst + i, &word, 4);
+    }
+#endif /* __SSE2__ */
+
+    for(; i < len; i++)
+        dst[i] = src[i] ^ key[i & 15];
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::LowWebSocketDirect
+// -----------------------------------------------------------------------------
+
+LowWebSocketDirect::LowWebSocketDirect(low_t *low, int callID, int maxPayload)
+    : LowLoopCallback(low), mLow(low), mSocket(NULL), mCallID(callID),
+      mMaxPayload(maxPayload), mHeadLen(0), mHeadNeed(2),
+      mMessageOpcode(-1), mMessage(NULL), mMessageLen(0),
+      mWriteFirst(NULL), mWriteLast(NULL), mWritePos(0), mWriteQueued(0),
+      mWantDrain(false), mWriteError(false),
+      mEventFirst(NULL), mEventLast(NULL), mEventBytes(0), mReadPaused(false),
+      mCloseSent(false), mCloseReceived(false), mCloseWritten(false),
+      mClosed(false), mCloseCode(1005), mCloseReasonLen(0)
+{
+    pthread_mutex_init(&mMutex, NULL);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::~LowWebSocketDirect
+// -----------------------------------------------------------------------------
+
+LowWebSocketDirect::~LowWebSocketDirect()
+{
+    if(mSocket)
+        mSocket->SetDirect(NULL, 0);
+
+    if(mCallID)
+        low_remove_stash(mLow->duk_ctx, mCallID);
+
+    while(mWriteFirst)
+    {
+        LowWebSocketDirect_Write *write = mWriteFirst;
+        mWriteFirst = write->next;
+
+        Release(mLow, write->frame);
+        low_free(write);
+    }
+    while(mEventFirst)
+    {
+        LowWebSocketDirect_Event *event = mEventFirst;
+        mEventFirst = event->next;
+
+        low_free(event->data);
+        low_free(event);
+    }
+    low_free(mMessage);
+
+    pthread_mutex_destroy(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::SetSocket
+// -----------------------------------------------------------------------------
+
+void LowWebSocketDirect::SetSocket(LowSocket *socket)
+{
+    mSocket = socket;
+    if(!mSocket)
+        low_loop_set_callback(mLow, this);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::NewFrame
+// -----------------------------------------------------------------------------
+
+LowWebSocketFrame *LowWebSocketDirect::NewFrame(int opcode,
+                                                const unsigned char *data,
+                                                int len, bool fin)
+{
+    // Server frames are not masked
+    int headLen = opcode < 0 ? 0 : len < 126 ? 2 : len < 65536 ? 4 : 10;
+    LowWebSocketFrame *frame = (LowWebSocketFrame *)low_alloc(
+      sizeof(LowWebSocketFrame) + headLen + len);
+    if(!frame)
+        return NULL;
+
+    frame->ref = 1;
+    frame->opcode = opcode;
+    frame->len = headLen + len;
+
+    unsigned char *head = frame->data;
+    if(headLen)
+        head[0] = (fin ? 0x80 : 0) | opcode;
+    if(headLen == 2)
+        head[1] = len;
+    else if(headLen == 4)
+    {
+        head[1] = 126;
+        head[2] = len >> 8;
+        head[3] = len;
+    }
+    else if(headLen == 10)
+    {
+        head[1] = 127;
+        head[2] = head[3] = head[4] = head[5] = 0;
+        head[6] = len >> 24;
+        head[7] = len >> 16;
+        head[8] = len >> 8;
+        head[9] = len;
+    }
+    if(data && len)
+        memcpy(head + headLen, data, len);
+
+    return frame;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::AddRef
+// -----------------------------------------------------------------------------
+
+void LowWebSocketDirect::AddRef(low_t *low, LowWebSocketFrame *frame,
+                                int count)
+{
+    pthread_mutex_lock(&low->ref_mutex);
+    frame->ref += count;
+    pthread_mutex_unlock(&low->ref_mutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Release
+// -----------------------------------------------------------------------------
+
+void LowWebSocketDirect::Release(low_t *low, LowWebSocketFrame *frame)
+{
+    pthread_mutex_lock(&low->ref_mutex);
+    bool last = !--frame->ref;
+    pthread_mutex_unlock(&low->ref_mutex);
+
+    if(last)
+        low_free(frame);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Send - takes over the reference on success
+// -----------------------------------------------------------------------------
+
+int LowWebSocketDirect::Send(LowWebSocketFrame *frame)
+{
+    return Queue(frame, true);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Close
+// -----------------------------------------------------------------------------
+
+int LowWebSocketDirect::Close(int code, const char *reason, int reasonLen)
+{
+    unsigned char payload[125];
+    int len = 0;
+    if(code)
+    {
+        if(reasonLen > 123)
+            reasonLen = 123;
+
+        payload[0] = code >> 8;
+        payload[1] = code;
+        memcpy(payload + 2, reason, reasonLen);
+        len = 2 + reasonLen;
+    }
+
+    LowWebSocketFrame *frame =
+      NewFrame(LOWWEBSOCKET_OPCODE_CLOSE, payload, len);
+    if(!frame)
+        return -1;
+
+    int queued = Queue(frame, true);
+    if(queued < 0)
+        Release(mLow, frame);
+    return queued;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Queue - takes over the reference on success. After a
+//  close frame nothing more is sent
+// -----------------------------------------------------------------------------
+
+int LowWebSocketDirect::Queue(LowWebSocketFrame *frame, bool trigger)
+{
+    LowWebSocketDirect_Write *write =
+      (LowWebSocketDirect_Write *)low_alloc(sizeof(LowWebSocketDirect_Write));
+    if(!write)
+        return -1;
+    write->next = NULL;
+    write->frame = frame;
+
+    pthread_mutex_lock(&mMutex);
+    if(mCloseSent || mWriteError || mClosed)
+    {
+        pthread_mutex_unlock(&mMutex);
+        low_free(write);
+        return -1;
+    }
+    if(frame->opcode == LOWWEBSOCKET_OPCODE_CLOSE)
+        mCloseSent = true;
+
+    bool wasEmpty = !mWriteFirst;
+    if(mWriteLast)
+        mWriteLast->next = write;
+    else
+        mWriteFirst = write;
+    mWriteLast = write;
+
+    mWriteQueued += frame->len;
+    if(mWriteQueued > LOWWEBSOCKETDIRECT_HIGH_WATER)
+        mWantDrain = true;
+    int queued = mWriteQueued;
+    pthread_mutex_unlock(&mMutex);
+
+    if(trigger && wasEmpty && mSocket)
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_WRITE);
+    return queued;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::AddEvent - takes over data. Returns false if we
+//  should stop reading until JavaScript caught up
+// -----------------------------------------------------------------------------
+
+bool LowWebSocketDirect::AddEvent(int type, int code, unsigned char *data,
+                                  int len)
+{
+    LowWebSocketDirect_Event *event =
+      (LowWebSocketDirect_Event *)low_alloc(sizeof(LowWebSocketDirect_Event));
+    if(!event)
+    {
+        low_free(data);
+        return true;
+    }
+    event->next = NULL;
+    event->type = type;
+    event->code = code;
+    event->data = data;
+    event->len = len;
+
+    pthread_mutex_lock(&mMutex);
+    bool wasEmpty = !mEventFirst;
+    if(mEventLast)
+        mEventLast->next = event;
+    else
+        mEventFirst = event;
+    mEventLast = event;
+
+    mEventBytes += len;
+    if(mEventBytes > LOWWEBSOCKETDIRECT_MAX_PENDING)
+        mReadPaused = true;
+    bool paused = mReadPaused;
+    pthread_mutex_unlock(&mMutex);
+
+    if(wasEmpty)
+        low_loop_set_callback(mLow, this);
+    return !paused;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Feed
+// -----------------------------------------------------------------------------
+
+bool LowWebSocketDirect::Feed(unsigned char *data, int len)
+{
+    return !len || Parse(data, len);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::OnSocketData
+// -----------------------------------------------------------------------------
+
+bool LowWebSocketDirect::OnSocketData(unsigned char *data, int len)
+{
+    if(mClosed || mCloseReceived)
+        return false;
+
+    if(len <= 0)
+    {
+        // Connection gone without closing handshake
+        pthread_mutex_lock(&mMutex);
+        mClosed = true;
+        pthread_mutex_unlock(&mMutex);
+
+        if(len == 0)
+            AddEvent(LOWWEBSOCKET_OPCODE_CLOSE, 1006, NULL, 0);
+        else
+            AddEvent(LOWWEBSOCKET_EVENT_ERROR, 0, NULL, 0);
+        return false;
+    }
+
+    return Parse(data, len);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Parse
+// -----------------------------------------------------------------------------
+
+bool LowWebSocketDirect::Parse(unsigned char *data, int len)
+{
+    bool more = true;
+    while(len)
+    {
+        if(mHeadLen < mHeadNeed)
+        {
+            int size = mHeadNeed - mHeadLen;
+            if(size > len)
+                size = len;
+            memcpy(mHead + mHeadLen, data, size);
+            mHeadLen += size;
+            data += size;
+            len -= size;
+            if(mHeadLen < mHeadNeed)
+                break;
+
+            if(mHeadLen == 2)
+            {
+                if(mHead[0] & 0x70)
+                {
+                    Fail(1002, "reserved bits set");
+                    return false;
+                }
+                if(!(mHead[1] & 0x80))
+                {
+                    Fail(1002, "frame not masked");
+                    return false;
+                }
+
+                int len7 = mHead[1] & 0x7F;
+                mHeadNeed = 2 + (len7 == 126 ? 2 : len7 == 127 ? 8 : 0) + 4;
+                continue;
+            }
+
+            mFin = mHead[0] & 0x80;
+            mOpcode = mHead[0] & 0x0F;
+
+            int len7 = mHead[1] & 0x7F;
+            if(len7 == 126)
+                mPayloadLen = (mHead[2] << 8) | mHead[3];
+            else if(len7 == 127)
+            {
+                if(mHead[2] & 0x80)
+                {
+                    Fail(1002, "invalid payload length");
+                    return false;
+                }
+
+                mPayloadLen = 0;
+                for(int i = 2; i < 10; i++)
+                    mPayloadLen = (mPayloadLen << 8) | mHead[i];
+            }
+            else
+                mPayloadLen = len7;
+            memcpy(mMask, mHead + mHeadNeed - 4, 4);
+            mPayloadPos = 0;
+
+            if(mOpcode & 0x08)
+            {
+                if(mOpcode > LOWWEBSOCKET_OPCODE_PONG)
+                {
+                    Fail(1002, "invalid opcode");
+                    return false;
+                }
+                if(!mFin || mPayloadLen > 125)
+                {
+                    Fail(1002, "invalid control frame");
+                    return false;
+                }
+            }
+            else
+            {
+                if(mOpcode > LOWWEBSOCKET_OPCODE_BINARY)
+                {
+                    Fail(1002, "invalid opcode");
+                    return false;
+                }
+                if((mOpcode == LOWWEBSOCKET_OPCODE_CONTINUATION)
+                   != (mMessageOpcode >= 0))
+                {
+                    Fail(1002, "unexpected continuation");
+                    return false;
+                }
+                if(mPayloadLen > mMaxPayload - mMessageLen)
+                {
+                    Fail(1009, "message too big");
+                    return false;
+                }
+
+                if(mOpcode != LOWWEBSOCKET_OPCODE_CONTINUATION)
+                    mMessageOpcode = mOpcode;
+                if(mPayloadLen)
+                {
+                    unsigned char *message = (unsigned char *)low_realloc(
+                      mMessage, mMessageLen + mPayloadLen);
+                    if(!message)
+                    {
+                        Fail(1011, "out of memory");
+                        return false;
+                    }
+                    mMessage = message;
+                }
+            }
+
+            if(mPayloadLen)
+                continue;
+        }
+        else
+        {
+            int size = mPayloadLen - mPayloadPos < len
+                         ? (int)(mPayloadLen - mPayloadPos)
+                         : len;
+            unsigned char *dst = (mOpcode & 0x08)
+                                   ? mControl + mPayloadPos
+                                   : mMessage + mMessageLen + mPayloadPos;
+            low_ws_unmask(dst, data, size, mMask, mPayloadPos & 3);
+
+            mPayloadPos += size;
+            data += size;
+            len -= size;
+            if(mPayloadPos < mPayloadLen)
+                break;
+        }
+
+        mHeadLen = 0;
+        mHeadNeed = 2;
+        if(!Frame())
+            more = false;
+        if(mCloseReceived)
+            return false;
+    }
+
+    return more;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Frame - called with the complete frame. Returns false
+//  if we should stop reading
+// -----------------------------------------------------------------------------
+
+bool LowWebSocketDirect::Frame()
+{
+    switch(mOpcode)
+    {
+    case LOWWEBSOCKET_OPCODE_CONTINUATION:
+    case LOWWEBSOCKET_OPCODE_TEXT:
+    case LOWWEBSOCKET_OPCODE_BINARY:
+        mMessageLen += mPayloadLen;
+        if(mFin)
+        {
+            int opcode = mMessageOpcode;
+            unsigned char *message = mMessage;
+            int len = mMessageLen;
+
+            if(opcode == LOWWEBSOCKET_OPCODE_TEXT
+               && !low_utf8_is_valid(message, len))
+            {
+                Fail(1007, "invalid UTF-8");
+                return false;
+            }
+
+            mMessageOpcode = -1;
+            mMessage = NULL;
+            mMessageLen = 0;
+            return AddEvent(opcode, 0, message, len);
+        }
+        return true;
+
+    case LOWWEBSOCKET_OPCODE_PING:
+    {
+        LowWebSocketFrame *frame =
+          NewFrame(LOWWEBSOCKET_OPCODE_PONG, mControl, mPayloadLen);
+        if(frame && Queue(frame, true) < 0)
+            Release(mLow, frame);
+        return true;
+    }
+
+    case LOWWEBSOCKET_OPCODE_PONG:
+    {
+        unsigned char *data = NULL;
+        if(mPayloadLen)
+        {
+            data = (unsigned char *)low_alloc(mPayloadLen);
+            if(!data)
+                return true;
+            memcpy(data, mControl, mPayloadLen);
+        }
+        return AddEvent(LOWWEBSOCKET_OPCODE_PONG, 0, data, mPayloadLen);
+    }
+
+    case LOWWEBSOCKET_OPCODE_CLOSE:
+    {
+        int code = 1005;
+        if(mPayloadLen == 1)
+        {
+            Fail(1002, "invalid close frame");
+            return false;
+        }
+        if(mPayloadLen >= 2)
+        {
+            code = (mControl[0] << 8) | mControl[1];
+            if(code < 1000 || (code >= 1004 && code <= 1006)
+               || (code >= 1015 && code < 3000) || code >= 5000)
+            {
+                Fail(1002, "invalid close code");
+                return false;
+            }
+            if(!low_utf8_is_valid(mControl + 2, mPayloadLen - 2))
+            {
+                Fail(1007, "invalid UTF-8");
+                return false;
+            }
+        }
+
+        mCloseReceived = true;
+        mCloseCode = code;
+        mCloseReasonLen = mPayloadLen >= 2 ? mPayloadLen - 2 : 0;
+        memcpy(mCloseReason, mControl + 2, mCloseReasonLen);
+
+        // Echo the code. If we sent ours already, the handshake is done as
+        // soon as it is written
+        if(Close(code == 1005 ? 0 : code, NULL, 0) < 0 && mCloseWritten)
+            Closed();
+        return false;
+    }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Fail - protocol error, we close with the given code
+//  and do not wait for the answer
+// -----------------------------------------------------------------------------
+
+void LowWebSocketDirect::Fail(int code, const char *reason)
+{
+    mCloseReceived = true;
+    mCloseCode = code;
+    mCloseReasonLen = strlen(reason);
+    memcpy(mCloseReason, reason, mCloseReasonLen);
+
+    if(Close(code, reason, mCloseReasonLen) < 0 && mCloseWritten)
+        Closed();
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::Closed - closing handshake done, JavaScript may now
+//  close the socket
+// -----------------------------------------------------------------------------
+
+void LowWebSocketDirect::Closed()
+{
+    pthread_mutex_lock(&mMutex);
+    if(mClosed)
+    {
+        pthread_mutex_unlock(&mMutex);
+        return;
+    }
+    mClosed = true;
+    pthread_mutex_unlock(&mMutex);
+
+    unsigned char *reason = NULL;
+    if(mCloseReasonLen)
+    {
+        reason = (unsigned char *)low_alloc(mCloseReasonLen);
+        if(reason)
+            memcpy(reason, mCloseReason, mCloseReasonLen);
+    }
+    AddEvent(LOWWEBSOCKET_OPCODE_CLOSE, mCloseCode, reason,
+             reason ? mCloseReasonLen : 0);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::OnSocketWrite
+// -----------------------------------------------------------------------------
+
+bool LowWebSocketDirect::OnSocketWrite()
+{
+    while(true)
+    {
+        struct iovec iov[LOWWEBSOCKETDIRECT_IOV];
+        int count = 0;
+
+        pthread_mutex_lock(&mMutex);
+        for(LowWebSocketDirect_Write *write = mWriteFirst;
+            write && count < LOWWEBSOCKETDIRECT_IOV;
+            write = write->next, count++)
+        {
+            int pos = count ? 0 : mWritePos;
+            iov[count].iov_base = write->frame->data + pos;
+            iov[count].iov_len = write->frame->len - pos;
+        }
+        pthread_mutex_unlock(&mMutex);
+        if(!count)
+            return false;
+
+        int size = mSocket->writev(iov, count);
+        if(size < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+                return true;
+
+            pthread_mutex_lock(&mMutex);
+            mWriteError = true;
+            bool report = !mClosed;
+            mClosed = true;
+            pthread_mutex_unlock(&mMutex);
+
+            if(report)
+                AddEvent(LOWWEBSOCKET_EVENT_ERROR, 1, NULL, 0);
+            return false;
+        }
+
+        // Written frames are taken out under the lock, freed outside of it
+        LowWebSocketDirect_Write *done = NULL;
+        bool closeWritten = false, drain = false;
+
+        pthread_mutex_lock(&mMutex);
+        mWriteQueued -= size;
+        size += mWritePos;
+        while(mWriteFirst && size >= mWriteFirst->frame->len)
+        {
+            LowWebSocketDirect_Write *write = mWriteFirst;
+            size -= write->frame->len;
+
+            mWriteFirst = write->next;
+            if(!mWriteFirst)
+                mWriteLast = NULL;
+            if(write->frame->opcode == LOWWEBSOCKET_OPCODE_CLOSE)
+                closeWritten = true;
+
+            write->next = done;
+            done = write;
+        }
+        mWritePos = size;
+        if(!mWriteFirst && mWantDrain)
+        {
+            mWantDrain = false;
+            drain = true;
+        }
+        pthread_mutex_unlock(&mMutex);
+
+        while(done)
+        {
+            LowWebSocketDirect_Write *write = done;
+            done = write->next;
+
+            Release(mLow, write->frame);
+            low_free(write);
+        }
+
+        if(drain)
+            AddEvent(LOWWEBSOCKET_EVENT_DRAIN, 0, NULL, 0);
+        if(closeWritten)
+        {
+            mCloseWritten = true;
+            if(mCloseReceived)
+                Closed();
+            return false;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowWebSocketDirect::OnLoop()
+{
+    pthread_mutex_lock(&mMutex);
+    LowWebSocketDirect_Event *event = mEventFirst;
+    mEventFirst = mEventLast = NULL;
+    mEventBytes = 0;
+    bool resume = mReadPaused;
+    mReadPaused = false;
+    pthread_mutex_unlock(&mMutex);
+
+    if(resume && mSocket)
+        mSocket->TriggerDirect(LOWSOCKET_TRIGGER_READ);
+
+    while(event)
+    {
+        LowWebSocketDirect_Event *next = event->next;
+        if(mSocket)
+        {
+            duk_context *ctx = mLow->duk_ctx;
+
+            low_push_stash(ctx, mCallID, false);
+            duk_push_int(ctx, event->type);
+            if(event->type == LOWWEBSOCKET_EVENT_ERROR)
+                mSocket->PushError(event->code);
+            else if(event->type == LOWWEBSOCKET_OPCODE_BINARY
+                    || event->type == LOWWEBSOCKET_OPCODE_PONG)
+                memcpy(low_push_buffer(ctx, event->len), event->data,
+                       event->len);
+            else if(low_utf8_is_internal(event->data, event->len))
+                duk_push_lstring(ctx, (const char *)event->data, event->len);
+            else
+            {
+                // Validated by Frame, only 4 byte sequences to convert
+                unsigned char *buf = (unsigned char *)duk_push_buffer_raw(
+                  ctx, event->len * 3, DUK_BUF_FLAG_NOZERO);
+                size_t size = low_utf8_to_internal(event->data, event->len,
+                                                   buf);
+                duk_push_lstring(ctx, (const char *)buf, size);
+                duk_remove(ctx, -2);
+            }
+            duk_push_int(ctx, event->code);
+            duk_call(ctx, 3);
+            duk_pop(ctx);
+        }
+
+        low_free(event->data);
+        low_free(event);
+        event = next;
+    }
+
+    return mSocket != NULL;
+}
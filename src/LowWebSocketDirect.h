@@ -0,0 +1,139 @@
+// -----------------------------------------------------------------------------
+//  LowWebSocketDirect.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWWEBSOCKETDIRECT_H__
+#define __LOWWEBSOCKETDIRECT_H__
+
+#include "LowLoopCallback.h"
+#include "LowSocketDirect.h"
+
+#include <pthread.h>
+
+// Direct type of the socket, LowHTTPDirect is 0
+#define LOWWEBSOCKETDIRECT_TYPE 1
+
+// Opcodes of RFC 6455
+enum LowWebSocket_Opcode
+{
+    LOWWEBSOCKET_OPCODE_CONTINUATION = 0,
+    LOWWEBSOCKET_OPCODE_TEXT = 1,
+    LOWWEBSOCKET_OPCODE_BINARY = 2,
+    LOWWEBSOCKET_OPCODE_CLOSE = 8,
+    LOWWEBSOCKET_OPCODE_PING = 9,
+    LOWWEBSOCKET_OPCODE_PONG = 10
+};
+
+// What the callback in JavaScript gets next to the opcodes of messages
+enum LowWebSocket_Event
+{
+    LOWWEBSOCKET_EVENT_DRAIN = -1,
+    LOWWEBSOCKET_EVENT_ERROR = -2
+};
+
+// A complete frame, header included, as it goes over the wire. Shared by
+// all sockets a message is broadcast to. opcode -1 is raw data, as the
+// response to the upgrade request
+struct LowWebSocketFrame
+{
+    int ref;
+    int opcode;
+    int len;
+    unsigned char data[1];
+};
+
+struct LowWebSocketDirect_Write
+{
+    LowWebSocketDirect_Write *next;
+    LowWebSocketFrame *frame;
+};
+
+struct LowWebSocketDirect_Event
+{
+    LowWebSocketDirect_Event *next;
+    int type;           // opcode or LowWebSocket_Event
+    int code;           // close code
+    int len;
+    unsigned char *data;
+};
+
+struct low_t;
+class LowSocket;
+class LowWebSocketDirect
+    : public LowSocketDirect
+    , public LowLoopCallback
+{
+  public:
+    LowWebSocketDirect(low_t *low, int callID, int maxPayload);
+    virtual ~LowWebSocketDirect();
+
+    virtual void SetSocket(LowSocket *socket);
+
+    // Bytes the client sent after the upgrade request, called before the
+    // socket is handed to us
+    bool Feed(unsigned char *data, int len);
+
+    // Returns the bytes not yet written, or -1 if the socket is closing
+    int Send(LowWebSocketFrame *frame);
+    int Close(int code, const char *reason, int reasonLen);
+
+    // Without data, the caller fills in the payload at the end of the frame
+    static LowWebSocketFrame *NewFrame(int opcode, const unsigned char *data,
+                                       int len, bool fin = true);
+    static void AddRef(low_t *low, LowWebSocketFrame *frame, int count = 1);
+    static void Release(low_t *low, LowWebSocketFrame *frame);
+
+  protected:
+    virtual bool OnLoop();
+
+    virtual bool OnSocketData(unsigned char *data, int len);
+    virtual bool OnSocketWrite();
+
+    bool Parse(unsigned char *data, int len);
+    bool Frame();
+    void Fail(int code, const char *reason);
+    void Closed();
+
+    int Queue(LowWebSocketFrame *frame, bool trigger);
+    bool AddEvent(int type, int code, unsigned char *data, int len);
+
+  private:
+    low_t *mLow;
+    LowSocket *mSocket;
+    int mCallID, mMaxPayload;
+
+    pthread_mutex_t mMutex;
+
+    // Frame being parsed, only touched by the web thread
+    unsigned char mHead[14];
+    int mHeadLen, mHeadNeed;
+    unsigned char mMask[4];
+    int mOpcode;
+    bool mFin;
+    long long mPayloadLen, mPayloadPos;
+
+    // Message assembled from the fragments, the payload of control frames
+    // goes into mControl, as they may come between fragments
+    int mMessageOpcode;
+    unsigned char *mMessage;
+    int mMessageLen;
+    unsigned char mControl[125];
+
+    // Protected by mMutex
+    LowWebSocketDirect_Write *mWriteFirst, *mWriteLast;
+    int mWritePos, mWriteQueued;
+    bool mWantDrain, mWriteError;
+
+    LowWebSocketDirect_Event *mEventFirst, *mEventLast;
+    int mEventBytes;
+    bool mReadPaused;
+
+    // mCloseSent and mClosed are protected by mMutex, the rest belongs to
+    // the web thread
+    bool mCloseSent, mCloseReceived, mCloseWritten, mClosed;
+    int mCloseCode;
+    char mCloseReason[123];
+    int mCloseReasonLen;
+};
+
+#endif /* __LOWWEBSOCKETDIRECT_H__ */
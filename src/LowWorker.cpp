@@ -0,0 +1,400 @@
+// -----------------------------------------------------------------------------
+//  LowWorker.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_config.h"
+#if LOW_INCLUDE_WORKER_THREADS
+
+#include "LowWorker.h"
+
+#include "low_module.h"
+#include "low_system.h"
+
+#include <errno.h>
+
+static pthread_mutex_t g_low_worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_low_worker_last_id = 0;
+
+
+// -----------------------------------------------------------------------------
+//  LowWorkerPort::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowWorkerPort::OnLoop()
+{
+    mWorker->Deliver(mParent);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::LowWorker
+// -----------------------------------------------------------------------------
+
+LowWorker::LowWorker(low_t *low) :
+    mParentLow(low), mChildLow(NULL), mChildPort(NULL), mIndex(-1),
+    mThreadRunning(false), mPath(NULL), mWorkerData(NULL),
+    mCallID(0), mReceiverCallID(0), mRef(true),
+    mHoldsRef(false), mPortRef(false), mTerminated(false), mExited(false),
+    mExitReported(false), mExitCode(0)
+{
+    mParentPort = new LowWorkerPort(low, this, true);
+
+    pthread_mutex_init(&mMutex, NULL);
+
+    pthread_mutex_lock(&g_low_worker_mutex);
+    mThreadID = ++g_low_worker_last_id;
+    pthread_mutex_unlock(&g_low_worker_mutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::~LowWorker
+// -----------------------------------------------------------------------------
+
+LowWorker::~LowWorker()
+{
+    Terminate();
+    if(mThreadRunning)
+        pthread_join(mThread, NULL);
+
+    if(mIndex >= 0)
+        mParentLow->workers[mIndex] = NULL;
+    if(mHoldsRef)
+        mParentLow->run_ref--;
+    if(mParentLow->duk_ctx)
+        low_remove_stash(mParentLow->duk_ctx, mCallID);
+
+    for(int i = 0; i < mToParent.size(); i++)
+        delete mToParent[i];
+    for(int i = 0; i < mToChild.size(); i++)
+        delete mToChild[i];
+    delete mWorkerData;
+
+    delete mParentPort;
+    low_free(mPath);
+
+    pthread_mutex_destroy(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::Start
+// -----------------------------------------------------------------------------
+
+bool LowWorker::Start(const char *path, LowWorkerMessage *workerData,
+                      int callID)
+{
+    mWorkerData = workerData;
+    mCallID = callID;
+
+    mPath = low_strdup(path);
+    if(!mPath)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    int err = pthread_create(&mThread, NULL, ThreadMain, this);
+    if(err)
+    {
+        errno = err;
+        return false;
+    }
+    mThreadRunning = true;
+
+    if(mRef)
+    {
+        mParentLow->run_ref++;
+        mHoldsRef = true;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::Terminate
+// -----------------------------------------------------------------------------
+
+void LowWorker::Terminate()
+{
+    pthread_mutex_lock(&mMutex);
+    mTerminated = true;
+    if(mChildLow)
+    {
+        // Also interrupts running JavaScript code, Duktape checks this flag
+        mChildLow->duk_flag_stop = 1;
+        low_loop_set_callback(mChildLow, mChildPort);
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::Ref
+// -----------------------------------------------------------------------------
+
+void LowWorker::Ref(bool ref)
+{
+    mRef = ref;
+    if(mExitReported || !mThreadRunning || mHoldsRef == ref)
+        return;
+
+    mHoldsRef = ref;
+    if(ref)
+        mParentLow->run_ref++;
+    else
+        mParentLow->run_ref--;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::Post
+// -----------------------------------------------------------------------------
+
+void LowWorker::Post(bool toChild, LowWorkerMessage *msg)
+{
+    pthread_mutex_lock(&mMutex);
+    if(toChild)
+    {
+        if(mExited)
+            delete msg;
+        else
+        {
+            mToChild.push_back(msg);
+            if(mChildPort)
+                low_loop_set_callback(mChildLow, mChildPort);
+        }
+    }
+    else
+    {
+        // Posted by finalizers while the child's heap is destroyed, the
+        // parent has already been told that the worker exited
+        if(!mChildLow)
+            delete msg;
+        else
+        {
+            mToParent.push_back(msg);
+            low_loop_set_callback(mParentLow, mParentPort);
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::PushWorkerData
+// -----------------------------------------------------------------------------
+
+void LowWorker::PushWorkerData(duk_context *ctx)
+{
+    if(!mWorkerData)
+    {
+        duk_push_undefined(ctx);
+        return;
+    }
+
+    low_clone_deserialize(ctx, mWorkerData->clone);
+
+    delete mWorkerData;
+    mWorkerData = NULL;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::SetReceiver
+// -----------------------------------------------------------------------------
+
+void LowWorker::SetReceiver(int callID)
+{
+    if(mReceiverCallID)
+        low_remove_stash(mChildLow->duk_ctx, mReceiverCallID);
+    mReceiverCallID = callID;
+
+    pthread_mutex_lock(&mMutex);
+    if(callID && !mToChild.empty())
+        low_loop_set_callback(mChildLow, mChildPort);
+    pthread_mutex_unlock(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::PortRef
+// -----------------------------------------------------------------------------
+
+void LowWorker::PortRef(bool ref)
+{
+    if(mPortRef == ref)
+        return;
+
+    mPortRef = ref;
+    if(ref)
+        mChildLow->run_ref++;
+    else
+        mChildLow->run_ref--;
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::PostError
+// -----------------------------------------------------------------------------
+
+static duk_ret_t low_worker_serialize_safe(duk_context *ctx, void *udata)
+{
+    duk_push_undefined(ctx);
+    low_clone_serialize(ctx, 0, 1, ((LowWorkerMessage *)udata)->clone);
+    return 0;
+}
+
+void LowWorker::PostError(duk_context *ctx)
+{
+    LowWorkerMessage *msg = new LowWorkerMessage();
+    msg->event = LOWWORKER_EVENT_ERROR;
+
+    duk_dup(ctx, -1);
+    if(duk_safe_call(ctx, low_worker_serialize_safe, msg, 1, 1)
+       != DUK_EXEC_SUCCESS)
+        msg->clone.data.clear();    // the parent creates a generic error
+    duk_pop(ctx);
+
+    Post(false, msg);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::ThreadMain / LowWorker::Run - the worker thread
+// -----------------------------------------------------------------------------
+
+void *LowWorker::ThreadMain(void *arg)
+{
+    ((LowWorker *)arg)->Run();
+    return NULL;
+}
+
+void LowWorker::Run()
+{
+    // Served by the web and data threads of the parent
+    low_t *low = low_init(mParentLow);
+    bool ok = low != NULL;
+
+    if(low)
+    {
+        low->worker = this;
+        low->max_heap_size = mParentLow->max_heap_size;
+
+        pthread_mutex_lock(&mMutex);
+        mChildLow = low;
+        mChildPort = new LowWorkerPort(low, this, false);
+        if(mTerminated)
+            low->duk_flag_stop = 1;
+        pthread_mutex_unlock(&mMutex);
+
+        if(!low->duk_flag_stop)
+        {
+            ok = low_lib_init(low);
+            if(ok && !low->duk_flag_stop)
+            {
+                LowWorkerMessage *msg = new LowWorkerMessage();
+                msg->event = LOWWORKER_EVENT_ONLINE;
+                Post(false, msg);
+
+                ok = low_module_main(low, mPath) && low_loop_run(low);
+            }
+        }
+    }
+    if(!ok)
+        mExitCode = 1;
+
+    pthread_mutex_lock(&mMutex);
+    if(mTerminated)
+        mExitCode = 1;
+
+    LowWorkerPort *port = mChildPort;
+    mChildPort = NULL;
+    mChildLow = NULL;
+    mExited = true;
+
+    // Messages which will never be read
+    while(!mToChild.empty())
+    {
+        delete mToChild.front();
+        mToChild.pop_front();
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    if(low)
+    {
+        // Before low_destroy, which deletes all queued loop callbacks
+        delete port;
+        low_destroy(low);
+    }
+
+    pthread_mutex_lock(&mMutex);
+    low_loop_set_callback(mParentLow, mParentPort);
+    pthread_mutex_unlock(&mMutex);
+}
+
+// -----------------------------------------------------------------------------
+//  LowWorker::Deliver - handles one message in the code thread of the
+//  receiving side
+// -----------------------------------------------------------------------------
+
+static duk_ret_t low_worker_deserialize_safe(duk_context *ctx, void *udata)
+{
+    low_clone_deserialize(ctx, ((LowWorkerMessage *)udata)->clone);
+    return 1;
+}
+
+bool LowWorker::Deliver(bool parent)
+{
+    low_t *low = parent ? mParentLow : mChildLow;
+    duk_context *ctx = low->duk_ctx;
+
+    pthread_mutex_lock(&mMutex);
+
+    deque<LowWorkerMessage *> &queue = parent ? mToParent : mToChild;
+    LowWorkerMessage *msg = NULL;
+    if(!queue.empty() && (parent || mReceiverCallID))
+    {
+        msg = queue.front();
+        queue.pop_front();
+
+        // One at a time, so other events are not held up
+        if(!queue.empty() || (parent && mExited))
+            low_loop_set_callback(low, parent ? mParentPort : mChildPort);
+    }
+    bool exited = parent && !msg && mExited && !mExitReported;
+    pthread_mutex_unlock(&mMutex);
+
+    if(msg)
+    {
+        int event = msg->event;
+        if(msg->clone.data.empty())
+            duk_push_undefined(ctx);
+        else if(duk_safe_call(ctx, low_worker_deserialize_safe, msg, 0, 1)
+                != DUK_EXEC_SUCCESS && event == LOWWORKER_EVENT_MESSAGE)
+            event = LOWWORKER_EVENT_MESSAGEERROR;
+        delete msg;
+
+        low_push_stash(ctx, parent ? mCallID : mReceiverCallID, false);
+        duk_push_int(ctx, event);
+        duk_dup(ctx, -3);
+        duk_call(ctx, 2);
+        duk_pop_2(ctx);
+        return true;
+    }
+
+    if(exited)
+    {
+        pthread_join(mThread, NULL);
+        mThreadRunning = false;
+        mExitReported = true;
+
+        if(mHoldsRef)
+        {
+            mParentLow->run_ref--;
+            mHoldsRef = false;
+        }
+
+        int callID = mCallID;
+        mCallID = 0;
+        low_push_stash(ctx, callID, true);
+        duk_push_int(ctx, LOWWORKER_EVENT_EXIT);
+        duk_push_int(ctx, mExitCode);
+        duk_call(ctx, 2);
+        duk_pop(ctx);
+    }
+
+    return true;
+}
+
+#endif /* LOW_INCLUDE_WORKER_THREADS */
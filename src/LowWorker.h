@@ -0,0 +1,108 @@
+// -----------------------------------------------------------------------------
+//  LowWorker.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWWORKER_H__
+#define __LOWWORKER_H__
+
+#include "LowLoopCallback.h"
+
+#include "low_clone.h"
+#include "low_main.h"
+
+#include <deque>
+#include <pthread.h>
+
+using namespace std;
+
+class LowWorker;
+
+enum
+{
+    LOWWORKER_EVENT_ONLINE,
+    LOWWORKER_EVENT_MESSAGE,
+    LOWWORKER_EVENT_MESSAGEERROR,
+    LOWWORKER_EVENT_ERROR,
+    LOWWORKER_EVENT_EXIT
+};
+
+struct LowWorkerMessage
+{
+    int event;
+    low_clone_t clone;
+};
+
+// Delivers the messages of one side in the loop of that side
+class LowWorkerPort : public LowLoopCallback
+{
+  public:
+    LowWorkerPort(low_t *low, LowWorker *worker, bool parent)
+        : LowLoopCallback(low), mWorker(worker), mParent(parent)
+    {
+        mLoopClearOnReset = false;
+    }
+
+  protected:
+    virtual bool OnLoop();
+
+  private:
+    LowWorker *mWorker;
+    bool mParent;
+};
+
+// A JavaScript thread with its own low_t and Duktape heap. Owned by the
+// parent, which accesses it by index in low->workers. The child reaches it
+// via low->worker
+class LowWorker
+{
+    friend class LowWorkerPort;
+
+  public:
+    LowWorker(low_t *low);
+    ~LowWorker();   // terminates and waits for the thread
+
+    void SetIndex(int index) { mIndex = index; }
+    int ThreadID() { return mThreadID; }
+
+    // All to be called in the parent's code thread
+    bool Start(const char *path, LowWorkerMessage *workerData, int callID);
+    void Terminate();
+    void Ref(bool ref);
+
+    // Called in the code thread of the sender, takes ownership of msg
+    void Post(bool toChild, LowWorkerMessage *msg);
+
+    // Called in the child's code thread
+    void PushWorkerData(duk_context *ctx);
+    void SetReceiver(int callID);
+    void PortRef(bool ref);
+    void SetExitCode(int code) { mExitCode = code; }
+    void PostError(duk_context *ctx);   // for uncaught errors
+
+  private:
+    static void *ThreadMain(void *arg);
+    void Run();
+
+    bool Deliver(bool parent);
+
+  private:
+    low_t *mParentLow, *mChildLow;
+    LowWorkerPort *mParentPort, *mChildPort;
+    int mIndex, mThreadID;
+
+    pthread_t mThread;
+    bool mThreadRunning;
+    pthread_mutex_t mMutex;
+
+    char *mPath;
+    LowWorkerMessage *mWorkerData;
+
+    deque<LowWorkerMessage *> mToParent, mToChild;
+
+    int mCallID, mReceiverCallID;
+    bool mRef, mHoldsRef, mPortRef;
+    bool mTerminated, mExited, mExitReported;
+    int mExitCode;
+};
+
+#endif /* __LOWWORKER_H__ */
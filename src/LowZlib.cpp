@@ -0,0 +1,301 @@
+// -----------------------------------------------------------------------------
+//  LowZlib.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_config.h"
+#if LOW_INCLUDE_ZLIB
+
+#include "LowZlib.h"
+
+#include "low_data_thread.h"
+#include "low_system.h"
+
+#include <errno.h>
+
+
+// -----------------------------------------------------------------------------
+//  LowZlib::LowZlib
+// -----------------------------------------------------------------------------
+
+LowZlib::LowZlib(low_t *low, LowZlibMode mode) :
+    LowDataCallback(low), LowLoopCallback(low), mLow(low), mIndex(-1),
+    mMode(mode), mInit(false), mInID(0), mOutID(0), mCallID(0)
+{
+    memset(&mStream, 0, sizeof(mStream));
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::~LowZlib
+// -----------------------------------------------------------------------------
+
+LowZlib::~LowZlib()
+{
+    low_data_clear_callback(mLow, this);
+    low_loop_clear_callback(mLow, this);
+
+    if(mInit)
+    {
+        if(mMode == LOWZLIB_MODE_DEFLATE || mMode == LOWZLIB_MODE_GZIP
+        || mMode == LOWZLIB_MODE_DEFLATERAW)
+            deflateEnd(&mStream);
+        else
+            inflateEnd(&mStream);
+    }
+
+    if(mInID)
+        low_remove_stash(mLow->duk_ctx, mInID);
+    if(mOutID)
+        low_remove_stash(mLow->duk_ctx, mOutID);
+    if(mCallID)
+    {
+        low_remove_stash(mLow->duk_ctx, mCallID);
+        mLow->run_ref--;
+    }
+
+    if(mIndex >= 0)
+    {
+        if(mIndex >= mLow->zlibStreams.size() ||
+           mLow->zlibStreams[mIndex] != this)
+            printf("assertion error at LowZlib\n");
+
+        mLow->zlibStreams[mIndex] = NULL;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::Init
+// -----------------------------------------------------------------------------
+
+int LowZlib::Init(int level, int windowBits, int memLevel, int strategy)
+{
+    int err;
+
+    switch(mMode)
+    {
+    case LOWZLIB_MODE_DEFLATE:
+    case LOWZLIB_MODE_GZIP:
+    case LOWZLIB_MODE_DEFLATERAW:
+        if(mMode == LOWZLIB_MODE_GZIP)
+            windowBits += 16;
+        else if(mMode == LOWZLIB_MODE_DEFLATERAW)
+            windowBits = -windowBits;
+
+        err = deflateInit2(&mStream, level, Z_DEFLATED, windowBits, memLevel, strategy);
+        break;
+
+    case LOWZLIB_MODE_INFLATE:
+    case LOWZLIB_MODE_GUNZIP:
+    case LOWZLIB_MODE_INFLATERAW:
+    case LOWZLIB_MODE_UNZIP:
+        if(mMode == LOWZLIB_MODE_GUNZIP)
+            windowBits += 16;
+        else if(mMode == LOWZLIB_MODE_UNZIP)
+            windowBits += 32;   // auto detect zlib or gzip header
+        else if(mMode == LOWZLIB_MODE_INFLATERAW)
+            windowBits = -windowBits;
+
+        err = inflateInit2(&mStream, windowBits);
+        break;
+
+    default:
+        err = Z_STREAM_ERROR;
+    }
+
+    mInit = err == Z_OK;
+    return err;
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::Reset
+// -----------------------------------------------------------------------------
+
+int LowZlib::Reset()
+{
+    if(!mInit || mCallID)
+        return Z_STREAM_ERROR;
+
+    if(mMode == LOWZLIB_MODE_DEFLATE || mMode == LOWZLIB_MODE_GZIP
+    || mMode == LOWZLIB_MODE_DEFLATERAW)
+        return deflateReset(&mStream);
+    else
+        return inflateReset(&mStream);
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::Write
+// -----------------------------------------------------------------------------
+
+void LowZlib::Write(int flush,
+                    unsigned char *in, int inLen, int inIndex,
+                    unsigned char *out, int outLen, int outIndex,
+                    int callIndex)
+{
+    if(!mInit || mCallID)
+    {
+        duk_dup(mLow->duk_ctx, callIndex);
+        low_push_error(mLow->duk_ctx, mInit ? EAGAIN : EBADF, "write");
+        low_call_next_tick(mLow->duk_ctx, 1);
+        return;
+    }
+
+    mFlush = flush;
+    mStream.next_in = in;
+    mStream.avail_in = inLen;
+    mStream.next_out = out;
+    mStream.avail_out = outLen;
+
+    // The buffers must stay alive while the data thread works on them
+    mInID = inIndex >= 0 ? low_add_stash(mLow->duk_ctx, inIndex) : 0;
+    mOutID = low_add_stash(mLow->duk_ctx, outIndex);
+    mCallID = low_add_stash(mLow->duk_ctx, callIndex);
+    mLow->run_ref++;
+
+    low_data_set_callback(mLow, this, LOW_DATA_THREAD_PRIORITY_MODIFY);
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::WriteSync
+// -----------------------------------------------------------------------------
+
+int LowZlib::WriteSync(int flush,
+                       unsigned char *in, int inLen,
+                       unsigned char *out, int outLen)
+{
+    if(!mInit || mCallID)
+        return Z_STREAM_ERROR;
+
+    mFlush = flush;
+    mStream.next_in = in;
+    mStream.avail_in = inLen;
+    mStream.next_out = out;
+    mStream.avail_out = outLen;
+
+    return Process();
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::Process
+// -----------------------------------------------------------------------------
+
+int LowZlib::Process()
+{
+    int err;
+
+    if(mMode == LOWZLIB_MODE_DEFLATE || mMode == LOWZLIB_MODE_GZIP
+    || mMode == LOWZLIB_MODE_DEFLATERAW)
+        err = deflate(&mStream, mFlush);
+    else
+    {
+        err = inflate(&mStream, mFlush);
+
+        // Concatenated gzip members, as written by gzip -c a b
+        while((mMode == LOWZLIB_MODE_GUNZIP || mMode == LOWZLIB_MODE_UNZIP)
+           && err == Z_STREAM_END && mStream.avail_in
+           && mStream.next_in[0] == 0x1F)
+        {
+            inflateReset(&mStream);
+            err = inflate(&mStream, mFlush);
+        }
+
+        if(err == Z_BUF_ERROR && mFlush == Z_FINISH && mStream.avail_out)
+            return Z_BUF_ERROR; // input ended before the stream did
+    }
+
+    // No progress possible is not an error while streaming, the caller
+    // sees it from avail_in/avail_out
+    if(err == Z_BUF_ERROR)
+        err = Z_OK;
+    return err;
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::OnData
+// -----------------------------------------------------------------------------
+
+bool LowZlib::OnData()
+{
+    mResult = Process();
+    low_loop_set_callback(mLow, this);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::OnLoop
+// -----------------------------------------------------------------------------
+
+bool LowZlib::OnLoop()
+{
+    if(!mCallID)
+        return true;
+
+    if(mInID)
+        low_remove_stash(mLow->duk_ctx, mInID);
+    low_remove_stash(mLow->duk_ctx, mOutID);
+    mInID = mOutID = 0;
+
+    int callID = mCallID;
+    mCallID = 0;
+    mLow->run_ref--;
+    low_push_stash(mLow->duk_ctx, callID, true);
+
+    if(mResult != Z_OK && mResult != Z_STREAM_END)
+    {
+        PushError(mLow->duk_ctx, mResult, mStream.msg);
+        duk_call(mLow->duk_ctx, 1);
+    }
+    else
+    {
+        duk_push_null(mLow->duk_ctx);
+        duk_push_uint(mLow->duk_ctx, mStream.avail_out);
+        duk_push_uint(mLow->duk_ctx, mStream.avail_in);
+        duk_call(mLow->duk_ctx, 3);
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  LowZlib::PushError
+// -----------------------------------------------------------------------------
+
+void LowZlib::PushError(duk_context *ctx, int err, const char *msg)
+{
+    const char *code;
+    switch(err)
+    {
+    case Z_NEED_DICT:
+        code = "Z_NEED_DICT";
+        if(!msg)
+            msg = "Missing dictionary";
+        break;
+    case Z_STREAM_ERROR:
+        code = "Z_STREAM_ERROR";
+        break;
+    case Z_DATA_ERROR:
+        code = "Z_DATA_ERROR";
+        break;
+    case Z_MEM_ERROR:
+        code = "Z_MEM_ERROR";
+        break;
+    case Z_BUF_ERROR:
+        code = "Z_BUF_ERROR";
+        if(!msg)
+            msg = "unexpected end of file";
+        break;
+    case Z_VERSION_ERROR:
+        code = "Z_VERSION_ERROR";
+        break;
+    default:
+        code = "Z_ERRNO";
+    }
+    if(!msg)
+        msg = "zlib error";
+
+    duk_push_error_object(ctx, DUK_ERR_ERROR, "%s", msg);
+    duk_push_string(ctx, code);
+    duk_put_prop_string(ctx, -2, "code");
+    duk_push_int(ctx, err);
+    duk_put_prop_string(ctx, -2, "errno");
+}
+
+#endif /* LOW_INCLUDE_ZLIB */
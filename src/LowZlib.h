@@ -0,0 +1,76 @@
+// -----------------------------------------------------------------------------
+//  LowZlib.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOWZLIB_H__
+#define __LOWZLIB_H__
+
+#include "LowDataCallback.h"
+#include "LowLoopCallback.h"
+
+#include "low_main.h"
+
+#include <zlib.h>
+
+// Same numbering as Node.JS
+enum LowZlibMode
+{
+    LOWZLIB_MODE_NONE = 0,
+    LOWZLIB_MODE_DEFLATE,
+    LOWZLIB_MODE_INFLATE,
+    LOWZLIB_MODE_GZIP,
+    LOWZLIB_MODE_GUNZIP,
+    LOWZLIB_MODE_DEFLATERAW,
+    LOWZLIB_MODE_INFLATERAW,
+    LOWZLIB_MODE_UNZIP
+};
+
+class LowZlib
+    : public LowDataCallback
+    , public LowLoopCallback
+{
+  public:
+    LowZlib(low_t *low, LowZlibMode mode);
+    virtual ~LowZlib();
+
+    void SetIndex(int index) { mIndex = index; }
+
+    int Init(int level, int windowBits, int memLevel, int strategy);
+    int Reset();
+
+    // Compresses/decompresses in into out. Write runs on a data thread and
+    // calls callback(err, availOutAfter, availInAfter) when done
+    void Write(int flush,
+               unsigned char *in, int inLen, int inIndex,
+               unsigned char *out, int outLen, int outIndex,
+               int callIndex);
+    int WriteSync(int flush,
+                  unsigned char *in, int inLen,
+                  unsigned char *out, int outLen);
+
+    unsigned int AvailIn() { return mStream.avail_in; }
+    unsigned int AvailOut() { return mStream.avail_out; }
+
+    static void PushError(duk_context *ctx, int err, const char *msg);
+    const char *Message() { return mStream.msg; }
+
+  protected:
+    virtual bool OnData();
+    virtual bool OnLoop();
+
+  private:
+    int Process();
+
+  private:
+    low_t *mLow;
+    int mIndex;
+
+    LowZlibMode mMode;
+    z_stream mStream;
+    bool mInit;
+
+    int mFlush, mResult;
+    int mInID, mOutID, mCallID;
+};
+
+#endif /* __LOWZLIB_H__ */
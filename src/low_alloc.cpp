@@ -4,13 +4,17 @@
 
 #include "low_alloc.h"
 
+#include "low_heap.h"
 #include "low_main.h"
+#include "low_slab.h"
 #include "low_system.h"
 
 #include <errno.h>
 
 #include <cstdlib>
 #include <cstring>
+#include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 
@@ -25,6 +29,104 @@ extern "C" bool alloc_use_fund();
 extern void *gRainyDayFund;
 
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
+#if !LOW_ESP32_LWIP_SPECIALITIES
+
+// -----------------------------------------------------------------------------
+//  low_gc_soft_limit / low_gc_hard_limit - heap sizes which trigger GC
+// -----------------------------------------------------------------------------
+
+static inline unsigned int low_gc_soft_limit(low_t *low)
+{
+    if(low->gc_soft_at)
+        return low->gc_soft_at;
+    return (unsigned int)((unsigned long long)low->max_heap_size
+                          * LOW_GC_SOFT_WATERMARK / 100);
+}
+
+static inline unsigned int low_gc_hard_limit(low_t *low)
+{
+    if(low->gc_hard_at)
+        return low->gc_hard_at;
+    return (unsigned int)((unsigned long long)low->max_heap_size
+                          * LOW_GC_HARD_WATERMARK / 100);
+}
+
+// -----------------------------------------------------------------------------
+//  low_gc_run
+// -----------------------------------------------------------------------------
+
+void low_gc_run(low_t *low, int reason)
+{
+    bool in_gc = low->in_gc;
+    long long start = low_micro_count();
+
+    low->in_gc = true;
+    duk_gc(low->duk_ctx, 0);
+    low->in_gc = in_gc;
+
+    long long end = low_micro_count();
+    long long pause = end - start;
+
+    if(reason == LOW_GC_REASON_IDLE)
+    {
+        low->gc_idle_count++;
+        low->gc_idle_pause = pause;
+    }
+    else if(reason == LOW_GC_REASON_FORCED)
+        low->gc_forced_count++;
+    else
+        low->gc_explicit_count++;
+
+    low->gc_total_pause += pause;
+    low->gc_last_pause = pause;
+    if(low->gc_max_pause < pause)
+        low->gc_max_pause = pause;
+    low->gc_last_end = end;
+    low->gc_requested = false;
+
+    // If much is still alive, do not collect again right away when the heap
+    // grows, but only after a part of the remaining room is used up
+    low->gc_soft_at = low->gc_hard_at = 0;
+    unsigned int room = low->heap_size < low->max_heap_size
+                        ? low->max_heap_size - low->heap_size : 0;
+    if(low->heap_size > low_gc_soft_limit(low))
+        low->gc_soft_at = low->heap_size + room / 4;
+    if(low->heap_size > low_gc_hard_limit(low))
+        low->gc_hard_at = low->heap_size + room / 2;
+}
+
+// -----------------------------------------------------------------------------
+//  low_gc_idle
+// -----------------------------------------------------------------------------
+
+bool low_gc_idle(low_t *low, int millisecs)
+{
+    if(!low->gc_requested)
+        return false;
+    if(low->heap_size <= low_gc_soft_limit(low))
+    {
+        // Freed in the meantime
+        low->gc_requested = false;
+        return false;
+    }
+
+    // Duktape cannot collect incrementally, so a full collection must fit
+    // into the time until the next timer is due, judged by the last one
+    if(millisecs >= 0 && low->gc_idle_pause > (long long)millisecs * 1000)
+        return false;
+
+    // Stay within the budget. After a pause of p we wait at least
+    // p * (100 - budget) / budget before collecting again
+    if(low->gc_last_end
+    && low_micro_count() - low->gc_last_end
+       < low->gc_last_pause * (100 - LOW_GC_IDLE_BUDGET) / LOW_GC_IDLE_BUDGET)
+        return false;
+
+    low_gc_run(low, LOW_GC_REASON_IDLE);
+    return true;
+}
+
+#endif /* !LOW_ESP32_LWIP_SPECIALITIES */
 
 
 // -----------------------------------------------------------------------------
@@ -41,36 +143,67 @@ void *low_duk_alloc(void *udata, duk_size_t size)
     low->in_gc = false;
     return ptr;
 #else
+#if LOW_USE_SLAB_ALLOC
+    // Blocks from the slabs have no size header, their size is the one of
+    // the size class
+    int cls = low_slab_class(low->slab, size);
+    size_t real_size = cls >= 0 ? low_slab_class_size(cls) : size + 4;
+#else
+    size_t real_size = size + 4;
+#endif /* LOW_USE_SLAB_ALLOC */
+
     if(size > 0xFFFFFFF0 - low->heap_size)
         return NULL;
 
-    if(!low->in_gc && low->heap_size + size > low->max_heap_size)
+    if(!low->in_gc && low->heap_size + real_size > low_gc_hard_limit(low))
     {
-        low->in_gc = true;
-        duk_gc(low->duk_ctx, 0);
-        low->in_gc = false;
+        low_gc_run(low, LOW_GC_REASON_FORCED);
 
 #ifdef LOWJS_SERV
-        if(low->heap_size + size + 4 > low->max_heap_size)
+        if(low->heap_size + real_size > low->max_heap_size)
         {
             gAllocFailed = true;
             low->duk_flag_stop = 1;
         }
 #else
-        if(low->heap_size + size + 4 > low->max_heap_size)
+        if(low->heap_size + real_size > low->max_heap_size)
         {
             fprintf(stderr, "Reached memory limit of %d MB, aborting. If the device has more memory, configure the low.js memory limit with --max-old-space-size.\n", (int)(low->max_heap_size / (1024 * 1024)));
             _exit(1);
         }
 #endif /* LOWJS_SERV */
     }
+    else if(!low->gc_requested
+         && low->heap_size + real_size > low_gc_soft_limit(low))
+        low->gc_requested = true;   // the event loop collects when idle
+
+#if LOW_USE_SLAB_ALLOC
+    if(cls >= 0)
+    {
+        void *block = low_slab_alloc(low->slab, cls);
+        if(block)
+        {
+            low->heap_size += real_size;
+            low->alloc_count++;
+            if(low->heap_sampler)
+                low_heap_sampler_alloc(low, block, size);
+            return block;
+        }
+
+        // Arena is full, fall back to malloc
+        real_size = size + 4;
+    }
+#endif /* LOW_USE_SLAB_ALLOC */
 
     unsigned int *ptr = (unsigned int *)low_alloc(size + 4);
     if(!ptr)
         return NULL;
 
-    low->heap_size += size + 4;
+    low->heap_size += real_size;
+    low->alloc_count++;
     *ptr = (unsigned int)size;
+    if(low->heap_sampler)
+        low_heap_sampler_alloc(low, ptr + 1, size);
     return (void *)(ptr + 1);
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
 }
@@ -92,18 +225,38 @@ void *low_duk_realloc(void *udata, void *data, duk_size_t size)
 #else
     if(!data)
         return low_duk_alloc(udata, size);
-    
+
+#if LOW_USE_SLAB_ALLOC
+    int old_cls = low_slab_owner(low->slab, data);
+    if(old_cls >= 0)
+    {
+        if(low_slab_class(low->slab, size) == old_cls)
+            return data;
+
+        size_t old_size = low_slab_class_size(old_cls);
+        void *block = low_duk_alloc(udata, size);
+        if(!block)
+            return NULL;
+
+        memcpy(block, data, old_size < size ? old_size : size);
+        low->heap_size -= old_size;
+        low_slab_free(low->slab, data, old_cls);
+        if(low->heap_sampler)
+            low_heap_sampler_free(low, data);
+        return block;
+    }
+#endif /* LOW_USE_SLAB_ALLOC */
+
     unsigned int *ptr = ((unsigned int *)data) - 1;
     size_t old_size = (size_t)*ptr;
 
     if(size > 0xFFFFFFF0 - (low->heap_size - old_size))
         return NULL;
 
-    if(!low->in_gc && low->heap_size - old_size + size > low->max_heap_size)
+    if(!low->in_gc
+    && low->heap_size - old_size + size > low_gc_hard_limit(low))
     {
-        low->in_gc = true;
-        duk_gc(low->duk_ctx, 0);
-        low->in_gc = false;
+        low_gc_run(low, LOW_GC_REASON_FORCED);
 
 #ifdef LOWJS_SERV
         if(low->heap_size - old_size + size > low->max_heap_size)
@@ -119,6 +272,9 @@ void *low_duk_realloc(void *udata, void *data, duk_size_t size)
         }
 #endif /* LOWJS_SERV */
     }
+    else if(!low->gc_requested
+         && low->heap_size - old_size + size > low_gc_soft_limit(low))
+        low->gc_requested = true;
 
     ptr = (unsigned int *)low_realloc(ptr, size + 4);
     if(!ptr)
@@ -126,6 +282,12 @@ void *low_duk_realloc(void *udata, void *data, duk_size_t size)
 
     low->heap_size += size - old_size;
     *ptr = (unsigned int)size;
+    if(low->heap_sampler)
+    {
+        // Counted as a new allocation, the grown block is new memory
+        low_heap_sampler_free(low, data);
+        low_heap_sampler_alloc(low, ptr + 1, size);
+    }
     return (void *)(ptr + 1);
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
 }
@@ -144,13 +306,83 @@ void low_duk_free(void *udata, void *data)
         return;
 
     low_t *low = (low_t *)udata;
+#if LOW_USE_SLAB_ALLOC
+    int cls = low_slab_owner(low->slab, data);
+    if(cls >= 0)
+    {
+        low->heap_size -= low_slab_class_size(cls);
+        low_slab_free(low->slab, data, cls);
+        if(low->heap_sampler)
+            low_heap_sampler_free(low, data);
+        return;
+    }
+#endif /* LOW_USE_SLAB_ALLOC */
+
     unsigned int *ptr = ((unsigned int *)data) - 1;
 
     low->heap_size -= ((size_t)*ptr) + 4;
     low_free(ptr);
+    if(low->heap_sampler)
+        low_heap_sampler_free(low, data);
+#endif /* !LOW_ESP32_LWIP_SPECIALITIES */
+}
+
+
+// -----------------------------------------------------------------------------
+//  low_duk_block_movable
+// -----------------------------------------------------------------------------
+
+bool low_duk_block_movable(low_t *low, void *data)
+{
+#if !LOW_ESP32_LWIP_SPECIALITIES && LOW_USE_SLAB_ALLOC
+    return low_slab_owner(low->slab, data) < 0;
+#else
+    return true;
+#endif /* !LOW_ESP32_LWIP_SPECIALITIES && LOW_USE_SLAB_ALLOC */
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_block_release - the block is not ours anymore
+// -----------------------------------------------------------------------------
+
+void low_duk_block_release(low_t *low, void *data)
+{
+#if !LOW_ESP32_LWIP_SPECIALITIES
+    unsigned int *ptr = ((unsigned int *)data) - 1;
+
+    low->heap_size -= ((size_t)*ptr) + 4;
+    if(low->heap_sampler)
+        low_heap_sampler_free(low, data);
+#endif /* !LOW_ESP32_LWIP_SPECIALITIES */
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_block_adopt - the block is ours now, low_duk_free frees it
+// -----------------------------------------------------------------------------
+
+void low_duk_block_adopt(low_t *low, void *data)
+{
+#if !LOW_ESP32_LWIP_SPECIALITIES
+    unsigned int *ptr = ((unsigned int *)data) - 1;
+
+    low->heap_size += ((size_t)*ptr) + 4;
+    if(!low->gc_requested && low->heap_size > low_gc_soft_limit(low))
+        low->gc_requested = true;
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
 }
 
+// -----------------------------------------------------------------------------
+//  low_duk_block_free
+// -----------------------------------------------------------------------------
+
+void low_duk_block_free(void *data)
+{
+#if LOW_ESP32_LWIP_SPECIALITIES
+    low_free(data);
+#else
+    low_free(((unsigned int *)data) - 1);
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+}
 
 
 // -----------------------------------------------------------------------------
@@ -14,6 +14,29 @@ void *low_duk_alloc(void *udata, duk_size_t size);
 void *low_duk_realloc(void *udata, void *ptr, duk_size_t size);
 void low_duk_free(void *udata, void *ptr);
 
+// Move a block allocated by low_duk_alloc from one heap to another, for
+// buffers transferred to a worker thread. Blocks from the slabs cannot move
+struct low_t;
+bool low_duk_block_movable(struct low_t *low, void *ptr);
+void low_duk_block_release(struct low_t *low, void *ptr);
+void low_duk_block_adopt(struct low_t *low, void *ptr);
+void low_duk_block_free(void *ptr);     // a released block nobody adopted
+
+#if !LOW_ESP32_LWIP_SPECIALITIES
+enum
+{
+    LOW_GC_REASON_IDLE,
+    LOW_GC_REASON_FORCED,
+    LOW_GC_REASON_EXPLICIT
+};
+
+// Runs the garbage collector and updates the statistics in low_t
+void low_gc_run(struct low_t *low, int reason);
+// Called by the event loop before waiting millisecs (-1 = forever) for
+// events. Returns true if garbage was collected
+bool low_gc_idle(struct low_t *low, int millisecs);
+#endif /* !LOW_ESP32_LWIP_SPECIALITIES */
+
 #if LOW_USE_SYSTEM_ALLOC
 #include <cstdlib>
 
@@ -0,0 +1,509 @@
+// -----------------------------------------------------------------------------
+//  low_buffer.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_buffer.h"
+#include "low_codec.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define LOWBUFFER_NEON
+#include <arm_neon.h>
+#endif /* __SSE2__ */
+
+enum
+{
+    LOWBUFFER_UTF8,
+    LOWBUFFER_HEX,
+    LOWBUFFER_BASE64,
+    LOWBUFFER_BASE64URL,
+    LOWBUFFER_LATIN1,
+    LOWBUFFER_ASCII,
+    LOWBUFFER_UTF16LE
+};
+
+// Strings up to this size are converted on the C stack, not in a buffer
+// the garbage collector has to take care of
+#define LOWBUFFER_STACK_SIZE 1024
+
+
+// -----------------------------------------------------------------------------
+//  low_buffer_encoding - the encoding at index, as normalized by buffer.js
+// -----------------------------------------------------------------------------
+
+static int low_buffer_encoding(duk_context *ctx, duk_idx_t index)
+{
+    if(duk_is_undefined(ctx, index))
+        return LOWBUFFER_UTF8;
+
+    const char *name = duk_require_string(ctx, index);
+    if(strcmp(name, "utf8") == 0)
+        return LOWBUFFER_UTF8;
+    if(strcmp(name, "hex") == 0)
+        return LOWBUFFER_HEX;
+    if(strcmp(name, "base64") == 0)
+        return LOWBUFFER_BASE64;
+    if(strcmp(name, "base64url") == 0)
+        return LOWBUFFER_BASE64URL;
+    if(strcmp(name, "latin1") == 0)
+        return LOWBUFFER_LATIN1;
+    if(strcmp(name, "ascii") == 0)
+        return LOWBUFFER_ASCII;
+    if(strcmp(name, "utf16le") == 0)
+        return LOWBUFFER_UTF16LE;
+
+    duk_type_error(ctx, "Unknown encoding: %s", name);
+    return -1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_decode_bound - space low_buffer_decode needs at most
+// -----------------------------------------------------------------------------
+
+static size_t low_buffer_decode_bound(int encoding, size_t len)
+{
+    switch(encoding)
+    {
+    case LOWBUFFER_HEX:
+        return len / 2;
+    case LOWBUFFER_BASE64:
+    case LOWBUFFER_BASE64URL:
+        return len * 3 / 4 + 3;
+    case LOWBUFFER_UTF16LE:
+        return len * 2;
+    default:
+        return len;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_decode - Duktape string to bytes
+// -----------------------------------------------------------------------------
+
+static size_t low_buffer_decode(int encoding, const unsigned char *src,
+                                size_t len, unsigned char *dst)
+{
+    switch(encoding)
+    {
+    case LOWBUFFER_HEX:
+        return low_hex_decode((const char *)src, len, dst);
+    case LOWBUFFER_BASE64:
+    case LOWBUFFER_BASE64URL:
+        return low_base64_decode((const char *)src, len, dst);
+    case LOWBUFFER_LATIN1:
+    case LOWBUFFER_ASCII:
+        return low_internal_to_latin1(src, len, dst);
+    case LOWBUFFER_UTF16LE:
+        return low_internal_to_utf16le(src, len, dst);
+    default:
+        return low_internal_to_utf8(src, len, dst);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_to_string - (buffer, encoding, start, end)
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_buffer_to_string(duk_context *ctx)
+{
+    duk_size_t len;
+    const unsigned char *data =
+      (const unsigned char *)duk_require_buffer_data(ctx, 0, &len);
+    int encoding = low_buffer_encoding(ctx, 1);
+
+    duk_int_t start = duk_get_int_default(ctx, 2, 0);
+    duk_int_t end = duk_get_int_default(ctx, 3, len);
+    if(start < 0)
+        start = 0;
+    if(end > (duk_int_t)len)
+        end = len;
+    if(end <= start)
+    {
+        duk_push_string(ctx, "");
+        return 1;
+    }
+    data += start;
+    len = end - start;
+
+    // Valid text needs no conversion
+    if((encoding == LOWBUFFER_UTF8 && low_utf8_is_internal(data, len))
+       || ((encoding == LOWBUFFER_LATIN1 || encoding == LOWBUFFER_ASCII)
+           && low_ascii_prefix(data, len) == len))
+    {
+        duk_push_lstring(ctx, (const char *)data, len);
+        return 1;
+    }
+
+    size_t bound;
+    switch(encoding)
+    {
+    case LOWBUFFER_HEX:
+        bound = len * 2;
+        break;
+    case LOWBUFFER_BASE64:
+    case LOWBUFFER_BASE64URL:
+        bound = (len + 2) / 3 * 4;
+        break;
+    case LOWBUFFER_LATIN1:
+    case LOWBUFFER_ASCII:
+        bound = len * 2;
+        break;
+    case LOWBUFFER_UTF16LE:
+        bound = len / 2 * 3;
+        break;
+    default:
+        bound = len * 3;
+    }
+
+    unsigned char stackBuf[LOWBUFFER_STACK_SIZE];
+    unsigned char *buf = stackBuf;
+    if(bound > sizeof(stackBuf))
+        buf = (unsigned char *)duk_push_buffer_raw(ctx, bound, DUK_BUF_FLAG_NOZERO);
+
+    size_t size;
+    switch(encoding)
+    {
+    case LOWBUFFER_HEX:
+        size = low_hex_encode(data, len, (char *)buf);
+        break;
+    case LOWBUFFER_BASE64:
+    case LOWBUFFER_BASE64URL:
+        size = low_base64_encode(data, len, (char *)buf,
+                                 encoding == LOWBUFFER_BASE64URL);
+        break;
+    case LOWBUFFER_LATIN1:
+    case LOWBUFFER_ASCII:
+        size = low_latin1_to_internal(data, len, buf,
+                                      encoding == LOWBUFFER_ASCII);
+        break;
+    case LOWBUFFER_UTF16LE:
+        size = low_utf16le_to_internal(data, len, buf);
+        break;
+    default:
+        size = low_utf8_to_internal(data, len, buf);
+    }
+
+    duk_push_lstring(ctx, (const char *)buf, size);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_from_string - (string, encoding), returns a new Buffer
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_buffer_from_string(duk_context *ctx)
+{
+    duk_size_t len;
+    const unsigned char *str =
+      (const unsigned char *)duk_require_lstring(ctx, 0, &len);
+    int encoding = low_buffer_encoding(ctx, 1);
+
+    size_t bound = low_buffer_decode_bound(encoding, len);
+    unsigned char *buf = (unsigned char *)duk_push_buffer_raw(
+      ctx, bound, DUK_BUF_FLAG_DYNAMIC | DUK_BUF_FLAG_NOZERO);
+
+    size_t size = low_buffer_decode(encoding, str, len, buf);
+    if(size != bound)
+        duk_resize_buffer(ctx, -1, size);
+
+    duk_push_buffer_object(ctx, -1, 0, size, DUK_BUFOBJ_NODEJS_BUFFER);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_write - (buffer, string, offset, length, encoding), returns
+//  the number of bytes written. Never writes a partial character
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_buffer_write(duk_context *ctx)
+{
+    duk_size_t bufLen;
+    unsigned char *data =
+      (unsigned char *)duk_require_buffer_data(ctx, 0, &bufLen);
+    duk_size_t len;
+    const unsigned char *str =
+      (const unsigned char *)duk_require_lstring(ctx, 1, &len);
+    duk_size_t offset = duk_get_uint_default(ctx, 2, 0);
+    if(offset > bufLen)
+        duk_range_error(ctx, "offset out of range");
+    duk_size_t length = duk_get_uint_default(ctx, 3, bufLen - offset);
+    if(length > bufLen - offset)
+        length = bufLen - offset;
+    int encoding = low_buffer_encoding(ctx, 4);
+
+    size_t bound = low_buffer_decode_bound(encoding, len);
+    if(bound <= length)
+    {
+        duk_push_uint(ctx, low_buffer_decode(encoding, str, len, data + offset));
+        return 1;
+    }
+
+    unsigned char stackBuf[LOWBUFFER_STACK_SIZE];
+    unsigned char *buf = stackBuf;
+    if(bound > sizeof(stackBuf))
+        buf = (unsigned char *)duk_push_buffer_raw(ctx, bound, DUK_BUF_FLAG_NOZERO);
+
+    size_t size = low_buffer_decode(encoding, str, len, buf);
+    if(size > length)
+    {
+        size = length;
+        if(encoding == LOWBUFFER_UTF8)
+            while(size && (buf[size] & 0xC0) == 0x80)
+                size--;
+        else if(encoding == LOWBUFFER_UTF16LE)
+            size &= ~(size_t)1;
+    }
+    memcpy(data + offset, buf, size);
+
+    duk_push_uint(ctx, size);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_byte_length - (string, encoding)
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_buffer_byte_length(duk_context *ctx)
+{
+    duk_size_t len;
+    const unsigned char *str =
+      (const unsigned char *)duk_require_lstring(ctx, 0, &len);
+    int encoding = low_buffer_encoding(ctx, 1);
+
+    switch(encoding)
+    {
+    case LOWBUFFER_HEX:
+        duk_push_uint(ctx, duk_get_length(ctx, 0) / 2);
+        break;
+    case LOWBUFFER_BASE64:
+    case LOWBUFFER_BASE64URL:
+        duk_push_uint(ctx, low_base64_decoded_len((const char *)str, len));
+        break;
+    case LOWBUFFER_LATIN1:
+    case LOWBUFFER_ASCII:
+        duk_push_uint(ctx, duk_get_length(ctx, 0));
+        break;
+    case LOWBUFFER_UTF16LE:
+        duk_push_uint(ctx, duk_get_length(ctx, 0) * 2);
+        break;
+    default:
+        duk_push_uint(ctx, low_internal_utf8_len(str, len));
+    }
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_find - first occurrence of needle, needleLen >= 1. Filters
+//  the candidates by the first and last byte of the needle, 16 positions at
+//  a time (W. Mula, "SIMD-friendly algorithms for substring searching").
+//  If that goes wrong too often, as with "aaaa...", memmem takes over,
+//  which is Two-Way and linear with glibc. For long needles, the skip
+//  table of glibc's memmem is faster than the filter
+// -----------------------------------------------------------------------------
+
+static const unsigned char *low_buffer_find(const unsigned char *hay,
+                                            size_t hayLen,
+                                            const unsigned char *needle,
+                                            size_t needleLen)
+{
+    if(needleLen > hayLen)
+        return NULL;
+    if(needleLen == 1)
+        return (const unsigned char *)memchr(hay, needle[0], hayLen);
+#ifdef __GLIBC__
+    if(needleLen >= 16)
+        return (const unsigned char *)memmem(hay, hayLen, needle, needleLen);
+#endif /* __GLIBC__ */
+
+    // Possible start positions are [0, end)
+    size_t end = hayLen - needleLen + 1;
+    size_t i = 0, misses = 0;
+
+#if defined(__SSE2__) || defined(LOWBUFFER_NEON)
+#if defined(__SSE2__)
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needleLen - 1]);
+#else
+    const uint8x16_t first = vdupq_n_u8(needle[0]);
+    const uint8x16_t last = vdupq_n_u8(needle[needleLen - 1]);
+#endif /* __SSE2__ */
+
+    for(; i + 16 <= end; i += 16)
+    {
+#if defined(__SSE2__)
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + needleLen - 1));
+        unsigned int mask = _mm_movemask_epi8(
+          _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        const int shift = 0;
+#else
+        uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(hay + i), first),
+                                 vceqq_u8(vld1q_u8(hay + i + needleLen - 1), last));
+        // 4 bits per position
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+          vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        const int shift = 2;
+#endif /* __SSE2__ */
+
+        while(mask)
+        {
+            size_t pos = i + (__builtin_ctzll(mask) >> shift);
+            if(memcmp(hay + pos + 1, needle + 1, needleLen - 2) == 0)
+                return hay + pos;
+
+#if defined(__SSE2__)
+            mask &= mask - 1;
+#else
+            mask &= ~(0xFULL << (__builtin_ctzll(mask) & ~3));
+#endif /* __SSE2__ */
+            if(++misses > 64 + i / 8)
+                goto fallback;
+        }
+    }
+#endif /* __SSE2__ || LOWBUFFER_NEON */
+
+    for(; i < end; i++)
+    {
+        const unsigned char *pos =
+          (const unsigned char *)memchr(hay + i, needle[0], end - i);
+        if(!pos)
+            return NULL;
+        i = pos - hay;
+        if(hay[i + needleLen - 1] == needle[needleLen - 1]
+           && memcmp(hay + i + 1, needle + 1, needleLen - 2) == 0)
+            return pos;
+        if(++misses > 64 + i / 8)
+            goto fallback;
+    }
+    return NULL;
+
+fallback:
+    return (const unsigned char *)memmem(hay + i, hayLen - i, needle, needleLen);
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_find_last - last occurrence of needle which starts at or before
+//  start, needleLen >= 1
+// -----------------------------------------------------------------------------
+
+static const unsigned char *low_buffer_find_last(const unsigned char *hay,
+                                                 size_t start,
+                                                 const unsigned char *needle,
+                                                 size_t needleLen)
+{
+    size_t len = start + 1;
+    while(len)
+    {
+#ifdef __GLIBC__
+        const unsigned char *pos =
+          (const unsigned char *)memrchr(hay, needle[0], len);
+        if(!pos)
+            return NULL;
+#else
+        const unsigned char *pos = hay + len - 1;
+        while(*pos != needle[0])
+        {
+            if(pos == hay)
+                return NULL;
+            pos--;
+        }
+#endif /* __GLIBC__ */
+
+        if(memcmp(pos + 1, needle + 1, needleLen - 1) == 0)
+            return pos;
+        len = pos - hay;
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+//  low_buffer_index_of - (buffer, value, byteOffset, encoding, last)
+//  value may be a string, a byte or a Buffer/Uint8Array. byteOffset is a
+//  number, negative counts from the end
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_buffer_index_of(duk_context *ctx)
+{
+    duk_size_t len;
+    const unsigned char *data =
+      (const unsigned char *)duk_require_buffer_data(ctx, 0, &len);
+    bool last = duk_get_boolean_default(ctx, 4, false);
+
+    unsigned char stackBuf[LOWBUFFER_STACK_SIZE];
+    const unsigned char *needle;
+    duk_size_t needleLen;
+    if(duk_is_number(ctx, 1))
+    {
+        stackBuf[0] = (unsigned char)duk_get_int(ctx, 1);
+        needle = stackBuf;
+        needleLen = 1;
+    }
+    else if(duk_is_string(ctx, 1))
+    {
+        int encoding = low_buffer_encoding(ctx, 3);
+        const unsigned char *str =
+          (const unsigned char *)duk_get_lstring(ctx, 1, &needleLen);
+
+        size_t bound = low_buffer_decode_bound(encoding, needleLen);
+        unsigned char *buf = stackBuf;
+        if(bound > sizeof(stackBuf))
+            buf = (unsigned char *)duk_push_buffer_raw(ctx, bound, DUK_BUF_FLAG_NOZERO);
+        needleLen = low_buffer_decode(encoding, str, needleLen, buf);
+        needle = buf;
+    }
+    else if(duk_is_buffer_data(ctx, 1))
+        needle = (const unsigned char *)duk_get_buffer_data(ctx, 1, &needleLen);
+    else
+        return duk_type_error(ctx, "value must be a string, number, Buffer or Uint8Array");
+
+    double offset = duk_get_number_default(ctx, 2, last ? len : 0);
+    if(offset != offset)    // NaN
+        offset = last ? len : 0;
+    if(offset < 0)
+        offset += len;
+
+    const unsigned char *pos;
+    if(!last)
+    {
+        if(offset < 0)
+            offset = 0;
+        if(needleLen == 0)
+        {
+            duk_push_number(ctx, offset < len ? offset : len);
+            return 1;
+        }
+        if(offset >= len)
+        {
+            duk_push_int(ctx, -1);
+            return 1;
+        }
+
+        size_t start = (size_t)offset;
+        pos = low_buffer_find(data + start, len - start, needle, needleLen);
+    }
+    else
+    {
+        if(offset < 0 || needleLen > len)
+        {
+            duk_push_int(ctx, -1);
+            return 1;
+        }
+        if(needleLen == 0)
+        {
+            duk_push_number(ctx, offset < len ? offset : len);
+            return 1;
+        }
+
+        size_t start = offset > len - needleLen ? len - needleLen : (size_t)offset;
+        pos = low_buffer_find_last(data, start, needle, needleLen);
+    }
+
+    if(pos)
+        duk_push_uint(ctx, pos - data);
+    else
+        duk_push_int(ctx, -1);
+    return 1;
+}
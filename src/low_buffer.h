@@ -0,0 +1,16 @@
+// -----------------------------------------------------------------------------
+//  low_buffer.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_BUFFER_H__
+#define __LOW_BUFFER_H__
+
+#include "duktape.h"
+
+duk_ret_t low_buffer_to_string(duk_context *ctx);
+duk_ret_t low_buffer_from_string(duk_context *ctx);
+duk_ret_t low_buffer_write(duk_context *ctx);
+duk_ret_t low_buffer_byte_length(duk_context *ctx);
+duk_ret_t low_buffer_index_of(duk_context *ctx);
+
+#endif /* __LOW_BUFFER_H__ */
@@ -0,0 +1,455 @@
+// -----------------------------------------------------------------------------
+//  low_child_process.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_config.h"
+#if LOW_INCLUDE_CHILD_PROCESS
+
+#include "low_child_process.h"
+#include "LowChildProcess.h"
+#include "LowSocket.h"
+
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern low_system_t g_low_system;
+
+
+// -----------------------------------------------------------------------------
+//  low_child_process_get - returns the child process at index of argument 0
+// -----------------------------------------------------------------------------
+
+static LowChildProcess *low_child_process_get(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int index = duk_require_int(ctx, 0);
+    if(index < 0 || index >= low->childProcesses.size() ||
+       !low->childProcesses[index])
+        duk_reference_error(ctx, "child process not found");
+
+    return low->childProcesses[index];
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_signal - signal number or name at index
+// -----------------------------------------------------------------------------
+
+static int low_child_process_signal(duk_context *ctx, int index)
+{
+    if(duk_is_number(ctx, index))
+        return duk_get_int(ctx, index);
+
+    int signal = low_signal_number(duk_require_string(ctx, index));
+    if(!signal)
+        duk_type_error(ctx, "unknown signal: %s", duk_get_string(ctx, index));
+    return signal;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_strings - pushes the strings of the array at index,
+//  pointers stay valid while they are on the stack
+// -----------------------------------------------------------------------------
+
+static void low_child_process_strings(duk_context *ctx, int index,
+                                      const char **strings, int len)
+{
+    duk_require_stack(ctx, len);
+    for(int i = 0; i < len; i++)
+    {
+        duk_get_prop_index(ctx, index, i);
+        strings[i] = duk_require_string(ctx, -1);
+    }
+    strings[len] = NULL;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_spawn
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_child_process_spawn(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    // SIGCHLD only reaches the loop of the main thread
+    if(low->threads != low ||
+       g_low_system.signal_pipe_fd != low->web_thread_pipe[1])
+        duk_generic_error(ctx, "child processes can only be spawned by the main thread");
+
+    const char *file = duk_require_string(ctx, 1);
+    const char *cwd = duk_is_string(ctx, 4) ? duk_get_string(ctx, 4) : NULL;
+    duk_require_function(ctx, 6);
+    int flags = duk_get_boolean_default(ctx, 7, false)
+                  ? LOWCHILDPROCESS_FLAG_DETACHED : 0;
+
+    int argc = duk_get_length(ctx, 2);
+    int envc = duk_get_length(ctx, 3);
+    int numStdio = duk_get_length(ctx, 5);
+
+    const char *argv[argc + 1], *envp[envc + 1];
+    int stdio[numStdio];
+
+    low_child_process_strings(ctx, 2, argv, argc);
+    low_child_process_strings(ctx, 3, envp, envc);
+    for(int i = 0; i < numStdio; i++)
+    {
+        duk_get_prop_index(ctx, 5, i);
+        stdio[i] = duk_require_int(ctx, -1);
+        duk_pop(ctx);
+    }
+
+    LowChildProcess *child = new(ctx) LowChildProcess(low);
+
+    int index;
+    for(index = 0; index < low->childProcesses.size(); index++)
+        if(!low->childProcesses[index])
+        {
+            low->childProcesses[index] = child;
+            break;
+        }
+    if(index == low->childProcesses.size())
+        low->childProcesses.push_back(child);
+    child->SetIndex(index);
+
+    int err;
+    const char *syscall;
+    if(!child->Spawn(file, (char *const *)argv, (char *const *)envp, cwd,
+                     flags, stdio, numStdio, low_add_stash(ctx, 6), err,
+                     syscall))
+    {
+        delete child;
+
+        low_push_error(ctx, err, syscall);
+        duk_throw(ctx);
+    }
+
+    duk_push_int(ctx, child->PID());
+    duk_put_prop_string(ctx, 0, "pid");
+    for(int i = 0; i < numStdio; i++)
+    {
+        duk_push_int(ctx, stdio[i]);
+        duk_put_prop_index(ctx, 5, i);
+    }
+
+    duk_push_int(ctx, index);
+    duk_push_c_function(ctx, low_child_process_finalizer, 1);
+    duk_set_finalizer(ctx, 0);
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_spawn_sync - runs the child to its end in the code
+//  thread, returns { pid, status, signal, output, error }
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_child_process_spawn_sync(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    const char *file = duk_require_string(ctx, 0);
+    const char *cwd = duk_is_string(ctx, 3) ? duk_get_string(ctx, 3) : NULL;
+
+    duk_size_t inputLen = 0;
+    const unsigned char *input = NULL;
+    if(duk_is_buffer_data(ctx, 5))
+        input = (const unsigned char *)duk_get_buffer_data(ctx, 5, &inputLen);
+    int timeout = duk_get_int_default(ctx, 6, 0);
+    duk_size_t maxBuffer = duk_get_uint_default(ctx, 7, 0);
+    int killSignal = duk_is_undefined(ctx, 8)
+                       ? SIGTERM : low_child_process_signal(ctx, 8);
+    int flags = LOWCHILDPROCESS_FLAG_SYNC;
+    if(duk_get_boolean_default(ctx, 9, false))
+        flags |= LOWCHILDPROCESS_FLAG_DETACHED;
+
+    int argc = duk_get_length(ctx, 1);
+    int envc = duk_get_length(ctx, 2);
+    int numStdio = duk_get_length(ctx, 4);
+
+    const char *argv[argc + 1], *envp[envc + 1];
+    int stdio[numStdio];
+
+    low_child_process_strings(ctx, 1, argv, argc);
+    low_child_process_strings(ctx, 2, envp, envc);
+    for(int i = 0; i < numStdio; i++)
+    {
+        duk_get_prop_index(ctx, 4, i);
+        stdio[i] = duk_require_int(ctx, -1);
+        duk_pop(ctx);
+    }
+
+    // Output of the pipes goes into dynamic buffers, so we never hold
+    // memory the garbage collector does not know about
+    int outIndex = duk_get_top(ctx);
+    duk_size_t outLen[numStdio], outSize[numStdio];
+    duk_require_stack(ctx, numStdio + 8);
+    for(int i = 0; i < numStdio; i++)
+    {
+        outLen[i] = outSize[i] = 0;
+        if(i > 0 && stdio[i] == LOWCHILDPROCESS_STDIO_PIPE)
+            duk_push_dynamic_buffer(ctx, 0);
+        else
+            duk_push_undefined(ctx);
+    }
+
+    LowChildProcess child(low);
+    child.Ref(false);
+
+    int err;
+    const char *syscall;
+    if(!child.Spawn(file, (char *const *)argv, (char *const *)envp, cwd, flags,
+                    stdio, numStdio, 0, err, syscall))
+    {
+        low_push_error(ctx, err, syscall);
+        duk_throw(ctx);
+    }
+
+    int open = 0;
+    for(int i = 0; i < numStdio; i++)
+        if(stdio[i] >= 0)
+        {
+            fcntl(stdio[i], F_SETFL, fcntl(stdio[i], F_GETFL) | O_NONBLOCK);
+            open++;
+        }
+    if(stdio[0] >= 0 && !inputLen)
+    {
+        close(stdio[0]);
+        stdio[0] = -1;
+        open--;
+    }
+
+    struct pollfd fds[numStdio];
+    int fdIndex[numStdio];
+    duk_size_t inputPos = 0;
+    int error = 0, start = low_tick_count();
+    bool killed = false;
+
+    while(open)
+    {
+        int count = 0;
+        for(int i = 0; i < numStdio; i++)
+            if(stdio[i] >= 0)
+            {
+                fds[count].fd = stdio[i];
+                fds[count].events = i == 0 ? POLLOUT : POLLIN;
+                fds[count].revents = 0;
+                fdIndex[count++] = i;
+            }
+
+        int wait = -1;
+        if(timeout > 0 && !killed)
+        {
+            wait = timeout - (low_tick_count() - start);
+            if(wait <= 0)
+            {
+                // Keep reading what the child writes while it goes down
+                error = ETIMEDOUT;
+                child.Kill(killSignal, err);
+                killed = true;
+                wait = -1;
+            }
+        }
+
+        int res = poll(fds, count, wait);
+        if(res < 0 && errno != EINTR)
+        {
+            error = errno;
+            break;
+        }
+
+        for(int j = 0; j < count && res > 0; j++)
+        {
+            if(!fds[j].revents)
+                continue;
+
+            int i = fdIndex[j];
+            bool done;
+            if(i == 0)
+            {
+                int len = send(stdio[0], input + inputPos, inputLen - inputPos,
+#ifdef MSG_NOSIGNAL
+                               MSG_NOSIGNAL);
+#else
+                               0);
+#endif /* MSG_NOSIGNAL */
+                if(len > 0)
+                    inputPos += len;
+                done = inputPos == inputLen ||
+                       (len < 0 && errno != EAGAIN && errno != EINTR);
+            }
+            else if(!duk_is_undefined(ctx, outIndex + i))
+            {
+                if(outSize[i] - outLen[i] < 16384)
+                {
+                    outSize[i] = outSize[i] ? outSize[i] * 2 : 65536;
+                    duk_resize_buffer(ctx, outIndex + i, outSize[i]);
+                }
+                unsigned char *buf = (unsigned char *)duk_get_buffer_data(
+                  ctx, outIndex + i, NULL);
+
+                int len = read(stdio[i], buf + outLen[i], outSize[i] - outLen[i]);
+                if(len > 0)
+                    outLen[i] += len;
+                done = len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR);
+
+                if(maxBuffer && outLen[i] > maxBuffer && !error)
+                {
+                    outLen[i] = maxBuffer;
+                    error = ENOBUFS;
+                    child.Kill(killSignal, err);
+                    killed = true;
+                }
+            }
+            else
+            {
+                // An fd >= 3 which is neither, just wait for it to close
+                char buf[1024];
+                int len = read(stdio[i], buf, sizeof(buf));
+                done = len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR);
+            }
+
+            if(done)
+            {
+                close(stdio[i]);
+                stdio[i] = -1;
+                open--;
+            }
+        }
+    }
+    for(int i = 0; i < numStdio; i++)
+        if(stdio[i] >= 0)
+            close(stdio[i]);
+
+    int status;
+    bool exited = child.Wait(status);
+
+    duk_push_object(ctx);
+    duk_push_int(ctx, child.PID());
+    duk_put_prop_string(ctx, -2, "pid");
+
+    if(exited && WIFEXITED(status))
+        duk_push_int(ctx, WEXITSTATUS(status));
+    else
+        duk_push_null(ctx);
+    duk_put_prop_string(ctx, -2, "status");
+    if(exited && WIFSIGNALED(status) && low_signal_name(WTERMSIG(status)))
+        duk_push_string(ctx, low_signal_name(WTERMSIG(status)));
+    else if(exited && WIFSIGNALED(status))
+        duk_push_int(ctx, WTERMSIG(status));
+    else
+        duk_push_null(ctx);
+    duk_put_prop_string(ctx, -2, "signal");
+
+    duk_push_array(ctx);
+    for(int i = 0; i < numStdio; i++)
+    {
+        if(duk_is_undefined(ctx, outIndex + i))
+            duk_push_null(ctx);
+        else
+            duk_push_buffer_object(ctx, outIndex + i, 0, outLen[i],
+                                   DUK_BUFOBJ_NODEJS_BUFFER);
+        duk_put_prop_index(ctx, -2, i);
+    }
+    duk_put_prop_string(ctx, -2, "output");
+
+    if(error)
+    {
+        low_push_error(ctx, error, "spawnSync");
+        duk_put_prop_string(ctx, -2, "error");
+    }
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_finalizer
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_child_process_finalizer(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_get_prop_string(ctx, 0, "_native");
+    int index = duk_get_int_default(ctx, -1, -1);
+
+    if(index < 0)
+        return 0;
+    if(index >= low->childProcesses.size())
+        duk_reference_error(ctx, "child process not found");
+
+    delete low->childProcesses[index];
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_kill
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_child_process_kill(duk_context *ctx)
+{
+    LowChildProcess *child = low_child_process_get(ctx);
+    int signal = low_child_process_signal(ctx, 1);
+
+    int err;
+    if(!child->Kill(signal, err))
+    {
+        low_push_error(ctx, err, "kill");
+        duk_throw(ctx);
+    }
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_ref
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_child_process_ref(duk_context *ctx)
+{
+    low_child_process_get(ctx)->Ref(duk_require_boolean(ctx, 1));
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_channel
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_child_process_channel(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int fd = duk_require_int(ctx, 0);
+    if(low->fds.find(fd) != low->fds.end())
+        duk_reference_error(ctx, "file descriptor already in use");
+
+    // Not for our own children
+    if(fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+    {
+        low_push_error(ctx, errno, "fcntl");
+        duk_throw(ctx);
+    }
+
+    new LowSocket(low, fd, LOWSOCKET_TYPE_PIPE);
+    duk_push_int(ctx, fd);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_child_process_reap
+// -----------------------------------------------------------------------------
+
+void low_child_process_reap(low_t *low)
+{
+    for(int i = 0; i < low->childProcesses.size(); i++)
+        if(low->childProcesses[i])
+            low->childProcesses[i]->Reap();
+}
+
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
@@ -0,0 +1,24 @@
+// -----------------------------------------------------------------------------
+//  low_child_process.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_CHILD_PROCESS_H__
+#define __LOW_CHILD_PROCESS_H__
+
+#include "duktape.h"
+
+struct low_t;
+
+duk_ret_t low_child_process_spawn(duk_context *ctx);
+duk_ret_t low_child_process_spawn_sync(duk_context *ctx);
+duk_ret_t low_child_process_finalizer(duk_context *ctx);
+duk_ret_t low_child_process_kill(duk_context *ctx);
+duk_ret_t low_child_process_ref(duk_context *ctx);
+
+// In the child: the IPC channel inherited from the parent
+duk_ret_t low_child_process_channel(duk_context *ctx);
+
+// Called on SIGCHLD
+void low_child_process_reap(low_t *low);
+
+#endif /* __LOW_CHILD_PROCESS_H__ */
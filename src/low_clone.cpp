@@ -0,0 +1,674 @@
+// -----------------------------------------------------------------------------
+//  low_clone.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_clone.h"
+
+#include "low_duktape.h"
+#include "low_main.h"
+
+#include <cstring>
+#include <map>
+
+// Deeper nesting is most probably an error and would exhaust the C stack
+#define LOW_CLONE_MAX_DEPTH     1000
+
+enum
+{
+    LOW_CLONE_UNDEFINED = 'u',
+    LOW_CLONE_NULL = 'n',
+    LOW_CLONE_TRUE = 't',
+    LOW_CLONE_FALSE = 'f',
+    LOW_CLONE_NUMBER = 'd',
+    LOW_CLONE_STRING = 's',
+    LOW_CLONE_DATE = 'D',
+    LOW_CLONE_REGEXP = 'R',
+    LOW_CLONE_ERROR = 'E',
+    LOW_CLONE_ARRAY = 'a',
+    LOW_CLONE_OBJECT = 'o',
+    LOW_CLONE_BUFFER = 'B',
+    LOW_CLONE_TRANSFER = 'T',
+    LOW_CLONE_REFERENCE = 'r'
+};
+
+// Buffer is a subclass of Uint8Array, so it must come first
+static const struct
+{
+    const char *name;
+    int type;
+} g_low_clone_buffer_kinds[] = {
+    {"Buffer", DUK_BUFOBJ_NODEJS_BUFFER},
+    {"ArrayBuffer", DUK_BUFOBJ_ARRAYBUFFER},
+    {"DataView", DUK_BUFOBJ_DATAVIEW},
+    {"Int8Array", DUK_BUFOBJ_INT8ARRAY},
+    {"Uint8Array", DUK_BUFOBJ_UINT8ARRAY},
+    {"Uint8ClampedArray", DUK_BUFOBJ_UINT8CLAMPEDARRAY},
+    {"Int16Array", DUK_BUFOBJ_INT16ARRAY},
+    {"Uint16Array", DUK_BUFOBJ_UINT16ARRAY},
+    {"Int32Array", DUK_BUFOBJ_INT32ARRAY},
+    {"Uint32Array", DUK_BUFOBJ_UINT32ARRAY},
+    {"Float32Array", DUK_BUFOBJ_FLOAT32ARRAY},
+    {"Float64Array", DUK_BUFOBJ_FLOAT64ARRAY}};
+#define LOW_CLONE_NUM_BUFFER_KINDS                                             \
+    (sizeof(g_low_clone_buffer_kinds) / sizeof(g_low_clone_buffer_kinds[0]))
+#define LOW_CLONE_KIND_UINT8ARRAY   4
+
+static const char *g_low_clone_error_names[] = {
+    "Error", "EvalError", "RangeError", "ReferenceError",
+    "SyntaxError", "TypeError", "URIError", NULL};
+
+struct low_clone_writer_t
+{
+    low_clone_t *clone;
+    int depth;
+
+    map<void *, uint32_t> objects;
+    map<void *, uint32_t> transfers;    // plain buffer -> index in clone
+};
+
+struct low_clone_reader_t
+{
+    low_clone_t *clone;
+    const unsigned char *pos, *end;
+
+    duk_idx_t table, buffers;   // buffers: the adopted transfers
+    uint32_t numObjects;
+};
+
+
+// -----------------------------------------------------------------------------
+//  low_clone_t::~low_clone_t
+// -----------------------------------------------------------------------------
+
+low_clone_t::~low_clone_t()
+{
+    for(int i = 0; i < transfers.size(); i++)
+        if(transfers[i].data)
+            low_duk_block_free(transfers[i].data);
+}
+
+
+// -----------------------------------------------------------------------------
+//  low_clone_error - throws DataCloneError
+// -----------------------------------------------------------------------------
+
+static void low_clone_error(duk_context *ctx, const char *what)
+{
+    duk_push_error_object(ctx, DUK_ERR_ERROR, "%s could not be cloned", what);
+    duk_push_string(ctx, "DataCloneError");
+    duk_put_prop_string(ctx, -2, "name");
+    duk_throw(ctx);
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_instanceof - checks against global constructor
+// -----------------------------------------------------------------------------
+
+static bool low_clone_instanceof(duk_context *ctx, duk_idx_t index,
+                                 const char *name)
+{
+    bool is = false;
+
+    if(duk_get_global_string(ctx, name) && duk_is_function(ctx, -1))
+        is = duk_instanceof(ctx, index, -1);
+    duk_pop(ctx);
+
+    return is;
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_put - helpers to append to the serialized data
+// -----------------------------------------------------------------------------
+
+static void low_clone_put(low_clone_writer_t *w, const void *data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    w->clone->data.insert(w->clone->data.end(), bytes, bytes + len);
+}
+
+static void low_clone_put_u32(low_clone_writer_t *w, uint32_t val)
+{
+    low_clone_put(w, &val, sizeof(val));
+}
+
+static void low_clone_put_string(duk_context *ctx, low_clone_writer_t *w,
+                                 duk_idx_t index)
+{
+    duk_size_t len;
+    const char *str = duk_to_lstring(ctx, index, &len);
+
+    low_clone_put_u32(w, len);
+    low_clone_put(w, str, len);
+}
+
+static void low_clone_put_prop_string(duk_context *ctx, low_clone_writer_t *w,
+                                      duk_idx_t index, const char *key)
+{
+    duk_get_prop_string(ctx, index, key);
+    if(duk_is_undefined(ctx, -1))
+    {
+        duk_pop(ctx);
+        duk_push_string(ctx, "");
+    }
+    low_clone_put_string(ctx, w, -1);
+    duk_pop(ctx);
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_write_buffer
+// -----------------------------------------------------------------------------
+
+static void low_clone_write_buffer(duk_context *ctx, low_clone_writer_t *w,
+                                   duk_idx_t index)
+{
+    int kind = LOW_CLONE_KIND_UINT8ARRAY;
+    if(!duk_is_buffer(ctx, index))
+    {
+        for(int i = 0; i < LOW_CLONE_NUM_BUFFER_KINDS; i++)
+            if(low_clone_instanceof(ctx, index, g_low_clone_buffer_kinds[i].name))
+            {
+                kind = i;
+                break;
+            }
+    }
+
+    // Transferred memory is moved after writing, we only note the view
+    low_duk_buffer_t buffer;
+    if(low_duk_get_buffer(ctx, index, &buffer))
+    {
+        auto iter = w->transfers.find(buffer.buf);
+        if(iter != w->transfers.end())
+        {
+            unsigned char header[2] = {LOW_CLONE_TRANSFER, (unsigned char)kind};
+            low_clone_put(w, header, 2);
+            low_clone_put_u32(w, iter->second);
+            low_clone_put_u32(w, buffer.offset);
+            low_clone_put_u32(w, buffer.length);
+            return;
+        }
+    }
+
+    duk_size_t len;
+    unsigned char *data =
+      (unsigned char *)duk_get_buffer_data(ctx, index, &len);
+
+    unsigned char header[2] = {LOW_CLONE_BUFFER, (unsigned char)kind};
+    low_clone_put(w, header, 2);
+    low_clone_put_u32(w, len);
+    low_clone_put(w, data, len);
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_write
+// -----------------------------------------------------------------------------
+
+static void low_clone_write(duk_context *ctx, low_clone_writer_t *w,
+                            duk_idx_t index)
+{
+    unsigned char tag;
+
+    index = duk_normalize_index(ctx, index);
+    switch(duk_get_type(ctx, index))
+    {
+    case DUK_TYPE_UNDEFINED:
+        tag = LOW_CLONE_UNDEFINED;
+        low_clone_put(w, &tag, 1);
+        return;
+
+    case DUK_TYPE_NULL:
+        tag = LOW_CLONE_NULL;
+        low_clone_put(w, &tag, 1);
+        return;
+
+    case DUK_TYPE_BOOLEAN:
+        tag = duk_get_boolean(ctx, index) ? LOW_CLONE_TRUE : LOW_CLONE_FALSE;
+        low_clone_put(w, &tag, 1);
+        return;
+
+    case DUK_TYPE_NUMBER:
+    {
+        double num = duk_get_number(ctx, index);
+
+        tag = LOW_CLONE_NUMBER;
+        low_clone_put(w, &tag, 1);
+        low_clone_put(w, &num, sizeof(num));
+        return;
+    }
+
+    case DUK_TYPE_STRING:
+        tag = LOW_CLONE_STRING;
+        low_clone_put(w, &tag, 1);
+        low_clone_put_string(ctx, w, index);
+        return;
+
+    case DUK_TYPE_BUFFER:
+        low_clone_write_buffer(ctx, w, index);
+        return;
+
+    case DUK_TYPE_OBJECT:
+        break;
+
+    default:
+        low_clone_error(ctx, duk_is_lightfunc(ctx, index) ? "function" : "value");
+    }
+
+    // Same object twice, or a cycle
+    void *ptr = duk_get_heapptr(ctx, index);
+    auto iter = w->objects.find(ptr);
+    if(iter != w->objects.end())
+    {
+        tag = LOW_CLONE_REFERENCE;
+        low_clone_put(w, &tag, 1);
+        low_clone_put_u32(w, iter->second);
+        return;
+    }
+
+    if(duk_is_function(ctx, index))
+        low_clone_error(ctx, "function");
+    if(++w->depth > LOW_CLONE_MAX_DEPTH)
+        low_clone_error(ctx, "deeply nested value");
+
+    // The reader registers the objects in the same order
+    uint32_t id = w->objects.size();
+    w->objects[ptr] = id;
+
+    if(duk_is_buffer_data(ctx, index))
+        low_clone_write_buffer(ctx, w, index);
+    else if(low_clone_instanceof(ctx, index, "Date"))
+    {
+        duk_push_string(ctx, "getTime");
+        duk_call_prop(ctx, index, 0);
+        double time = duk_get_number(ctx, -1);
+        duk_pop(ctx);
+
+        tag = LOW_CLONE_DATE;
+        low_clone_put(w, &tag, 1);
+        low_clone_put(w, &time, sizeof(time));
+    }
+    else if(low_clone_instanceof(ctx, index, "RegExp"))
+    {
+        tag = LOW_CLONE_REGEXP;
+        low_clone_put(w, &tag, 1);
+        low_clone_put_prop_string(ctx, w, index, "source");
+
+        char flags[4];
+        int numFlags = 0;
+        if(duk_get_prop_string(ctx, index, "global") && duk_to_boolean(ctx, -1))
+            flags[numFlags++] = 'g';
+        duk_pop(ctx);
+        if(duk_get_prop_string(ctx, index, "ignoreCase") && duk_to_boolean(ctx, -1))
+            flags[numFlags++] = 'i';
+        duk_pop(ctx);
+        if(duk_get_prop_string(ctx, index, "multiline") && duk_to_boolean(ctx, -1))
+            flags[numFlags++] = 'm';
+        duk_pop(ctx);
+        duk_push_lstring(ctx, flags, numFlags);
+        low_clone_put_string(ctx, w, -1);
+        duk_pop(ctx);
+    }
+    else if(low_clone_instanceof(ctx, index, "Error"))
+    {
+        tag = LOW_CLONE_ERROR;
+        low_clone_put(w, &tag, 1);
+        low_clone_put_prop_string(ctx, w, index, "name");
+        low_clone_put_prop_string(ctx, w, index, "message");
+        low_clone_put_prop_string(ctx, w, index, "stack");
+        low_clone_put_prop_string(ctx, w, index, "code");
+    }
+    else if(duk_is_array(ctx, index))
+    {
+        uint32_t len = duk_get_length(ctx, index);
+
+        tag = LOW_CLONE_ARRAY;
+        low_clone_put(w, &tag, 1);
+        low_clone_put_u32(w, len);
+        for(uint32_t i = 0; i < len; i++)
+        {
+            duk_get_prop_index(ctx, index, i);
+            low_clone_write(ctx, w, -1);
+            duk_pop(ctx);
+        }
+    }
+    else
+    {
+        // Other objects lose their prototype, as in Node.js
+        tag = LOW_CLONE_OBJECT;
+        low_clone_put(w, &tag, 1);
+
+        size_t countPos = w->clone->data.size();
+        uint32_t count = 0;
+        low_clone_put_u32(w, 0);
+
+        duk_enum(ctx, index, DUK_ENUM_OWN_PROPERTIES_ONLY);
+        while(duk_next(ctx, -1, 1))
+        {
+            low_clone_put_string(ctx, w, -2);
+            low_clone_write(ctx, w, -1);
+            duk_pop_2(ctx);
+            count++;
+        }
+        duk_pop(ctx);
+
+        memcpy(&w->clone->data[countPos], &count, sizeof(count));
+    }
+
+    w->depth--;
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_serialize
+// -----------------------------------------------------------------------------
+
+void low_clone_serialize(duk_context *ctx, duk_idx_t index,
+                         duk_idx_t transferIndex, low_clone_t &clone)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    low_clone_writer_t w;
+    w.clone = &clone;
+    w.depth = 0;
+
+    int numTransfers = 0;
+    transferIndex = duk_normalize_index(ctx, transferIndex);
+    if(!duk_is_null_or_undefined(ctx, transferIndex))
+    {
+        if(!duk_is_array(ctx, transferIndex))
+            duk_type_error(ctx, "transferList must be an array");
+
+        numTransfers = duk_get_length(ctx, transferIndex);
+        for(int i = 0; i < numTransfers; i++)
+        {
+            duk_get_prop_index(ctx, transferIndex, i);
+
+            low_duk_buffer_t buffer;
+            if(!low_duk_get_buffer(ctx, -1, &buffer))
+                low_clone_error(ctx, "transferList entry which is no buffer");
+
+            // Fixed buffers have their data inline and blocks of the slabs
+            // belong to our heap, these are copied
+            if(buffer.data && low_duk_block_movable(low, buffer.data)
+            && w.transfers.find(buffer.buf) == w.transfers.end())
+            {
+                low_clone_transfer_t transfer = {NULL, buffer.size};
+                w.transfers[buffer.buf] = clone.transfers.size();
+                clone.transfers.push_back(transfer);
+            }
+            duk_pop(ctx);
+        }
+    }
+
+    low_clone_write(ctx, &w, index);
+
+    // The value could be cloned, so now the sender loses the buffers. All
+    // views on moved memory are empty, copied buffers only the listed views
+    for(auto iter = w.transfers.begin(); iter != w.transfers.end(); iter++)
+    {
+        void *data = low_duk_steal_buffer(ctx, iter->first);
+        low_duk_block_release(low, data);
+        clone.transfers[iter->second].data = data;
+    }
+    for(int i = 0; i < numTransfers; i++)
+    {
+        duk_get_prop_index(ctx, transferIndex, i);
+        low_duk_detach_buffer(ctx, -1);
+        duk_pop(ctx);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_get - helpers to read from the serialized data
+// -----------------------------------------------------------------------------
+
+static const unsigned char *low_clone_get(duk_context *ctx,
+                                          low_clone_reader_t *r, size_t len)
+{
+    if(len > r->end - r->pos)
+        duk_generic_error(ctx, "corrupt cloned value");
+
+    const unsigned char *data = r->pos;
+    r->pos += len;
+    return data;
+}
+
+static uint32_t low_clone_get_u32(duk_context *ctx, low_clone_reader_t *r)
+{
+    uint32_t val;
+    memcpy(&val, low_clone_get(ctx, r, sizeof(val)), sizeof(val));
+    return val;
+}
+
+static double low_clone_get_double(duk_context *ctx, low_clone_reader_t *r)
+{
+    double val;
+    memcpy(&val, low_clone_get(ctx, r, sizeof(val)), sizeof(val));
+    return val;
+}
+
+static void low_clone_push_string(duk_context *ctx, low_clone_reader_t *r)
+{
+    uint32_t len = low_clone_get_u32(ctx, r);
+    duk_push_lstring(ctx, (const char *)low_clone_get(ctx, r, len), len);
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_register - remembers object on top of stack for references
+// -----------------------------------------------------------------------------
+
+static void low_clone_register(duk_context *ctx, low_clone_reader_t *r)
+{
+    duk_dup(ctx, -1);
+    duk_put_prop_index(ctx, r->table, r->numObjects++);
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_push_buffer
+// -----------------------------------------------------------------------------
+
+static void low_clone_push_buffer(duk_context *ctx, int kind,
+                                  const unsigned char *src, size_t len)
+{
+    if(kind < 0 || kind >= LOW_CLONE_NUM_BUFFER_KINDS)
+        duk_generic_error(ctx, "corrupt cloned value");
+
+    void *data = duk_push_fixed_buffer(ctx, len);
+    if(len)
+        memcpy(data, src, len);
+
+    duk_push_buffer_object(ctx, -1, 0, len, g_low_clone_buffer_kinds[kind].type);
+    duk_remove(ctx, -2);
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_push_transfer - pushes the plain buffer of a transfer, which
+//  the first view on it adopts
+// -----------------------------------------------------------------------------
+
+static void low_clone_push_transfer(duk_context *ctx, low_clone_reader_t *r,
+                                    uint32_t id)
+{
+    if(id >= r->clone->transfers.size())
+        duk_generic_error(ctx, "corrupt cloned value");
+    if(duk_get_prop_index(ctx, r->buffers, id))
+        return;
+    duk_pop(ctx);
+
+    low_clone_transfer_t &transfer = r->clone->transfers[id];
+    low_duk_push_buffer_data(ctx, transfer.data, transfer.size);
+    low_duk_block_adopt(duk_get_low_context(ctx), transfer.data);
+    transfer.data = NULL;
+
+    duk_dup(ctx, -1);
+    duk_put_prop_index(ctx, r->buffers, id);
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_read
+// -----------------------------------------------------------------------------
+
+static void low_clone_read(duk_context *ctx, low_clone_reader_t *r)
+{
+    unsigned char tag = *low_clone_get(ctx, r, 1);
+    switch(tag)
+    {
+    case LOW_CLONE_UNDEFINED:
+        duk_push_undefined(ctx);
+        break;
+
+    case LOW_CLONE_NULL:
+        duk_push_null(ctx);
+        break;
+
+    case LOW_CLONE_TRUE:
+    case LOW_CLONE_FALSE:
+        duk_push_boolean(ctx, tag == LOW_CLONE_TRUE);
+        break;
+
+    case LOW_CLONE_NUMBER:
+        duk_push_number(ctx, low_clone_get_double(ctx, r));
+        break;
+
+    case LOW_CLONE_STRING:
+        low_clone_push_string(ctx, r);
+        break;
+
+    case LOW_CLONE_REFERENCE:
+    {
+        uint32_t id = low_clone_get_u32(ctx, r);
+        if(id >= r->numObjects)
+            duk_generic_error(ctx, "corrupt cloned value");
+        duk_get_prop_index(ctx, r->table, id);
+        break;
+    }
+
+    case LOW_CLONE_BUFFER:
+    {
+        int kind = *low_clone_get(ctx, r, 1);
+        uint32_t len = low_clone_get_u32(ctx, r);
+        low_clone_push_buffer(ctx, kind, low_clone_get(ctx, r, len), len);
+        low_clone_register(ctx, r);
+        break;
+    }
+
+    case LOW_CLONE_TRANSFER:
+    {
+        int kind = *low_clone_get(ctx, r, 1);
+        uint32_t id = low_clone_get_u32(ctx, r);
+        uint32_t offset = low_clone_get_u32(ctx, r);
+        uint32_t length = low_clone_get_u32(ctx, r);
+        if(kind >= LOW_CLONE_NUM_BUFFER_KINDS || offset + length < offset)
+            duk_generic_error(ctx, "corrupt cloned value");
+
+        low_clone_push_transfer(ctx, r, id);
+        duk_push_buffer_object(ctx, -1, offset, length,
+                               g_low_clone_buffer_kinds[kind].type);
+        duk_remove(ctx, -2);
+        low_clone_register(ctx, r);
+        break;
+    }
+
+    case LOW_CLONE_DATE:
+        duk_get_global_string(ctx, "Date");
+        duk_push_number(ctx, low_clone_get_double(ctx, r));
+        duk_new(ctx, 1);
+        low_clone_register(ctx, r);
+        break;
+
+    case LOW_CLONE_REGEXP:
+        duk_get_global_string(ctx, "RegExp");
+        low_clone_push_string(ctx, r);
+        low_clone_push_string(ctx, r);
+        duk_new(ctx, 2);
+        low_clone_register(ctx, r);
+        break;
+
+    case LOW_CLONE_ERROR:
+    {
+        low_clone_push_string(ctx, r);
+        const char *name = duk_get_string(ctx, -1);
+
+        const char *ctor = "Error";
+        for(int i = 0; g_low_clone_error_names[i]; i++)
+            if(strcmp(name, g_low_clone_error_names[i]) == 0)
+                ctor = name;
+
+        duk_get_global_string(ctx, ctor);
+        low_clone_push_string(ctx, r);
+        duk_new(ctx, 1);
+        if(strcmp(name, ctor) != 0)
+        {
+            duk_dup(ctx, -2);
+            duk_put_prop_string(ctx, -2, "name");
+        }
+        duk_remove(ctx, -2);
+        low_clone_register(ctx, r);
+
+        // Stack is an accessor of Error.prototype, so define it
+        duk_push_string(ctx, "stack");
+        low_clone_push_string(ctx, r);
+        duk_def_prop(ctx, -3, DUK_DEFPROP_HAVE_VALUE
+                              | DUK_DEFPROP_SET_WRITABLE
+                              | DUK_DEFPROP_SET_CONFIGURABLE);
+
+        low_clone_push_string(ctx, r);
+        if(duk_get_length(ctx, -1))
+            duk_put_prop_string(ctx, -2, "code");
+        else
+            duk_pop(ctx);
+        break;
+    }
+
+    case LOW_CLONE_ARRAY:
+    {
+        uint32_t len = low_clone_get_u32(ctx, r);
+
+        duk_push_array(ctx);
+        low_clone_register(ctx, r);
+        for(uint32_t i = 0; i < len; i++)
+        {
+            low_clone_read(ctx, r);
+            duk_put_prop_index(ctx, -2, i);
+        }
+        break;
+    }
+
+    case LOW_CLONE_OBJECT:
+    {
+        uint32_t count = low_clone_get_u32(ctx, r);
+
+        duk_push_object(ctx);
+        low_clone_register(ctx, r);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            low_clone_push_string(ctx, r);
+            low_clone_read(ctx, r);
+            duk_put_prop(ctx, -3);
+        }
+        break;
+    }
+
+    default:
+        duk_generic_error(ctx, "corrupt cloned value");
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_clone_deserialize
+// -----------------------------------------------------------------------------
+
+void low_clone_deserialize(duk_context *ctx, low_clone_t &clone)
+{
+    low_clone_reader_t r;
+    r.clone = &clone;
+    r.pos = clone.data.size() ? &clone.data[0] : NULL;
+    r.end = r.pos + clone.data.size();
+    r.numObjects = 0;
+
+    duk_push_array(ctx);
+    r.table = duk_get_top_index(ctx);
+    duk_push_array(ctx);
+    r.buffers = duk_get_top_index(ctx);
+
+    low_clone_read(ctx, &r);
+    duk_remove(ctx, r.buffers);
+    duk_remove(ctx, r.table);
+}
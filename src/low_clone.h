@@ -0,0 +1,45 @@
+// -----------------------------------------------------------------------------
+//  low_clone.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_CLONE_H__
+#define __LOW_CLONE_H__
+
+#include "duktape.h"
+
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+// A JavaScript value serialized so it can be recreated in another Duktape
+// heap, similar to the structured clone algorithm of HTML. Supports
+// primitives, plain objects, arrays, Date, RegExp, Error, Buffer,
+// ArrayBuffer, typed arrays and cyclic references
+
+// Memory of a transferred buffer, owned until the receiver adopts it
+struct low_clone_transfer_t
+{
+    void *data;
+    size_t size;
+};
+
+struct low_clone_t
+{
+    vector<unsigned char> data;
+    vector<low_clone_transfer_t> transfers;
+
+    ~low_clone_t();     // frees the transfers nobody received
+};
+
+// transferIndex is the stack index of an array of buffers to transfer, or
+// of undefined. The memory of transferred dynamic buffers is moved to the
+// receiving heap, other buffers are copied. Either way the transferred
+// buffers are empty for the sender afterwards.
+// Throws DataCloneError if the value cannot be cloned
+void low_clone_serialize(duk_context *ctx, duk_idx_t index,
+                         duk_idx_t transferIndex, low_clone_t &clone);
+// Pushes the value
+void low_clone_deserialize(duk_context *ctx, low_clone_t &clone);
+
+#endif /* __LOW_CLONE_H__ */
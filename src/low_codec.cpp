@@ -0,0 +1,882 @@
+// -----------------------------------------------------------------------------
+//  low_codec.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_codec.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// x86: SSE2 is always there on x86_64, the SSSE3 versions are compiled
+// with target attributes and chosen at runtime, so the default build
+// benefits. ARM: NEON is always there on AArch64
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOW_CODEC_SSSE3
+#include <immintrin.h>
+#define LOW_CODEC_TARGET_SSSE3 __attribute__((target("ssse3")))
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define LOW_CODEC_NEON
+#include <arm_neon.h>
+#endif /* __x86_64__ */
+
+static const char gBase64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char gBase64URL[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+static const char gHex[] = "0123456789abcdef";
+
+#define LOW_CODEC_INVALID 0xFF
+#define LOW_CODEC_PAD 0xFE
+
+// Both base64 alphabets, '=' as LOW_CODEC_PAD
+static unsigned char gBase64Dec[256];
+// Value of hex digits, others LOW_CODEC_INVALID
+static unsigned char gHexDec[256];
+static bool gTablesInit = false;
+
+#ifdef LOW_CODEC_SSSE3
+static bool gHasSSSE3 = false;
+#endif /* LOW_CODEC_SSSE3 */
+
+
+// -----------------------------------------------------------------------------
+//  low_codec_init - fills the decoding tables and checks the CPU. Called
+//  by everybody which needs them, doing this twice is harmless
+// -----------------------------------------------------------------------------
+
+static void low_codec_init()
+{
+    if(gTablesInit)
+        return;
+
+    memset(gBase64Dec, LOW_CODEC_INVALID, sizeof(gBase64Dec));
+    for(int i = 0; i < 64; i++)
+    {
+        gBase64Dec[(unsigned char)gBase64[i]] = i;
+        gBase64Dec[(unsigned char)gBase64URL[i]] = i;
+    }
+    gBase64Dec['='] = LOW_CODEC_PAD;
+
+    memset(gHexDec, LOW_CODEC_INVALID, sizeof(gHexDec));
+    for(int i = 0; i < 16; i++)
+    {
+        gHexDec[(unsigned char)gHex[i]] = i;
+        gHexDec[(unsigned char)"0123456789ABCDEF"[i]] = i;
+    }
+
+#ifdef LOW_CODEC_SSSE3
+#ifdef __SSSE3__
+    gHasSSSE3 = true;
+#else
+    gHasSSSE3 = __builtin_cpu_supports("ssse3");
+#endif /* __SSSE3__ */
+#endif /* LOW_CODEC_SSSE3 */
+
+    gTablesInit = true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_ascii_prefix
+// -----------------------------------------------------------------------------
+
+size_t low_ascii_prefix(const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for(; i + 64 <= len; i += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 48));
+        if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))))
+            break;
+    }
+    for(; i + 16 <= len; i += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(src + i)));
+        if(mask)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(LOW_CODEC_NEON)
+    for(; i + 16 <= len; i += 16)
+        if(vmaxvq_u8(vld1q_u8(src + i)) & 0x80)
+            break;
+#else
+    for(; i + 8 <= len; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, src + i, 8);
+        if(word & 0x8080808080808080ULL)
+            break;
+    }
+#endif /* __SSE2__ */
+
+    while(i < len && src[i] < 0x80)
+        i++;
+    return i;
+}
+
+// -----------------------------------------------------------------------------
+//  low_base64_encode
+// -----------------------------------------------------------------------------
+
+#ifdef LOW_CODEC_SSSE3
+// 12 bytes to 16 characters per round, see W. Mula, D. Lemire, "Faster
+// Base64 Encoding and Decoding using AVX2 Instructions"
+LOW_CODEC_TARGET_SSSE3
+static size_t low_base64_encode_ssse3(const unsigned char *src, size_t len,
+                                      char *dst, bool url)
+{
+    const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                         4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      url ? '-' - 62 : '+' - 62, url ? '_' - 63 : '/' - 63, 'A', 0, 0);
+
+    size_t i = 0;
+    for(; i + 16 <= len; i += 12, dst += 16)
+    {
+        __m128i in = _mm_shuffle_epi8(
+          _mm_loadu_si128((const __m128i *)(src + i)), shuffle);
+
+        // Split the 24 bit groups into 6 bit indices, one per byte
+        __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t1, t3);
+
+        // Indices to characters, by adding the offset of their range
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+        __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shift, range), indices);
+
+        _mm_storeu_si128((__m128i *)dst, chars);
+    }
+    return i;
+}
+#endif /* LOW_CODEC_SSSE3 */
+
+size_t low_base64_encode(const unsigned char *src, size_t len, char *dst,
+                         bool url)
+{
+    const char *alphabet = url ? gBase64URL : gBase64;
+    char *start = dst;
+    size_t i = 0;
+
+#if defined(LOW_CODEC_SSSE3)
+    low_codec_init();
+    if(gHasSSSE3)
+    {
+        i = low_base64_encode_ssse3(src, len, dst, url);
+        dst += i / 3 * 4;
+    }
+#elif defined(LOW_CODEC_NEON)
+    // 48 bytes to 64 characters per round
+    uint8x16x4_t table = {{vld1q_u8((const uint8_t *)alphabet),
+                           vld1q_u8((const uint8_t *)alphabet + 16),
+                           vld1q_u8((const uint8_t *)alphabet + 32),
+                           vld1q_u8((const uint8_t *)alphabet + 48)}};
+    uint8x16_t mask = vdupq_n_u8(0x3F);
+    for(; i + 48 <= len; i += 48, dst += 64)
+    {
+        uint8x16x3_t in = vld3q_u8(src + i);
+        uint8x16x4_t out;
+
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4),
+                                       vshlq_n_u8(in.val[0], 4)), mask);
+        out.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6),
+                                       vshlq_n_u8(in.val[1], 2)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+        for(int j = 0; j < 4; j++)
+            out.val[j] = vqtbl4q_u8(table, out.val[j]);
+
+        vst4q_u8((uint8_t *)dst, out);
+    }
+#endif /* LOW_CODEC_SSSE3 */
+
+    for(; i + 3 <= len; i += 3)
+    {
+        uint32_t v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        *dst++ = alphabet[v >> 18];
+        *dst++ = alphabet[(v >> 12) & 0x3F];
+        *dst++ = alphabet[(v >> 6) & 0x3F];
+        *dst++ = alphabet[v & 0x3F];
+    }
+    if(i < len)
+    {
+        uint32_t v = src[i] << 16;
+        if(i + 1 < len)
+            v |= src[i + 1] << 8;
+
+        *dst++ = alphabet[v >> 18];
+        *dst++ = alphabet[(v >> 12) & 0x3F];
+        if(i + 1 < len)
+            *dst++ = alphabet[(v >> 6) & 0x3F];
+        else if(!url)
+            *dst++ = '=';
+        if(!url)
+            *dst++ = '=';
+    }
+
+    return dst - start;
+}
+
+// -----------------------------------------------------------------------------
+//  low_base64_decode
+// -----------------------------------------------------------------------------
+
+#ifdef LOW_CODEC_SSSE3
+// Decodes 16 characters to 12 bytes per round, but stores 16, so stops 4
+// characters before the end. Also stops at the first round with a
+// character which is not part of the alphabets. Returns the number of
+// characters decoded
+LOW_CODEC_TARGET_SSSE3
+static size_t low_base64_decode_ssse3(const char *src, size_t len,
+                                      unsigned char *dst)
+{
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                        0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+                                        0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                        0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                          0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for(; i + 20 <= len; i += 16, dst += 12)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+
+        // base64url characters to their counterparts, '-' to '+' and '_' to '/'
+        in = _mm_add_epi8(in, _mm_and_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('-')),
+                                            _mm_set1_epi8('+' - '-')));
+        in = _mm_add_epi8(in, _mm_and_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('_')),
+                                            _mm_set1_epi8('/' - '_')));
+
+        __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+        __m128i loNibbles = _mm_and_si128(in, nibble);
+        __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())))
+            break;
+
+        __m128i eq2F = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+        __m128i values = _mm_add_epi8(in, roll);
+
+        // Join the 6 bit values to 24 bit groups and put them in order
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        merged = _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8,
+                                                        14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *)dst, merged);
+    }
+    return i;
+}
+#endif /* LOW_CODEC_SSSE3 */
+
+size_t low_base64_decode(const char *src, size_t len, unsigned char *dst)
+{
+    low_codec_init();
+
+    unsigned char *start = dst;
+    uint32_t group = 0;
+    int numGroup = 0;
+    size_t i = 0;
+
+    while(i < len)
+    {
+#ifdef LOW_CODEC_SSSE3
+        // Leaves 4 characters room, as 16 bytes are stored for 12
+        if(gHasSSSE3 && numGroup == 0)
+        {
+            size_t decoded = low_base64_decode_ssse3(src + i, len - i, dst);
+            i += decoded;
+            dst += decoded / 4 * 3;
+
+            // Line breaks and the like are in the next 16 characters,
+            // do them the slow way
+            size_t end = i + 16 < len ? i + 16 : len;
+            for(; i < end || (numGroup && i < len); i++)
+            {
+                unsigned char c = gBase64Dec[(unsigned char)src[i]];
+                if(c == LOW_CODEC_PAD)
+                    goto done;
+                if(c == LOW_CODEC_INVALID)
+                    continue;
+
+                group = (group << 6) | c;
+                if(++numGroup == 4)
+                {
+                    *dst++ = group >> 16;
+                    *dst++ = group >> 8;
+                    *dst++ = group;
+                    numGroup = 0;
+                }
+            }
+            continue;
+        }
+#endif /* LOW_CODEC_SSSE3 */
+
+        // Fast path for groups of 4 valid characters
+        if(numGroup == 0)
+            for(; i + 4 <= len; i += 4)
+            {
+                unsigned char a = gBase64Dec[(unsigned char)src[i]];
+                unsigned char b = gBase64Dec[(unsigned char)src[i + 1]];
+                unsigned char c = gBase64Dec[(unsigned char)src[i + 2]];
+                unsigned char d = gBase64Dec[(unsigned char)src[i + 3]];
+                if((a | b | c | d) & 0x80)
+                    break;
+
+                uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+                *dst++ = v >> 16;
+                *dst++ = v >> 8;
+                *dst++ = v;
+            }
+        if(i == len)
+            break;
+
+        unsigned char c = gBase64Dec[(unsigned char)src[i++]];
+        if(c == LOW_CODEC_PAD)
+            break;
+        if(c == LOW_CODEC_INVALID)
+            continue;
+
+        group = (group << 6) | c;
+        if(++numGroup == 4)
+        {
+            *dst++ = group >> 16;
+            *dst++ = group >> 8;
+            *dst++ = group;
+            numGroup = 0;
+        }
+    }
+
+#ifdef LOW_CODEC_SSSE3
+done:
+#endif /* LOW_CODEC_SSSE3 */
+    if(numGroup == 2)
+        *dst++ = group >> 4;
+    else if(numGroup == 3)
+    {
+        *dst++ = group >> 10;
+        *dst++ = group >> 2;
+    }
+
+    return dst - start;
+}
+
+// -----------------------------------------------------------------------------
+//  low_base64_decoded_len
+// -----------------------------------------------------------------------------
+
+size_t low_base64_decoded_len(const char *src, size_t len)
+{
+    if(len > 0 && src[len - 1] == '=')
+        len--;
+    if(len > 0 && src[len - 1] == '=')
+        len--;
+    return len * 3 / 4;
+}
+
+// -----------------------------------------------------------------------------
+//  low_hex_encode
+// -----------------------------------------------------------------------------
+
+#ifdef LOW_CODEC_SSSE3
+LOW_CODEC_TARGET_SSSE3
+static size_t low_hex_encode_ssse3(const unsigned char *src, size_t len,
+                                   char *dst)
+{
+    const __m128i lut = _mm_loadu_si128((const __m128i *)gHex);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    size_t i = 0;
+    for(; i + 16 <= len; i += 16, dst += 32)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(in, nibble));
+
+        _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+#endif /* LOW_CODEC_SSSE3 */
+
+size_t low_hex_encode(const unsigned char *src, size_t len, char *dst)
+{
+    size_t i = 0;
+
+#if defined(LOW_CODEC_SSSE3)
+    low_codec_init();
+    if(gHasSSSE3)
+        i = low_hex_encode_ssse3(src, len, dst);
+#elif defined(LOW_CODEC_NEON)
+    const uint8x16_t lut = vld1q_u8((const uint8_t *)gHex);
+    for(; i + 16 <= len; i += 16)
+    {
+        uint8x16_t in = vld1q_u8(src + i);
+        uint8x16x2_t out;
+        out.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(in, 4));
+        out.val[1] = vqtbl1q_u8(lut, vandq_u8(in, vdupq_n_u8(0x0F)));
+        vst2q_u8((uint8_t *)dst + i * 2, out);
+    }
+#endif /* LOW_CODEC_SSSE3 */
+
+    for(; i < len; i++)
+    {
+        dst[i * 2] = gHex[src[i] >> 4];
+        dst[i * 2 + 1] = gHex[src[i] & 0x0F];
+    }
+    return len * 2;
+}
+
+// -----------------------------------------------------------------------------
+//  low_hex_decode
+// -----------------------------------------------------------------------------
+
+size_t low_hex_decode(const char *src, size_t len, unsigned char *dst)
+{
+    low_codec_init();
+
+    size_t i;
+    for(i = 0; i < len / 2; i++)
+    {
+        unsigned char hi = gHexDec[(unsigned char)src[i * 2]];
+        unsigned char lo = gHexDec[(unsigned char)src[i * 2 + 1]];
+        if(hi == LOW_CODEC_INVALID || lo == LOW_CODEC_INVALID)
+            break;
+        dst[i] = (hi << 4) | lo;
+    }
+    return i;
+}
+
+// -----------------------------------------------------------------------------
+//  low_utf8_next - decodes the UTF-8 sequence at src[*pos] strictly, returns
+//  the code point or -1 if invalid. *pos is advanced past the sequence, or
+//  past the longest valid prefix of it, as the WHATWG decoder does
+// -----------------------------------------------------------------------------
+
+static inline int low_utf8_next(const unsigned char *src, size_t len,
+                                size_t *pos)
+{
+    size_t i = *pos;
+    unsigned char c = src[i++];
+    int cp, need;
+    unsigned char lo = 0x80, hi = 0xBF;
+
+    if(c < 0x80)
+    {
+        *pos = i;
+        return c;
+    }
+    else if(c >= 0xC2 && c <= 0xDF)
+    {
+        need = 1;
+        cp = c & 0x1F;
+    }
+    else if(c >= 0xE0 && c <= 0xEF)
+    {
+        need = 2;
+        cp = c & 0x0F;
+        if(c == 0xE0)
+            lo = 0xA0;
+        else if(c == 0xED)
+            hi = 0x9F;
+    }
+    else if(c >= 0xF0 && c <= 0xF4)
+    {
+        need = 3;
+        cp = c & 0x07;
+        if(c == 0xF0)
+            lo = 0x90;
+        else if(c == 0xF4)
+            hi = 0x8F;
+    }
+    else
+    {
+        *pos = i;
+        return -1;
+    }
+
+    for(; need; need--)
+    {
+        if(i == len || src[i] < lo || src[i] > hi)
+        {
+            *pos = i;
+            return -1;
+        }
+        cp = (cp << 6) | (src[i++] & 0x3F);
+        lo = 0x80;
+        hi = 0xBF;
+    }
+
+    *pos = i;
+    return cp;
+}
+
+// -----------------------------------------------------------------------------
+//  low_internal_next - decodes the character at src[*pos] of a Duktape
+//  string, which may be a lone surrogate. Returns -1 for bytes Duktape does
+//  not create, these only come from native code pushing raw data
+// -----------------------------------------------------------------------------
+
+static inline int low_internal_next(const unsigned char *src, size_t len,
+                                    size_t *pos)
+{
+    size_t i = *pos;
+    unsigned char c = src[i++];
+    int cp, need;
+
+    if(c < 0x80)
+    {
+        *pos = i;
+        return c;
+    }
+    else if(c < 0xC0)
+    {
+        *pos = i;
+        return -1;
+    }
+    else if(c < 0xE0)
+    {
+        need = 1;
+        cp = c & 0x1F;
+    }
+    else if(c < 0xF0)
+    {
+        need = 2;
+        cp = c & 0x0F;
+    }
+    else
+    {
+        need = 3;
+        cp = c & 0x07;
+    }
+
+    for(; need && i < len && (src[i] & 0xC0) == 0x80; need--)
+        cp = (cp << 6) | (src[i++] & 0x3F);
+
+    *pos = i;
+    return need ? -1 : cp;
+}
+
+// -----------------------------------------------------------------------------
+//  low_internal_put - writes a code unit or BMP code point as Duktape does,
+//  code points above the BMP as surrogate pair
+// -----------------------------------------------------------------------------
+
+static inline unsigned char *low_internal_put(unsigned char *dst, int cp)
+{
+    if(cp >= 0x10000)
+    {
+        cp -= 0x10000;
+        dst = low_internal_put(dst, 0xD800 + (cp >> 10));
+        return low_internal_put(dst, 0xDC00 + (cp & 0x3FF));
+    }
+
+    if(cp < 0x80)
+        *dst++ = cp;
+    else if(cp < 0x800)
+    {
+        *dst++ = 0xC0 | (cp >> 6);
+        *dst++ = 0x80 | (cp & 0x3F);
+    }
+    else
+    {
+        *dst++ = 0xE0 | (cp >> 12);
+        *dst++ = 0x80 | ((cp >> 6) & 0x3F);
+        *dst++ = 0x80 | (cp & 0x3F);
+    }
+    return dst;
+}
+
+// -----------------------------------------------------------------------------
+//  low_utf8_is_internal
+// -----------------------------------------------------------------------------
+
+bool low_utf8_is_internal(const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+    while(true)
+    {
+        i += low_ascii_prefix(src + i, len - i);
+        if(i == len)
+            return true;
+
+        // Only look at the non ASCII part, then go back to the fast path
+        do
+        {
+            int cp = low_utf8_next(src, len, &i);
+            if(cp < 0 || cp >= 0x10000)
+                return false;
+        } while(i < len && src[i] >= 0x80);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_utf8_is_valid
+// -----------------------------------------------------------------------------
+
+bool low_utf8_is_valid(const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+    while(true)
+    {
+        i += low_ascii_prefix(src + i, len - i);
+        if(i == len)
+            return true;
+
+        do
+        {
+            if(low_utf8_next(src, len, &i) < 0)
+                return false;
+        } while(i < len && src[i] >= 0x80);
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_utf8_to_internal
+// -----------------------------------------------------------------------------
+
+size_t low_utf8_to_internal(const unsigned char *src, size_t len,
+                            unsigned char *dst)
+{
+    unsigned char *start = dst;
+    size_t i = 0;
+
+    while(i < len)
+    {
+        size_t ascii = low_ascii_prefix(src + i, len - i);
+        memcpy(dst, src + i, ascii);
+        dst += ascii;
+        i += ascii;
+
+        while(i < len && src[i] >= 0x80)
+        {
+            int cp = low_utf8_next(src, len, &i);
+            dst = low_internal_put(dst, cp < 0 ? 0xFFFD : cp);
+        }
+    }
+
+    return dst - start;
+}
+
+// -----------------------------------------------------------------------------
+//  low_internal_to_utf8
+// -----------------------------------------------------------------------------
+
+size_t low_internal_to_utf8(const unsigned char *src, size_t len,
+                            unsigned char *dst)
+{
+    unsigned char *start = dst;
+    size_t i = 0;
+
+    while(i < len)
+    {
+        size_t ascii = low_ascii_prefix(src + i, len - i);
+        memcpy(dst, src + i, ascii);
+        dst += ascii;
+        i += ascii;
+
+        while(i < len && src[i] >= 0x80)
+        {
+            size_t pos = i;
+            int cp = low_internal_next(src, len, &i);
+
+            if(cp >= 0xD800 && cp <= 0xDBFF && i < len)
+            {
+                size_t next = i;
+                int lo = low_internal_next(src, len, &next);
+                if(lo >= 0xDC00 && lo <= 0xDFFF)
+                {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i = next;
+                }
+            }
+
+            if(cp >= 0x10000)
+            {
+                *dst++ = 0xF0 | (cp >> 18);
+                *dst++ = 0x80 | ((cp >> 12) & 0x3F);
+                *dst++ = 0x80 | ((cp >> 6) & 0x3F);
+                *dst++ = 0x80 | (cp & 0x3F);
+            }
+            else if(cp >= 0xD800 && cp <= 0xDFFF)
+                dst = low_internal_put(dst, 0xFFFD);
+            else
+            {
+                // Valid already (or garbage we pass on), copy as it is
+                memcpy(dst, src + pos, i - pos);
+                dst += i - pos;
+            }
+        }
+    }
+
+    return dst - start;
+}
+
+// -----------------------------------------------------------------------------
+//  low_internal_utf8_len
+// -----------------------------------------------------------------------------
+
+size_t low_internal_utf8_len(const unsigned char *src, size_t len)
+{
+    size_t utf8Len = 0;
+    size_t i = 0;
+
+    while(i < len)
+    {
+        size_t ascii = low_ascii_prefix(src + i, len - i);
+        utf8Len += ascii;
+        i += ascii;
+
+        while(i < len && src[i] >= 0x80)
+        {
+            size_t pos = i;
+            int cp = low_internal_next(src, len, &i);
+
+            if(cp >= 0xD800 && cp <= 0xDBFF && i < len)
+            {
+                size_t next = i;
+                int lo = low_internal_next(src, len, &next);
+                if(lo >= 0xDC00 && lo <= 0xDFFF)
+                {
+                    cp = 0x10000;
+                    i = next;
+                }
+            }
+
+            if(cp >= 0x10000)
+                utf8Len += 4;
+            else if(cp >= 0xD800 && cp <= 0xDFFF)
+                utf8Len += 3;
+            else
+                utf8Len += i - pos;
+        }
+    }
+
+    return utf8Len;
+}
+
+// -----------------------------------------------------------------------------
+//  low_latin1_to_internal
+// -----------------------------------------------------------------------------
+
+size_t low_latin1_to_internal(const unsigned char *src, size_t len,
+                              unsigned char *dst, bool ascii)
+{
+    unsigned char *start = dst;
+    size_t i = 0;
+
+    while(i < len)
+    {
+        size_t prefix = low_ascii_prefix(src + i, len - i);
+        memcpy(dst, src + i, prefix);
+        dst += prefix;
+        i += prefix;
+
+        for(; i < len && src[i] >= 0x80; i++)
+        {
+            if(ascii)
+                *dst++ = src[i] & 0x7F;
+            else
+            {
+                *dst++ = 0xC0 | (src[i] >> 6);
+                *dst++ = 0x80 | (src[i] & 0x3F);
+            }
+        }
+    }
+
+    return dst - start;
+}
+
+// -----------------------------------------------------------------------------
+//  low_internal_to_latin1
+// -----------------------------------------------------------------------------
+
+size_t low_internal_to_latin1(const unsigned char *src, size_t len,
+                              unsigned char *dst)
+{
+    unsigned char *start = dst;
+    size_t i = 0;
+
+    while(i < len)
+    {
+        size_t ascii = low_ascii_prefix(src + i, len - i);
+        memcpy(dst, src + i, ascii);
+        dst += ascii;
+        i += ascii;
+
+        while(i < len && src[i] >= 0x80)
+        {
+            int cp = low_internal_next(src, len, &i);
+            if(cp < 0)
+                cp = 0xFFFD;
+            if(cp >= 0x10000)
+            {
+                cp -= 0x10000;
+                *dst++ = (0xD800 + (cp >> 10)) & 0xFF;
+                *dst++ = (0xDC00 + (cp & 0x3FF)) & 0xFF;
+            }
+            else
+                *dst++ = cp & 0xFF;
+        }
+    }
+
+    return dst - start;
+}
+
+// -----------------------------------------------------------------------------
+//  low_utf16le_to_internal
+// -----------------------------------------------------------------------------
+
+size_t low_utf16le_to_internal(const unsigned char *src, size_t len,
+                               unsigned char *dst)
+{
+    unsigned char *start = dst;
+    for(size_t i = 0; i + 2 <= len; i += 2)
+        dst = low_internal_put(dst, src[i] | (src[i + 1] << 8));
+    return dst - start;
+}
+
+// -----------------------------------------------------------------------------
+//  low_internal_to_utf16le
+// -----------------------------------------------------------------------------
+
+size_t low_internal_to_utf16le(const unsigned char *src, size_t len,
+                               unsigned char *dst)
+{
+    unsigned char *start = dst;
+    size_t i = 0;
+
+    while(i < len)
+    {
+        int cp = low_internal_next(src, len, &i);
+        if(cp < 0)
+            cp = 0xFFFD;
+        if(cp >= 0x10000)
+        {
+            cp -= 0x10000;
+            int hi = 0xD800 + (cp >> 10), lo = 0xDC00 + (cp & 0x3FF);
+            *dst++ = hi;
+            *dst++ = hi >> 8;
+            cp = lo;
+        }
+        *dst++ = cp;
+        *dst++ = cp >> 8;
+    }
+
+    return dst - start;
+}
@@ -0,0 +1,61 @@
+// -----------------------------------------------------------------------------
+//  low_codec.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_CODEC_H__
+#define __LOW_CODEC_H__
+
+#include <stddef.h>
+
+// Conversions between raw bytes and the representation of strings inside
+// Duktape (UTF-8, with non-BMP characters as surrogate pairs, as CESU-8).
+// None of the functions allocate, the caller passes a destination which is
+// at least as large as the given bound. The return value is the number of
+// bytes written
+
+// Length of the prefix of src which is 7 bit ASCII only
+size_t low_ascii_prefix(const unsigned char *src, size_t len);
+
+// Bound: (len + 2) / 3 * 4. base64url has no padding
+size_t low_base64_encode(const unsigned char *src, size_t len, char *dst,
+                         bool url);
+// Accepts both alphabets, skips other characters as Node.js does and stops
+// at the first '='. Bound: len * 3 / 4 + 3
+size_t low_base64_decode(const char *src, size_t len, unsigned char *dst);
+// Decoded length as Node.js computes it for Buffer.byteLength
+size_t low_base64_decoded_len(const char *src, size_t len);
+
+// Bound: len * 2
+size_t low_hex_encode(const unsigned char *src, size_t len, char *dst);
+// Stops at the first pair which is not hex. Bound: len / 2
+size_t low_hex_decode(const char *src, size_t len, unsigned char *dst);
+
+// Returns true if src can be used as Duktape string as it is, that is, it
+// is valid UTF-8 without 4 byte sequences
+bool low_utf8_is_internal(const unsigned char *src, size_t len);
+// Returns true if src is valid UTF-8
+bool low_utf8_is_valid(const unsigned char *src, size_t len);
+// Invalid sequences become U+FFFD. Bound: len * 3
+size_t low_utf8_to_internal(const unsigned char *src, size_t len,
+                            unsigned char *dst);
+// Surrogate pairs are joined, lone surrogates become U+FFFD. Bound: len
+size_t low_internal_to_utf8(const unsigned char *src, size_t len,
+                            unsigned char *dst);
+// What low_internal_to_utf8 would return
+size_t low_internal_utf8_len(const unsigned char *src, size_t len);
+
+// Bound: len * 2
+size_t low_latin1_to_internal(const unsigned char *src, size_t len,
+                              unsigned char *dst, bool ascii);
+// Low byte of each UTF-16 code unit. Bound: len
+size_t low_internal_to_latin1(const unsigned char *src, size_t len,
+                              unsigned char *dst);
+
+// Bound: len / 2 * 3
+size_t low_utf16le_to_internal(const unsigned char *src, size_t len,
+                               unsigned char *dst);
+// Bound: len * 2
+size_t low_internal_to_utf16le(const unsigned char *src, size_t len,
+                               unsigned char *dst);
+
+#endif /* __LOW_CODEC_H__ */
@@ -4,31 +4,57 @@
 
 #include "low_crypto.h"
 #include "LowCryptoHash.h"
+#include "LowCryptoCipher.h"
 
 #include "low_alloc.h"
+#include "low_system.h"
+
+#include <ctype.h>
+#include <errno.h>
 
 
 // -----------------------------------------------------------------------------
-//  low_crypto_create_hash
+//  low_crypto_upper - mbedtls names are upper case
 // -----------------------------------------------------------------------------
 
-duk_ret_t low_crypto_create_hash(duk_context *ctx)
+static char *low_crypto_upper(duk_context *ctx, const char *type)
 {
-    low_t *low = duk_get_low_context(ctx);
-
-    const char *type = duk_require_string(ctx, 1);
-
     int len = strlen(type);
     char *typeUpper = (char *)low_alloc_throw(ctx, len + 1);
     for(int i = 0; i < len; i++)
         typeUpper[i] = toupper((unsigned)type[i]);
     typeUpper[len] = 0;
+
+    return typeUpper;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_get_md_info
+// -----------------------------------------------------------------------------
+
+static const mbedtls_md_info_t *low_crypto_get_md_info(duk_context *ctx,
+                                                       int index)
+{
+    const char *type = duk_require_string(ctx, index);
+
+    char *typeUpper = low_crypto_upper(ctx, type);
     const mbedtls_md_info_t *info = mbedtls_md_info_from_string(typeUpper);
     low_free(typeUpper);
 
     if(!info)
-        duk_reference_error(
-          low->duk_ctx, "unsupported hashing algorithm %s!", type);
+        duk_reference_error(ctx, "unsupported hashing algorithm %s!", type);
+    return info;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_create_hash
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_create_hash(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    const mbedtls_md_info_t *info = low_crypto_get_md_info(ctx, 1);
 
     unsigned char *key = NULL;
     duk_size_t key_len;
@@ -96,7 +122,12 @@ duk_ret_t low_crypto_hash_update(duk_context *ctx)
     duk_size_t len;
     auto buffer = duk_require_buffer_data(ctx, 1, &len);
 
-    low->cryptoHashes[index]->Update((unsigned char *)buffer, len);
+    // With callback on a data thread, for large chunks of streams
+    if(duk_is_function(ctx, 2))
+        low->cryptoHashes[index]->UpdateAsync((unsigned char *)buffer, len,
+                                              1, 2);
+    else
+        low->cryptoHashes[index]->Update((unsigned char *)buffer, len);
     return 0;
 }
 
@@ -121,6 +152,306 @@ duk_ret_t low_crypto_hash_digest(duk_context *ctx)
 }
 
 
+// -----------------------------------------------------------------------------
+//  low_crypto_hash_file
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_hash_file(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    const char *path = duk_require_string(ctx, 0);
+    const mbedtls_md_info_t *info = low_crypto_get_md_info(ctx, 1);
+    duk_require_function(ctx, 2);
+
+    // Not in low->cryptoHashes, it is always either queued on the data
+    // threads or in the loop, and so cleaned up on reset
+    LowCryptoHash *hash = new LowCryptoHash(low, info, NULL, 0);
+    if(!hash->HashFile(path, 2))
+    {
+        int err = hash->Error();
+        delete hash;
+
+        low_push_error(ctx, err, "open");
+        duk_throw(ctx);
+    }
+    return 0;
+}
+
+
+// -----------------------------------------------------------------------------
+//  low_crypto_get_cipher
+// -----------------------------------------------------------------------------
+
+static LowCryptoCipher *low_crypto_get_cipher(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int index = duk_require_int(ctx, 0);
+    if(index < 0 || index >= low->cryptoCiphers.size()
+    || !low->cryptoCiphers[index])
+        duk_reference_error(ctx, "crypto cipher not found");
+
+    LowCryptoCipher *cipher = low->cryptoCiphers[index];
+    if(cipher->IsBusy())
+        duk_generic_error(ctx, "cipher is busy with an asynchronous update");
+    return cipher;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_get_data - buffer or string argument
+// -----------------------------------------------------------------------------
+
+static unsigned char *low_crypto_get_data(duk_context *ctx, int index,
+                                          duk_size_t &len)
+{
+    unsigned char *data =
+      (unsigned char *)duk_get_buffer_data(ctx, index, &len);
+    if(!data)
+    {
+        data = (unsigned char *)duk_require_string(ctx, index);
+        len = strlen((char *)data);
+    }
+    return data;
+}
+
+
+// -----------------------------------------------------------------------------
+//  low_crypto_create_cipher
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_create_cipher(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    const char *type = duk_require_string(ctx, 1);
+    bool encrypt = duk_require_boolean(ctx, 2);
+
+    char *typeUpper = low_crypto_upper(ctx, type);
+    const mbedtls_cipher_info_t *info =
+      mbedtls_cipher_info_from_string(typeUpper);
+    low_free(typeUpper);
+    if(!info)
+        duk_reference_error(ctx, "Unknown cipher %s", type);
+
+    duk_size_t key_len, iv_len = 0;
+    unsigned char *key = low_crypto_get_data(ctx, 3, key_len);
+    unsigned char *iv = NULL;
+    if(!duk_is_null_or_undefined(ctx, 4))
+        iv = low_crypto_get_data(ctx, 4, iv_len);
+
+    if(key_len * 8 != info->key_bitlen
+    && !(info->flags & MBEDTLS_CIPHER_VARIABLE_KEY_LEN))
+        duk_range_error(ctx, "Invalid key length");
+    if(info->flags & MBEDTLS_CIPHER_VARIABLE_IV_LEN
+       ? (iv_len == 0 || iv_len > MBEDTLS_MAX_IV_LENGTH)
+       : iv_len != info->iv_size)
+        duk_range_error(ctx, "Invalid IV length");
+
+    LowCryptoCipher *cipher = new LowCryptoCipher(low, info, encrypt);
+    int err = cipher->Init(key, key_len, iv, iv_len);
+    if(err != 0)
+    {
+        delete cipher;
+
+        LowCryptoCipher::PushError(ctx, err);
+        duk_throw(ctx);
+    }
+
+    int index;
+    for(index = 0; index < low->cryptoCiphers.size(); index++)
+        if(!low->cryptoCiphers[index])
+        {
+            low->cryptoCiphers[index] = cipher;
+            break;
+        }
+    if(index == low->cryptoCiphers.size())
+        low->cryptoCiphers.push_back(cipher);
+    cipher->SetIndex(index);
+
+    duk_push_int(low->duk_ctx, index);
+    duk_push_c_function(ctx, low_crypto_cipher_finalizer, 1);
+    duk_set_finalizer(ctx, 0);
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_cipher_finalizer
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_cipher_finalizer(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_get_prop_string(ctx, 0, "_native");
+    int index = duk_require_int(ctx, -1);
+
+    if(index < 0 || index >= low->cryptoCiphers.size())
+        duk_reference_error(ctx, "crypto cipher not found");
+
+    delete low->cryptoCiphers[index];
+    return 0;
+}
+
+
+// -----------------------------------------------------------------------------
+//  low_crypto_cipher_update
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_cipher_update(duk_context *ctx)
+{
+    LowCryptoCipher *cipher = low_crypto_get_cipher(ctx);
+
+    duk_size_t in_size, out_size;
+    unsigned char *in =
+      (unsigned char *)duk_require_buffer_data(ctx, 1, &in_size);
+    int inOffset = duk_require_int(ctx, 2);
+    int inLen = duk_require_int(ctx, 3);
+    if(inOffset < 0 || inLen < 0 || inOffset + inLen > in_size)
+        duk_range_error(ctx, "offset/length outside of buffer");
+    in += inOffset;
+
+    // Without output buffer we work in place
+    unsigned char *out = in;
+    int outIndex = 1;
+    if(!duk_is_null_or_undefined(ctx, 4))
+    {
+        out = (unsigned char *)duk_require_buffer_data(ctx, 4, &out_size);
+        int outOffset = duk_require_int(ctx, 5);
+        if(outOffset < 0
+        || outOffset + inLen + MBEDTLS_MAX_BLOCK_LENGTH > out_size)
+            duk_range_error(ctx, "output buffer too small");
+        out += outOffset;
+        outIndex = 4;
+    }
+
+    // With callback on a data thread, for large chunks of streams
+    if(duk_is_function(ctx, 6))
+    {
+        cipher->UpdateAsync(in, inLen, 1, out, outIndex, 6);
+        return 0;
+    }
+
+    int outLen;
+    int err = cipher->Update(in, inLen, out, outLen);
+    if(err != 0)
+    {
+        LowCryptoCipher::PushError(ctx, err);
+        duk_throw(ctx);
+    }
+
+    duk_push_int(ctx, outLen);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_cipher_final
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_cipher_final(duk_context *ctx)
+{
+    LowCryptoCipher *cipher = low_crypto_get_cipher(ctx);
+
+    // At most a held back partial block and a padding block
+    unsigned char out[2 * MBEDTLS_MAX_BLOCK_LENGTH];
+    int outLen;
+    int err = cipher->Final(out, outLen);
+    if(err != 0)
+    {
+        LowCryptoCipher::PushError(ctx, err);
+        duk_throw(ctx);
+    }
+
+    memcpy(low_push_buffer(ctx, outLen), out, outLen);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_cipher_set_aad
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_cipher_set_aad(duk_context *ctx)
+{
+    LowCryptoCipher *cipher = low_crypto_get_cipher(ctx);
+
+    duk_size_t len;
+    unsigned char *data = low_crypto_get_data(ctx, 1, len);
+
+    int err = cipher->SetAAD(data, len);
+    if(err != 0)
+    {
+        LowCryptoCipher::PushError(ctx, err);
+        duk_throw(ctx);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_cipher_set_auto_padding
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_cipher_set_auto_padding(duk_context *ctx)
+{
+    LowCryptoCipher *cipher = low_crypto_get_cipher(ctx);
+
+    int err = cipher->SetAutoPadding(duk_require_boolean(ctx, 1));
+    if(err != 0)
+    {
+        LowCryptoCipher::PushError(ctx, err);
+        duk_throw(ctx);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_cipher_set_auth_tag
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_cipher_set_auth_tag(duk_context *ctx)
+{
+    LowCryptoCipher *cipher = low_crypto_get_cipher(ctx);
+
+    duk_size_t len;
+    unsigned char *data =
+      (unsigned char *)duk_require_buffer_data(ctx, 1, &len);
+
+    int err = cipher->SetAuthTag(data, len);
+    if(err != 0)
+    {
+        if(err == MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA && cipher->IsAEAD())
+            duk_type_error(ctx, "Invalid authentication tag length: %d",
+                           (int)len);
+
+        LowCryptoCipher::PushError(ctx, err);
+        duk_throw(ctx);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_crypto_cipher_get_auth_tag
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_crypto_cipher_get_auth_tag(duk_context *ctx)
+{
+    LowCryptoCipher *cipher = low_crypto_get_cipher(ctx);
+
+    int len = duk_require_int(ctx, 1);
+    if(len < 4 || len > 16)
+        duk_range_error(ctx, "Invalid authentication tag length: %d", len);
+
+    unsigned char *data = (unsigned char *)low_push_buffer(ctx, len);
+    int err = cipher->GetAuthTag(data, len);
+    if(err != 0)
+    {
+        LowCryptoCipher::PushError(ctx, err);
+        duk_throw(ctx);
+    }
+    return 1;
+}
+
+
 // -----------------------------------------------------------------------------
 //  low_crypto_random_bytes
 // -----------------------------------------------------------------------------
@@ -12,6 +12,17 @@ duk_ret_t low_crypto_hash_finalizer(duk_context *ctx);
 
 duk_ret_t low_crypto_hash_update(duk_context *ctx);
 duk_ret_t low_crypto_hash_digest(duk_context *ctx);
+duk_ret_t low_crypto_hash_file(duk_context *ctx);
+
+duk_ret_t low_crypto_create_cipher(duk_context *ctx);
+duk_ret_t low_crypto_cipher_finalizer(duk_context *ctx);
+
+duk_ret_t low_crypto_cipher_update(duk_context *ctx);
+duk_ret_t low_crypto_cipher_final(duk_context *ctx);
+duk_ret_t low_crypto_cipher_set_aad(duk_context *ctx);
+duk_ret_t low_crypto_cipher_set_auto_padding(duk_context *ctx);
+duk_ret_t low_crypto_cipher_set_auth_tag(duk_context *ctx);
+duk_ret_t low_crypto_cipher_get_auth_tag(duk_context *ctx);
 
 duk_ret_t low_crypto_random_bytes(duk_context *ctx);
 
@@ -6,6 +6,7 @@
 #include "LowDataCallback.h"
 
 #include "low_main.h"
+#include "low_system.h"
 
 
 // -----------------------------------------------------------------------------
@@ -60,6 +61,16 @@ void *low_data_thread_main(void *arg)
 
                     callback->mNext = NULL;
                     callback->mInDataThread = true;
+
+                    // Might be the heap of a worker thread
+                    low_t *heap = callback->mLow;
+                    heap->data_callbacks_running++;
+
+                    long long wait = low_micro_count() - callback->mQueuedAt;
+                    heap->metrics.data_jobs++;
+                    heap->metrics.data_wait_total += wait;
+                    if(heap->metrics.data_wait_max < wait)
+                        heap->metrics.data_wait_max = wait;
                     pthread_mutex_unlock(&low->data_thread_mutex);
 
                     if(!callback->OnData())
@@ -76,6 +87,8 @@ void *low_data_thread_main(void *arg)
                     pthread_mutex_lock(&low->data_thread_mutex);
                     if(callback)
                         callback->mInDataThread = false;
+                    heap->data_callbacks_running--;
+                    pthread_cond_broadcast(&low->data_thread_done_cond);
                     goto start;
                 }
             if(low->destroying)
@@ -104,6 +117,7 @@ void *low_data_thread_main(void *arg)
 void low_data_set_callback(low_t *low, LowDataCallback *callback,
                            int priority)
 {
+    low = low->threads;
     pthread_mutex_lock(&low->data_thread_mutex);
 
     if(callback->mNext || low->data_callback_last[0] == callback ||
@@ -118,6 +132,7 @@ void low_data_set_callback(low_t *low, LowDataCallback *callback,
     else
         low->data_callback_first[priority] = callback;
     low->data_callback_last[priority] = callback;
+    callback->mQueuedAt = low_micro_count();
 
     if(!callback->mInDataThread)
         pthread_cond_broadcast(&low->data_thread_cond);
@@ -130,6 +145,7 @@ void low_data_set_callback(low_t *low, LowDataCallback *callback,
 
 void low_data_clear_callback(low_t *low, LowDataCallback *callback)
 {
+    low = low->threads;
     pthread_mutex_lock(&low->data_thread_mutex);
 
     if(low->data_callback_first[0] == callback)
@@ -172,3 +188,54 @@ void low_data_clear_callback(low_t *low, LowDataCallback *callback)
         pthread_cond_wait(&low->data_thread_done_cond, &low->data_thread_mutex);
     pthread_mutex_unlock(&low->data_thread_mutex);
 }
+
+// -----------------------------------------------------------------------------
+//  low_data_clear_heap - deletes the queued callbacks of a heap which is
+//  destroyed and waits for the ones running in a data thread
+// -----------------------------------------------------------------------------
+
+void low_data_clear_heap(low_t *low)
+{
+    low_t *threads = low->threads;
+
+    pthread_mutex_lock(&threads->data_thread_mutex);
+    while(true)
+    {
+        LowDataCallback *found = NULL;
+        for(int priority = 0; priority < 2 && !found; priority++)
+        {
+            LowDataCallback *prev = NULL;
+            for(LowDataCallback *callback =
+                  threads->data_callback_first[priority];
+                callback; prev = callback, callback = callback->mNext)
+                if(callback->mLow == low && !callback->mInDataThread)
+                {
+                    // Unlinked here, so no data thread picks it up
+                    if(prev)
+                        prev->mNext = callback->mNext;
+                    else
+                        threads->data_callback_first[priority] =
+                          callback->mNext;
+                    if(threads->data_callback_last[priority] == callback)
+                        threads->data_callback_last[priority] = prev;
+                    callback->mNext = NULL;
+
+                    found = callback;
+                    break;
+                }
+        }
+
+        if(found)
+        {
+            pthread_mutex_unlock(&threads->data_thread_mutex);
+            delete found;
+            pthread_mutex_lock(&threads->data_thread_mutex);
+        }
+        else if(low->data_callbacks_running)
+            pthread_cond_wait(&threads->data_thread_done_cond,
+                              &threads->data_thread_mutex);
+        else
+            break;
+    }
+    pthread_mutex_unlock(&threads->data_thread_mutex);
+}
@@ -19,5 +19,6 @@ void *low_data_thread_main(void *arg);
 void low_data_set_callback(low_t *low, LowDataCallback *callback,
                            int priority);
 void low_data_clear_callback(low_t *low, LowDataCallback *callback);
+void low_data_clear_heap(low_t *low);
 
 #endif /* __LOW_DATA_THREAD_H__ */
\ No newline at end of file
@@ -0,0 +1,194 @@
+// -----------------------------------------------------------------------------
+//  low_duktape.cpp
+// -----------------------------------------------------------------------------
+
+// Duktape is compiled here, so the helpers can use its internals
+#include "duktape.c"
+
+#include "low_duktape.h"
+
+
+// -----------------------------------------------------------------------------
+//  low_duk_get_buffer
+// -----------------------------------------------------------------------------
+
+bool low_duk_get_buffer(duk_context *ctx, duk_idx_t idx,
+                        low_duk_buffer_t *buffer)
+{
+    duk_hthread *thr = (duk_hthread *)ctx;
+    duk_hbuffer *h_buf;
+
+    duk_tval *tv = duk_get_tval(thr, idx);
+    if(tv && DUK_TVAL_IS_BUFFER(tv))
+    {
+        h_buf = DUK_TVAL_GET_BUFFER(tv);
+        buffer->offset = 0;
+        buffer->length = DUK_HBUFFER_GET_SIZE(h_buf);
+    }
+    else if(tv && DUK_TVAL_IS_OBJECT(tv)
+         && DUK_HOBJECT_IS_BUFOBJ(DUK_TVAL_GET_OBJECT(tv)))
+    {
+        duk_hbufobj *h_bufobj = (duk_hbufobj *)DUK_TVAL_GET_OBJECT(tv);
+        h_buf = h_bufobj->buf;
+        if(!h_buf)
+            return false;
+        buffer->offset = h_bufobj->offset;
+        buffer->length = h_bufobj->length;
+    }
+    else
+        return false;
+
+    buffer->buf = (void *)h_buf;
+    buffer->size = DUK_HBUFFER_GET_SIZE(h_buf);
+    if(DUK_HBUFFER_HAS_DYNAMIC(h_buf) && !DUK_HBUFFER_HAS_EXTERNAL(h_buf))
+        buffer->data = DUK_HBUFFER_DYNAMIC_GET_DATA_PTR(
+          thr->heap, (duk_hbuffer_dynamic *)h_buf);
+    else
+        buffer->data = NULL;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_steal_buffer
+// -----------------------------------------------------------------------------
+
+void *low_duk_steal_buffer(duk_context *ctx, void *buf)
+{
+    duk_size_t size;
+
+    duk_push_heapptr(ctx, buf);
+    void *data = duk_steal_buffer(ctx, -1, &size);
+    duk_pop(ctx);
+
+    return data;
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_push_buffer_data
+// -----------------------------------------------------------------------------
+
+void low_duk_push_buffer_data(duk_context *ctx, void *data, duk_size_t size)
+{
+    duk_hthread *thr = (duk_hthread *)ctx;
+
+    // Without size, Duktape does not allocate any memory
+    duk_push_dynamic_buffer(ctx, 0);
+
+    duk_hbuffer_dynamic *h_buf =
+      (duk_hbuffer_dynamic *)duk_known_hbuffer(thr, -1);
+    DUK_HBUFFER_DYNAMIC_SET_DATA_PTR(thr->heap, h_buf, data);
+    DUK_HBUFFER_DYNAMIC_SET_SIZE(h_buf, size);
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_detach_buffer
+// -----------------------------------------------------------------------------
+
+void low_duk_detach_buffer(duk_context *ctx, duk_idx_t idx)
+{
+    duk_hthread *thr = (duk_hthread *)ctx;
+
+    duk_hobject *h = duk_get_hobject(thr, idx);
+    if(!h || !DUK_HOBJECT_IS_BUFOBJ(h))
+        return;
+
+    duk_hbufobj *h_bufobj = (duk_hbufobj *)h;
+    h_bufobj->offset = 0;
+    h_bufobj->length = 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_string_prop - own string property of an object, without getters
+// -----------------------------------------------------------------------------
+
+static void low_duk_string_prop(duk_heap *heap, duk_hobject *obj,
+                                duk_small_uint_t stridx, const char **str,
+                                duk_size_t *len)
+{
+    duk_tval *tv = duk_hobject_find_entry_tval_ptr_stridx(heap, obj, stridx);
+    if(tv && DUK_TVAL_IS_STRING(tv))
+    {
+        duk_hstring *h_str = DUK_TVAL_GET_STRING(tv);
+        *str = (const char *)DUK_HSTRING_GET_DATA(h_str);
+        *len = DUK_HSTRING_GET_BYTELEN(h_str);
+    }
+    else
+    {
+        *str = NULL;
+        *len = 0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_stack
+// -----------------------------------------------------------------------------
+
+int low_duk_stack(duk_context *ctx, low_duk_frame_t *frames, int max)
+{
+    duk_heap *heap = ((duk_hthread *)ctx)->heap;
+    int depth = 0;
+
+    // A resumed coroutine continues the stack of the thread which resumed it
+    for(duk_hthread *thr = heap->curr_thread; thr && depth < max;
+        thr = thr->resumer)
+        for(duk_activation *act = thr->callstack_curr; act && depth < max;
+            act = act->parent)
+        {
+            low_duk_frame_t &frame = frames[depth++];
+            frame.name = frame.file_name = NULL;
+            frame.name_len = frame.file_name_len = 0;
+            frame.line = frame.start_line = 0;
+
+            duk_hobject *func = act->func;
+            if(!func)
+                continue;   // lightfunc
+            low_duk_string_prop(heap, func, DUK_STRIDX_NAME, &frame.name,
+                                &frame.name_len);
+            if(!DUK_HOBJECT_IS_COMPFUNC(func))
+                continue;
+            low_duk_string_prop(heap, func, DUK_STRIDX_FILE_NAME,
+                                &frame.file_name, &frame.file_name_len);
+
+#if defined(DUK_USE_PC2LINE)
+            duk_tval *tv = duk_hobject_find_entry_tval_ptr_stridx(
+              heap, func, DUK_STRIDX_INT_PC2LINE);
+            if(!tv || !DUK_TVAL_IS_BUFFER(tv))
+                continue;
+            duk_hbuffer_fixed *pc2line =
+              (duk_hbuffer_fixed *)DUK_TVAL_GET_BUFFER(tv);
+
+            // The executor keeps the pc of the innermost activation in a
+            // local variable, see duk_hthread_sync_currpc
+            duk_instr_t *pc = act->curr_pc;
+            if(act == thr->callstack_curr && thr->ptr_curr_pc)
+                pc = *thr->ptr_curr_pc;
+            if(!pc)
+                continue;
+
+            // The pc points to the next instruction, as in
+            // duk_hthread_get_act_prev_pc
+            duk_uint_fast32_t offset =
+              (duk_uint_fast32_t)(pc - DUK_HCOMPFUNC_GET_CODE_BASE(
+                                         heap, (duk_hcompfunc *)func));
+            frame.line = (int)duk__hobject_pc2line_query_raw(
+              thr, pc2line, offset ? offset - 1 : 0);
+            frame.start_line =
+              (int)duk__hobject_pc2line_query_raw(thr, pc2line, 0);
+#endif /* DUK_USE_PC2LINE */
+        }
+
+    return depth;
+}
+
+// -----------------------------------------------------------------------------
+//  low_duk_interrupt
+// -----------------------------------------------------------------------------
+
+void low_duk_interrupt(duk_context *ctx)
+{
+#if defined(DUK_USE_INTERRUPT_COUNTER)
+    // The executor reloads the counter before every instruction. A write
+    // lost to its own decrement only delays the interrupt to the next try
+    *(volatile duk_int_t *)&((duk_hthread *)ctx)->interrupt_counter = 0;
+#endif /* DUK_USE_INTERRUPT_COUNTER */
+}
@@ -0,0 +1,58 @@
+// -----------------------------------------------------------------------------
+//  low_duktape.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_DUKTAPE_H__
+#define __LOW_DUKTAPE_H__
+
+#include "duktape.h"
+
+// Helpers which need the internals of Duktape. low_duktape.cpp compiles
+// Duktape itself, so these are not available to util/dukc
+
+// The memory behind a buffer or buffer object
+struct low_duk_buffer_t
+{
+    void *buf;                  // the plain buffer, as heap pointer
+    void *data;                 // if a dynamic buffer, its memory, else NULL
+    duk_size_t size;            // of the plain buffer
+    duk_size_t offset, length;  // of the value within the plain buffer
+};
+
+// Returns false if the value at idx is no buffer or buffer object
+bool low_duk_get_buffer(duk_context *ctx, duk_idx_t idx,
+                        low_duk_buffer_t *buffer);
+
+// Takes the memory of a dynamic buffer found by low_duk_get_buffer. The
+// buffer is left empty, so all views on it do not have data anymore
+void *low_duk_steal_buffer(duk_context *ctx, void *buf);
+
+// Pushes a dynamic buffer which uses data, allocated for another Duktape
+// heap and handed over with low_duk_block_adopt
+void low_duk_push_buffer_data(duk_context *ctx, void *data, duk_size_t size);
+
+// Makes the buffer object at idx empty, as after a transfer
+void low_duk_detach_buffer(duk_context *ctx, duk_idx_t idx);
+
+// A function on the call stack. The strings are in the internal encoding of
+// Duktape and not terminated, NULL if the function has no such property
+struct low_duk_frame_t
+{
+    const char *name, *file_name;
+    duk_size_t name_len, file_name_len;
+    int line, start_line;       // 1-based, 0 if unknown
+};
+
+// Fills frames with the call stack of the running code, innermost first, and
+// returns their count. Reads the activations directly, so it neither
+// allocates nor uses the Duktape API, and may be called from the executor
+// interrupt and from the allocator. The strings are only valid until
+// Duktape runs again
+int low_duk_stack(duk_context *ctx, low_duk_frame_t *frames, int max);
+
+// Makes the executor call the interrupt before its next instruction, may be
+// called from any native thread. Only works while ctx is the running Duktape
+// thread, as it is for all JavaScript of low.js
+void low_duk_interrupt(duk_context *ctx);
+
+#endif /* __LOW_DUKTAPE_H__ */
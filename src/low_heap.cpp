@@ -0,0 +1,745 @@
+// -----------------------------------------------------------------------------
+//  low_heap.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_heap.h"
+
+#include "low_alloc.h"
+#include "low_codec.h"
+#include "low_config.h"
+#include "low_duktape.h"
+#include "low_main.h"
+#include "low_profiler.h"
+#include "low_system.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Node and edge types of the .heapsnapshot format, in the order of its meta
+// data
+enum
+{
+    LOW_HEAP_NODE_HIDDEN,
+    LOW_HEAP_NODE_ARRAY,
+    LOW_HEAP_NODE_STRING,
+    LOW_HEAP_NODE_OBJECT,
+    LOW_HEAP_NODE_CODE,
+    LOW_HEAP_NODE_CLOSURE,
+    LOW_HEAP_NODE_REGEXP,
+    LOW_HEAP_NODE_NUMBER,
+    LOW_HEAP_NODE_NATIVE,
+    LOW_HEAP_NODE_SYNTHETIC,
+    LOW_HEAP_NODE_CONCATENATED_STRING,
+    LOW_HEAP_NODE_SLICED_STRING,
+    LOW_HEAP_NODE_SYMBOL
+};
+enum
+{
+    LOW_HEAP_EDGE_CONTEXT,
+    LOW_HEAP_EDGE_ELEMENT,
+    LOW_HEAP_EDGE_PROPERTY,
+    LOW_HEAP_EDGE_INTERNAL,
+    LOW_HEAP_EDGE_HIDDEN,
+    LOW_HEAP_EDGE_SHORTCUT,
+    LOW_HEAP_EDGE_WEAK
+};
+
+#define LOW_HEAP_NODE_FIELDS    6
+#define LOW_HEAP_STRING_NAME_MAX 256
+
+struct low_heap_node_t
+{
+    void *ptr;
+    int type, name;
+    double self_size;
+    int edge_count, trace_node;
+};
+
+struct low_heap_walk_t
+{
+    duk_context *ctx;
+    duk_idx_t keep_idx;
+
+    map<void *, int> ids;
+    vector<low_heap_node_t> nodes;
+    vector<int> edges;              // type, name or index, to node
+
+    map<string, int> string_ids;
+    vector<string> strings;
+    int get_name, set_name, proto_name, buffer_name;
+};
+
+// -----------------------------------------------------------------------------
+//  low_heap_sampler_next - bytes until the next sample
+// -----------------------------------------------------------------------------
+
+static long long low_heap_sampler_next(low_heap_sampler_t *sampler)
+{
+    // Exponentially distributed, so every byte has the same chance to be
+    // sampled, whatever the pattern of allocation sizes is
+    double u = (rand_r(&sampler->seed) + 1.0) / ((double)RAND_MAX + 2.0);
+    return (long long)(-log(u) * sampler->interval) + 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_sampler_alloc / low_heap_sampler_free
+// -----------------------------------------------------------------------------
+
+void low_heap_sampler_alloc(low_t *low, void *ptr, size_t size)
+{
+    low_heap_sampler_t *sampler = low->heap_sampler;
+
+    sampler->countdown -= size;
+    if(sampler->countdown > 0)
+        return;
+    sampler->countdown = low_heap_sampler_next(sampler);
+
+    // The stack which allocates, read without the Duktape API. Allocations
+    // of Duktape outside of any call, such as at start up, have none
+    int node = low_profiler_stack(low->duk_ctx, sampler->tree);
+    if(!node)
+        node = low_profiler_child(sampler->tree, 0,
+                                  sampler->unattributed_frame);
+
+    low_heap_sample_t &sample = sampler->live[ptr];
+    sample.size = size;
+    sample.node = node;
+}
+
+void low_heap_sampler_free(low_t *low, void *ptr)
+{
+    low_heap_sampler_t *sampler = low->heap_sampler;
+
+    auto iter = sampler->live.find(ptr);
+    if(iter != sampler->live.end())
+        sampler->live.erase(iter);
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_sampler_destroy
+// -----------------------------------------------------------------------------
+
+void low_heap_sampler_destroy(low_t *low)
+{
+    low_heap_sampler_t *sampler = low->heap_sampler;
+    if(!sampler)
+        return;
+
+    low->heap_sampler = NULL;
+    delete sampler->tree;
+    delete sampler;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_sample_weight - estimated bytes allocated per sample of a size
+// -----------------------------------------------------------------------------
+
+static double low_heap_sample_weight(low_heap_sampler_t *sampler,
+                                     unsigned int size)
+{
+    return size / (1.0 - exp(-(double)size / sampler->interval));
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_sampling_start - native.heapSamplingStart([interval in bytes])
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_heap_sampling_start(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int interval = duk_is_undefined(ctx, 0) ? 0 : duk_require_int(ctx, 0);
+    if(low->heap_sampler)
+        duk_generic_error(ctx, "heap sampling is already running");
+
+    low_heap_sampler_t *sampler = new low_heap_sampler_t();
+    sampler->tree = low_profiler_create(low);
+    sampler->unattributed_frame =
+        low_profiler_special_frame(sampler->tree, "(unattributed)");
+    sampler->interval = interval > 0 ? interval : 32768;
+    sampler->seed = (unsigned int)low_micro_count();
+    sampler->countdown = low_heap_sampler_next(sampler);
+
+    low->heap_sampler = sampler;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_profile_node - writes the call tree in the .heapprofile format
+// -----------------------------------------------------------------------------
+
+static void low_heap_profile_node(string &json, low_profiler_t *tree,
+                                  vector<double> &self_sizes, int id)
+{
+    low_profiler_node_t &node = tree->nodes[id];
+    low_profiler_frame_t &frame = tree->frames[node.frame];
+    char num[64];
+
+    json += "{\"callFrame\":{\"functionName\":";
+    low_profiler_json_string(json, frame.name);
+    json += ",\"scriptId\":\"0\",\"url\":";
+    low_profiler_json_string(json, frame.url);
+    sprintf(num, ",\"lineNumber\":%d,\"columnNumber\":%d},", frame.line,
+            frame.line < 0 ? -1 : 0);
+    json += num;
+    sprintf(num, "\"selfSize\":%.0f,\"id\":%d,\"children\":[",
+            self_sizes[id], id + 1);
+    json += num;
+    for(size_t i = 0; i < node.children.size(); i++)
+    {
+        if(i)
+            json += ',';
+        low_heap_profile_node(json, tree, self_sizes, node.children[i]);
+    }
+    json += "]}";
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_sampling_stop - native.heapSamplingStop(), returns the allocations
+//  which are still alive as JSON text in the .heapprofile format of V8, or
+//  undefined if sampling is not running
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_heap_sampling_stop(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    low_heap_sampler_t *sampler = low->heap_sampler;
+    if(!sampler)
+        return 0;
+
+    low->heap_sampler = NULL;
+
+    vector<double> self_sizes(sampler->tree->nodes.size(), 0.0);
+    for(auto iter = sampler->live.begin(); iter != sampler->live.end(); iter++)
+        self_sizes[iter->second.node] +=
+            low_heap_sample_weight(sampler, iter->second.size);
+
+    string json = "{\"head\":";
+    low_heap_profile_node(json, sampler->tree, self_sizes, 0);
+    json += ",\"samples\":[";
+
+    char num[96];
+    int ordinal = 0;
+    for(auto iter = sampler->live.begin(); iter != sampler->live.end(); iter++)
+    {
+        sprintf(num, "%s{\"size\":%u,\"nodeId\":%d,\"ordinal\":%d}",
+                ordinal ? "," : "", iter->second.size, iter->second.node + 1,
+                ordinal);
+        json += num;
+        ordinal++;
+    }
+    json += "]}";
+
+    low_profiler_free(low, sampler->tree);
+    delete sampler;
+
+    duk_push_lstring(ctx, json.data(), json.size());
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_string - index in the string table of the snapshot
+// -----------------------------------------------------------------------------
+
+static int low_heap_string(low_heap_walk_t &w, const char *str, size_t len)
+{
+    // Duktape keeps non-BMP characters as surrogate pairs, JSON must be UTF-8
+    string utf8;
+    utf8.resize(len);
+    utf8.resize(low_internal_to_utf8((const unsigned char *)str, len,
+                                     (unsigned char *)&utf8[0]));
+
+    auto iter = w.string_ids.find(utf8);
+    if(iter != w.string_ids.end())
+        return iter->second;
+
+    int id = w.strings.size();
+    w.strings.push_back(utf8);
+    w.string_ids[utf8] = id;
+    return id;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_key_name - readable name of a property key, symbols included
+// -----------------------------------------------------------------------------
+
+static string low_heap_key_name(const char *str, size_t len, bool *hidden)
+{
+    unsigned char first = len ? (unsigned char)str[0] : 0;
+    *hidden = false;
+
+    if(first == 0x80 || first == 0x81)
+    {
+        // Global and local symbols, the description ends at the next marker
+        size_t end = 1;
+        while(end < len && (unsigned char)str[end] != 0xFF
+              && (unsigned char)str[end] != 0x81)
+            end++;
+        return "Symbol(" + string(str + 1, end - 1) + ")";
+    }
+    if(first == 0x82 || first == 0xFF)
+    {
+        // Hidden symbols of low.js and internal properties of Duktape
+        *hidden = true;
+        return "<" + string(str + 1, len - 1) + ">";
+    }
+    return string(str, len);
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_node - node id of the value at idx, added if new
+// -----------------------------------------------------------------------------
+
+static int low_heap_node(low_heap_walk_t &w, duk_idx_t idx)
+{
+    duk_context *ctx = w.ctx;
+    void *ptr = duk_get_heapptr(ctx, idx);
+    if(!ptr)
+        return -1;
+
+    auto iter = w.ids.find(ptr);
+    if(iter != w.ids.end())
+        return iter->second;
+
+    low_heap_node_t node;
+    node.ptr = ptr;
+    node.type = LOW_HEAP_NODE_HIDDEN;
+    node.name = 0;
+    node.self_size = 0;
+    node.edge_count = 0;
+    node.trace_node = 0;
+
+    int id = w.nodes.size();
+    w.nodes.push_back(node);
+    w.ids[ptr] = id;
+
+    // Finalizers might drop the last reference while we walk, so we keep
+    // every value we have seen alive until the snapshot is written
+    idx = duk_normalize_index(ctx, idx);
+    duk_dup(ctx, idx);
+    duk_put_prop_index(ctx, w.keep_idx, id);
+    return id;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_edge
+// -----------------------------------------------------------------------------
+
+static void low_heap_edge(low_heap_walk_t &w, int from, int type,
+                          int name_or_index, duk_idx_t to_idx)
+{
+    int to = low_heap_node(w, to_idx);
+    if(to < 0)
+        return;
+
+    w.edges.push_back(type);
+    w.edges.push_back(name_or_index);
+    w.edges.push_back(to);
+    w.nodes[from].edge_count++;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_own_value - pushes an own data property without calling getters
+//  or proxy traps, undefined if there is none
+// -----------------------------------------------------------------------------
+
+static void low_heap_own_value(duk_context *ctx, duk_idx_t obj_idx,
+                               const char *key)
+{
+    duk_push_string(ctx, key);
+    duk_get_prop_desc(ctx, obj_idx, 0);
+    if(duk_is_object(ctx, -1))
+        duk_get_prop_string(ctx, -1, "value");
+    else
+        duk_push_undefined(ctx);
+    duk_remove(ctx, -2);
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_inspect_size - memory used by the value itself
+// -----------------------------------------------------------------------------
+
+static double low_heap_inspect_size(duk_context *ctx, duk_idx_t idx)
+{
+    static const char *fields[] = {"hbytes", "pbytes", "bcbytes", "dbytes"};
+    double size = 0;
+
+    duk_inspect_value(ctx, idx);
+    for(int i = 0; i < 4; i++)
+    {
+        duk_get_prop_string(ctx, -1, fields[i]);
+        size += duk_get_number_default(ctx, -1, 0);
+        duk_pop(ctx);
+    }
+    duk_pop(ctx);
+    return size;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_visit - describes a node and adds its outgoing edges
+// -----------------------------------------------------------------------------
+
+static void low_heap_visit(low_heap_walk_t &w, int id)
+{
+    duk_context *ctx = w.ctx;
+
+    duk_push_heapptr(ctx, w.nodes[id].ptr);
+    duk_idx_t obj_idx = duk_get_top_index(ctx);
+
+    double size = low_heap_inspect_size(ctx, obj_idx);
+    int type;
+    string name;
+
+    int duk_type = duk_get_type(ctx, obj_idx);
+    if(duk_type == DUK_TYPE_STRING)
+    {
+        duk_size_t len;
+        const char *str = duk_get_lstring(ctx, obj_idx, &len);
+        unsigned char first = len ? (unsigned char)str[0] : 0;
+
+        if(first >= 0x80 && (first <= 0x82 || first == 0xFF))
+        {
+            bool hidden;
+            type = LOW_HEAP_NODE_SYMBOL;
+            name = low_heap_key_name(str, len, &hidden);
+        }
+        else
+        {
+            type = LOW_HEAP_NODE_STRING;
+            name.assign(str, len < LOW_HEAP_STRING_NAME_MAX
+                             ? len : LOW_HEAP_STRING_NAME_MAX);
+        }
+    }
+    else if(duk_type == DUK_TYPE_BUFFER)
+    {
+        type = LOW_HEAP_NODE_NATIVE;
+        name = "(buffer)";
+    }
+    else if(duk_type == DUK_TYPE_OBJECT)
+    {
+        if(duk_is_thread(ctx, obj_idx))
+        {
+            type = LOW_HEAP_NODE_NATIVE;
+            name = "(thread)";
+        }
+        else if(duk_is_function(ctx, obj_idx))
+        {
+            type = LOW_HEAP_NODE_CLOSURE;
+            low_heap_own_value(ctx, obj_idx, "name");
+            if(duk_is_string(ctx, -1))
+                name = duk_get_string(ctx, -1);
+            duk_pop(ctx);
+            if(name.empty())
+                name = "(anonymous)";
+        }
+        else
+        {
+            // Name of the constructor, as V8 does it
+            type = LOW_HEAP_NODE_OBJECT;
+            duk_get_prototype(ctx, obj_idx);
+            if(duk_is_object(ctx, -1))
+            {
+                low_heap_own_value(ctx, -1, "constructor");
+                if(duk_is_function(ctx, -1))
+                {
+                    low_heap_own_value(ctx, -1, "name");
+                    if(duk_is_string(ctx, -1))
+                        name = duk_get_string(ctx, -1);
+                    duk_pop(ctx);
+                }
+                duk_pop(ctx);
+            }
+            duk_pop(ctx);
+            if(name.empty())
+                name = "Object";
+        }
+
+        low_duk_buffer_t buffer;
+        if(low_duk_get_buffer(ctx, obj_idx, &buffer))
+        {
+            // Enumerating would list every byte. The data is counted once,
+            // by the plain buffer all views on it point to
+            duk_push_heapptr(ctx, buffer.buf);
+            low_heap_edge(w, id, LOW_HEAP_EDGE_INTERNAL, w.buffer_name, -1);
+            duk_pop(ctx);
+        }
+        else
+        {
+            bool is_array = duk_is_array(ctx, obj_idx);
+
+            duk_enum(ctx, obj_idx,
+                     DUK_ENUM_OWN_PROPERTIES_ONLY
+                     | DUK_ENUM_INCLUDE_NONENUMERABLE
+                     | DUK_ENUM_INCLUDE_HIDDEN | DUK_ENUM_INCLUDE_SYMBOLS
+                     | DUK_ENUM_NO_PROXY_BEHAVIOR);
+            while(duk_next(ctx, -1, 0))
+            {
+                duk_size_t len;
+                const char *key = duk_get_lstring(ctx, -1, &len);
+
+                int edge_type, name_or_index;
+                char *end = NULL;
+                unsigned long index = key && len && key[0] >= '0'
+                                      && key[0] <= '9'
+                                      ? strtoul(key, &end, 10) : 0;
+                if(is_array && key && len && key[0] >= '0' && key[0] <= '9'
+                && end == key + len)
+                {
+                    edge_type = LOW_HEAP_EDGE_ELEMENT;
+                    name_or_index = (int)index;
+                }
+                else
+                {
+                    bool hidden;
+                    string key_name = low_heap_key_name(key ? key : "",
+                                                        key ? len : 0,
+                                                        &hidden);
+                    edge_type = hidden ? LOW_HEAP_EDGE_HIDDEN
+                                       : LOW_HEAP_EDGE_PROPERTY;
+                    name_or_index = low_heap_string(w, key_name.data(),
+                                                    key_name.size());
+                }
+
+                duk_dup(ctx, -1);
+                duk_get_prop_desc(ctx, obj_idx, 0);
+                if(duk_is_object(ctx, -1))
+                {
+                    duk_get_prop_string(ctx, -1, "value");
+                    low_heap_edge(w, id, edge_type, name_or_index, -1);
+                    duk_pop(ctx);
+
+                    // Accessors are internal edges, named after the property
+                    duk_get_prop_string(ctx, -1, "get");
+                    low_heap_edge(w, id, LOW_HEAP_EDGE_INTERNAL, w.get_name,
+                                  -1);
+                    duk_pop(ctx);
+                    duk_get_prop_string(ctx, -1, "set");
+                    low_heap_edge(w, id, LOW_HEAP_EDGE_INTERNAL, w.set_name,
+                                  -1);
+                    duk_pop(ctx);
+                }
+                duk_pop_2(ctx);
+            }
+            duk_pop(ctx);
+        }
+
+        duk_get_prototype(ctx, obj_idx);
+        low_heap_edge(w, id, LOW_HEAP_EDGE_INTERNAL, w.proto_name, -1);
+        duk_pop(ctx);
+    }
+    else
+    {
+        type = LOW_HEAP_NODE_HIDDEN;
+        name = "(unknown)";
+    }
+    duk_pop(ctx);
+
+    w.nodes[id].type = type;
+    w.nodes[id].name = low_heap_string(w, name.data(), name.size());
+    w.nodes[id].self_size = size;
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_write_trace_node - allocation call tree in the trace_tree format
+// -----------------------------------------------------------------------------
+
+static void low_heap_write_trace_node(FILE *f, low_profiler_t *tree,
+                                      vector<int> &counts,
+                                      vector<double> &sizes, int id)
+{
+    low_profiler_node_t &node = tree->nodes[id];
+
+    fprintf(f, "%d,%d,%d,%.0f,[", id + 1, node.frame, counts[id], sizes[id]);
+    for(size_t i = 0; i < node.children.size(); i++)
+    {
+        if(i)
+            fputc(',', f);
+        low_heap_write_trace_node(f, tree, counts, sizes, node.children[i]);
+    }
+    fputc(']', f);
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_write - writes the walked heap in the .heapsnapshot format
+// -----------------------------------------------------------------------------
+
+static bool low_heap_write(low_heap_walk_t &w, low_heap_sampler_t *sampler,
+                           FILE *f)
+{
+    low_profiler_t *tree = sampler ? sampler->tree : NULL;
+
+    // Function infos and the call tree come first in our string table
+    vector<int> info_names, info_urls;
+    if(tree)
+        for(size_t i = 0; i < tree->frames.size(); i++)
+        {
+            low_profiler_frame_t &frame = tree->frames[i];
+            info_names.push_back(low_heap_string(w, frame.name.data(),
+                                                 frame.name.size()));
+            info_urls.push_back(low_heap_string(w, frame.url.data(),
+                                                frame.url.size()));
+        }
+
+    fprintf(f, "{\"snapshot\":{\"meta\":{"
+               "\"node_fields\":[\"type\",\"name\",\"id\",\"self_size\","
+               "\"edge_count\",\"trace_node_id\"],"
+               "\"node_types\":[[\"hidden\",\"array\",\"string\",\"object\","
+               "\"code\",\"closure\",\"regexp\",\"number\",\"native\","
+               "\"synthetic\",\"concatenated string\",\"sliced string\","
+               "\"symbol\",\"bigint\"],\"string\",\"number\",\"number\","
+               "\"number\",\"number\",\"number\"],"
+               "\"edge_fields\":[\"type\",\"name_or_index\",\"to_node\"],"
+               "\"edge_types\":[[\"context\",\"element\",\"property\","
+               "\"internal\",\"hidden\",\"shortcut\",\"weak\"],"
+               "\"string_or_number\",\"node\"],"
+               "\"trace_function_info_fields\":[\"function_id\",\"name\","
+               "\"script_name\",\"script_id\",\"line\",\"column\"],"
+               "\"trace_node_fields\":[\"id\",\"function_info_index\","
+               "\"count\",\"size\",\"children\"],"
+               "\"sample_fields\":[\"timestamp_us\",\"last_assigned_id\"],"
+               "\"location_fields\":[\"object_index\",\"script_id\","
+               "\"line\",\"column\"]},"
+               "\"node_count\":%d,\"edge_count\":%d,"
+               "\"trace_function_count\":%d},\n",
+            (int)w.nodes.size(), (int)(w.edges.size() / 3),
+            tree ? (int)tree->frames.size() : 0);
+
+    fprintf(f, "\"nodes\":[");
+    for(size_t i = 0; i < w.nodes.size(); i++)
+    {
+        low_heap_node_t &node = w.nodes[i];
+        fprintf(f, "%s%d,%d,%d,%.0f,%d,%d\n", i ? "," : "", node.type,
+                node.name, (int)i * 2 + 1, node.self_size, node.edge_count,
+                node.trace_node);
+    }
+    fprintf(f, "],\n\"edges\":[");
+    for(size_t i = 0; i < w.edges.size(); i += 3)
+        fprintf(f, "%s%d,%d,%d\n", i ? "," : "", w.edges[i], w.edges[i + 1],
+                w.edges[i + 2] * LOW_HEAP_NODE_FIELDS);
+
+    fprintf(f, "],\n\"trace_function_infos\":[");
+    if(tree)
+        for(size_t i = 0; i < tree->frames.size(); i++)
+            fprintf(f, "%s%d,%d,%d,0,%d,%d\n", i ? "," : "", (int)i,
+                    info_names[i], info_urls[i], tree->frames[i].line + 1,
+                    tree->frames[i].line < 0 ? 0 : 1);
+    fprintf(f, "],\n\"trace_tree\":[");
+    if(tree)
+    {
+        vector<int> counts(tree->nodes.size(), 0);
+        vector<double> sizes(tree->nodes.size(), 0.0);
+        for(auto iter = sampler->live.begin(); iter != sampler->live.end();
+            iter++)
+        {
+            counts[iter->second.node]++;
+            sizes[iter->second.node] +=
+                low_heap_sample_weight(sampler, iter->second.size);
+        }
+        low_heap_write_trace_node(f, tree, counts, sizes, 0);
+    }
+    fprintf(f, "],\n\"samples\":[],\n\"locations\":[],\n\"strings\":[");
+
+    string json;
+    for(size_t i = 0; i < w.strings.size(); i++)
+    {
+        json.clear();
+        if(i)
+            json += ",\n";
+        low_profiler_json_string(json, w.strings[i]);
+        fwrite(json.data(), 1, json.size(), f);
+    }
+    fprintf(f, "]}\n");
+
+    return !ferror(f);
+}
+
+// -----------------------------------------------------------------------------
+//  low_heap_snapshot - native.heapSnapshot(path)
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_heap_snapshot(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    const char *path = duk_require_string(ctx, 0);
+
+    FILE *f = fopen(path, "w");
+    if(!f)
+    {
+        low_push_error(ctx, errno, "open");
+        duk_throw(ctx);
+    }
+
+    // Only what is alive, as V8 does it
+#if LOW_ESP32_LWIP_SPECIALITIES
+    duk_gc(ctx, 0);
+#else
+    low_gc_run(low, LOW_GC_REASON_EXPLICIT);
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+
+    low_heap_walk_t w;
+    w.ctx = ctx;
+    duk_push_array(ctx);
+    w.keep_idx = duk_get_top_index(ctx);
+
+    // The empty string first, V8 has it there as well
+    low_heap_string(w, "", 0);
+    w.get_name = low_heap_string(w, "get", 3);
+    w.set_name = low_heap_string(w, "set", 3);
+    w.proto_name = low_heap_string(w, "__proto__", 9);
+    w.buffer_name = low_heap_string(w, "(buffer)", 8);
+
+    low_heap_node_t root;
+    root.ptr = NULL;
+    root.type = LOW_HEAP_NODE_SYNTHETIC;
+    root.name = low_heap_string(w, "(root)", 6);
+    root.self_size = 0;
+    root.edge_count = 0;
+    root.trace_node = 0;
+    w.nodes.push_back(root);
+
+    duk_push_global_object(ctx);
+    low_heap_edge(w, 0, LOW_HEAP_EDGE_SHORTCUT,
+                  low_heap_string(w, "global", 6), -1);
+    duk_pop(ctx);
+    duk_push_global_stash(ctx);
+    low_heap_edge(w, 0, LOW_HEAP_EDGE_INTERNAL,
+                  low_heap_string(w, "(stash)", 7), -1);
+    duk_pop(ctx);
+    duk_push_heap_stash(ctx);
+    low_heap_edge(w, 0, LOW_HEAP_EDGE_INTERNAL,
+                  low_heap_string(w, "(heap stash)", 12), -1);
+    duk_pop(ctx);
+
+    // Breadth first, so the edges are in the order of their nodes
+    for(size_t i = 1; i < w.nodes.size(); i++)
+        low_heap_visit(w, i);
+
+    if(low->heap_sampler)
+        for(size_t i = 1; i < w.nodes.size(); i++)
+        {
+            auto iter = low->heap_sampler->live.find(w.nodes[i].ptr);
+            if(iter != low->heap_sampler->live.end())
+                w.nodes[i].trace_node = iter->second.node + 1;
+        }
+
+    bool ok = low_heap_write(w, low->heap_sampler, f);
+    int err = errno;
+    if(fclose(f) != 0 && ok)
+    {
+        ok = false;
+        err = errno;
+    }
+    duk_pop(ctx);
+
+    if(!ok)
+    {
+        low_push_error(ctx, err, "write");
+        duk_throw(ctx);
+    }
+    return 0;
+}
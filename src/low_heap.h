@@ -0,0 +1,48 @@
+// -----------------------------------------------------------------------------
+//  low_heap.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_HEAP_H__
+#define __LOW_HEAP_H__
+
+#include "duktape.h"
+
+#include <map>
+
+using namespace std;
+
+struct low_t;
+struct low_profiler_t;
+
+struct low_heap_sample_t
+{
+    unsigned int size;
+    int node;           // in the call tree
+};
+
+// Allocation sampling. On average one allocation every interval bytes is
+// sampled, and kept track of until it is freed again
+struct low_heap_sampler_t
+{
+    low_profiler_t *tree;
+    int unattributed_frame;
+
+    double interval;
+    long long countdown;
+    unsigned int seed;
+
+    map<void *, low_heap_sample_t> live;
+};
+
+// Called by low_duk_alloc / low_duk_realloc / low_duk_free. Must not use the
+// Duktape API, the heap may be in the middle of a change
+void low_heap_sampler_alloc(low_t *low, void *ptr, size_t size);
+void low_heap_sampler_free(low_t *low, void *ptr);
+
+void low_heap_sampler_destroy(low_t *low);
+
+duk_ret_t low_heap_sampling_start(duk_context *ctx);
+duk_ret_t low_heap_sampling_stop(duk_context *ctx);
+duk_ret_t low_heap_snapshot(duk_context *ctx);
+
+#endif /* __LOW_HEAP_H__ */
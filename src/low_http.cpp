@@ -4,7 +4,11 @@
 
 #include "low_http.h"
 
+#include "LowFile.h"
 #include "LowHTTPDirect.h"
+#include "LowHTTPPool.h"
+#include "LowHTTPRouter.h"
+#include "LowServerSocket.h"
 #include "LowSocket.h"
 
 #include "low_alloc.h"
@@ -12,6 +16,11 @@
 #include "low_system.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 // -----------------------------------------------------------------------------
 //  low_http_get_request
@@ -32,14 +41,23 @@ duk_ret_t low_http_get_request(duk_context *ctx)
 
     int directType;
     LowHTTPDirect *direct = (LowHTTPDirect *)socket->GetDirect(directType);
-    if(direct && directType == 0)
+    if(direct && directType == 0 && !direct->IsServer())
+    {
+        // Client version, next request on a connection of the pool
+        direct->Init();
+        direct->SetRequestCallID(low_add_stash(ctx, 1));
+    }
+    else if(direct && directType == 0)
     {
         // Server version
+        direct->SetTimeouts(duk_get_int_default(ctx, 2, 0),
+                            duk_get_int_default(ctx, 3, 0));
         direct->SetRequestCallID(low_add_stash(ctx, 1));
     }
     else if(!direct)
     {
-        // Client version
+        // Client version, with agent the direct stays attached after the
+        // response, see LowHTTPPool
         direct = new LowHTTPDirect(low, false);
         if(!direct)
         {
@@ -48,6 +66,7 @@ duk_ret_t low_http_get_request(duk_context *ctx)
             low_call_next_tick(ctx, 1);
             return 0;
         }
+        direct->SetPooled(duk_get_boolean_default(ctx, 2, false));
 
         socket->SetDirect(direct, 0);
         direct->SetRequestCallID(low_add_stash(ctx, 1));
@@ -121,6 +140,68 @@ duk_ret_t low_http_read(duk_context *ctx)
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+//  low_http_pipe_body
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pipe_body(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int socketFD = duk_require_int(ctx, 0);
+    int fileFD = duk_require_int(ctx, 1);
+
+    auto iter = low->fds.find(fileFD);
+    if(iter == low->fds.end())
+        duk_reference_error(ctx, "file descriptor not found");
+    if(iter->second->FDType() != LOWFD_TYPE_FILE)
+        duk_reference_error(ctx, "file descriptor is not a file");
+
+    iter = low->fds.find(socketFD);
+    if(iter == low->fds.end())
+        return 0;
+
+    if(iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        duk_reference_error(ctx, "file descriptor is not a socket");
+    LowSocket *socket = (LowSocket *)iter->second;
+
+    int directType;
+    LowHTTPDirect *http = (LowHTTPDirect *)socket->GetDirect(directType);
+    if(!http || directType != 0)
+    {
+        duk_dup(ctx, 2);
+        duk_push_error_object(ctx, DUK_ERR_ERROR, "file descriptor is not HTTP stream / HTTP error");
+        low_call_next_tick(low->duk_ctx, 1);
+        return 0;
+    }
+
+    http->PipeBody(fileFD, 2);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pipe_progress - bytes written to the file so far
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pipe_progress(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    int socketFD = duk_require_int(ctx, 0);
+
+    auto iter = low->fds.find(socketFD);
+    if(iter == low->fds.end() || iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        return 0;
+
+    int directType;
+    LowHTTPDirect *http =
+      (LowHTTPDirect *)((LowSocket *)iter->second)->GetDirect(directType);
+    if(!http || directType != 0)
+        return 0;
+
+    duk_push_number(ctx, (double)http->PipeBytes());
+    return 1;
+}
+
 // -----------------------------------------------------------------------------
 //  low_http_write
 // -----------------------------------------------------------------------------
@@ -157,6 +238,227 @@ duk_ret_t low_http_write(duk_context *ctx)
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+//  Pre-encoded parts of response headers
+// -----------------------------------------------------------------------------
+
+struct low_http_status_t
+{
+    int code;
+    const char *line;
+    int len;
+};
+
+#define LOW_HTTP_STATUS(code, text)                                            \
+    {                                                                          \
+        code, "HTTP/1.1 " #code " " text "\r\n",                               \
+          sizeof("HTTP/1.1 " #code " " text "\r\n") - 1                        \
+    }
+
+// Same as STATUS_CODES in lib_js/internal/http.js, sorted by code
+static const low_http_status_t g_low_http_status[] = {
+  LOW_HTTP_STATUS(100, "Continue"),
+  LOW_HTTP_STATUS(101, "Switching Protocols"),
+  LOW_HTTP_STATUS(102, "Processing"),
+  LOW_HTTP_STATUS(103, "Early Hints"),
+  LOW_HTTP_STATUS(200, "OK"),
+  LOW_HTTP_STATUS(201, "Created"),
+  LOW_HTTP_STATUS(202, "Accepted"),
+  LOW_HTTP_STATUS(203, "Non-Authoritative Information"),
+  LOW_HTTP_STATUS(204, "No Content"),
+  LOW_HTTP_STATUS(205, "Reset Content"),
+  LOW_HTTP_STATUS(206, "Partial Content"),
+  LOW_HTTP_STATUS(207, "Multi-Status"),
+  LOW_HTTP_STATUS(208, "Already Reported"),
+  LOW_HTTP_STATUS(226, "IM Used"),
+  LOW_HTTP_STATUS(300, "Multiple Choices"),
+  LOW_HTTP_STATUS(301, "Moved Permanently"),
+  LOW_HTTP_STATUS(302, "Found"),
+  LOW_HTTP_STATUS(303, "See Other"),
+  LOW_HTTP_STATUS(304, "Not Modified"),
+  LOW_HTTP_STATUS(305, "Use Proxy"),
+  LOW_HTTP_STATUS(307, "Temporary Redirect"),
+  LOW_HTTP_STATUS(308, "Permanent Redirect"),
+  LOW_HTTP_STATUS(400, "Bad Request"),
+  LOW_HTTP_STATUS(401, "Unauthorized"),
+  LOW_HTTP_STATUS(402, "Payment Required"),
+  LOW_HTTP_STATUS(403, "Forbidden"),
+  LOW_HTTP_STATUS(404, "Not Found"),
+  LOW_HTTP_STATUS(405, "Method Not Allowed"),
+  LOW_HTTP_STATUS(406, "Not Acceptable"),
+  LOW_HTTP_STATUS(407, "Proxy Authentication Required"),
+  LOW_HTTP_STATUS(408, "Request Timeout"),
+  LOW_HTTP_STATUS(409, "Conflict"),
+  LOW_HTTP_STATUS(410, "Gone"),
+  LOW_HTTP_STATUS(411, "Length Required"),
+  LOW_HTTP_STATUS(412, "Precondition Failed"),
+  LOW_HTTP_STATUS(413, "Payload Too Large"),
+  LOW_HTTP_STATUS(414, "URI Too Long"),
+  LOW_HTTP_STATUS(415, "Unsupported Media Type"),
+  LOW_HTTP_STATUS(416, "Range Not Satisfiable"),
+  LOW_HTTP_STATUS(417, "Expectation Failed"),
+  LOW_HTTP_STATUS(418, "I'm a Teapot"),
+  LOW_HTTP_STATUS(421, "Misdirected Request"),
+  LOW_HTTP_STATUS(422, "Unprocessable Entity"),
+  LOW_HTTP_STATUS(423, "Locked"),
+  LOW_HTTP_STATUS(424, "Failed Dependency"),
+  LOW_HTTP_STATUS(425, "Unordered Collection"),
+  LOW_HTTP_STATUS(426, "Upgrade Required"),
+  LOW_HTTP_STATUS(428, "Precondition Required"),
+  LOW_HTTP_STATUS(429, "Too Many Requests"),
+  LOW_HTTP_STATUS(431, "Request Header Fields Too Large"),
+  LOW_HTTP_STATUS(451, "Unavailable For Legal Reasons"),
+  LOW_HTTP_STATUS(500, "Internal Server Error"),
+  LOW_HTTP_STATUS(501, "Not Implemented"),
+  LOW_HTTP_STATUS(502, "Bad Gateway"),
+  LOW_HTTP_STATUS(503, "Service Unavailable"),
+  LOW_HTTP_STATUS(504, "Gateway Timeout"),
+  LOW_HTTP_STATUS(505, "HTTP Version Not Supported"),
+  LOW_HTTP_STATUS(506, "Variant Also Negotiates"),
+  LOW_HTTP_STATUS(507, "Insufficient Storage"),
+  LOW_HTTP_STATUS(508, "Loop Detected"),
+  LOW_HTTP_STATUS(509, "Bandwidth Limit Exceeded"),
+  LOW_HTTP_STATUS(510, "Not Extended"),
+  LOW_HTTP_STATUS(511, "Network Authentication Required"),
+};
+
+struct low_http_line_t
+{
+    const char *line;
+    int len;
+};
+
+#define LOW_HTTP_LINE(text)                                                    \
+    {                                                                          \
+        text, sizeof(text) - 1                                                 \
+    }
+
+// Index i is added with flag 1 << i, see LOW_HTTP_HEAD_*
+static const low_http_line_t g_low_http_lines[] = {
+  LOW_HTTP_LINE("Connection: keep-alive\r\n"),
+  LOW_HTTP_LINE("Connection: close\r\n"),
+  LOW_HTTP_LINE("Transfer-Encoding: chunked\r\n")};
+
+// Well-known header names, lower case and sorted. Header blocks refer to
+// them by index, and JavaScript keeps them in one array, so they are not
+// interned again for every request
+static const char *const g_low_http_header_names[] = {
+  "accept", "accept-charset", "accept-encoding", "accept-language",
+  "accept-ranges", "access-control-request-headers",
+  "access-control-request-method", "age", "authorization", "cache-control",
+  "connection", "content-disposition", "content-encoding", "content-language",
+  "content-length", "content-location", "content-range", "content-type",
+  "cookie", "date", "dnt", "etag", "expect", "expires", "forwarded", "from",
+  "host", "if-match", "if-modified-since", "if-none-match", "if-range",
+  "if-unmodified-since", "keep-alive", "last-modified", "link", "location",
+  "max-forwards", "origin", "pragma", "proxy-authorization", "range",
+  "referer", "retry-after", "sec-fetch-dest", "sec-fetch-mode",
+  "sec-fetch-site", "sec-fetch-user", "sec-websocket-extensions",
+  "sec-websocket-key", "sec-websocket-protocol", "sec-websocket-version",
+  "server", "set-cookie", "te", "trailer", "transfer-encoding", "upgrade",
+  "upgrade-insecure-requests", "user-agent", "vary", "via",
+  "www-authenticate", "x-forwarded-for", "x-forwarded-host",
+  "x-forwarded-proto", "x-real-ip", "x-request-id", "x-requested-with"};
+
+#define LOW_HTTP_NUM_HEADER_NAMES                                              \
+    (int)(sizeof(g_low_http_header_names) / sizeof(const char *))
+
+static pthread_mutex_t g_low_http_date_mutex = PTHREAD_MUTEX_INITIALIZER;
+static time_t g_low_http_date_time;
+static char g_low_http_date[48];
+static int g_low_http_date_len;
+
+// -----------------------------------------------------------------------------
+//  low_http_date - Date header line, formatted at most once per second
+// -----------------------------------------------------------------------------
+
+static int low_http_date(char *line)
+{
+    static const char *days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+    static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                   "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+    // Without a set clock (ESP32 before SNTP) we are in 1970, better no date
+    time_t now = time(NULL);
+    if(now < 946684800) // 2000-01-01
+        return 0;
+
+    pthread_mutex_lock(&g_low_http_date_mutex);
+    if(now != g_low_http_date_time)
+    {
+        struct tm tm;
+        gmtime_r(&now, &tm);
+
+        g_low_http_date_len = sprintf(g_low_http_date,
+            "Date: %s, %02d %s %04d %02d:%02d:%02d GMT\r\n",
+            days[tm.tm_wday], tm.tm_mday, months[tm.tm_mon],
+            tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        g_low_http_date_time = now;
+    }
+    int len = g_low_http_date_len;
+    memcpy(line, g_low_http_date, len);
+    pthread_mutex_unlock(&g_low_http_date_mutex);
+
+    return len;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_head_lines - lines selected by LOW_HTTP_HEAD_* flags, line must
+//  have room for 128 bytes
+// -----------------------------------------------------------------------------
+
+int low_http_head_lines(char *line, int flags)
+{
+    int len = 0;
+    for(int i = 0; i < (int)(sizeof(g_low_http_lines) / sizeof(low_http_line_t)); i++)
+        if(flags & (1 << i))
+        {
+            memcpy(line + len, g_low_http_lines[i].line, g_low_http_lines[i].len);
+            len += g_low_http_lines[i].len;
+        }
+    if(flags & LOW_HTTP_HEAD_DATE)
+        len += low_http_date(line + len);
+
+    return len;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_head_add - appends to the header buffer of the connection
+// -----------------------------------------------------------------------------
+
+static bool low_http_head_add(LowHTTPDirect *http,
+                              int &pos,
+                              const char *txt,
+                              int len)
+{
+    char *data = http->HeadBuffer(pos + len + 1);
+    if(!data)
+        return false;
+
+    memcpy(data + pos, txt, len);
+    pos += len;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_head_add_header
+// -----------------------------------------------------------------------------
+
+static bool low_http_head_add_header(duk_context *ctx,
+                                     LowHTTPDirect *http,
+                                     int &pos,
+                                     const char *name,
+                                     duk_size_t nameLen)
+{
+    duk_size_t valueLen;
+    const char *value = duk_to_lstring(ctx, -1, &valueLen);
+
+    return low_http_head_add(http, pos, name, nameLen) &&
+           low_http_head_add(http, pos, ": ", 2) &&
+           low_http_head_add(http, pos, value, valueLen) &&
+           low_http_head_add(http, pos, "\r\n", 2);
+}
+
 // -----------------------------------------------------------------------------
 //  low_http_write_head
 // -----------------------------------------------------------------------------
@@ -166,9 +468,10 @@ duk_ret_t low_http_write_head(duk_context *ctx)
     low_t *low = duk_get_low_context(ctx);
 
     int socketFD = duk_require_int(ctx, 0);
-    const char *headers = duk_require_string(ctx, 1);
-    int len = duk_require_int(ctx, 2);
-    bool isChunked = duk_require_boolean(ctx, 3);
+    int len = duk_require_int(ctx, 3);
+    bool isChunked = duk_require_boolean(ctx, 4);
+    int compressMode = duk_get_int_default(ctx, 5, 0);
+    int flags = duk_get_int_default(ctx, 6, 0);
 
     auto iter = low->fds.find(socketFD);
     if(iter == low->fds.end())
@@ -186,7 +489,461 @@ duk_ret_t low_http_write_head(duk_context *ctx)
         low_call_next_tick(low->duk_ctx, 1);
         return 0;
     }
+    if(!http->CanWriteHeaders())
+        return 0;
+
+    // Straight into the buffer we write from, no string in between
+    int pos = 0;
+    bool ok;
+    if(duk_is_number(ctx, 1))
+    {
+        int code = duk_get_int(ctx, 1);
 
-    http->WriteHeaders(headers, 1, len, isChunked);
+        int num = sizeof(g_low_http_status) / sizeof(low_http_status_t);
+        int lo = 0, hi = num;
+        while(lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if(g_low_http_status[mid].code < code)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if(lo < num && g_low_http_status[lo].code == code)
+            ok = low_http_head_add(http, pos, g_low_http_status[lo].line,
+                                   g_low_http_status[lo].len);
+        else
+        {
+            char line[48];
+            ok = low_http_head_add(http, pos, line,
+                                   sprintf(line, "HTTP/1.1 %d unknown\r\n", code));
+        }
+    }
+    else
+    {
+        duk_size_t lineLen;
+        const char *line = duk_require_lstring(ctx, 1, &lineLen);
+        ok = low_http_head_add(http, pos, line, lineLen) &&
+             low_http_head_add(http, pos, "\r\n", 2);
+    }
+
+    duk_uarridx_t count = duk_is_array(ctx, 2) ? duk_get_length(ctx, 2) : 0;
+    for(duk_uarridx_t i = 0; ok && i + 1 < count; i += 2)
+    {
+        duk_get_prop_index(ctx, 2, i);
+        duk_size_t nameLen;
+        const char *name = duk_to_lstring(ctx, -1, &nameLen);
+
+        duk_get_prop_index(ctx, 2, i + 1);
+        if(duk_is_array(ctx, -1))
+        {
+            // One line per value, the only way for Set-Cookie
+            duk_uarridx_t valueCount = duk_get_length(ctx, -1);
+            for(duk_uarridx_t j = 0; ok && j < valueCount; j++)
+            {
+                duk_get_prop_index(ctx, -1, j);
+                ok = low_http_head_add_header(ctx, http, pos, name, nameLen);
+                duk_pop(ctx);
+            }
+        }
+        else
+            ok = low_http_head_add_header(ctx, http, pos, name, nameLen);
+        duk_pop_2(ctx);
+    }
+
+    if(ok && flags)
+    {
+        char line[128];
+        ok = low_http_head_add(http, pos, line, low_http_head_lines(line, flags));
+    }
+    ok = ok && low_http_head_add(http, pos, "\r\n", 3);   // with \0
+    if(!ok)
+    {
+        low_push_error(ctx, ENOMEM, "malloc");
+        duk_throw(ctx);
+    }
+
+    if(!http->WriteHeaders(http->HeadBuffer(0), -1, len, isChunked, compressMode))
+    {
+        low_push_error(ctx, ENOMEM, "deflateInit");
+        duk_throw(ctx);
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_header_index - index of well-known header name or -1
+// -----------------------------------------------------------------------------
+
+int low_http_header_index(const char *name, int len)
+{
+    int lo = 0, hi = LOW_HTTP_NUM_HEADER_NAMES;
+    while(lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        // name is not null-terminated
+        int cmp = strncmp(g_low_http_header_names[mid], name, len);
+        if(cmp == 0 && g_low_http_header_names[mid][len])
+            cmp = 1;
+
+        if(cmp < 0)
+            lo = mid + 1;
+        else if(cmp > 0)
+            hi = mid;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_header_names
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_header_names(duk_context *ctx)
+{
+    duk_push_array(ctx);
+    for(int i = 0; i < LOW_HTTP_NUM_HEADER_NAMES; i++)
+    {
+        duk_push_string(ctx, g_low_http_header_names[i]);
+        duk_put_prop_index(ctx, -2, i);
+    }
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_raw_headers - header block to [name, value, ...]
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_raw_headers(duk_context *ctx)
+{
+    // Index 1 is the array returned by httpHeaderNames
+    duk_size_t len;
+    unsigned char *block =
+      (unsigned char *)duk_require_buffer_data(ctx, 0, &len);
+
+    duk_push_array(ctx);
+    duk_uarridx_t arr_ind = 0;
+    duk_size_t pos = 0;
+    while(pos + 2 <= len)
+    {
+        int tag = block[pos++];
+        if(tag == LOW_HTTP_HEADER_LITERAL)
+        {
+            int n = block[pos++];
+            if(pos + n + 1 > len)
+                break;
+            duk_push_lstring(ctx, (char *)block + pos, n);
+            pos += n;
+        }
+        else
+            duk_get_prop_index(ctx, 1, tag);
+        duk_put_prop_index(ctx, -2, arr_ind++);
+
+        int n = block[pos++];
+        if(pos + n > len)
+            break;
+        duk_push_lstring(ctx, (char *)block + pos, n);
+        duk_put_prop_index(ctx, -2, arr_ind++);
+        pos += n;
+    }
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_header - first value of a header in a header block
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_header(duk_context *ctx)
+{
+    duk_size_t len, nameLen;
+    unsigned char *block =
+      (unsigned char *)duk_require_buffer_data(ctx, 0, &len);
+    const char *name = duk_require_lstring(ctx, 1, &nameLen);
+
+    int index = low_http_header_index(name, nameLen);
+    duk_size_t pos = 0;
+    while(pos + 2 <= len)
+    {
+        int tag = block[pos++];
+        bool found;
+        if(tag == LOW_HTTP_HEADER_LITERAL)
+        {
+            int n = block[pos++];
+            if(pos + n + 1 > len)
+                break;
+            found = index < 0 && n == (int)nameLen &&
+                    memcmp(block + pos, name, n) == 0;
+            pos += n;
+        }
+        else
+            found = tag == index;
+
+        int n = block[pos++];
+        if(pos + n > len)
+            break;
+        if(found)
+        {
+            duk_push_lstring(ctx, (char *)block + pos, n);
+            return 1;
+        }
+        pos += n;
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_routes - replaces the native routes of an HTTP server with the
+//  given [method, path, type, handler id / body / file name, head] entries
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_routes(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int serverFD = duk_require_int(ctx, 0);
+    bool keepAlive = duk_require_boolean(ctx, 1);
+    duk_uarridx_t count = duk_get_length(ctx, 2);
+
+    auto iter = low->fds.find(serverFD);
+    if(iter == low->fds.end())
+        return 0;
+
+    if(iter->second->FDType() != LOWFD_TYPE_SERVER)
+        duk_reference_error(ctx, "file descriptor is not a server");
+    LowHTTPRouter *router = ((LowServerSocket *)iter->second)->Router();
+    if(!router)
+        duk_reference_error(ctx, "file descriptor is not an HTTP server");
+
+    // Check first, so nothing throws while we build the tree
+    for(duk_uarridx_t i = 0; i < count; i++)
+    {
+        duk_get_prop_index(ctx, 2, i);
+        duk_get_prop_index(ctx, -1, 0);
+        duk_require_string(ctx, -1);
+        duk_get_prop_index(ctx, -2, 1);
+        duk_require_string(ctx, -1);
+        duk_get_prop_index(ctx, -3, 2);
+        int type = duk_require_int(ctx, -1);
+        duk_get_prop_index(ctx, -4, 3);
+        if(type == LOWHTTPROUTE_JS)
+            duk_require_int(ctx, -1);
+        else if(type == LOWHTTPROUTE_FILE)
+            duk_require_string(ctx, -1);
+        else if(type != LOWHTTPROUTE_STATIC)
+            duk_range_error(ctx, "unknown route type");
+        duk_pop_n(ctx, 5);
+    }
+
+    LowHTTPRouterNode *root = NULL;
+    for(duk_uarridx_t i = 0; i < count; i++)
+    {
+        duk_get_prop_index(ctx, 2, i);
+        duk_get_prop_index(ctx, -1, 0);
+        duk_get_prop_index(ctx, -2, 1);
+        duk_get_prop_index(ctx, -3, 2);
+        duk_get_prop_index(ctx, -4, 3);
+        duk_get_prop_index(ctx, -5, 4);
+
+        LowHTTPRoute *route =
+          LowHTTPRouter::NewRoute((LowHTTPRoute_Type)duk_get_int(ctx, -3));
+        if(!route)
+            goto err_nomem;
+
+        if(route->type == LOWHTTPROUTE_JS)
+            route->id = duk_get_int(ctx, -2);
+        else
+        {
+            duk_size_t len;
+            const char *head = duk_to_lstring(ctx, -1, &len);
+            route->head = (char *)low_alloc(len);
+            if(!route->head)
+            {
+                LowHTTPRouter::FreeRoute(route);
+                goto err_nomem;
+            }
+            memcpy(route->head, head, len);
+            route->headLen = len;
+        }
+
+        if(route->type == LOWHTTPROUTE_STATIC)
+        {
+            duk_size_t len;
+            const char *body = duk_is_buffer_data(ctx, -2)
+                             ? (const char *)duk_get_buffer_data(ctx, -2, &len)
+                             : duk_to_lstring(ctx, -2, &len);
+            route->body = (char *)low_alloc(len ? len : 1);
+            if(!route->body)
+            {
+                LowHTTPRouter::FreeRoute(route);
+                goto err_nomem;
+            }
+            memcpy(route->body, body, len);
+            route->bodyLen = len;
+        }
+        else if(route->type == LOWHTTPROUTE_FILE)
+        {
+            // Opened once, every response reads with its own position
+            route->fd = open(duk_get_string(ctx, -2), O_RDONLY);
+            if(route->fd < 0)
+            {
+                int err = errno;
+                LowHTTPRouter::FreeRoute(route);
+                LowHTTPRouter::FreeTree(root);
+                low_push_error(ctx, err, "open");
+                duk_throw(ctx);
+            }
+        }
+
+        if(!LowHTTPRouter::Insert(root, duk_get_string(ctx, -5),
+                                  duk_get_string(ctx, -4), route))
+        {
+            LowHTTPRouter::FreeRoute(route);
+            goto err_nomem;
+        }
+        duk_pop_n(ctx, 6);
+    }
+
+    router->SetRoutes(root, keepAlive);
+    return 0;
+
+err_nomem:
+    LowHTTPRouter::FreeTree(root);
+    low_push_error(ctx, ENOMEM, "malloc");
+    duk_throw(ctx);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_get - pool of the object at index
+// -----------------------------------------------------------------------------
+
+static LowHTTPPool *low_http_pool_get(duk_context *ctx, int index)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_get_prop_string(ctx, index, "_index");
+    int poolIndex = duk_require_int(ctx, -1);
+    duk_pop(ctx);
+    if(poolIndex < 0 || poolIndex >= low->httpPools.size() ||
+       !low->httpPools[poolIndex])
+        duk_reference_error(ctx, "http pool not found");
+
+    return low->httpPools[poolIndex];
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_create
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pool_create(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    // Infinity is clamped
+    LowHTTPPool *pool = new LowHTTPPool(low, duk_require_int(ctx, 0),
+                                        duk_require_int(ctx, 1),
+                                        duk_require_int(ctx, 2));
+    if(!pool)
+    {
+        low_push_error(ctx, ENOMEM, "malloc");
+        duk_throw(ctx);
+    }
+
+    int index;
+    for(index = 0; index < low->httpPools.size(); index++)
+        if(!low->httpPools[index])
+        {
+            low->httpPools[index] = pool;
+            break;
+        }
+    if(index == low->httpPools.size())
+        low->httpPools.push_back(pool);
+    pool->SetIndex(index);
+
+    duk_push_object(ctx);
+    duk_push_int(ctx, index);
+    duk_put_prop_string(ctx, -2, "_index");
+
+    duk_push_c_function(ctx, low_http_pool_finalizer, 1);
+    duk_set_finalizer(ctx, -2);
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_finalizer
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pool_finalizer(duk_context *ctx)
+{
+    low_http_pool_get(ctx, 0)->DecRef();
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_set_evict - the function which destroys idle sockets the
+//  pools do not keep any more, gets the file descriptor
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pool_set_evict(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_require_function(ctx, 0);
+    if(low->http_evict_call_id)
+        low_remove_stash(ctx, low->http_evict_call_id);
+    low->http_evict_call_id = low_add_stash(ctx, 0);
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_lease
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pool_lease(duk_context *ctx)
+{
+    LowHTTPPool *pool = low_http_pool_get(ctx, 0);
+    const char *key = duk_require_string(ctx, 1);
+    duk_require_function(ctx, 2);
+
+    duk_push_int(ctx, pool->Lease(key, 2));
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_release
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pool_release(duk_context *ctx)
+{
+    LowHTTPPool *pool = low_http_pool_get(ctx, 0);
+    const char *key = duk_require_string(ctx, 1);
+
+    duk_push_int(ctx, pool->Release(key, duk_require_int(ctx, 2)));
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_remove
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pool_remove(duk_context *ctx)
+{
+    LowHTTPPool *pool = low_http_pool_get(ctx, 0);
+    pool->Remove(duk_require_string(ctx, 1));
+
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http_pool_close
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http_pool_close(duk_context *ctx)
+{
+    low_http_pool_get(ctx, 0)->Close();
+    return 0;
+}
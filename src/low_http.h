@@ -8,12 +8,44 @@
 
 #include "duktape.h"
 
+// Flags for the headers which httpWriteHead adds from pre-encoded lines
+#define LOW_HTTP_HEAD_KEEP_ALIVE 1
+#define LOW_HTTP_HEAD_CLOSE 2
+#define LOW_HTTP_HEAD_CHUNKED 4
+#define LOW_HTTP_HEAD_DATE 8
+
+int low_http_head_lines(char *line, int flags);
+
+// Header block, as LowHTTPDirect delivers the headers of a request or a
+// response. Per header a tag byte, which is the index of a well-known name
+// or LOW_HTTP_HEADER_LITERAL followed by length byte and name. Then length
+// byte and value
+#define LOW_HTTP_HEADER_LITERAL 0xFF
+
+int low_http_header_index(const char *name, int len);
+
 duk_ret_t low_http_get_request(duk_context *ctx);
 duk_ret_t low_http_detach(duk_context *ctx);
 
 duk_ret_t low_http_read(duk_context *ctx);
+duk_ret_t low_http_pipe_body(duk_context *ctx);
+duk_ret_t low_http_pipe_progress(duk_context *ctx);
 
 duk_ret_t low_http_write(duk_context *ctx);
 duk_ret_t low_http_write_head(duk_context *ctx);
 
+duk_ret_t low_http_routes(duk_context *ctx);
+
+duk_ret_t low_http_pool_create(duk_context *ctx);
+duk_ret_t low_http_pool_finalizer(duk_context *ctx);
+duk_ret_t low_http_pool_set_evict(duk_context *ctx);
+duk_ret_t low_http_pool_lease(duk_context *ctx);
+duk_ret_t low_http_pool_release(duk_context *ctx);
+duk_ret_t low_http_pool_remove(duk_context *ctx);
+duk_ret_t low_http_pool_close(duk_context *ctx);
+
+duk_ret_t low_http_header_names(duk_context *ctx);
+duk_ret_t low_http_raw_headers(duk_context *ctx);
+duk_ret_t low_http_header(duk_context *ctx);
+
 #endif /* __LOW_HTTP_H__ */
\ No newline at end of file
@@ -0,0 +1,206 @@
+// -----------------------------------------------------------------------------
+//  low_http2.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_http2.h"
+#include "low_http.h"
+
+#include "LowHTTP2Direct.h"
+#include "LowSocket.h"
+
+#include "low_alloc.h"
+#include "low_codec.h"
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------
+//  low_http2_get - the HTTP/2 connection on the socket, NULL if the socket is
+//  closed or speaks HTTP/1
+// -----------------------------------------------------------------------------
+
+static LowHTTP2Direct *low_http2_get(duk_context *ctx, int socketFD)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    auto iter = low->fds.find(socketFD);
+    if(iter == low->fds.end() || iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        return NULL;
+    LowSocket *socket = (LowSocket *)iter->second;
+
+    int directType;
+    LowSocketDirect *direct = socket->GetDirect(directType);
+    if(!direct || directType != LOWHTTP2DIRECT_TYPE)
+        return NULL;
+    return (LowHTTP2Direct *)direct;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http2_string - string at index as UTF-8
+// -----------------------------------------------------------------------------
+
+static const char *low_http2_string(duk_context *ctx, duk_idx_t index,
+                                    int &len)
+{
+    duk_size_t size;
+    const unsigned char *str =
+      (const unsigned char *)duk_to_lstring(ctx, index, &size);
+
+    // Strings without surrogate pairs are UTF-8 already
+    if(!low_utf8_is_internal(str, size))
+    {
+        int utf8Len = low_internal_utf8_len(str, size);
+        unsigned char *utf8 =
+          (unsigned char *)duk_push_fixed_buffer(ctx, utf8Len);
+        low_internal_to_utf8(str, size, utf8);
+        duk_replace(ctx, index);
+
+        str = utf8;
+        size = utf8Len;
+    }
+    len = size;
+    return (const char *)str;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http2_attach - (socketFD, callback), returns false if the client did
+//  not choose HTTP/2
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http2_attach(duk_context *ctx)
+{
+    int socketFD = duk_require_int(ctx, 0);
+    duk_require_function(ctx, 1);
+
+    LowHTTP2Direct *direct = low_http2_get(ctx, socketFD);
+    if(!direct)
+    {
+        duk_push_false(ctx);
+        return 1;
+    }
+
+    direct->SetCallID(low_add_stash(ctx, 1));
+    duk_push_true(ctx);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http2_respond - (socketFD, streamID, status, headers, end, flags),
+//  headers is a flat array of names and values. flags: LOW_HTTP_HEAD_DATE.
+//  Returns false if the stream is gone
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http2_respond(duk_context *ctx)
+{
+    LowHTTP2Direct *direct = low_http2_get(ctx, duk_require_int(ctx, 0));
+    int id = duk_require_int(ctx, 1);
+    int status = duk_require_int(ctx, 2);
+    bool end = duk_require_boolean(ctx, 4);
+    int flags = duk_get_int_default(ctx, 5, 0);
+    if(!direct)
+    {
+        duk_push_false(ctx);
+        return 1;
+    }
+
+    LowHTTP2Direct_Buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    bool ok = LowHTTP2Direct::EncodeStatus(buf, status);
+
+    if(duk_is_array(ctx, 3))
+    {
+        int count = duk_get_length(ctx, 3);
+        for(int i = 0; ok && i + 1 < count; i += 2)
+        {
+            duk_get_prop_index(ctx, 3, i);
+            duk_get_prop_index(ctx, 3, i + 1);
+
+            int nameLen, valueLen;
+            const char *name = low_http2_string(ctx, -2, nameLen);
+            const char *value = low_http2_string(ctx, -1, valueLen);
+
+            // Names are lower case in HTTP/2, connection specific headers
+            // are not allowed
+            char *lower = (char *)duk_push_fixed_buffer(ctx, nameLen);
+            for(int j = 0; j < nameLen; j++)
+                lower[j] = name[j] >= 'A' && name[j] <= 'Z' ? name[j] + 32
+                                                            : name[j];
+            if(!((nameLen == 10 && memcmp(lower, "connection", 10) == 0)
+              || (nameLen == 10 && memcmp(lower, "keep-alive", 10) == 0)
+              || (nameLen == 17 && memcmp(lower, "transfer-encoding", 17) == 0)
+              || (nameLen == 7 && memcmp(lower, "upgrade", 7) == 0)))
+                ok = LowHTTP2Direct::EncodeHeader(buf, lower, nameLen, value,
+                                                  valueLen);
+            duk_pop_3(ctx);
+        }
+    }
+    if(ok && (flags & LOW_HTTP_HEAD_DATE))
+    {
+        // "Date: " and "\r\n" around the value
+        char line[128];
+        int len = low_http_head_lines(line, LOW_HTTP_HEAD_DATE);
+        if(len > 8)
+            ok = LowHTTP2Direct::EncodeHeader(buf, "date", 4, line + 6,
+                                              len - 8);
+    }
+    if(!ok)
+    {
+        low_free(buf.data);
+        low_push_error(ctx, ENOMEM, "malloc");
+        duk_throw(ctx);
+    }
+
+    ok = direct->Respond(id, buf.data, buf.len, end);
+    low_free(buf.data);
+
+    duk_push_boolean(ctx, ok);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http2_write - (socketFD, streamID, data, end), data may be undefined.
+//  Returns 1 if the caller should wait for the drain event, -1 if the stream
+//  is gone
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http2_write(duk_context *ctx)
+{
+    LowHTTP2Direct *direct = low_http2_get(ctx, duk_require_int(ctx, 0));
+    int id = duk_require_int(ctx, 1);
+    bool end = duk_require_boolean(ctx, 3);
+    if(!direct)
+    {
+        duk_push_int(ctx, -1);
+        return 1;
+    }
+
+    const unsigned char *data = NULL;
+    int len = 0;
+    if(duk_is_string(ctx, 2))
+        data = (const unsigned char *)low_http2_string(ctx, 2, len);
+    else if(!duk_is_undefined(ctx, 2))
+    {
+        duk_size_t size;
+        data = (const unsigned char *)duk_require_buffer_data(ctx, 2, &size);
+        len = size;
+    }
+
+    duk_push_int(ctx, direct->Write(id, data, len, end));
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_http2_reset - (socketFD, streamID, code)
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_http2_reset(duk_context *ctx)
+{
+    LowHTTP2Direct *direct = low_http2_get(ctx, duk_require_int(ctx, 0));
+    int id = duk_require_int(ctx, 1);
+    int code = duk_get_int_default(ctx, 2, LOWHTTP2_CANCEL);
+
+    duk_push_boolean(ctx, direct && direct->Reset(id, code));
+    return 1;
+}
@@ -0,0 +1,16 @@
+// -----------------------------------------------------------------------------
+//  low_http2.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_HTTP2_H__
+#define __LOW_HTTP2_H__
+
+#include "duktape.h"
+
+duk_ret_t low_http2_attach(duk_context *ctx);
+
+duk_ret_t low_http2_respond(duk_context *ctx);
+duk_ret_t low_http2_write(duk_context *ctx);
+duk_ret_t low_http2_reset(duk_context *ctx);
+
+#endif /* __LOW_HTTP2_H__ */
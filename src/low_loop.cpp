@@ -7,6 +7,8 @@
 
 #include "low_config.h"
 #include "low_main.h"
+#include "low_metrics.h"
+#include "low_profiler.h"
 #include "low_system.h"
 
 #include <errno.h>
@@ -33,6 +35,7 @@ duk_ret_t low_loop_run_safe(duk_context *ctx, void *udata)
             int num_args = duk_require_int(low->next_tick_ctx, -1);
             duk_pop(low->next_tick_ctx);
             duk_xmove_top(ctx, low->next_tick_ctx, num_args + 1);
+            low->metrics.next_ticks++;
             duk_call(ctx, num_args);
             duk_pop_n(ctx, duk_get_top(ctx));
         }
@@ -99,6 +102,7 @@ duk_ret_t low_loop_run_safe(duk_context *ctx, void *udata)
             callback->mNext = NULL;
 
             pthread_mutex_unlock(&low->loop_thread_mutex);
+            low->metrics.loop_callbacks++;
             if(!callback->OnLoop())
                 delete callback;
 
@@ -123,6 +127,11 @@ duk_ret_t low_loop_run_safe(duk_context *ctx, void *udata)
             {
                 low->last_chore_time = iter->first;
 
+                low->metrics.timers++;
+                low->metrics.timer_late_total -= millisecs;
+                if(low->metrics.timer_late_max < -millisecs)
+                    low->metrics.timer_late_max = -millisecs;
+
                 int index = iter->second;
                 low->chore_times.erase(iter);
 
@@ -170,6 +179,14 @@ duk_ret_t low_loop_run_safe(duk_context *ctx, void *udata)
         }
 
 #if !LOW_ESP32_LWIP_SPECIALITIES
+        // Nothing to do, good time to collect garbage before the heap
+        // reaches the limit and an allocation has to do it
+        if(!low->loop_callback_first && low_gc_idle(low, millisecs))
+        {
+            duk_pop_n(ctx, duk_get_top(ctx));
+            continue;
+        }
+
         pthread_mutex_lock(&low->loop_thread_mutex);
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
         if(!low->loop_callback_first)
@@ -177,7 +194,10 @@ duk_ret_t low_loop_run_safe(duk_context *ctx, void *udata)
 #if LOW_ESP32_LWIP_SPECIALITIES || defined(LOWJS_SERV)
             user_cpu_load(false);
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
+            low_metrics_idle_begin(low);
             low_loop_wait(ctx, millisecs);
+            low_metrics_idle_end(low);
+            low_profiler_idle(low);
 #if LOW_ESP32_LWIP_SPECIALITIES || defined(LOWJS_SERV)
             user_cpu_load(true);
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
@@ -7,16 +7,28 @@
 
 #include "low_data_thread.h"
 #include "low_web_thread.h"
+#include "low_profiler.h"
+#include "low_heap.h"
 
 #include "LowCryptoHash.h"
+#include "LowCryptoCipher.h"
 #include "LowDataCallback.h"
 #include "LowFD.h"
+#include "LowHTTPPool.h"
 #include "LowLoopCallback.h"
 #include "LowSocket.h"
 #include "LowTLSContext.h"
+#include "LowWorker.h"
+#if LOW_INCLUDE_ZLIB
+#include "LowZlib.h"
+#endif /* LOW_INCLUDE_ZLIB */
+#if LOW_INCLUDE_CHILD_PROCESS
+#include "LowChildProcess.h"
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
 
 #include "low_alloc.h"
 #include "low_config.h"
+#include "low_slab.h"
 #include "low_system.h"
 
 #include "low_native_api.h"
@@ -48,7 +60,7 @@ extern low_system_t g_low_system;
 //  low_init
 // -----------------------------------------------------------------------------
 
-low_t *low_init()
+low_t *low_init(low_t *parent)
 {
 #if LOW_INCLUDE_CARES_RESOLVER
     int err = ares_library_init_mem(
@@ -74,11 +86,28 @@ low_t *low_init()
 #if !LOW_ESP32_LWIP_SPECIALITIES
     low->heap_size = 0;
     low->max_heap_size = 512 * 1024 * 1024;
+#if LOW_USE_SLAB_ALLOC
+    // Address space is reserved as the heap grows, if that fails the
+    // blocks come from malloc
+    low->slab = low_slab_create();
+#endif /* LOW_USE_SLAB_ALLOC */
+
+    low->gc_requested = false;
+    low->gc_soft_at = low->gc_hard_at = 0;
+    low->gc_last_end = 0;
+    low->gc_idle_count = low->gc_forced_count = low->gc_explicit_count = 0;
+    low->gc_total_pause = low->gc_max_pause = 0;
+    low->gc_last_pause = low->gc_idle_pause = 0;
+    low->alloc_count = 0;
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
     low->in_gc = false;
     low->disallow_native = false;
+    low_metrics_init(low);
+    low->profiler = NULL;
+    low->heap_sampler = NULL;
 
     low->web_thread = NULL;
+    low->web_deadline_first = low->web_deadline_last = NULL;
     for(int i = 0; i < LOW_NUM_DATA_THREADS; i++)
         low->data_thread[i] = NULL;
 
@@ -94,6 +123,9 @@ low_t *low_init()
     {
         fprintf(stderr, "Cannot initialize Duktape heap\n");
 
+#if LOW_USE_SLAB_ALLOC
+        low_slab_destroy(low->slab);
+#endif /* LOW_USE_SLAB_ALLOC */
         low_free(low);
 #if LOW_INCLUDE_CARES_RESOLVER
         ares_library_cleanup();
@@ -105,6 +137,12 @@ low_t *low_init()
     low->run_ref = 0;
     low->last_stash_index = 0;
     low->signal_call_id = 0;
+    low->http_evict_call_id = 0;
+    low->read_arena_data = NULL;
+    low->read_arena_id = low->read_arena_pos = 0;
+#if LOW_INCLUDE_WORKER_THREADS
+    low->worker = NULL;
+#endif /* LOW_INCLUDE_WORKER_THREADS */
     low->web_thread_done = false;
     low->data_thread_done = false;
     low->last_chore_time = low_tick_count();
@@ -209,6 +247,22 @@ low_t *low_init()
 
     low->data_callback_first[0] = low->data_callback_last[0] = NULL;
     low->data_callback_first[1] = low->data_callback_last[1] = NULL;
+    low->data_callbacks_running = 0;
+    low->web_changed_first = low->web_changed_last = NULL;
+    low->reset_accepts = false;
+
+    // Worker threads share the web and data threads of the process
+    low->threads = parent ? parent->threads : low;
+    if(parent)
+    {
+#if LOW_INCLUDE_CARES_RESOLVER
+        pthread_mutex_lock(&low->threads->resolvers_mutex);
+        low->threads->thread_heaps.push_back(low);
+        pthread_mutex_unlock(&low->threads->resolvers_mutex);
+#endif /* LOW_INCLUDE_CARES_RESOLVER */
+        goto threads_done;
+    }
+
     for(int i = 0; i < LOW_NUM_DATA_THREADS; i++)
     {
 #if LOW_ESP32_LWIP_SPECIALITIES
@@ -253,7 +307,6 @@ low_t *low_init()
     }
 
     low->web_thread_done = false;
-    low->reset_accepts = false;
 #if !LOW_ESP32_LWIP_SPECIALITIES
     if(pipe(low->web_thread_pipe) < 0)
     {
@@ -385,6 +438,7 @@ low_t *low_init()
         goto err;
     }
 
+threads_done:
     new LowSocket(low, 0);
     new LowSocket(low, 1);
     new LowSocket(low, 2);
@@ -400,7 +454,9 @@ low_t *low_init()
         return NULL;
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
 #if !LOW_ESP32_LWIP_SPECIALITIES
-    g_low_system.signal_pipe_fd = low->web_thread_pipe[1];
+    // Signals go to the main thread, not to workers
+    if(!parent && g_low_system.signal_pipe_fd < 0)
+        g_low_system.signal_pipe_fd = low->web_thread_pipe[1];
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
     low->in_uncaught_exception = false;
 
@@ -409,6 +465,9 @@ low_t *low_init()
 err:
 #if !LOW_ESP32_LWIP_SPECIALITIES
     duk_destroy_heap(low->duk_ctx);
+#if LOW_USE_SLAB_ALLOC
+    low_slab_destroy(low->slab);
+#endif /* LOW_USE_SLAB_ALLOC */
     low_free(low);
 #if LOW_INCLUDE_CARES_RESOLVER
     ares_library_cleanup();
@@ -453,6 +512,13 @@ extern "C" void alloc_use_fund();
 
 bool low_reset(low_t *low)
 {
+#if LOW_INCLUDE_WORKER_THREADS
+    // Workers use our loop, so they go first
+    for(int i = 0; i < low->workers.size(); i++)
+        if(low->workers[i])
+            delete low->workers[i];
+#endif /* LOW_INCLUDE_WORKER_THREADS */
+
     low->duk_flag_stop = 1;
 
     low->destroying = true;
@@ -591,11 +657,30 @@ bool low_reset(low_t *low)
     for(int i = 0; i < low->tlsContexts.size(); i++)
         if(low->tlsContexts[i])
             delete low->tlsContexts[i];
+    for(int i = 0; i < low->httpPools.size(); i++)
+        if(low->httpPools[i])
+            delete low->httpPools[i];
     for(int i = 0; i < low->cryptoHashes.size(); i++)
         if(low->cryptoHashes[i])
             delete low->cryptoHashes[i];
+    for(int i = 0; i < low->cryptoCiphers.size(); i++)
+        if(low->cryptoCiphers[i])
+            delete low->cryptoCiphers[i];
+#if LOW_INCLUDE_ZLIB
+    for(int i = 0; i < low->zlibStreams.size(); i++)
+        if(low->zlibStreams[i])
+            delete low->zlibStreams[i];
+#endif /* LOW_INCLUDE_ZLIB */
+#if LOW_INCLUDE_CHILD_PROCESS
+    for(int i = 0; i < low->childProcesses.size(); i++)
+        if(low->childProcesses[i])
+            delete low->childProcesses[i];
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
 
     low->duk_ctx = new_ctx;
+    low->http_evict_call_id = 0;
+    low->read_arena_data = NULL;
+    low->read_arena_id = 0;
 
     low->chores.clear();
     low->chore_times.clear();
@@ -781,36 +866,65 @@ low_thread low_get_current_thread(duk_context *ctx)
 void low_destroy(low_t *low)
 {
 #if !LOW_ESP32_LWIP_SPECIALITIES
-    g_low_system.signal_pipe_fd = low->web_thread_pipe[1];
-    if(g_low_system.signal_pipe_fd == low->web_thread_pipe[1])
-        g_low_system.signal_pipe_fd = -1;
+#if LOW_INCLUDE_WORKER_THREADS
+    // Workers use our loop, so they go first
+    for(int i = 0; i < low->workers.size(); i++)
+        if(low->workers[i])
+            delete low->workers[i];
+#endif /* LOW_INCLUDE_WORKER_THREADS */
 
     low->destroying = true;
-    low_web_thread_break(low);
+    if(low->threads == low)
+    {
+        if(g_low_system.signal_pipe_fd == low->web_thread_pipe[1])
+            g_low_system.signal_pipe_fd = -1;
 
-    pthread_join(low->web_thread, NULL);
+        low_web_thread_break(low);
 
-    pthread_mutex_lock(&low->web_thread_mutex);
-    pthread_cond_broadcast(&low->web_thread_done_cond);
-    pthread_mutex_unlock(&low->web_thread_mutex);
+        pthread_join(low->web_thread, NULL);
 
-    // Finish up data threads
-    pthread_mutex_lock(&low->data_thread_mutex);
-    pthread_cond_broadcast(&low->data_thread_cond);
-    pthread_mutex_unlock(&low->data_thread_mutex);
+        pthread_mutex_lock(&low->web_thread_mutex);
+        pthread_cond_broadcast(&low->web_thread_done_cond);
+        pthread_mutex_unlock(&low->web_thread_mutex);
 
-    for(int i = 0; i < LOW_NUM_DATA_THREADS; i++)
-        pthread_join(low->data_thread[i], NULL);
+        // Finish up data threads
+        pthread_mutex_lock(&low->data_thread_mutex);
+        pthread_cond_broadcast(&low->data_thread_cond);
+        pthread_mutex_unlock(&low->data_thread_mutex);
+
+        for(int i = 0; i < LOW_NUM_DATA_THREADS; i++)
+            pthread_join(low->data_thread[i], NULL);
+    }
+#if LOW_INCLUDE_CARES_RESOLVER
+    else
+    {
+        // The web thread keeps running, it must be done with our resolvers
+        // before they are deleted
+        low_t *threads = low->threads;
+        pthread_mutex_lock(&threads->resolvers_mutex);
+        for(int i = 0; i < threads->thread_heaps.size(); i++)
+            if(threads->thread_heaps[i] == low)
+            {
+                threads->thread_heaps.erase(threads->thread_heaps.begin() + i);
+                break;
+            }
+        pthread_mutex_unlock(&threads->resolvers_mutex);
+
+        pthread_mutex_lock(&threads->web_thread_mutex);
+        low_web_thread_break(low);
+        pthread_cond_wait(&threads->web_thread_done_cond,
+                          &threads->web_thread_mutex);
+        pthread_mutex_unlock(&threads->web_thread_mutex);
+    }
+#endif /* LOW_INCLUDE_CARES_RESOLVER */
 
     try
     {
         // Then we close all FDs and delete all classes behind the callbacks
         while(low->loop_callback_first) // before FDs important for LowDNSResolver!
             delete low->loop_callback_first;
-        while(low->data_callback_first[0])
-            delete low->data_callback_first[0];
-        while(low->data_callback_first[1])
-            delete low->data_callback_first[1];
+        // With shared threads, also waits for the callbacks running
+        low_data_clear_heap(low);
         for(auto iter = low->fds.begin(); iter != low->fds.end();)
         {
             auto iter2 = iter;
@@ -827,15 +941,18 @@ void low_destroy(low_t *low)
         fprintf(stderr, "Fatal exception\n");
     }
 
-    close(low->web_thread_pipe[0]);
-    close(low->web_thread_pipe[1]);
+    if(low->threads == low)
+    {
+        close(low->web_thread_pipe[0]);
+        close(low->web_thread_pipe[1]);
 
-    pthread_mutex_destroy(&low->data_thread_mutex);
-    pthread_cond_destroy(&low->data_thread_cond);
-    pthread_cond_destroy(&low->data_thread_done_cond);
+        pthread_mutex_destroy(&low->data_thread_mutex);
+        pthread_cond_destroy(&low->data_thread_cond);
+        pthread_cond_destroy(&low->data_thread_done_cond);
 
-    pthread_mutex_destroy(&low->web_thread_mutex);
-    pthread_cond_destroy(&low->web_thread_done_cond);
+        pthread_mutex_destroy(&low->web_thread_mutex);
+        pthread_cond_destroy(&low->web_thread_done_cond);
+    }
 
 #if LOW_ESP32_LWIP_SPECIALITIES
     vSemaphoreDelete(low->loop_thread_sema);
@@ -844,6 +961,14 @@ void low_destroy(low_t *low)
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
     pthread_mutex_destroy(&low->loop_thread_mutex);
 
+    // Not written out if still running, the profile would be lost anyway
+    if(low->profiler)
+    {
+        low_profiler_free(low, low->profiler);
+        low->profiler = NULL;
+    }
+    low_heap_sampler_destroy(low);
+
     if(low->duk_ctx)
         duk_destroy_heap(low->duk_ctx);
 
@@ -859,11 +984,32 @@ void low_destroy(low_t *low)
     for(int i = 0; i < low->tlsContexts.size(); i++)
         if(low->tlsContexts[i])
             delete low->tlsContexts[i];
+    for(int i = 0; i < low->httpPools.size(); i++)
+        if(low->httpPools[i])
+            delete low->httpPools[i];
     for(int i = 0; i < low->cryptoHashes.size(); i++)
         if(low->cryptoHashes[i])
             delete low->cryptoHashes[i]; // TODO: also needed in restart?
+    for(int i = 0; i < low->cryptoCiphers.size(); i++)
+        if(low->cryptoCiphers[i])
+            delete low->cryptoCiphers[i];
+#if LOW_INCLUDE_ZLIB
+    for(int i = 0; i < low->zlibStreams.size(); i++)
+        if(low->zlibStreams[i])
+            delete low->zlibStreams[i];
+#endif /* LOW_INCLUDE_ZLIB */
+#if LOW_INCLUDE_CHILD_PROCESS
+    for(int i = 0; i < low->childProcesses.size(); i++)
+        if(low->childProcesses[i])
+            delete low->childProcesses[i];
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
+    for(int i = 0; i < low->read_arena_free.size(); i++)
+        low_free(low->read_arena_free[i]);
 
     pthread_mutex_destroy(&low->ref_mutex);
+#if LOW_USE_SLAB_ALLOC
+    low_slab_destroy(low->slab);
+#endif /* LOW_USE_SLAB_ALLOC */
     low_free(low);
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
 }
@@ -958,6 +1104,16 @@ void *low_push_buffer(duk_context *ctx, int len)
 
 void low_duk_print_error(duk_context *ctx)
 {
+#if LOW_INCLUDE_WORKER_THREADS
+    // Errors of workers are emitted by the Worker object of the parent
+    low_t *low = duk_get_low_context(ctx);
+    if(low->worker)
+    {
+        low->worker->PostError(ctx);
+        return;
+    }
+#endif /* LOW_INCLUDE_WORKER_THREADS */
+
     if(duk_is_error(ctx, -1))
     {
         if(duk_get_prop_string(ctx, -1, "stack"))
@@ -8,6 +8,7 @@
 #include "low_alloc.h"
 #include "low_config.h"
 #include "low_loop.h"
+#include "low_metrics.h"
 
 #if LOW_ESP32_LWIP_SPECIALITIES
 #include <freertos/FreeRTOS.h>
@@ -24,9 +25,15 @@ using namespace std;
 class LowLoopCallback;
 class LowDataCallback;
 class LowFD;
+class LowHTTPDirect;
+class LowHTTPPool;
 class LowDNSResolver;
 class LowTLSContext;
 class LowCryptoHash;
+class LowCryptoCipher;
+class LowZlib;
+class LowWorker;
+class LowChildProcess;
 
 struct low_t
 {
@@ -36,12 +43,33 @@ struct low_t
 
 #if !LOW_ESP32_LWIP_SPECIALITIES
     unsigned int heap_size, max_heap_size;
+#if LOW_USE_SLAB_ALLOC
+    struct low_slab_t *slab;
+#endif /* LOW_USE_SLAB_ALLOC */
+
+    // Garbage collection scheduling, see low_gc_idle
+    bool gc_requested;
+    unsigned int gc_soft_at, gc_hard_at;
+    long long gc_last_end;  // in us
+    int gc_idle_count, gc_forced_count, gc_explicit_count;
+    long long gc_total_pause, gc_max_pause, gc_last_pause, gc_idle_pause;
+    long long alloc_count;  // blocks allocated for the Duktape heap
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
     bool in_gc, disallow_native;
 
     int run_ref, last_stash_index;
 
+    low_metrics_t metrics;
+    struct low_profiler_t *profiler;     // set while the CPU profiler runs
+    struct low_heap_sampler_t *heap_sampler;
+
+    // Arena chunk socket reads land in, see LowSocket::ReadArena
+    unsigned char *read_arena_data;
+    int read_arena_id, read_arena_pos;
+    vector<unsigned char *> read_arena_free;
+
     int signal_call_id;
+    int http_evict_call_id;     // closes idle sockets of LowHTTPPool
     bool in_uncaught_exception;
 
     map<int, low_chore_t> chores;
@@ -61,10 +89,20 @@ struct low_t
 
     LowLoopCallback *loop_callback_first, *loop_callback_last;
 
+    // The heap whose web and data threads serve us: ourself, or for the heap
+    // of a worker thread the one of the main thread. The thread fields below
+    // are only used in that heap
+    low_t *threads;
+#if LOW_INCLUDE_CARES_RESOLVER
+    vector<low_t *> thread_heaps;   // the other heaps served, for c-ares
+#endif /* LOW_INCLUDE_CARES_RESOLVER */
+
     pthread_mutex_t data_thread_mutex;
     pthread_cond_t data_thread_cond, data_thread_done_cond;
     LowDataCallback *data_callback_first[2], *data_callback_last[2];
     bool data_thread_done;
+    // Our callbacks in a data thread, protected by threads->data_thread_mutex
+    int data_callbacks_running;
 
     pthread_mutex_t web_thread_mutex;
     pthread_cond_t web_thread_done_cond;
@@ -72,6 +110,8 @@ struct low_t
     int web_thread_pipe[2];
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
     LowFD *web_changed_first, *web_changed_last;
+    // HTTP connections waiting for a request, sorted by deadline
+    LowHTTPDirect *web_deadline_first, *web_deadline_last;
     bool web_thread_done;
     bool reset_accepts;
 
@@ -83,7 +123,19 @@ struct low_t
     pthread_mutex_t resolvers_mutex;
 #endif /* LOW_INCLUDE_CARES_RESOLVER */
     vector<LowTLSContext *> tlsContexts;
+    vector<LowHTTPPool *> httpPools;
     vector<LowCryptoHash *> cryptoHashes;
+    vector<LowCryptoCipher *> cryptoCiphers;
+#if LOW_INCLUDE_ZLIB
+    vector<LowZlib *> zlibStreams;
+#endif /* LOW_INCLUDE_ZLIB */
+#if LOW_INCLUDE_WORKER_THREADS
+    vector<LowWorker *> workers;
+    LowWorker *worker;      // set if this is the heap of a worker thread
+#endif /* LOW_INCLUDE_WORKER_THREADS */
+#if LOW_INCLUDE_CHILD_PROCESS
+    vector<LowChildProcess *> childProcesses;
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
 
     pthread_mutex_t ref_mutex;
 
@@ -101,7 +153,7 @@ typedef enum
     LOW_THREAD_IMMEDIATE
 } low_thread;
 
-low_t *low_init();
+low_t *low_init(low_t *parent = NULL);   // parent: the heap starting a worker
 bool low_lib_init(low_t *low);
 void low_destroy(low_t *low);
 
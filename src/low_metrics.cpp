@@ -0,0 +1,224 @@
+// -----------------------------------------------------------------------------
+//  low_metrics.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_metrics.h"
+
+#include "LowDataCallback.h"
+#include "LowFD.h"
+#include "LowLoopCallback.h"
+
+#include "low_main.h"
+#include "low_system.h"
+
+#include <cstring>
+
+// -----------------------------------------------------------------------------
+//  low_metrics_init
+// -----------------------------------------------------------------------------
+
+void low_metrics_init(low_t *low)
+{
+    memset(&low->metrics, 0, sizeof(low->metrics));
+    low->metrics.start = low->metrics.busy_start = low_micro_count();
+}
+
+// -----------------------------------------------------------------------------
+//  low_metrics_idle_begin - the loop goes to sleep, account the busy period
+// -----------------------------------------------------------------------------
+
+void low_metrics_idle_begin(low_t *low)
+{
+    low_metrics_t &m = low->metrics;
+    long long now = low_micro_count();
+    long long busy = now - m.busy_start;
+
+    m.idle_start = now;
+    m.turns++;
+    m.busy_total += busy;
+    if(m.busy_max < busy)
+        m.busy_max = busy;
+
+    int bucket = 0;
+    while(busy > 1 && bucket < LOW_METRICS_LAG_BUCKETS - 1)
+    {
+        busy >>= 1;
+        bucket++;
+    }
+    m.lag_buckets[bucket]++;
+}
+
+// -----------------------------------------------------------------------------
+//  low_metrics_idle_end
+// -----------------------------------------------------------------------------
+
+void low_metrics_idle_end(low_t *low)
+{
+    low_metrics_t &m = low->metrics;
+    long long now = low_micro_count();
+
+    m.idle_total += now - m.idle_start;
+    m.busy_start = now;
+}
+
+// -----------------------------------------------------------------------------
+//  low_metrics_percentile - upper bound of the bucket with the percentile
+// -----------------------------------------------------------------------------
+
+static double low_metrics_percentile(low_metrics_t &m, int percent)
+{
+    if(!m.turns)
+        return 0;
+
+    unsigned long long want = ((unsigned long long)m.turns * percent + 99)
+                              / 100, sum = 0;
+    for(int i = 0; i < LOW_METRICS_LAG_BUCKETS - 1; i++)
+    {
+        sum += m.lag_buckets[i];
+        if(sum >= want)
+            return (double)(2LL << i);
+    }
+    return (double)m.busy_max;
+}
+
+// -----------------------------------------------------------------------------
+//  low_metrics - native.metrics(), all times in ms
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_metrics(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    low_metrics_t &m = low->metrics;
+    long long now = low_micro_count();
+
+    // The current busy period is not finished, but counts as busy time
+    long long busy_total = m.busy_total + (now - m.busy_start);
+
+    duk_push_object(ctx);
+
+    duk_push_object(ctx);
+    duk_push_number(ctx, (now - m.start) / 1000.0);
+    duk_put_prop_string(ctx, -2, "uptime");
+    duk_push_number(ctx, busy_total / 1000.0);
+    duk_put_prop_string(ctx, -2, "busy");
+    duk_push_number(ctx, m.idle_total / 1000.0);
+    duk_put_prop_string(ctx, -2, "idle");
+    duk_push_number(ctx, busy_total + m.idle_total
+                         ? (double)busy_total / (busy_total + m.idle_total)
+                         : 0);
+    duk_put_prop_string(ctx, -2, "utilization");
+    duk_push_uint(ctx, m.turns);
+    duk_put_prop_string(ctx, -2, "turns");
+    duk_push_uint(ctx, m.next_ticks);
+    duk_put_prop_string(ctx, -2, "nextTicks");
+    duk_push_uint(ctx, m.loop_callbacks);
+    duk_put_prop_string(ctx, -2, "callbacks");
+    duk_push_uint(ctx, m.timers);
+    duk_put_prop_string(ctx, -2, "timers");
+    duk_push_number(ctx, m.turns
+                         ? (double)(m.next_ticks + m.loop_callbacks + m.timers)
+                           / m.turns
+                         : 0);
+    duk_put_prop_string(ctx, -2, "callbacksPerTurn");
+    duk_put_prop_string(ctx, -2, "loop");
+
+    // How long the loop could not react, measured per busy period
+    duk_push_object(ctx);
+    duk_push_number(ctx, m.turns ? m.busy_total / 1000.0 / m.turns : 0);
+    duk_put_prop_string(ctx, -2, "mean");
+    duk_push_number(ctx, low_metrics_percentile(m, 50) / 1000.0);
+    duk_put_prop_string(ctx, -2, "p50");
+    duk_push_number(ctx, low_metrics_percentile(m, 99) / 1000.0);
+    duk_put_prop_string(ctx, -2, "p99");
+    duk_push_number(ctx, m.busy_max / 1000.0);
+    duk_put_prop_string(ctx, -2, "max");
+    duk_push_array(ctx);
+    for(int i = 0; i < LOW_METRICS_LAG_BUCKETS; i++)
+    {
+        duk_push_uint(ctx, m.lag_buckets[i]);
+        duk_put_prop_index(ctx, -2, i);
+    }
+    duk_put_prop_string(ctx, -2, "histogram");
+    duk_put_prop_string(ctx, -2, "lag");
+
+    // How much later than scheduled timers fired
+    duk_push_object(ctx);
+    duk_push_number(ctx, m.timers ? (double)m.timer_late_total / m.timers : 0);
+    duk_put_prop_string(ctx, -2, "meanLate");
+    duk_push_number(ctx, (double)m.timer_late_max);
+    duk_put_prop_string(ctx, -2, "maxLate");
+    duk_push_uint(ctx, low->chores.size());
+    duk_put_prop_string(ctx, -2, "active");
+    duk_put_prop_string(ctx, -2, "timers");
+
+    duk_push_object(ctx);
+    int pending = 0;
+    pthread_mutex_lock(&low->loop_thread_mutex);
+    for(LowLoopCallback *callback = low->loop_callback_first; callback;
+        callback = callback->mNext)
+        pending++;
+    pthread_mutex_unlock(&low->loop_thread_mutex);
+    duk_push_int(ctx, pending);
+    duk_put_prop_string(ctx, -2, "loopCallbacks");
+    // Each entry on the next tick stack is function, arguments, count
+    int ticks = 0;
+    for(int i = duk_get_top(low->next_tick_ctx) - 1; i >= 0;
+        i -= duk_get_int(low->next_tick_ctx, i) + 2)
+        ticks++;
+    duk_push_int(ctx, ticks);
+    duk_put_prop_string(ctx, -2, "nextTicks");
+    duk_push_int(ctx, low->run_ref);
+    duk_put_prop_string(ctx, -2, "refs");
+    duk_put_prop_string(ctx, -2, "pending");
+
+    // Jobs waiting for one of the data threads (file system, DNS, crypto...)
+    duk_push_object(ctx);
+    int queued[2] = {0, 0};
+    // Worker threads share the data threads, we only count our jobs
+    pthread_mutex_lock(&low->threads->data_thread_mutex);
+    for(int priority = 0; priority < 2; priority++)
+        for(LowDataCallback *callback =
+              low->threads->data_callback_first[priority];
+            callback; callback = callback->mNext)
+            if(callback->mLow == low)
+                queued[priority]++;
+    unsigned int jobs = m.data_jobs;
+    long long wait_total = m.data_wait_total, wait_max = m.data_wait_max;
+    pthread_mutex_unlock(&low->threads->data_thread_mutex);
+    duk_push_int(ctx, LOW_NUM_DATA_THREADS);
+    duk_put_prop_string(ctx, -2, "threads");
+    duk_push_int(ctx, queued[0] + queued[1]);
+    duk_put_prop_string(ctx, -2, "queued");
+    duk_push_int(ctx, queued[0]);
+    duk_put_prop_string(ctx, -2, "queuedHigh");
+    duk_push_uint(ctx, jobs);
+    duk_put_prop_string(ctx, -2, "jobs");
+    duk_push_number(ctx, jobs ? wait_total / 1000.0 / jobs : 0);
+    duk_put_prop_string(ctx, -2, "meanWait");
+    duk_push_number(ctx, wait_max / 1000.0);
+    duk_put_prop_string(ctx, -2, "maxWait");
+    duk_put_prop_string(ctx, -2, "dataThreads");
+
+    int types[LOWFD_TYPE_CUSTOM + 1];
+    memset(types, 0, sizeof(types));
+    for(auto iter = low->fds.begin(); iter != low->fds.end(); iter++)
+        types[iter->second->FDType()]++;
+
+    duk_push_object(ctx);
+    duk_push_int(ctx, low->fds.size());
+    duk_put_prop_string(ctx, -2, "total");
+    duk_push_int(ctx, types[LOWFD_TYPE_FILE]);
+    duk_put_prop_string(ctx, -2, "file");
+    duk_push_int(ctx, types[LOWFD_TYPE_SERVER]);
+    duk_put_prop_string(ctx, -2, "server");
+    duk_push_int(ctx, types[LOWFD_TYPE_SOCKET]);
+    duk_put_prop_string(ctx, -2, "socket");
+    duk_push_int(ctx, types[LOWFD_TYPE_DATAGRAM]);
+    duk_put_prop_string(ctx, -2, "datagram");
+    duk_push_int(ctx, types[LOWFD_TYPE_NATIVE_API]
+                      + types[LOWFD_TYPE_CUSTOM]);
+    duk_put_prop_string(ctx, -2, "other");
+    duk_put_prop_string(ctx, -2, "handles");
+
+    return 1;
+}
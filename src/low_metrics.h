@@ -0,0 +1,40 @@
+// -----------------------------------------------------------------------------
+//  low_metrics.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_METRICS_H__
+#define __LOW_METRICS_H__
+
+#include "duktape.h"
+
+// Busy periods of the event loop are put into buckets by their length,
+// bucket i holds the ones shorter than 2^(i + 1) us. The last one holds all
+// which are longer
+#define LOW_METRICS_LAG_BUCKETS 24
+
+struct low_t;
+
+struct low_metrics_t
+{
+    // All times in us
+    long long start, busy_start, idle_start;
+    long long busy_total, busy_max, idle_total;
+    unsigned int lag_buckets[LOW_METRICS_LAG_BUCKETS];
+
+    unsigned int turns, next_ticks, loop_callbacks, timers;
+    long long timer_late_total, timer_late_max;     // in ms
+
+    // Protected by threads->data_thread_mutex, see low_t
+    unsigned int data_jobs;
+    long long data_wait_total, data_wait_max;
+};
+
+void low_metrics_init(low_t *low);
+
+// Called around low_loop_wait, everything in between is idle time
+void low_metrics_idle_begin(low_t *low);
+void low_metrics_idle_end(low_t *low);
+
+duk_ret_t low_metrics(duk_context *ctx);
+
+#endif /* __LOW_METRICS_H__ */
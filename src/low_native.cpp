@@ -2,29 +2,52 @@
 //  low_native.cpp
 // -----------------------------------------------------------------------------
 
+#include "low_config.h"
+
+#include "low_buffer.h"
+#include "low_child_process.h"
 #include "low_crypto.h"
 #include "low_dns.h"
 #include "low_fs.h"
 #include "low_fs_misc.h"
+#include "low_heap.h"
 #include "low_http.h"
+#include "low_http2.h"
 #include "low_loop.h"
+#include "low_metrics.h"
 #include "low_module.h"
 #include "low_native_aux.h"
 #include "low_net.h"
 #include "low_dgram.h"
 #include "low_process.h"
+#include "low_profiler.h"
 #include "low_tls.h"
+#include "low_websocket.h"
+#include "low_worker.h"
+#include "low_zlib.h"
 
 // The methods of the module 'native', accessable by files in lib_js directory
 duk_function_list_entry g_low_native_methods[] = {
   {"gc", low_gc, 0},
+  {"heapStats", low_heap_stats, 0},
+  {"metrics", low_metrics, 0},
+  {"cpuProfileStart", low_cpu_profile_start, 1},
+  {"cpuProfileStop", low_cpu_profile_stop, 0},
+  {"heapSamplingStart", low_heap_sampling_start, 1},
+  {"heapSamplingStop", low_heap_sampling_stop, 0},
+  {"heapSnapshot", low_heap_snapshot, 1},
   {"processInfo", low_process_info, 1},
   {"osInfo", low_os_info, 0},
   {"ttyInfo", low_tty_info, 0},
   {"hrtime", low_hrtime, 1},
   {"compile", low_compile, 1},
   {"runInContext", low_run_in_context, 4},
-  {"compare", low_compare, 2},
+  {"compare", low_compare, 6},
+  {"bufferToString", low_buffer_to_string, 4},
+  {"bufferFromString", low_buffer_from_string, 2},
+  {"bufferWrite", low_buffer_write, 5},
+  {"bufferByteLength", low_buffer_byte_length, 2},
+  {"bufferIndexOf", low_buffer_index_of, 5},
   {"setChore", low_loop_set_chore, 3},
   {"clearChore", low_loop_clear_chore, 1},
   {"choreRef", low_loop_chore_ref, 2},
@@ -54,11 +77,13 @@ duk_function_list_entry g_low_native_methods[] = {
   {"file_pos", low_fs_file_pos, 1},
   {"bind", low_dgram_bind, 6},
   {"send", low_dgram_send, 5},
-  {"listen", low_net_listen, 7},
+  {"listen", low_net_listen, 8},
   {"connect", low_net_connect, 6},
   {"setsockopt", low_net_setsockopt, 5},
   {"shutdown", low_net_shutdown, 2},
+  {"socketRead", low_net_read, 3},
   {"netConnections", low_net_connections, 3},
+  {"netPipe", low_net_pipe, 5},
   {"isIP", low_is_ip, 1},
   {"lookup", low_dns_lookup, 4},
   {"lookupService", low_dns_lookup_service, 3},
@@ -68,15 +93,67 @@ duk_function_list_entry g_low_native_methods[] = {
   {"resolverSetServers", low_dns_resolver_set_servers, 2},
   {"resolverResolve", low_dns_resolver_resolve, 5},
   {"resolverGetHostByAddr", low_dns_resolver_gethostbyaddr, 3},
-  {"httpGetRequest", low_http_get_request, 2},
+  {"httpGetRequest", low_http_get_request, 4},
   {"httpDetach", low_http_detach, 1},
   {"httpRead", low_http_read, 3},
+  {"httpPipeBody", low_http_pipe_body, 3},
+  {"httpPipeProgress", low_http_pipe_progress, 1},
   {"httpWrite", low_http_write, 3},
-  {"httpWriteHead", low_http_write_head, 4},
+  {"httpWriteHead", low_http_write_head, 7},
+  {"httpRoutes", low_http_routes, 3},
+  {"httpPoolCreate", low_http_pool_create, 3},
+  {"httpPoolSetEvict", low_http_pool_set_evict, 1},
+  {"httpPoolLease", low_http_pool_lease, 3},
+  {"httpPoolRelease", low_http_pool_release, 3},
+  {"httpPoolRemove", low_http_pool_remove, 2},
+  {"httpPoolClose", low_http_pool_close, 1},
+  {"httpHeaderNames", low_http_header_names, 0},
+  {"httpRawHeaders", low_http_raw_headers, 2},
+  {"httpHeader", low_http_header, 2},
+  {"http2Attach", low_http2_attach, 2},
+  {"http2Respond", low_http2_respond, 6},
+  {"http2Write", low_http2_write, 4},
+  {"http2Reset", low_http2_reset, 3},
+  {"wsAttach", low_ws_attach, 5},
+  {"wsSend", low_ws_send, 4},
+  {"wsClose", low_ws_close, 3},
+  {"wsBroadcast", low_ws_broadcast, 4},
   {"createTLSContext", low_tls_create_context, 2},
   {"makeModule", low_module_make, 2},
   {"createCryptoHash", low_crypto_create_hash, 3},
-  {"cryptoHashUpdate", low_crypto_hash_update, 2},
+  {"cryptoHashUpdate", low_crypto_hash_update, 3},
   {"cryptoHashDigest", low_crypto_hash_digest, 1},
+  {"cryptoHashFile", low_crypto_hash_file, 3},
+  {"createCryptoCipher", low_crypto_create_cipher, 5},
+  {"cryptoCipherUpdate", low_crypto_cipher_update, 7},
+  {"cryptoCipherFinal", low_crypto_cipher_final, 1},
+  {"cryptoCipherSetAAD", low_crypto_cipher_set_aad, 2},
+  {"cryptoCipherSetAutoPadding", low_crypto_cipher_set_auto_padding, 2},
+  {"cryptoCipherSetAuthTag", low_crypto_cipher_set_auth_tag, 2},
+  {"cryptoCipherGetAuthTag", low_crypto_cipher_get_auth_tag, 2},
   {"randomBytes", low_crypto_random_bytes, 2},
+#if LOW_INCLUDE_ZLIB
+  {"zlibCreate", low_zlib_create, 6},
+  {"zlibWrite", low_zlib_write, 9},
+  {"zlibWriteSync", low_zlib_write_sync, 8},
+  {"zlibReset", low_zlib_reset, 1},
+  {"zlibClose", low_zlib_close, 1},
+#endif /* LOW_INCLUDE_ZLIB */
+#if LOW_INCLUDE_WORKER_THREADS
+  {"workerCreate", low_worker_create, 5},
+  {"workerPostMessage", low_worker_post_message, 3},
+  {"workerTerminate", low_worker_terminate, 1},
+  {"workerRef", low_worker_ref, 2},
+  {"workerInfo", low_worker_info, 0},
+  {"workerPost", low_worker_post, 2},
+  {"workerSetReceiver", low_worker_set_receiver, 1},
+  {"workerPortRef", low_worker_port_ref, 1},
+#endif /* LOW_INCLUDE_WORKER_THREADS */
+#if LOW_INCLUDE_CHILD_PROCESS
+  {"childSpawn", low_child_process_spawn, 8},
+  {"childSpawnSync", low_child_process_spawn_sync, 10},
+  {"childKill", low_child_process_kill, 2},
+  {"childRef", low_child_process_ref, 2},
+  {"childChannel", low_child_process_channel, 1},
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
   {NULL, NULL, 0}};
@@ -16,7 +16,8 @@
 #include <cstring>
 
 // -----------------------------------------------------------------------------
-//  low_compare
+//  low_compare - (a, b, aStart, aEnd, bStart, bEnd), compares the ranges
+//  lexicographically as Buffer.compare does, ranges default to everything
 // -----------------------------------------------------------------------------
 
 duk_ret_t low_compare(duk_context *ctx)
@@ -25,12 +26,25 @@ duk_ret_t low_compare(duk_context *ctx)
     unsigned char *a = (unsigned char *)duk_require_buffer_data(ctx, 0, &a_len);
     unsigned char *b = (unsigned char *)duk_require_buffer_data(ctx, 1, &b_len);
 
-    if(a_len < b_len)
-        duk_push_int(ctx, -1);
-    else if(a_len > b_len)
-        duk_push_int(ctx, 1);
-    else
-        duk_push_int(ctx, memcmp(a, b, a_len));
+    duk_size_t a_start = duk_get_uint_default(ctx, 2, 0);
+    duk_size_t a_end = duk_get_uint_default(ctx, 3, a_len);
+    duk_size_t b_start = duk_get_uint_default(ctx, 4, 0);
+    duk_size_t b_end = duk_get_uint_default(ctx, 5, b_len);
+    if(a_end > a_len)
+        a_end = a_len;
+    if(a_start > a_end)
+        a_start = a_end;
+    if(b_end > b_len)
+        b_end = b_len;
+    if(b_start > b_end)
+        b_start = b_end;
+    a_len = a_end - a_start;
+    b_len = b_end - b_start;
+
+    int res = memcmp(a + a_start, b + b_start, a_len < b_len ? a_len : b_len);
+    if(res == 0)
+        res = a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+    duk_push_int(ctx, res < 0 ? -1 : (res > 0 ? 1 : 0));
     return 1;
 }
 
@@ -4,6 +4,7 @@
 
 #include "low_net.h"
 
+#include "LowFDPipe.h"
 #include "LowServerSocket.h"
 #include "LowSocket.h"
 
@@ -119,7 +120,8 @@ duk_ret_t low_net_listen(duk_context *ctx)
 
     int err;
     const char *syscall;
-    if(!server->Listen(addr, addrLen, 6, err, syscall))
+    bool reusePort = duk_get_boolean_default(ctx, 7, false);
+    if(!server->Listen(addr, addrLen, 6, err, syscall, reusePort))
     {
         delete server;
 
@@ -325,6 +327,31 @@ duk_ret_t low_net_shutdown(duk_context *ctx)
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+//  low_net_read - reads into the read arena, the callback gets the number of
+//  bytes read and a Buffer view of them
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_net_read(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    int fd = duk_require_int(ctx, 0);
+    int len = duk_require_int(ctx, 1);
+    duk_require_function(ctx, 2);
+
+    if(len <= 0)
+        duk_range_error(ctx, "invalid read size %d", len);
+
+    auto iter = low->fds.find(fd);
+    if(iter == low->fds.end())
+        duk_reference_error(ctx, "file descriptor not found");
+    if(iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        duk_reference_error(ctx, "file descriptor is not a socket");
+
+    ((LowSocket *)iter->second)->ReadArena(len, 2);
+    return 0;
+}
+
 // -----------------------------------------------------------------------------
 //  low_net_connections
 // -----------------------------------------------------------------------------
@@ -345,3 +372,19 @@ duk_ret_t low_net_connections(duk_context *ctx)
     socket->Connections(duk_require_int(ctx, 1), duk_require_int(ctx, 2));
     return 0;
 }
+
+// -----------------------------------------------------------------------------
+//  low_net_pipe - returns false if JavaScript has to pipe
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_net_pipe(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    int srcFD = duk_require_int(ctx, 0);
+    int destFD = duk_require_int(ctx, 1);
+    long long pos = (long long)duk_require_number(ctx, 2);
+    long long len = (long long)duk_require_number(ctx, 3);
+
+    duk_push_boolean(ctx, LowFDPipe::Start(low, srcFD, destFD, pos, len, 4));
+    return 1;
+}
@@ -11,6 +11,8 @@ duk_ret_t low_net_listen(duk_context *ctx);
 duk_ret_t low_net_connect(duk_context *ctx);
 duk_ret_t low_net_setsockopt(duk_context *ctx);
 duk_ret_t low_net_shutdown(duk_context *ctx);
+duk_ret_t low_net_read(duk_context *ctx);
 duk_ret_t low_net_connections(duk_context *ctx);
+duk_ret_t low_net_pipe(duk_context *ctx);
 
 #endif /* __LOW_NET_H__ */
\ No newline at end of file
@@ -4,13 +4,17 @@
 
 #include "low_process.h"
 
+#include "LowWorker.h"
+
 #include "low_alloc.h"
 #include "low_config.h"
 #include "low_main.h"
 #include "low_loop.h"
+#include "low_slab.h"
 #include "low_system.h"
 
 #include <errno.h>
+#include <stdio.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
@@ -59,10 +63,95 @@ extern low_system_t g_low_system;
 
 duk_ret_t low_gc(duk_context *ctx)
 {
+#if LOW_ESP32_LWIP_SPECIALITIES
     duk_gc(ctx, 0);
+#else
+    low_gc_run(duk_get_low_context(ctx), LOW_GC_REASON_EXPLICIT);
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
     return 0;
 }
 
+// -----------------------------------------------------------------------------
+//  low_heap_stats
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_heap_stats(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_push_object(ctx);
+#if !LOW_ESP32_LWIP_SPECIALITIES
+    duk_push_uint(ctx, low->heap_size);
+    duk_put_prop_string(ctx, -2, "heapSize");
+    duk_push_uint(ctx, low->max_heap_size);
+    duk_put_prop_string(ctx, -2, "maxHeapSize");
+    duk_push_number(ctx, (double)low->alloc_count);
+    duk_put_prop_string(ctx, -2, "allocations");
+
+    // Pause times in ms
+    duk_push_object(ctx);
+    duk_push_int(ctx, low->gc_idle_count + low->gc_forced_count
+                      + low->gc_explicit_count);
+    duk_put_prop_string(ctx, -2, "count");
+    duk_push_int(ctx, low->gc_idle_count);
+    duk_put_prop_string(ctx, -2, "idle");
+    duk_push_int(ctx, low->gc_forced_count);
+    duk_put_prop_string(ctx, -2, "forced");
+    duk_push_int(ctx, low->gc_explicit_count);
+    duk_put_prop_string(ctx, -2, "explicit");
+    duk_push_number(ctx, low->gc_total_pause / 1000.0);
+    duk_put_prop_string(ctx, -2, "totalPause");
+    duk_push_number(ctx, low->gc_max_pause / 1000.0);
+    duk_put_prop_string(ctx, -2, "maxPause");
+    duk_push_number(ctx, low->gc_last_pause / 1000.0);
+    duk_put_prop_string(ctx, -2, "lastPause");
+    duk_push_uint(ctx, (unsigned int)((unsigned long long)low->max_heap_size
+                                      * LOW_GC_SOFT_WATERMARK / 100));
+    duk_put_prop_string(ctx, -2, "softWatermark");
+    duk_push_uint(ctx, (unsigned int)((unsigned long long)low->max_heap_size
+                                      * LOW_GC_HARD_WATERMARK / 100));
+    duk_put_prop_string(ctx, -2, "hardWatermark");
+    duk_put_prop_string(ctx, -2, "gc");
+#endif /* !LOW_ESP32_LWIP_SPECIALITIES */
+
+#if LOW_USE_SLAB_ALLOC && !LOW_ESP32_LWIP_SPECIALITIES
+    if(low->slab)
+    {
+        low_slab_class_stats_t stats[LOW_SLAB_NUM_CLASSES];
+        int released;
+        int pages = low_slab_stats(low->slab, stats, &released);
+
+        duk_push_object(ctx);
+        duk_push_uint(ctx, LOW_SLAB_PAGE_SIZE);
+        duk_put_prop_string(ctx, -2, "pageSize");
+        duk_push_uint(ctx, pages);
+        duk_put_prop_string(ctx, -2, "pages");
+        duk_push_uint(ctx, released);
+        duk_put_prop_string(ctx, -2, "releasedPages");
+
+        duk_push_array(ctx);
+        for(int i = 0; i < LOW_SLAB_NUM_CLASSES; i++)
+        {
+            duk_push_object(ctx);
+            duk_push_uint(ctx, stats[i].size);
+            duk_put_prop_string(ctx, -2, "size");
+            duk_push_uint(ctx, stats[i].pages);
+            duk_put_prop_string(ctx, -2, "pages");
+            duk_push_number(ctx, stats[i].blocks_used);
+            duk_put_prop_string(ctx, -2, "used");
+            duk_push_number(ctx, stats[i].blocks_free);
+            duk_put_prop_string(ctx, -2, "free");
+            duk_put_prop_index(ctx, -2, i);
+        }
+        duk_put_prop_string(ctx, -2, "classes");
+
+        duk_put_prop_string(ctx, -2, "slab");
+    }
+#endif /* LOW_USE_SLAB_ALLOC && !LOW_ESP32_LWIP_SPECIALITIES */
+
+    return 1;
+}
+
 // -----------------------------------------------------------------------------
 //  low_process_exit
 // -----------------------------------------------------------------------------
@@ -80,6 +169,15 @@ duk_ret_t low_process_exit(duk_context *ctx)
         duk_push_int(ctx, code);
         duk_call_prop(ctx, -4, 2);
     }
+#if LOW_INCLUDE_WORKER_THREADS
+    if(low->worker)
+    {
+        // Only ends the worker thread
+        low->worker->SetExitCode(code);
+        low->duk_flag_stop = 1;
+        duk_generic_error(ctx, "abort (should not be visible)");
+    }
+#endif /* LOW_INCLUDE_WORKER_THREADS */
 #if LOW_ESP32_LWIP_SPECIALITIES || defined(LOWJS_SERV)
     low->duk_flag_stop = 1;
     duk_generic_error(ctx, "abort (should not be visible)");
@@ -168,6 +266,38 @@ static duk_ret_t low_process_chdir(duk_context *ctx)
     return 0;
 }
 
+#if LOW_HAS_SYS_SIGNALS && !LOW_ESP32_LWIP_SPECIALITIES && !defined(LOWJS_SERV)
+// -----------------------------------------------------------------------------
+//  low_process_kill
+// -----------------------------------------------------------------------------
+
+static duk_ret_t low_process_kill(duk_context *ctx)
+{
+    int pid = duk_require_int(ctx, 0);
+
+    int signal;
+    if(duk_is_undefined(ctx, 1))
+        signal = SIGTERM;
+    else if(duk_is_number(ctx, 1))
+        signal = duk_get_int(ctx, 1);
+    else
+    {
+        signal = low_signal_number(duk_require_string(ctx, 1));
+        if(!signal)
+            duk_type_error(ctx, "unknown signal: %s", duk_get_string(ctx, 1));
+    }
+
+    if(kill(pid, signal) < 0)
+    {
+        low_push_error(ctx, errno, "kill");
+        duk_throw(ctx);
+    }
+
+    duk_push_true(ctx);
+    return 1;
+}
+#endif /* LOW_HAS_SYS_SIGNALS && !LOW_ESP32_LWIP_SPECIALITIES */
+
 // -----------------------------------------------------------------------------
 //  low_process_umask
 // -----------------------------------------------------------------------------
@@ -193,31 +323,72 @@ static duk_ret_t low_process_umask(duk_context *ctx)
     return 1;
 }
 
-/*
 // -----------------------------------------------------------------------------
 //  low_process_memoryUsage
 // -----------------------------------------------------------------------------
 
 static duk_ret_t low_process_memoryUsage(duk_context *ctx)
 {
-    duk_push_object(ctx);
-NOT DONE YET
+    double rss = 0, heapTotal, heapUsed;
+
 #if LOW_ESP32_LWIP_SPECIALITIES
-    duk_push_int(ctx, "win32");
-    duk_put_prop_string(ctx, 0, "rss");
-    duk_push_int(ctx, "win32");
-    duk_put_prop_string(ctx, 0, "heapTotal");
-    duk_push_int(ctx, "win32");
-    duk_put_prop_string(ctx, 0, "heapUsed");
-    duk_push_int(ctx, 0);
-    duk_put_prop_string(ctx, 0, "external");
+    heapTotal = 4 * 1024 * 1024;
+    rss = heapUsed = heapTotal - heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
 #else
-    // TODO for non-esp32
-#endif * LOW_ESP32_LWIP_SPECIALITIES *
+    low_t *low = duk_get_low_context(ctx);
+
+    heapUsed = heapTotal = low->heap_size;
+#if LOW_USE_SLAB_ALLOC
+    // Free blocks on slab pages are not given back to the system, so they
+    // count as heap which is reserved but not used
+    if(low->slab)
+    {
+        low_slab_class_stats_t stats[LOW_SLAB_NUM_CLASSES];
+        int released;
+        low_slab_stats(low->slab, stats, &released);
 
+        for(int i = 0; i < LOW_SLAB_NUM_CLASSES; i++)
+            heapTotal += (double)stats[i].blocks_free * stats[i].size;
+    }
+#endif /* LOW_USE_SLAB_ALLOC */
+
+#if defined(__APPLE__)
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                 (task_info_t)&info, &count) == KERN_SUCCESS)
+        rss = info.resident_size;
+#else
+    FILE *f = fopen("/proc/self/statm", "r");
+    if(f)
+    {
+        unsigned long size, resident;
+        if(fscanf(f, "%lu %lu", &size, &resident) == 2)
+            rss = (double)resident * sysconf(_SC_PAGESIZE);
+        fclose(f);
+    }
+#endif /* __APPLE__ */
+    if(rss < heapTotal)
+        rss = heapTotal;
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+
+    duk_push_object(ctx);
+    duk_push_number(ctx, rss);
+    duk_put_prop_string(ctx, -2, "rss");
+    duk_push_number(ctx, heapTotal);
+    duk_put_prop_string(ctx, -2, "heapTotal");
+    duk_push_number(ctx, heapUsed);
+    duk_put_prop_string(ctx, -2, "heapUsed");
+
+    // Buffers are allocated inside of the Duktape heap, so they are already
+    // part of heapUsed
+    duk_push_int(ctx, 0);
+    duk_put_prop_string(ctx, -2, "external");
+    duk_push_int(ctx, 0);
+    duk_put_prop_string(ctx, -2, "arrayBuffers");
     return 1;
 }
-*/
+
 // -----------------------------------------------------------------------------
 //  low_process_info
 // -----------------------------------------------------------------------------
@@ -327,6 +498,15 @@ duk_ret_t low_process_info(duk_context *ctx)
         }
     }
     duk_put_prop_string(ctx, 0, "env");
+
+    duk_push_int(ctx, getpid());
+    duk_put_prop_string(ctx, 0, "pid");
+    duk_push_int(ctx, getppid());
+    duk_put_prop_string(ctx, 0, "ppid");
+#if LOW_HAS_SYS_SIGNALS
+    duk_push_c_function(ctx, low_process_kill, 2);
+    duk_put_prop_string(ctx, 0, "kill");
+#endif /* LOW_HAS_SYS_SIGNALS */
 #endif /* !LOW_ESP32_LWIP_SPECIALITIES */
 
     duk_push_c_function(ctx, low_process_exit, 1);
@@ -341,8 +521,8 @@ duk_ret_t low_process_info(duk_context *ctx)
     duk_put_prop_string(ctx, 0, "nextTick");
     duk_push_c_function(ctx, low_process_umask, 1);
     duk_put_prop_string(ctx, 0, "umask");
-    //    duk_push_c_function(ctx, low_process_memoryUsage, 0);
-    //    duk_put_prop_string(ctx, 0, "memoryUsage");
+    duk_push_c_function(ctx, low_process_memoryUsage, 0);
+    duk_put_prop_string(ctx, 0, "memoryUsage");
 
 #if LOW_ESP32_LWIP_SPECIALITIES
     duk_push_string(ctx, "esp32");
@@ -8,6 +8,7 @@
 #include "duktape.h"
 
 duk_ret_t low_gc(duk_context *ctx);
+duk_ret_t low_heap_stats(duk_context *ctx);
 duk_ret_t low_hrtime(duk_context *ctx);
 
 duk_ret_t low_process_exit(duk_context *ctx);
@@ -0,0 +1,426 @@
+// -----------------------------------------------------------------------------
+//  low_profiler.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_profiler.h"
+
+#include "low_duktape.h"
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+#include <time.h>
+
+#include <cstdio>
+#include <cstring>
+
+// Frames every tree has, see low_profiler_create
+#define LOW_PROFILER_FRAME_IDLE     1
+#define LOW_PROFILER_FRAME_PROGRAM  2
+
+// Called by Duktape from the bytecode executor every few 100k instructions
+// and after low_duk_interrupt, see DUK_USE_EXEC_TIMEOUT_CHECK in the
+// Makefile. Returning true would abort the running code
+extern "C" duk_bool_t low_exec_timeout_check(void *udata);
+
+static void low_profiler_add_sample(low_profiler_t *prof, int node,
+                                    long long now);
+
+// -----------------------------------------------------------------------------
+//  low_exec_timeout_check - takes the sample which is due. Must not use the
+//  Duktape API, so the stack is read with low_duk_stack
+// -----------------------------------------------------------------------------
+
+duk_bool_t low_exec_timeout_check(void *udata)
+{
+    low_t *low = (low_t *)udata;
+    if(!low || !low->profiler || !low->profiler->sample_due)
+        return 0;
+
+    low_profiler_t *prof = low->profiler;
+    prof->sample_due = false;
+
+    int node = low_profiler_stack(prof->ctx, prof);
+    if(!node)
+        node = low_profiler_child(prof, 0, LOW_PROFILER_FRAME_PROGRAM);
+    low_profiler_add_sample(prof, node, low_micro_count());
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_timer_main - forces the interrupt once per interval, the
+//  executor calls it on its own only every few 100k instructions
+// -----------------------------------------------------------------------------
+
+static void *low_profiler_timer_main(void *arg)
+{
+    low_profiler_t *prof = (low_profiler_t *)arg;
+    struct timespec ts;
+
+    pthread_mutex_lock(&prof->timer_mutex);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    while(!prof->timer_stop)
+    {
+        // Ticks are kept on a fixed schedule, so the rate does not drop by
+        // the time we need to wake up
+        long long nsec = ts.tv_nsec + prof->interval * 1000;
+        ts.tv_sec += nsec / 1000000000;
+        ts.tv_nsec = nsec % 1000000000;
+
+        int err = 0;
+        while(!prof->timer_stop && err != ETIMEDOUT)
+            err = pthread_cond_timedwait(&prof->timer_cond,
+                                         &prof->timer_mutex, &ts);
+        if(prof->timer_stop)
+            break;
+
+        prof->sample_due = true;
+        low_duk_interrupt(prof->ctx);
+
+        // After a stall, such as a suspended process, we do not catch up
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if(now.tv_sec > ts.tv_sec + 1)
+            ts = now;
+    }
+    pthread_mutex_unlock(&prof->timer_mutex);
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_special_frame / low_profiler_child
+// -----------------------------------------------------------------------------
+
+int low_profiler_special_frame(low_profiler_t *prof, const char *name)
+{
+    low_profiler_frame_t frame;
+    frame.name = name;
+    frame.line = -1;
+    prof->frames.push_back(frame);
+    return prof->frames.size() - 1;
+}
+
+int low_profiler_child(low_profiler_t *prof, int parent, int frame)
+{
+    auto iter = prof->node_ids.find(pair<int, int>(parent, frame));
+    if(iter != prof->node_ids.end())
+        return iter->second;
+
+    low_profiler_node_t node;
+    node.parent = parent;
+    node.frame = frame;
+    node.hits = 0;
+    prof->nodes.push_back(node);
+
+    int id = prof->nodes.size() - 1;
+    prof->nodes[parent].children.push_back(id);
+    prof->node_ids[pair<int, int>(parent, frame)] = id;
+    return id;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_add_sample
+// -----------------------------------------------------------------------------
+
+static void low_profiler_add_sample(low_profiler_t *prof, int node,
+                                    long long now)
+{
+    prof->nodes[node].hits++;
+    prof->samples.push_back(node);
+    prof->time_deltas.push_back((int)(now - prof->last_sample));
+    prof->last_sample = now;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_frame - stack entry to frame id. Functions are told apart by
+//  what they look like, their heap pointers may be reused after they are
+//  freed
+// -----------------------------------------------------------------------------
+
+static int low_profiler_frame(low_profiler_t *prof,
+                              const low_duk_frame_t &entry)
+{
+    char line[16];
+    sprintf(line, "%d", entry.start_line);
+
+    string key;
+    if(entry.name)
+        key.append(entry.name, entry.name_len);
+    key += '\0';
+    if(entry.file_name)
+        key.append(entry.file_name, entry.file_name_len);
+    key += '\0';
+    key += line;
+
+    auto iter = prof->frame_ids.find(key);
+    if(iter != prof->frame_ids.end())
+        return iter->second;
+
+    low_profiler_frame_t frame;
+    if(entry.name_len)
+        frame.name.assign(entry.name, entry.name_len);
+    else
+        frame.name = "(anonymous)";
+    if(entry.file_name_len)
+    {
+        if(entry.file_name[0] == '/')
+            frame.url = "file://";
+        frame.url.append(entry.file_name, entry.file_name_len);
+    }
+    frame.line = entry.start_line - 1;
+
+    int id = prof->frames.size();
+    prof->frames.push_back(frame);
+    prof->frame_ids[key] = id;
+    return id;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_stack - adds the call stack of the running code to the tree
+//  and returns its node, 0 if nothing runs. Does not use the Duktape API
+// -----------------------------------------------------------------------------
+
+int low_profiler_stack(duk_context *ctx, low_profiler_t *prof)
+{
+    low_duk_frame_t stack[LOW_PROFILER_MAX_DEPTH];
+    int depth = low_duk_stack(ctx, stack, LOW_PROFILER_MAX_DEPTH);
+
+    int node = 0;
+    for(int i = depth - 1; i >= 0; i--)
+        node = low_profiler_child(prof, node,
+                                  low_profiler_frame(prof, stack[i]));
+    return node;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_idle - called when the event loop wakes up again
+// -----------------------------------------------------------------------------
+
+void low_profiler_idle(low_t *low)
+{
+    low_profiler_t *prof = low->profiler;
+    if(!prof)
+        return;
+
+    // The time since the last tick was spent waiting
+    prof->sample_due = false;
+    low_profiler_add_sample(prof,
+                            low_profiler_child(prof, 0,
+                                               LOW_PROFILER_FRAME_IDLE),
+                            low_micro_count());
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_create / low_profiler_free
+// -----------------------------------------------------------------------------
+
+low_profiler_t *low_profiler_create(low_t *low)
+{
+    low_profiler_t *prof = new low_profiler_t();
+    prof->ctx = low->duk_ctx;
+    prof->interval = prof->start = prof->last_sample = 0;
+    prof->sample_due = false;
+    prof->timer_running = prof->timer_stop = false;
+
+    // Frame 0 to 2, node 0 is the root
+    low_profiler_special_frame(prof, "(root)");
+    low_profiler_special_frame(prof, "(idle)");
+    low_profiler_special_frame(prof, "(program)");
+
+    low_profiler_node_t root;
+    root.parent = -1;
+    root.frame = 0;
+    root.hits = 0;
+    prof->nodes.push_back(root);
+
+    return prof;
+}
+
+void low_profiler_free(low_t *low, low_profiler_t *prof)
+{
+    if(prof->timer_running)
+    {
+        pthread_mutex_lock(&prof->timer_mutex);
+        prof->timer_stop = true;
+        pthread_cond_signal(&prof->timer_cond);
+        pthread_mutex_unlock(&prof->timer_mutex);
+        pthread_join(prof->timer_thread, NULL);
+
+        pthread_cond_destroy(&prof->timer_cond);
+        pthread_mutex_destroy(&prof->timer_mutex);
+    }
+    delete prof;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_start
+// -----------------------------------------------------------------------------
+
+bool low_profiler_start(low_t *low, int interval)
+{
+    if(low->profiler)
+        return false;
+
+    low_profiler_t *prof = low_profiler_create(low);
+    prof->interval = interval > 0 ? interval : 1000;
+    prof->start = prof->last_sample = low_micro_count();
+
+    pthread_mutex_init(&prof->timer_mutex, NULL);
+    pthread_cond_init(&prof->timer_cond, NULL);
+    if(pthread_create(&prof->timer_thread, NULL, low_profiler_timer_main,
+                      prof) != 0)
+    {
+        pthread_cond_destroy(&prof->timer_cond);
+        pthread_mutex_destroy(&prof->timer_mutex);
+        low_profiler_free(low, prof);
+        return false;
+    }
+    prof->timer_running = true;
+
+    low->profiler = prof;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_json_string
+// -----------------------------------------------------------------------------
+
+void low_profiler_json_string(string &json, const string &str)
+{
+    json += '"';
+    for(size_t i = 0; i < str.size(); i++)
+    {
+        unsigned char c = str[i];
+        if(c == '"' || c == '\\')
+        {
+            json += '\\';
+            json += c;
+        }
+        else if(c < 0x20)
+        {
+            char esc[8];
+            sprintf(esc, "\\u%04x", c);
+            json += esc;
+        }
+        else
+            json += c;
+    }
+    json += '"';
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_stop
+// -----------------------------------------------------------------------------
+
+bool low_profiler_stop(low_t *low, string &json)
+{
+    low_profiler_t *prof = low->profiler;
+    if(!prof)
+        return false;
+    low->profiler = NULL;
+
+    long long end = low_micro_count();
+    char num[32];
+
+    json = "{\"nodes\":[";
+    for(size_t i = 0; i < prof->nodes.size(); i++)
+    {
+        low_profiler_node_t &node = prof->nodes[i];
+        low_profiler_frame_t &frame = prof->frames[node.frame];
+
+        sprintf(num, "%s{\"id\":%d,", i ? "," : "", (int)i + 1);
+        json += num;
+        json += "\"callFrame\":{\"functionName\":";
+        low_profiler_json_string(json, frame.name);
+        json += ",\"scriptId\":\"0\",\"url\":";
+        low_profiler_json_string(json, frame.url);
+        sprintf(num, ",\"lineNumber\":%d,", frame.line);
+        json += num;
+        sprintf(num, "\"columnNumber\":%d},", frame.line < 0 ? -1 : 0);
+        json += num;
+        sprintf(num, "\"hitCount\":%u,\"children\":[", node.hits);
+        json += num;
+        for(size_t j = 0; j < node.children.size(); j++)
+        {
+            sprintf(num, "%s%d", j ? "," : "", node.children[j] + 1);
+            json += num;
+        }
+        json += "]}";
+    }
+
+    sprintf(num, "],\"startTime\":%lld,", prof->start);
+    json += num;
+    sprintf(num, "\"endTime\":%lld,\"samples\":[", end);
+    json += num;
+    for(size_t i = 0; i < prof->samples.size(); i++)
+    {
+        sprintf(num, "%s%d", i ? "," : "", prof->samples[i] + 1);
+        json += num;
+    }
+    json += "],\"timeDeltas\":[";
+    for(size_t i = 0; i < prof->time_deltas.size(); i++)
+    {
+        sprintf(num, "%s%d", i ? "," : "", prof->time_deltas[i]);
+        json += num;
+    }
+    json += "]}";
+
+    low_profiler_free(low, prof);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_profiler_write - stops the profiler and writes the profile to a file
+// -----------------------------------------------------------------------------
+
+bool low_profiler_write(low_t *low, const char *path)
+{
+    string json;
+    if(!low_profiler_stop(low, json))
+        return false;
+
+    FILE *f = fopen(path, "w");
+    if(!f || fwrite(json.data(), 1, json.size(), f) != json.size())
+    {
+        fprintf(stderr, "Cannot write CPU profile to %s: %s\n", path,
+                strerror(errno));
+        if(f)
+            fclose(f);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_cpu_profile_start - native.cpuProfileStart([interval in us])
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_cpu_profile_start(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int interval = duk_is_undefined(ctx, 0) ? 0 : duk_require_int(ctx, 0);
+    if(low->profiler)
+        duk_generic_error(ctx, "CPU profiler is already running");
+    if(!low_profiler_start(low, interval))
+        duk_generic_error(ctx, "cannot start the CPU profiler timer");
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_cpu_profile_stop - native.cpuProfileStop(), returns the profile as
+//  JSON text or undefined if the profiler is not running
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_cpu_profile_stop(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    string json;
+    if(!low_profiler_stop(low, json))
+        return 0;
+
+    duk_push_lstring(ctx, json.data(), json.size());
+    return 1;
+}
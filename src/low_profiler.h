@@ -0,0 +1,76 @@
+// -----------------------------------------------------------------------------
+//  low_profiler.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_PROFILER_H__
+#define __LOW_PROFILER_H__
+
+#include "duktape.h"
+
+#include <pthread.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Sampled stacks are cut off at this depth, the outermost frames are lost
+#define LOW_PROFILER_MAX_DEPTH 64
+
+struct low_t;
+
+struct low_profiler_frame_t
+{
+    string name, url;
+    int line;       // 0-based, where the function starts
+};
+
+struct low_profiler_node_t
+{
+    int parent, frame;
+    unsigned int hits;
+    vector<int> children;
+};
+
+struct low_profiler_t
+{
+    duk_context *ctx;
+    long long interval, start, last_sample;     // in us
+
+    map<string, int> frame_ids;     // name, url and line -> frame
+    vector<low_profiler_frame_t> frames;
+
+    map<pair<int, int>, int> node_ids;      // (parent node, frame) -> node
+    vector<low_profiler_node_t> nodes;
+
+    vector<int> samples, time_deltas;
+
+    // The timer thread sets sample_due once per interval and forces the
+    // executor interrupt, which takes the sample
+    volatile bool sample_due;
+    bool timer_running, timer_stop;
+    pthread_t timer_thread;
+    pthread_mutex_t timer_mutex;
+    pthread_cond_t timer_cond;
+};
+
+// The call tree is also used for the allocation samples of low_heap
+low_profiler_t *low_profiler_create(low_t *low);
+void low_profiler_free(low_t *low, low_profiler_t *prof);
+int low_profiler_special_frame(low_profiler_t *prof, const char *name);
+int low_profiler_child(low_profiler_t *prof, int parent, int frame);
+int low_profiler_stack(duk_context *ctx, low_profiler_t *prof);
+void low_profiler_json_string(string &json, const string &str);
+
+bool low_profiler_start(low_t *low, int interval);
+// Returns the profile in the .cpuprofile format of V8
+bool low_profiler_stop(low_t *low, string &json);
+bool low_profiler_write(low_t *low, const char *path);
+
+void low_profiler_idle(low_t *low);
+
+duk_ret_t low_cpu_profile_start(duk_context *ctx);
+duk_ret_t low_cpu_profile_stop(duk_context *ctx);
+
+#endif /* __LOW_PROFILER_H__ */
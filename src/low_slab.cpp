@@ -0,0 +1,303 @@
+// -----------------------------------------------------------------------------
+//  low_slab.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_slab.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+#define LOW_SLAB_NO_CLASS 0xFF
+
+// Tuned to the sizes Duktape allocates most, on 32 and 64 bit
+static const uint16_t g_low_slab_sizes[LOW_SLAB_NUM_CLASSES] = {
+    8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024};
+
+
+// -----------------------------------------------------------------------------
+//  low_slab_create
+// -----------------------------------------------------------------------------
+
+low_slab_t *low_slab_create()
+{
+    low_slab_t *slab = (low_slab_t *)malloc(sizeof(low_slab_t));
+    if(!slab)
+        return NULL;
+
+    // Chunks are reserved by low_slab_grow when needed
+    slab->num_chunks = 0;
+    slab->lowest = slab->highest = NULL;
+    slab->num_pages = slab->top_page = 0;
+    slab->pages = NULL;
+
+    for(int i = 0; i < LOW_SLAB_NUM_CLASSES; i++)
+        slab->partial[i] = -1;
+    slab->released = -1;
+
+    int cls = 0;
+    for(int i = 0; i <= LOW_SLAB_MAX_SIZE / 8; i++)
+    {
+        while(g_low_slab_sizes[cls] < i * 8)
+            cls++;
+        slab->class_of[i] = cls;
+    }
+
+    return slab;
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_destroy
+// -----------------------------------------------------------------------------
+
+void low_slab_destroy(low_slab_t *slab)
+{
+    if(!slab)
+        return;
+
+    for(int i = 0; i < slab->num_chunks; i++)
+        munmap(slab->chunks[i], LOW_SLAB_CHUNK_SIZE);
+    free(slab->pages);
+    free(slab);
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_grow - reserves the next chunk, false if we cannot
+// -----------------------------------------------------------------------------
+
+static bool low_slab_grow(low_slab_t *slab)
+{
+    if(slab->num_chunks == LOW_SLAB_MAX_CHUNKS)
+        return false;
+
+    low_slab_page_t *pages = (low_slab_page_t *)realloc(
+      slab->pages,
+      (slab->num_pages + LOW_SLAB_CHUNK_PAGES) * sizeof(low_slab_page_t));
+    if(!pages)
+        return false;
+    slab->pages = pages;
+
+    // Reserve only, the OS gives us memory for the pages we touch
+    unsigned char *chunk = (unsigned char *)mmap(NULL, LOW_SLAB_CHUNK_SIZE,
+                                                 PROT_READ | PROT_WRITE,
+                                                 MAP_PRIVATE | MAP_ANONYMOUS
+#ifdef MAP_NORESERVE
+                                                 | MAP_NORESERVE
+#endif /* MAP_NORESERVE */
+                                                 , -1, 0);
+    if(chunk == MAP_FAILED)
+        return false;
+
+    int num = slab->num_chunks++;
+    slab->chunks[num] = chunk;
+
+    int pos = num;
+    while(pos > 0 && slab->chunks[slab->sorted[pos - 1]] > chunk)
+    {
+        slab->sorted[pos] = slab->sorted[pos - 1];
+        pos--;
+    }
+    slab->sorted[pos] = num;
+
+    if(!slab->lowest || chunk < slab->lowest)
+        slab->lowest = chunk;
+    if(chunk + LOW_SLAB_CHUNK_SIZE > slab->highest)
+        slab->highest = chunk + LOW_SLAB_CHUNK_SIZE;
+
+    for(int i = 0; i < LOW_SLAB_CHUNK_PAGES; i++)
+        slab->pages[slab->num_pages + i].cls = LOW_SLAB_NO_CLASS;
+    slab->num_pages += LOW_SLAB_CHUNK_PAGES;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_page
+// -----------------------------------------------------------------------------
+
+int low_slab_page(low_slab_t *slab, unsigned char *ptr)
+{
+    // Last chunk starting at or below ptr
+    int low = 0, high = slab->num_chunks;
+    while(high - low > 1)
+    {
+        int mid = (low + high) / 2;
+        if(slab->chunks[slab->sorted[mid]] <= ptr)
+            low = mid;
+        else
+            high = mid;
+    }
+
+    int num = slab->sorted[low];
+    unsigned char *chunk = slab->chunks[num];
+    if(ptr < chunk || ptr >= chunk + LOW_SLAB_CHUNK_SIZE)
+        return -1;
+    return num * LOW_SLAB_CHUNK_PAGES + (ptr - chunk) / LOW_SLAB_PAGE_SIZE;
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_page_data
+// -----------------------------------------------------------------------------
+
+static inline unsigned char *low_slab_page_data(low_slab_t *slab, int index)
+{
+    return slab->chunks[index / LOW_SLAB_CHUNK_PAGES]
+           + (size_t)(index % LOW_SLAB_CHUNK_PAGES) * LOW_SLAB_PAGE_SIZE;
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_class_size
+// -----------------------------------------------------------------------------
+
+size_t low_slab_class_size(int cls)
+{
+    return g_low_slab_sizes[cls];
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_unlink - removes page from list of pages with free blocks
+// -----------------------------------------------------------------------------
+
+static void low_slab_unlink(low_slab_t *slab, int index)
+{
+    low_slab_page_t *page = &slab->pages[index];
+
+    if(page->prev >= 0)
+        slab->pages[page->prev].next = page->next;
+    else
+        slab->partial[page->cls] = page->next;
+    if(page->next >= 0)
+        slab->pages[page->next].prev = page->prev;
+    page->prev = page->next = -1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_link - adds page to list of pages with free blocks
+// -----------------------------------------------------------------------------
+
+static void low_slab_link(low_slab_t *slab, int index)
+{
+    low_slab_page_t *page = &slab->pages[index];
+
+    page->prev = -1;
+    page->next = slab->partial[page->cls];
+    if(page->next >= 0)
+        slab->pages[page->next].prev = index;
+    slab->partial[page->cls] = index;
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_alloc
+// -----------------------------------------------------------------------------
+
+void *low_slab_alloc(low_slab_t *slab, int cls)
+{
+    int index = slab->partial[cls];
+    if(index < 0)
+    {
+        // New page, reuse released ones first
+        if(slab->released >= 0)
+        {
+            index = slab->released;
+            slab->released = slab->pages[index].next;
+        }
+        else if(slab->top_page < slab->num_pages || low_slab_grow(slab))
+            index = slab->top_page++;
+        else
+            return NULL;
+
+        low_slab_page_t *page = &slab->pages[index];
+        page->free = NULL;
+        page->bump = 0;
+        page->used = 0;
+        page->capacity = LOW_SLAB_PAGE_SIZE / g_low_slab_sizes[cls];
+        page->cls = cls;
+        low_slab_link(slab, index);
+    }
+
+    low_slab_page_t *page = &slab->pages[index];
+    void *ptr;
+    if(page->free)
+    {
+        ptr = page->free;
+        page->free = *(void **)ptr;
+    }
+    else
+    {
+        ptr = low_slab_page_data(slab, index) + page->bump;
+        page->bump += g_low_slab_sizes[cls];
+    }
+
+    if(++page->used == page->capacity)
+        low_slab_unlink(slab, index);
+    return ptr;
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_free
+// -----------------------------------------------------------------------------
+
+void low_slab_free(low_slab_t *slab, void *ptr, int cls)
+{
+    int index = low_slab_page(slab, (unsigned char *)ptr);
+    low_slab_page_t *page = &slab->pages[index];
+
+    *(void **)ptr = page->free;
+    page->free = ptr;
+
+    if(page->used-- == page->capacity)
+        low_slab_link(slab, index);
+    else if(page->used == 0 && (page->prev >= 0 || page->next >= 0))
+    {
+        // Empty and not the only page of the class with free blocks, give
+        // the memory back. One page is kept so a single block which is
+        // allocated and freed all the time does not cause system calls
+        low_slab_unlink(slab, index);
+        page->cls = LOW_SLAB_NO_CLASS;
+#ifdef MADV_DONTNEED
+        madvise(low_slab_page_data(slab, index), LOW_SLAB_PAGE_SIZE,
+                MADV_DONTNEED);
+#endif /* MADV_DONTNEED */
+
+        page->next = slab->released;
+        slab->released = index;
+    }
+}
+
+// -----------------------------------------------------------------------------
+//  low_slab_stats
+// -----------------------------------------------------------------------------
+
+int low_slab_stats(low_slab_t *slab, low_slab_class_stats_t *stats,
+                   int *released)
+{
+    for(int i = 0; i < LOW_SLAB_NUM_CLASSES; i++)
+    {
+        stats[i].size = g_low_slab_sizes[i];
+        stats[i].pages = 0;
+        stats[i].blocks_used = 0;
+        stats[i].blocks_free = 0;
+    }
+
+    int in_use = 0;
+    *released = 0;
+    if(!slab)
+        return 0;
+
+    for(int i = 0; i < slab->top_page; i++)
+    {
+        low_slab_page_t *page = &slab->pages[i];
+        if(page->cls == LOW_SLAB_NO_CLASS)
+        {
+            (*released)++;
+            continue;
+        }
+
+        in_use++;
+        stats[page->cls].pages++;
+        stats[page->cls].blocks_used += page->used;
+        stats[page->cls].blocks_free += page->capacity - page->used;
+    }
+
+    return in_use;
+}
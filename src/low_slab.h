@@ -0,0 +1,104 @@
+// -----------------------------------------------------------------------------
+//  low_slab.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_SLAB_H__
+#define __LOW_SLAB_H__
+
+#include "low_config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Duktape allocates mostly small blocks of few distinct sizes (hstrings,
+// hobjects, property tables). These go into pages of same sized blocks,
+// without size header. Larger blocks are allocated with malloc.
+// Only to be used by the thread owning the Duktape heap, no locking
+#define LOW_SLAB_PAGE_SIZE      (64 * 1024)
+#define LOW_SLAB_MAX_SIZE       1024
+#define LOW_SLAB_NUM_CLASSES    24
+
+// Address space is reserved in chunks as the heap grows, so many heaps
+// (workers) or 32 bit builds do not run out of it. Only touched pages use
+// memory. LOW_SLAB_ARENA_SIZE is the most one heap reserves
+#define LOW_SLAB_CHUNK_SIZE     (4 * 1024 * 1024)
+#define LOW_SLAB_CHUNK_PAGES    (LOW_SLAB_CHUNK_SIZE / LOW_SLAB_PAGE_SIZE)
+#ifndef LOW_SLAB_ARENA_SIZE
+#if UINTPTR_MAX > 0xFFFFFFFF
+#define LOW_SLAB_ARENA_SIZE     (1024 * 1024 * 1024)
+#else
+#define LOW_SLAB_ARENA_SIZE     (128 * 1024 * 1024)
+#endif /* UINTPTR_MAX */
+#endif /* LOW_SLAB_ARENA_SIZE */
+#define LOW_SLAB_MAX_CHUNKS     (LOW_SLAB_ARENA_SIZE / LOW_SLAB_CHUNK_SIZE)
+
+struct low_slab_page_t
+{
+    void *free;         // list of freed blocks
+    uint32_t bump;      // offset of first block never used
+    uint16_t used, capacity;
+    uint8_t cls;        // LOW_SLAB_NO_CLASS if not in use
+    int32_t prev, next; // list of pages with free blocks of this class,
+                        // or stack of released pages
+};
+
+struct low_slab_class_stats_t
+{
+    uint32_t size;
+    uint32_t pages;
+    size_t blocks_used, blocks_free;
+};
+
+struct low_slab_t
+{
+    // Chunk i holds pages i * LOW_SLAB_CHUNK_PAGES onwards. sorted has the
+    // chunk numbers in address order, for low_slab_page
+    unsigned char *chunks[LOW_SLAB_MAX_CHUNKS];
+    int sorted[LOW_SLAB_MAX_CHUNKS];
+    int num_chunks;
+    unsigned char *lowest, *highest;
+
+    int num_pages, top_page;
+    low_slab_page_t *pages;
+
+    int partial[LOW_SLAB_NUM_CLASSES];  // pages with free blocks
+    int released;                       // pages given back to the OS
+
+    uint8_t class_of[LOW_SLAB_MAX_SIZE / 8 + 1];
+};
+
+low_slab_t *low_slab_create();
+void low_slab_destroy(low_slab_t *slab);
+
+// Size class of a block of given size, -1 if too large for the slabs
+static inline int low_slab_class(low_slab_t *slab, size_t size)
+{
+    if(!slab || size > LOW_SLAB_MAX_SIZE)
+        return -1;
+    return slab->class_of[(size + 7) >> 3];
+}
+size_t low_slab_class_size(int cls);
+
+// NULL if the arena is full, the caller falls back to malloc then
+void *low_slab_alloc(low_slab_t *slab, int cls);
+
+// Page of the block or -1 if not from the slabs
+int low_slab_page(low_slab_t *slab, unsigned char *ptr);
+
+// Returns the size class of the block or -1 if not from the slabs
+static inline int low_slab_owner(low_slab_t *slab, void *ptr)
+{
+    if(!slab || (unsigned char *)ptr < slab->lowest
+    || (unsigned char *)ptr >= slab->highest)
+        return -1;
+
+    int index = low_slab_page(slab, (unsigned char *)ptr);
+    return index < 0 ? -1 : slab->pages[index].cls;
+}
+void low_slab_free(low_slab_t *slab, void *ptr, int cls);
+
+// Fills stats[LOW_SLAB_NUM_CLASSES], returns number of pages in use
+int low_slab_stats(low_slab_t *slab, low_slab_class_stats_t *stats,
+                   int *released);
+
+#endif /* __LOW_SLAB_H__ */
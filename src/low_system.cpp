@@ -116,6 +116,11 @@ bool low_system_init(int argc, const char *argv[])
     sigaction(SIGTERM, &action, NULL);
     sigaction(SIGINT, &action, NULL);
     sigaction(SIGHUP, &action, NULL);
+#if LOW_INCLUDE_CHILD_PROCESS
+    // Exited children are reaped by the code thread, see LowChildProcess
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, NULL);
+#endif /* LOW_INCLUDE_CHILD_PROCESS */
 
     action.sa_flags = 0;
     action.sa_handler = low_system_crash;
@@ -307,6 +312,60 @@ int low_tick_count()
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
 }
 
+// -----------------------------------------------------------------------------
+//  low_micro_count - give monotonic time in us, for measurements
+// -----------------------------------------------------------------------------
+
+long long low_micro_count()
+{
+#if LOW_ESP32_LWIP_SPECIALITIES
+    return ((long long)xTaskGetTickCount()) * portTICK_PERIOD_MS * 1000;
+#elif defined(__APPLE__)
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return ((long long)tv.tv_sec) * 1000000 + tv.tv_usec;
+#else
+    struct timespec tv;
+    clock_gettime(CLOCK_MONOTONIC, &tv);
+    return ((long long)tv.tv_sec) * 1000000 + tv.tv_nsec / 1000;
+#endif /* LOW_ESP32_LWIP_SPECIALITIES */
+}
+
+// -----------------------------------------------------------------------------
+//  low_signal_name / low_signal_number - map between signals and their
+//  Node.js names
+// -----------------------------------------------------------------------------
+
+static const struct
+{
+    int signal;
+    const char *name;
+} gLowSignals[] = {
+  {SIGHUP, "SIGHUP"},     {SIGINT, "SIGINT"},     {SIGQUIT, "SIGQUIT"},
+  {SIGILL, "SIGILL"},     {SIGTRAP, "SIGTRAP"},   {SIGABRT, "SIGABRT"},
+  {SIGBUS, "SIGBUS"},     {SIGFPE, "SIGFPE"},     {SIGKILL, "SIGKILL"},
+  {SIGUSR1, "SIGUSR1"},   {SIGSEGV, "SIGSEGV"},   {SIGUSR2, "SIGUSR2"},
+  {SIGPIPE, "SIGPIPE"},   {SIGALRM, "SIGALRM"},   {SIGTERM, "SIGTERM"},
+  {SIGCHLD, "SIGCHLD"},   {SIGCONT, "SIGCONT"},   {SIGSTOP, "SIGSTOP"},
+  {SIGTSTP, "SIGTSTP"},   {SIGTTIN, "SIGTTIN"},   {SIGTTOU, "SIGTTOU"},
+  {SIGWINCH, "SIGWINCH"}, {0, NULL}};
+
+const char *low_signal_name(int signal)
+{
+    for(int i = 0; gLowSignals[i].name; i++)
+        if(gLowSignals[i].signal == signal)
+            return gLowSignals[i].name;
+    return NULL;
+}
+
+int low_signal_number(const char *name)
+{
+    for(int i = 0; gLowSignals[i].name; i++)
+        if(strcmp(gLowSignals[i].name, name) == 0)
+            return gLowSignals[i].signal;
+    return 0;
+}
+
 // -----------------------------------------------------------------------------
 //  low_push_error
 // -----------------------------------------------------------------------------
@@ -69,6 +69,10 @@ extern "C"
 
 bool low_set_raw_mode(bool mode);
 int low_tick_count();
+long long low_micro_count();
+
+const char *low_signal_name(int signal);     // NULL if unknown
+int low_signal_number(const char *name);    // 0 if unknown
 
 extern "C" void low_push_error(duk_context *ctx, int error, const char *syscall);
 
@@ -179,6 +179,28 @@ duk_ret_t low_tls_create_context(duk_context *ctx)
     if(malloc_ca)
         low_free(my_ca);
 
+    duk_get_prop_string(ctx, 0, "ALPNProtocols");
+    if(duk_is_array(ctx, -1))
+    {
+        const char *protocols[8];
+        int count = duk_get_length(ctx, -1);
+        if(count > 8)
+            count = 8;
+        // The strings stay on the stack until they are copied
+        for(int i = 0; i < count; i++)
+        {
+            duk_get_prop_index(ctx, -1 - i, i);
+            protocols[i] = duk_to_string(ctx, -1);
+        }
+        if(!context->SetALPNProtocols(protocols, count))
+        {
+            delete context;
+            duk_generic_error(ctx, "SSL context error");
+        }
+        duk_pop_n(ctx, count);
+    }
+    duk_pop(ctx);
+
     int index;
     for(index = 0; index < low->tlsContexts.size(); index++)
         if(!low->tlsContexts[index])
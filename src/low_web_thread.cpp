@@ -4,6 +4,7 @@
 
 #include "low_web_thread.h"
 #include "LowFD.h"
+#include "LowHTTPDirect.h"
 
 #include "low_main.h"
 #include "low_system.h"
@@ -35,6 +36,34 @@ extern bool gCodeRunning;
 
 using namespace std;
 
+#if LOW_INCLUDE_CARES_RESOLVER
+
+// -----------------------------------------------------------------------------
+//  low_web_resolvers - the c-ares channels with queries running, of our heap
+//  and of the worker heaps we serve. Called with low->resolvers_mutex locked
+// -----------------------------------------------------------------------------
+
+static void low_web_resolvers(low_t *low, vector<ares_channel> &channels)
+{
+    channels.clear();
+    for(int h = 0; h <= low->thread_heaps.size(); h++)
+    {
+        low_t *heap = h ? low->thread_heaps[h - 1] : low;
+        if(!heap->resolvers_active)
+            continue;
+
+        if(h)
+            pthread_mutex_lock(&heap->resolvers_mutex);
+        for(int i = 0; i < heap->resolvers.size(); i++)
+            if(heap->resolvers[i] && heap->resolvers[i]->IsActive())
+                channels.push_back(heap->resolvers[i]->Channel());
+        if(h)
+            pthread_mutex_unlock(&heap->resolvers_mutex);
+    }
+}
+
+#endif /* LOW_INCLUDE_CARES_RESOLVER */
+
 // -----------------------------------------------------------------------------
 //  low_web_thread_main
 // -----------------------------------------------------------------------------
@@ -43,6 +72,10 @@ void *low_web_thread_main(void *arg)
 {
     low_t *low = (low_t *)arg;
 
+#if LOW_INCLUDE_CARES_RESOLVER
+    vector<ares_channel> channels;
+#endif /* LOW_INCLUDE_CARES_RESOLVER */
+
 #if LOW_HAS_POLL && !defined(LOWJS_SERV)
     vector<pollfd> fds;
     vector<LowFD *> lowFDs;
@@ -59,46 +92,46 @@ void *low_web_thread_main(void *arg)
 
 #if LOW_INCLUDE_CARES_RESOLVER
         int first_cares_fd = fds.size();
-        if(low->resolvers_active)
+        pthread_mutex_lock(&low->resolvers_mutex);
+        low_web_resolvers(low, channels);
+        pthread_mutex_unlock(&low->resolvers_mutex);
+        for(i = 0; i < channels.size(); i++)
         {
-            pthread_mutex_lock(&low->resolvers_mutex);
-            for(i = 0; i < low->resolvers.size(); i++)
-            {
-                if(!low->resolvers[i]->IsActive())
-                    continue;
-                ares_channel &channel = low->resolvers[i]->Channel();
+            ares_channel channel = channels[i];
 
-                int sockets[16];
-                int mask = ares_getsock(channel, sockets, 16);
-                for(int j = 0; j < 16; j++)
-                {
-                    short events =
-                        (ARES_GETSOCK_READABLE(mask, j) ? POLLIN : 0) |
-                        (ARES_GETSOCK_WRITABLE(mask, j) ? POLLOUT : 0);
-                    if(!events)
-                        break;
+            int sockets[16];
+            int mask = ares_getsock(channel, sockets, 16);
+            for(int j = 0; j < 16; j++)
+            {
+                short events =
+                    (ARES_GETSOCK_READABLE(mask, j) ? POLLIN : 0) |
+                    (ARES_GETSOCK_WRITABLE(mask, j) ? POLLOUT : 0);
+                if(!events)
+                    break;
 
-                    pollfd fd;
-                    fd.fd = sockets[j];
-                    fd.events = events;
-                    fds.push_back(fd);
+                pollfd fd;
+                fd.fd = sockets[j];
+                fd.events = events;
+                fds.push_back(fd);
 
-                    lowFDs.push_back((LowFD *)channel);
+                lowFDs.push_back((LowFD *)channel);
 
-                    struct timeval tv;
-                    struct timeval *val = ares_timeout(channel, NULL, &tv);
-                    if(val)
-                    {
-                        int millisecs =
-                            val->tv_sec * 1000 + val->tv_usec / 1000;
-                        if(timeout > millisecs || timeout == -1)
-                            timeout = millisecs;
-                    }
+                struct timeval tv;
+                struct timeval *val = ares_timeout(channel, NULL, &tv);
+                if(val)
+                {
+                    int millisecs =
+                        val->tv_sec * 1000 + val->tv_usec / 1000;
+                    if(timeout > millisecs || timeout == -1)
+                        timeout = millisecs;
                 }
             }
-            pthread_mutex_unlock(&low->resolvers_mutex);
         }
 #endif /* LOW_INCLUDE_CARES_RESOLVER */
+        int deadline = LowHTTPDirect::ExpireDeadlines(low);
+        if(deadline != -1 && (timeout > deadline || timeout == -1))
+            timeout = deadline;
+
         int count = poll(&fds[0], fds.size(), timeout);
         if(low->destroying)
             break;
@@ -283,35 +316,31 @@ void *low_web_thread_main(void *arg)
             fd_set write_set1 = write_set;
 
 #if LOW_INCLUDE_CARES_RESOLVER
-            bool has_cares = false;
-            if(low->resolvers_active)
+            pthread_mutex_lock(&low->resolvers_mutex);
+            low_web_resolvers(low, channels);
+            pthread_mutex_unlock(&low->resolvers_mutex);
+            for(i = 0; i < channels.size(); i++)
             {
-                pthread_mutex_lock(&low->resolvers_mutex);
-                for(i = 0; i < low->resolvers.size(); i++)
-                {
-                    if(!low->resolvers[i]->IsActive())
-                        continue;
-                    ares_channel &channel = low->resolvers[i]->Channel();
+                ares_channel channel = channels[i];
 
-                    int count = ares_fds(channel, &read_set1, &write_set1);
-                    if(count)
+                int count = ares_fds(channel, &read_set1, &write_set1);
+                if(count)
+                {
+                    struct timeval tv;
+                    struct timeval *val = ares_timeout(channel, NULL, &tv);
+                    if(val)
                     {
-                        has_cares = true;
-
-                        struct timeval tv;
-                        struct timeval *val = ares_timeout(channel, NULL, &tv);
-                        if(val)
-                        {
-                            int millisecs =
-                                val->tv_sec * 1000 + val->tv_usec / 1000;
-                            if(timeout > millisecs || timeout == -1)
-                                timeout = millisecs;
-                        }
+                        int millisecs =
+                            val->tv_sec * 1000 + val->tv_usec / 1000;
+                        if(timeout > millisecs || timeout == -1)
+                            timeout = millisecs;
                     }
                 }
-                pthread_mutex_unlock(&low->resolvers_mutex);
             }
 #endif /* LOW_INCLUDE_CARES_RESOLVER */
+            int deadline = LowHTTPDirect::ExpireDeadlines(low);
+            if(deadline != -1 && (timeout > deadline || timeout == -1))
+                timeout = deadline;
 
 #if LOW_ESP32_LWIP_SPECIALITIES || defined(LOWJS_SERV)
             int timeout2 = gWebThreadNextTick - low_tick_count();
@@ -361,17 +390,13 @@ void *low_web_thread_main(void *arg)
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
 
 #if LOW_INCLUDE_CARES_RESOLVER
-            if(has_cares)
+            if(!channels.empty())
             {
+                // Again, resolvers might have been deleted meanwhile
                 pthread_mutex_lock(&low->resolvers_mutex);
-                for(i = 0; i < low->resolvers.size(); i++)
-                {
-                    if(!low->resolvers[i]->IsActive())
-                        continue;
-                    ares_channel &channel = low->resolvers[i]->Channel();
-
-                    ares_process(channel, &read_set1, &write_set1);
-                }
+                low_web_resolvers(low, channels);
+                for(i = 0; i < channels.size(); i++)
+                    ares_process(channels[i], &read_set1, &write_set1);
                 pthread_mutex_unlock(&low->resolvers_mutex);
             }
 #endif /* LOW_INCLUDE_CARES_RESOLVER */
@@ -603,7 +628,7 @@ void low_web_thread_break(low_t *low)
     lowjs_esp32_break_web(false);
 #else
     char c = 0xFF;
-    write(low->web_thread_pipe[1], &c, 1);
+    write(low->threads->web_thread_pipe[1], &c, 1);
 #endif /* LOW_ESP32_LWIP_SPECIALITIES */
 }
 
@@ -613,6 +638,7 @@ void low_web_thread_break(low_t *low)
 
 void low_web_set_poll_events(low_t *low, LowFD *fd, short events)
 {
+    low = low->threads;
     pthread_mutex_lock(&low->web_thread_mutex);
 
     fd->mPollEvents = events;
@@ -638,6 +664,7 @@ void low_web_set_poll_events(low_t *low, LowFD *fd, short events)
 
 void low_web_clear_poll(low_t *low, LowFD *fd)
 {
+    low = low->threads;
     pthread_mutex_lock(&low->web_thread_mutex);
     while(true)
     {
@@ -673,6 +700,7 @@ void low_web_clear_poll(low_t *low, LowFD *fd)
 
 void low_web_mark_delete(low_t *low, LowFD *fd)
 {
+    low = low->threads;
     pthread_mutex_lock(&low->web_thread_mutex);
 
     fd->mMarkDelete = true;
@@ -0,0 +1,214 @@
+// -----------------------------------------------------------------------------
+//  low_websocket.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_websocket.h"
+
+#include "LowSocket.h"
+#include "LowWebSocketDirect.h"
+
+#include "low_codec.h"
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+
+// -----------------------------------------------------------------------------
+//  low_ws_get - the WebSocket on the socket, NULL if the socket is closed
+// -----------------------------------------------------------------------------
+
+static LowWebSocketDirect *low_ws_get(duk_context *ctx, int socketFD)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    auto iter = low->fds.find(socketFD);
+    if(iter == low->fds.end() || iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        return NULL;
+    LowSocket *socket = (LowSocket *)iter->second;
+
+    int directType;
+    LowSocketDirect *direct = socket->GetDirect(directType);
+    if(!direct || directType != LOWWEBSOCKETDIRECT_TYPE)
+        return NULL;
+    return (LowWebSocketDirect *)direct;
+}
+
+// -----------------------------------------------------------------------------
+//  low_ws_frame - frame with the string or buffer at index as payload
+// -----------------------------------------------------------------------------
+
+static LowWebSocketFrame *low_ws_frame(duk_context *ctx, int opcode,
+                                       duk_idx_t index, bool fin = true)
+{
+    LowWebSocketFrame *frame;
+    if(duk_is_string(ctx, index))
+    {
+        duk_size_t len;
+        const unsigned char *str =
+          (const unsigned char *)duk_get_lstring(ctx, index, &len);
+
+        // Strings without surrogate pairs are UTF-8 already
+        if(low_utf8_is_internal(str, len))
+            frame = LowWebSocketDirect::NewFrame(opcode, str, len, fin);
+        else
+        {
+            size_t size = low_internal_utf8_len(str, len);
+            frame = LowWebSocketDirect::NewFrame(opcode, NULL, size, fin);
+            if(frame)
+                low_internal_to_utf8(str, len,
+                                     frame->data + frame->len - size);
+        }
+    }
+    else
+    {
+        duk_size_t len;
+        const unsigned char *data =
+          (const unsigned char *)duk_require_buffer_data(ctx, index, &len);
+        frame = LowWebSocketDirect::NewFrame(opcode, data, len, fin);
+    }
+
+    if(!frame)
+    {
+        low_push_error(ctx, ENOMEM, "malloc");
+        duk_throw(ctx);
+    }
+    return frame;
+}
+
+// -----------------------------------------------------------------------------
+//  low_ws_attach - (socketFD, response, head, maxPayload, callback)
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_ws_attach(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int socketFD = duk_require_int(ctx, 0);
+    int maxPayload = duk_require_int(ctx, 3);
+    duk_require_function(ctx, 4);
+
+    auto iter = low->fds.find(socketFD);
+    if(iter == low->fds.end())
+        return 0;
+
+    if(iter->second->FDType() != LOWFD_TYPE_SOCKET)
+        duk_reference_error(ctx, "file descriptor is not a socket");
+    LowSocket *socket = (LowSocket *)iter->second;
+
+    int directType;
+    if(socket->GetDirect(directType))
+        duk_reference_error(
+          ctx, "file descriptor is already acquired by direct object");
+
+    duk_size_t headLen = 0;
+    unsigned char *head = NULL;
+    if(!duk_is_undefined(ctx, 2))
+        head = (unsigned char *)duk_require_buffer_data(ctx, 2, &headLen);
+
+    LowWebSocketFrame *response = low_ws_frame(ctx, -1, 1);
+    LowWebSocketDirect *direct =
+      new LowWebSocketDirect(low, low_add_stash(ctx, 4), maxPayload);
+    if(!direct)
+    {
+        LowWebSocketDirect::Release(low, response);
+        low_push_error(ctx, ENOMEM, "malloc");
+        duk_throw(ctx);
+    }
+
+    // The response goes out before any frame, including the answers to
+    // what the client sent with the upgrade request
+    direct->Send(response);
+    direct->Feed(head, headLen);
+
+    socket->SetDirect(direct, LOWWEBSOCKETDIRECT_TYPE);
+    socket->TriggerDirect(LOWSOCKET_TRIGGER_READ | LOWSOCKET_TRIGGER_WRITE);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_ws_send - (socketFD, opcode, data, fin), returns the bytes queued for
+//  writing or -1 if the WebSocket is closing
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_ws_send(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    LowWebSocketDirect *direct = low_ws_get(ctx, duk_require_int(ctx, 0));
+    if(!direct)
+    {
+        duk_push_int(ctx, -1);
+        return 1;
+    }
+
+    LowWebSocketFrame *frame =
+      low_ws_frame(ctx, duk_require_int(ctx, 1), 2,
+                   duk_is_undefined(ctx, 3) || duk_require_boolean(ctx, 3));
+    int queued = direct->Send(frame);
+    if(queued < 0)
+        LowWebSocketDirect::Release(low, frame);
+
+    duk_push_int(ctx, queued);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_ws_close - (socketFD, code, reason)
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_ws_close(duk_context *ctx)
+{
+    LowWebSocketDirect *direct = low_ws_get(ctx, duk_require_int(ctx, 0));
+    if(!direct)
+    {
+        duk_push_int(ctx, -1);
+        return 1;
+    }
+
+    int code = duk_get_int_default(ctx, 1, 0);
+    duk_size_t len = 0;
+    const char *reason = duk_get_lstring_default(ctx, 2, &len, "", 0);
+
+    duk_push_int(ctx, direct->Close(code, reason, len));
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_ws_broadcast - (socketFDs, opcode, data, exceptFD), the frame is built
+//  once and shared by all sockets. Returns the number of sockets
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_ws_broadcast(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int opcode = duk_require_int(ctx, 1);
+    int exceptFD = duk_get_int_default(ctx, 3, -1);
+
+    LowWebSocketFrame *frame = low_ws_frame(ctx, opcode, 2);
+
+    int count = 0;
+    duk_uarridx_t len = duk_is_array(ctx, 0) ? duk_get_length(ctx, 0) : 0;
+    for(duk_uarridx_t i = 0; i < len; i++)
+    {
+        duk_get_prop_index(ctx, 0, i);
+        int socketFD = duk_get_int_default(ctx, -1, -1);
+        duk_pop(ctx);
+
+        if(socketFD == exceptFD)
+            continue;
+        LowWebSocketDirect *direct = low_ws_get(ctx, socketFD);
+        if(!direct)
+            continue;
+
+        LowWebSocketDirect::AddRef(low, frame);
+        if(direct->Send(frame) < 0)
+            LowWebSocketDirect::Release(low, frame);
+        else
+            count++;
+    }
+    LowWebSocketDirect::Release(low, frame);
+
+    duk_push_int(ctx, count);
+    return 1;
+}
@@ -0,0 +1,16 @@
+// -----------------------------------------------------------------------------
+//  low_websocket.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_WEBSOCKET_H__
+#define __LOW_WEBSOCKET_H__
+
+#include "duktape.h"
+
+duk_ret_t low_ws_attach(duk_context *ctx);
+
+duk_ret_t low_ws_send(duk_context *ctx);
+duk_ret_t low_ws_close(duk_context *ctx);
+duk_ret_t low_ws_broadcast(duk_context *ctx);
+
+#endif /* __LOW_WEBSOCKET_H__ */
@@ -0,0 +1,216 @@
+// -----------------------------------------------------------------------------
+//  low_worker.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_config.h"
+#if LOW_INCLUDE_WORKER_THREADS
+
+#include "low_worker.h"
+#include "LowWorker.h"
+
+#include "low_main.h"
+#include "low_system.h"
+
+#include <errno.h>
+
+
+// -----------------------------------------------------------------------------
+//  low_worker_get - returns the worker at index of argument 0
+// -----------------------------------------------------------------------------
+
+static LowWorker *low_worker_get(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int index = duk_require_int(ctx, 0);
+    if(index < 0 || index >= low->workers.size() || !low->workers[index])
+        duk_reference_error(ctx, "worker not found");
+
+    return low->workers[index];
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_message - serializes value and transfer list
+// -----------------------------------------------------------------------------
+
+static LowWorkerMessage *low_worker_message(duk_context *ctx, int index)
+{
+    // Serialize first, so nothing leaks if the value cannot be cloned
+    low_clone_t clone;
+    low_clone_serialize(ctx, index, index + 1, clone);
+
+    LowWorkerMessage *msg = new(ctx) LowWorkerMessage();
+    msg->event = LOWWORKER_EVENT_MESSAGE;
+    msg->clone.data.swap(clone.data);
+    msg->clone.transfers.swap(clone.transfers);
+
+    return msg;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_create
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_create(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    const char *path = duk_require_string(ctx, 1);
+    duk_require_function(ctx, 4);
+
+    LowWorkerMessage *workerData = low_worker_message(ctx, 2);
+    LowWorker *worker = new(ctx) LowWorker(low);
+
+    int index;
+    for(index = 0; index < low->workers.size(); index++)
+        if(!low->workers[index])
+        {
+            low->workers[index] = worker;
+            break;
+        }
+    if(index == low->workers.size())
+        low->workers.push_back(worker);
+    worker->SetIndex(index);
+
+    if(!worker->Start(path, workerData, low_add_stash(ctx, 4)))
+    {
+        int err = errno;
+        delete worker;
+
+        low_push_error(ctx, err, "pthread_create");
+        duk_throw(ctx);
+    }
+
+    duk_push_int(ctx, worker->ThreadID());
+    duk_put_prop_string(ctx, 0, "threadId");
+
+    duk_push_int(ctx, index);
+    duk_push_c_function(ctx, low_worker_finalizer, 1);
+    duk_set_finalizer(ctx, 0);
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_finalizer
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_finalizer(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_get_prop_string(ctx, 0, "_native");
+    int index = duk_get_int_default(ctx, -1, -1);
+
+    if(index < 0)
+        return 0;
+    if(index >= low->workers.size())
+        duk_reference_error(ctx, "worker not found");
+
+    delete low->workers[index];
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_post_message
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_post_message(duk_context *ctx)
+{
+    LowWorker *worker = low_worker_get(ctx);
+
+    worker->Post(true, low_worker_message(ctx, 1));
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_terminate
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_terminate(duk_context *ctx)
+{
+    low_worker_get(ctx)->Terminate();
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_ref
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_ref(duk_context *ctx)
+{
+    low_worker_get(ctx)->Ref(duk_require_boolean(ctx, 1));
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_info - null in the main thread
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_info(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    if(!low->worker)
+    {
+        duk_push_null(ctx);
+        return 1;
+    }
+
+    duk_push_object(ctx);
+    duk_push_int(ctx, low->worker->ThreadID());
+    duk_put_prop_string(ctx, -2, "threadId");
+    low->worker->PushWorkerData(ctx);
+    duk_put_prop_string(ctx, -2, "workerData");
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_post
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_post(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    if(!low->worker)
+        duk_reference_error(ctx, "not in a worker");
+
+    low->worker->Post(false, low_worker_message(ctx, 0));
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_set_receiver
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_set_receiver(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    if(!low->worker)
+        duk_reference_error(ctx, "not in a worker");
+
+    if(duk_is_null_or_undefined(ctx, 0))
+        low->worker->SetReceiver(0);
+    else
+    {
+        duk_require_function(ctx, 0);
+        low->worker->SetReceiver(low_add_stash(ctx, 0));
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_worker_port_ref
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_worker_port_ref(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+    if(!low->worker)
+        duk_reference_error(ctx, "not in a worker");
+
+    low->worker->PortRef(duk_require_boolean(ctx, 0));
+    return 0;
+}
+
+#endif /* LOW_INCLUDE_WORKER_THREADS */
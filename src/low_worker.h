@@ -0,0 +1,23 @@
+// -----------------------------------------------------------------------------
+//  low_worker.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_WORKER_H__
+#define __LOW_WORKER_H__
+
+#include "duktape.h"
+
+// Parent side
+duk_ret_t low_worker_create(duk_context *ctx);
+duk_ret_t low_worker_finalizer(duk_context *ctx);
+duk_ret_t low_worker_post_message(duk_context *ctx);
+duk_ret_t low_worker_terminate(duk_context *ctx);
+duk_ret_t low_worker_ref(duk_context *ctx);
+
+// Worker side
+duk_ret_t low_worker_info(duk_context *ctx);
+duk_ret_t low_worker_post(duk_context *ctx);
+duk_ret_t low_worker_set_receiver(duk_context *ctx);
+duk_ret_t low_worker_port_ref(duk_context *ctx);
+
+#endif /* __LOW_WORKER_H__ */
@@ -0,0 +1,186 @@
+// -----------------------------------------------------------------------------
+//  low_zlib.cpp
+// -----------------------------------------------------------------------------
+
+#include "low_config.h"
+#if LOW_INCLUDE_ZLIB
+
+#include "low_zlib.h"
+#include "LowZlib.h"
+
+#include "low_main.h"
+#include "low_system.h"
+
+
+// -----------------------------------------------------------------------------
+//  low_zlib_get - returns the stream at index of argument 0
+// -----------------------------------------------------------------------------
+
+static LowZlib *low_zlib_get(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int index = duk_require_int(ctx, 0);
+    if(index < 0 || index >= low->zlibStreams.size() || !low->zlibStreams[index])
+        duk_reference_error(ctx, "zlib stream not found");
+
+    return low->zlibStreams[index];
+}
+
+// -----------------------------------------------------------------------------
+//  low_zlib_get_buffer - reads buffer, offset and length arguments
+// -----------------------------------------------------------------------------
+
+static unsigned char *low_zlib_get_buffer(duk_context *ctx, int index, int &len)
+{
+    duk_size_t buf_len;
+    unsigned char *buf =
+      (unsigned char *)duk_require_buffer_data(ctx, index, &buf_len);
+
+    int offset = duk_require_int(ctx, index + 1);
+    len = duk_require_int(ctx, index + 2);
+    if(offset < 0 || len < 0 || offset + len > buf_len)
+        duk_range_error(ctx, "offset/length outside of buffer");
+
+    return buf + offset;
+}
+
+// -----------------------------------------------------------------------------
+//  low_zlib_create
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_zlib_create(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    int mode = duk_require_int(ctx, 1);
+    int level = duk_require_int(ctx, 2);
+    int windowBits = duk_require_int(ctx, 3);
+    int memLevel = duk_require_int(ctx, 4);
+    int strategy = duk_require_int(ctx, 5);
+
+    if(mode <= LOWZLIB_MODE_NONE || mode > LOWZLIB_MODE_UNZIP)
+        duk_range_error(ctx, "invalid zlib mode %d", mode);
+
+    LowZlib *stream = new(ctx) LowZlib(low, (LowZlibMode)mode);
+    int err = stream->Init(level, windowBits, memLevel, strategy);
+    if(err != Z_OK)
+    {
+        delete stream;
+
+        LowZlib::PushError(ctx, err, "Init error");
+        duk_throw(ctx);
+    }
+
+    int index;
+    for(index = 0; index < low->zlibStreams.size(); index++)
+        if(!low->zlibStreams[index])
+        {
+            low->zlibStreams[index] = stream;
+            break;
+        }
+    if(index == low->zlibStreams.size())
+        low->zlibStreams.push_back(stream);
+    stream->SetIndex(index);
+
+    duk_push_int(low->duk_ctx, index);
+    duk_push_c_function(ctx, low_zlib_finalizer, 1);
+    duk_set_finalizer(ctx, 0);
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_zlib_finalizer
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_zlib_finalizer(duk_context *ctx)
+{
+    low_t *low = duk_get_low_context(ctx);
+
+    duk_get_prop_string(ctx, 0, "_native");
+    int index = duk_get_int_default(ctx, -1, -1);
+
+    // Already closed
+    if(index < 0)
+        return 0;
+    if(index >= low->zlibStreams.size())
+        duk_reference_error(ctx, "zlib stream not found");
+
+    delete low->zlibStreams[index];
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_zlib_write
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_zlib_write(duk_context *ctx)
+{
+    LowZlib *stream = low_zlib_get(ctx);
+
+    int flush = duk_require_int(ctx, 1);
+    int inLen, outLen;
+    unsigned char *in = low_zlib_get_buffer(ctx, 2, inLen);
+    unsigned char *out = low_zlib_get_buffer(ctx, 5, outLen);
+
+    stream->Write(flush, in, inLen, 2, out, outLen, 5, 8);
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_zlib_write_sync
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_zlib_write_sync(duk_context *ctx)
+{
+    LowZlib *stream = low_zlib_get(ctx);
+
+    int flush = duk_require_int(ctx, 1);
+    int inLen, outLen;
+    unsigned char *in = low_zlib_get_buffer(ctx, 2, inLen);
+    unsigned char *out = low_zlib_get_buffer(ctx, 5, outLen);
+
+    int err = stream->WriteSync(flush, in, inLen, out, outLen);
+    if(err != Z_OK && err != Z_STREAM_END)
+    {
+        LowZlib::PushError(ctx, err, stream->Message());
+        duk_throw(ctx);
+    }
+
+    duk_push_array(ctx);
+    duk_push_uint(ctx, stream->AvailOut());
+    duk_put_prop_index(ctx, -2, 0);
+    duk_push_uint(ctx, stream->AvailIn());
+    duk_put_prop_index(ctx, -2, 1);
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+//  low_zlib_reset
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_zlib_reset(duk_context *ctx)
+{
+    LowZlib *stream = low_zlib_get(ctx);
+
+    int err = stream->Reset();
+    if(err != Z_OK)
+    {
+        LowZlib::PushError(ctx, err, "Reset error");
+        duk_throw(ctx);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  low_zlib_close
+// -----------------------------------------------------------------------------
+
+duk_ret_t low_zlib_close(duk_context *ctx)
+{
+    delete low_zlib_get(ctx);
+    return 0;
+}
+
+#endif /* LOW_INCLUDE_ZLIB */
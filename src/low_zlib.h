@@ -0,0 +1,18 @@
+// -----------------------------------------------------------------------------
+//  low_zlib.h
+// -----------------------------------------------------------------------------
+
+#ifndef __LOW_ZLIB_H__
+#define __LOW_ZLIB_H__
+
+#include "duktape.h"
+
+duk_ret_t low_zlib_create(duk_context *ctx);
+duk_ret_t low_zlib_finalizer(duk_context *ctx);
+
+duk_ret_t low_zlib_write(duk_context *ctx);
+duk_ret_t low_zlib_write_sync(duk_context *ctx);
+duk_ret_t low_zlib_reset(duk_context *ctx);
+duk_ret_t low_zlib_close(duk_context *ctx);
+
+#endif /* __LOW_ZLIB_H__ */
@@ -0,0 +1,60 @@
+// Allocation heavy workload for the JavaScript heap, prints the time taken
+// and, with low.js, the usage and fragmentation of the slab allocator
+//
+//     low test/bench/bench-alloc.js [rounds]
+
+var rounds = parseInt(process.argv[2]) || 20;
+
+function churn() {
+    // Many small objects, strings and arrays, most of them short lived
+    var keep = [];
+    for (var i = 0; i < 100000; i++) {
+        var obj = { id: i, name: 'item' + i, tags: [i & 7, i & 15] };
+        if ((i & 31) == 0)
+            keep.push(obj);
+        else if ((i & 7) == 0)
+            obj.extra = JSON.stringify(obj);
+    }
+    return keep;
+}
+
+function report(label) {
+    if (!process.heapStats)
+        return;
+
+    var stats = process.heapStats();
+    console.log(label + ': heap ' + (stats.heapSize / 1024).toFixed(0) + ' KB');
+    if (stats.gc)
+        console.log('  gc ' + stats.gc.count + ' times (' + stats.gc.idle + ' idle, '
+            + stats.gc.forced + ' forced), pauses ' + stats.gc.totalPause.toFixed(1)
+            + ' ms total, ' + stats.gc.maxPause.toFixed(1) + ' ms max');
+    if (!stats.slab)
+        return;
+
+    var used = 0, total = 0;
+    for (var i = 0; i < stats.slab.classes.length; i++) {
+        var cls = stats.slab.classes[i];
+        used += cls.used * cls.size;
+        total += (cls.used + cls.free) * cls.size;
+        if (cls.pages)
+            console.log('  ' + ('    ' + cls.size).slice(-4) + ' bytes: '
+                + cls.pages + ' pages, ' + cls.used + ' used, ' + cls.free + ' free');
+    }
+    console.log('  slab pages ' + stats.slab.pages + ' (' + stats.slab.releasedPages
+        + ' released), ' + (total ? (100 - used * 100 / total).toFixed(1) : 0) + '% fragmentation');
+}
+
+var start = Date.now();
+var retained = [];
+for (var r = 0; r < rounds; r++) {
+    retained.push(churn());
+    if (retained.length > 4)
+        retained.shift();
+}
+console.log(rounds + ' rounds in ' + (Date.now() - start) + ' ms');
+report('after churn');
+
+retained = null;
+if (global.gc)
+    global.gc();
+report('after release');
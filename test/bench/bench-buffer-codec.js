@@ -0,0 +1,56 @@
+// Throughput of Buffer encoding and decoding per encoding, in GB/s, with
+// low.js and with Node.JS
+//
+//     low test/bench/bench-buffer-codec.js [MB]
+
+var totalMB = parseInt(process.argv[2]) || 16;
+var size = totalMB * 1024 * 1024;
+
+var binary = Buffer.alloc(size);
+for (var i = 0; i < size; i++)
+    binary[i] = (i * 7919) & 0xFF;
+
+// Mostly ASCII with some accents and an emoji, as JSON APIs deliver it
+var text = '';
+var line = '{"name": "Zoë", "city": "Zürich", "mood": "😀", "n": 12345},\n';
+while (text.length < size)
+    text += line;
+var textBuffer = Buffer.from(text);
+
+function measure(name, bytes, fn) {
+    var rounds = 0;
+    var start = Date.now();
+    do {
+        fn();
+        rounds++;
+    } while (Date.now() - start < 1000);
+
+    var seconds = (Date.now() - start) / 1000;
+    console.log(name + ': ' + (bytes * rounds / seconds / 1e9).toFixed(3) + ' GB/s');
+}
+
+['hex', 'base64', 'base64url', 'latin1'].forEach(function (encoding) {
+    var encoded = binary.toString(encoding);
+
+    measure(encoding + ' toString', size, function () {
+        binary.toString(encoding);
+    });
+    measure(encoding + ' Buffer.from', size, function () {
+        Buffer.from(encoded, encoding);
+    });
+});
+
+measure('utf8 toString', textBuffer.length, function () {
+    textBuffer.toString();
+});
+measure('utf8 Buffer.from', textBuffer.length, function () {
+    Buffer.from(text);
+});
+measure('utf8 byteLength', textBuffer.length, function () {
+    Buffer.byteLength(text);
+});
+
+var target = Buffer.alloc(textBuffer.length);
+measure('utf8 write', textBuffer.length, function () {
+    target.write(text);
+});
@@ -0,0 +1,52 @@
+// Throughput of Buffer.indexOf and friends, as multipart parsers use them to
+// find boundaries, in GB/s
+//
+//     low test/bench/bench-buffer-search.js [MB]
+
+var totalMB = parseInt(process.argv[2]) || 16;
+var size = totalMB * 1024 * 1024;
+
+// Text-like data, which has many false candidates for the first byte
+var alphabet = 'etaoin shrdlu\r\n-';
+var haystack = Buffer.alloc(size);
+for (var i = 0; i < size; i++)
+    haystack[i] = alphabet.charCodeAt((i * 7919 + (i >> 5)) % alphabet.length);
+
+var boundary = Buffer.from('\r\n------WebKitFormBoundary7MA4YWxkTrZu0gW');
+boundary.copy(haystack, size - boundary.length);
+
+function measure(name, fn) {
+    var rounds = 0;
+    var start = Date.now();
+    do {
+        fn();
+        rounds++;
+    } while (Date.now() - start < 1000);
+
+    var seconds = (Date.now() - start) / 1000;
+    console.log(name + ': ' + (size * rounds / seconds / 1e9).toFixed(3) + ' GB/s');
+}
+
+measure('indexOf byte', function () {
+    haystack.indexOf(0x5A);
+});
+measure('indexOf 4 bytes', function () {
+    haystack.indexOf('ZZZZ');
+});
+measure('indexOf boundary', function () {
+    haystack.indexOf(boundary);
+});
+measure('lastIndexOf 4 bytes', function () {
+    haystack.lastIndexOf('ZZZZ');
+});
+measure('includes string', function () {
+    haystack.includes('WebKitFormBoundary', 0, 'latin1');
+});
+
+var copy = Buffer.from(haystack);
+measure('equals', function () {
+    haystack.equals(copy);
+});
+measure('compare', function () {
+    haystack.compare(copy, 0, size, 0, size);
+});
@@ -0,0 +1,97 @@
+// HTTP requests per second served by a cluster of 1 to n workers, each
+// request does a bit of CPU work. The load is generated by the primary, so
+// it stops scaling when the primary becomes the bottleneck
+//
+//     low test/bench/bench-cluster.js [max workers] [seconds]
+
+var cluster = require('cluster');
+var http = require('http');
+var net = require('net');
+var os = require('os');
+
+var PORT = 8123;
+var CONCURRENCY = 32;
+
+function work(n) {
+    // Count primes below n, the slow way
+    var count = 0;
+    for (var i = 2; i < n; i++) {
+        var prime = true;
+        for (var j = 2; j * j <= i; j++)
+            if (i % j == 0) {
+                prime = false;
+                break;
+            }
+        if (prime)
+            count++;
+    }
+    return count;
+}
+
+function load(seconds, callback) {
+    var end = Date.now() + seconds * 1000;
+    var done = 0, running = 0;
+
+    function request() {
+        running++;
+        var socket = net.connect(PORT, '127.0.0.1', function () {
+            socket.end('GET / HTTP/1.0\r\n\r\n');
+        });
+        socket.on('data', function () { });
+        socket.on('error', function () { });
+        socket.on('close', function (hadError) {
+            running--;
+            if (!hadError)
+                done++;
+            if (Date.now() < end)
+                request();
+            else if (running == 0)
+                callback(done / seconds);
+        });
+    }
+    for (var i = 0; i < CONCURRENCY; i++)
+        request();
+}
+
+function run(numWorkers, seconds, callback) {
+    var listening = 0;
+
+    cluster.removeAllListeners('listening');
+    cluster.on('listening', function () {
+        if (++listening == numWorkers)
+            load(seconds, function (rps) {
+                cluster.disconnect(function () {
+                    callback(rps);
+                });
+            });
+    });
+    for (var i = 0; i < numWorkers; i++)
+        cluster.fork();
+}
+
+if (cluster.isWorker) {
+    http.createServer(function (req, res) {
+        res.end(String(work(20000)));
+    }).listen(PORT);
+} else {
+    var maxWorkers = parseInt(process.argv[2]) || os.cpus().length;
+    var seconds = parseInt(process.argv[3]) || 5;
+    var base;
+
+    var next = function (numWorkers) {
+        run(numWorkers, seconds, function (rps) {
+            if (!base)
+                base = rps;
+            console.log(numWorkers + ' workers: ' + Math.round(rps) + ' req/s, speedup '
+                + (rps / base).toFixed(2));
+
+            if (numWorkers >= maxWorkers)
+                return;
+            if (numWorkers * 2 > maxWorkers)
+                next(maxWorkers);
+            else
+                next(numWorkers * 2);
+        });
+    };
+    next(1);
+}
@@ -0,0 +1,90 @@
+// Runs a CPU bound workload without and with the CPU profiler, prints the
+// overhead of sampling and the functions with the most samples. Then profiles
+// a loop which never leaves JavaScript, and prints how many of its samples
+// were charged to it and the sample rate
+//
+//     low test/bench/bench-cpu-prof.js [interval in us]
+
+var interval = parseInt(process.argv[2]) || 1000;
+
+function fib(n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+function strings() {
+    var s = '';
+    for (var i = 0; i < 20000; i++)
+        s += String.fromCharCode(65 + i % 26);
+    return s.length;
+}
+
+// No native calls, so the samples can only come from the interrupt
+function spin(n) {
+    var x = 0;
+    for (var i = 0; i < n; i++)
+        x = (x * 31 + i) % 1000003;
+    return x;
+}
+
+function work() {
+    var start = Date.now();
+    for (var i = 0; i < 20; i++) {
+        fib(20);
+        strings();
+    }
+    return Date.now() - start;
+}
+
+if (!process.startCpuProfile) {
+    console.log('process.startCpuProfile not available');
+    process.exit(0);
+}
+
+work();
+var plain = work();
+
+process.startCpuProfile(interval);
+var profiled = work();
+var profile = process.stopCpuProfile();
+
+console.log('without profiler ' + plain + ' ms, with profiler ' + profiled + ' ms ('
+    + ((profiled - plain) * 100 / plain).toFixed(1) + '% overhead)');
+console.log(profile.samples.length + ' samples, ' + profile.nodes.length + ' nodes');
+
+var self = {};
+for (var i = 0; i < profile.nodes.length; i++) {
+    var node = profile.nodes[i];
+    var name = node.callFrame.functionName + ' ' + node.callFrame.url + ':' + (node.callFrame.lineNumber + 1);
+    self[name] = (self[name] || 0) + node.hitCount;
+}
+var names = Object.keys(self).sort(function (a, b) { return self[b] - self[a]; });
+for (var i = 0; i < names.length && i < 5; i++)
+    console.log('  ' + self[names[i]] + ' samples  ' + names[i]);
+
+// Long enough for a second or more of samples
+var loops = 100000;
+for (;;) {
+    var start = Date.now();
+    spin(loops);
+    if (Date.now() - start >= 100)
+        break;
+    loops *= 2;
+}
+loops *= 10;
+
+process.startCpuProfile(interval);
+start = Date.now();
+spin(loops);
+var ms = Date.now() - start;
+profile = process.stopCpuProfile();
+
+var hits = 0, total = 0;
+for (var i = 0; i < profile.nodes.length; i++) {
+    if (profile.nodes[i].callFrame.functionName == 'spin')
+        hits += profile.nodes[i].hitCount;
+    total += profile.nodes[i].hitCount;
+}
+console.log('pure JavaScript loop: ' + hits + ' of ' + total + ' samples in spin ('
+    + (hits * 100 / (total || 1)).toFixed(1) + '%), '
+    + (total * 1000 / ms).toFixed(0) + ' samples/s over ' + ms + ' ms, expected '
+    + (1000000 / interval).toFixed(0));
@@ -0,0 +1,87 @@
+// Throughput of crypto hashing per algorithm, with low.js and with Node.JS
+//
+//     low test/bench/bench-crypto-hash.js [MB]
+//
+// Measures update() on the code thread, the Hash stream (large chunks are
+// hashed on the data threads) and, with low.js, crypto.hashFile()
+
+var crypto = require('crypto');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+var totalMB = parseInt(process.argv[2]) || 64;
+var algorithms = ['md5', 'sha1', 'sha256', 'sha512'];
+
+var chunk = Buffer.alloc(64 * 1024, 'lowjs');
+var chunks = totalMB * 1024 * 1024 / chunk.length;
+
+function report(name, algo, start) {
+    var ms = Date.now() - start;
+    console.log(name + ' ' + algo + ': ' + (totalMB * 1000 / Math.max(ms, 1)).toFixed(1) + ' MB/s');
+}
+
+function benchUpdate(algo) {
+    var start = Date.now();
+    var hash = crypto.createHash(algo);
+    for (var i = 0; i < chunks; i++)
+        hash.update(chunk);
+    hash.digest('hex');
+    report('update', algo, start);
+}
+
+function benchStream(algo, done) {
+    var start = Date.now();
+    var hash = crypto.createHash(algo);
+    var i = 0;
+
+    function write() {
+        while (i < chunks) {
+            i++;
+            if (!hash.write(chunk)) {
+                hash.once('drain', write);
+                return;
+            }
+        }
+        hash.end();
+    }
+    hash.on('data', function () {
+        report('stream', algo, start);
+        done();
+    });
+    write();
+}
+
+function benchFile(file, algo, done) {
+    if (!crypto.hashFile)
+        return done();
+
+    var start = Date.now();
+    crypto.hashFile(file, algo, 'hex', function (err) {
+        if (err)
+            throw err;
+        report('hashFile', algo, start);
+        done();
+    });
+}
+
+var file = path.join(os.tmpdir(), 'bench-crypto-hash.bin');
+var fd = fs.openSync(file, 'w');
+for (var i = 0; i < chunks; i++)
+    fs.writeSync(fd, chunk);
+fs.closeSync(fd);
+
+var pos = 0;
+function next() {
+    if (pos == algorithms.length) {
+        fs.unlinkSync(file);
+        return;
+    }
+
+    var algo = algorithms[pos++];
+    benchUpdate(algo);
+    benchStream(algo, function () {
+        benchFile(file, algo, next);
+    });
+}
+next();
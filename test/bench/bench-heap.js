@@ -0,0 +1,63 @@
+// Builds up retained objects while allocations are sampled, then writes a
+// heap snapshot. Prints the cost of sampling and of the snapshot and where
+// the sampled memory was allocated
+//
+//     low test/bench/bench-heap.js [interval in bytes]
+
+var fs = require('fs');
+
+var interval = parseInt(process.argv[2]) || 32768;
+
+function Item(i) {
+    this.id = i;
+    this.name = 'item' + i;
+    this.tags = [i & 7, i & 15];
+}
+
+function build(n) {
+    var list = [];
+    for (var i = 0; i < n; i++)
+        list.push(new Item(i));
+    return list;
+}
+
+if (!process.startHeapSampling) {
+    console.log('process.startHeapSampling not available');
+    process.exit(0);
+}
+
+build(100000);
+var start = Date.now();
+build(100000);
+var plain = Date.now() - start;
+
+process.startHeapSampling(interval);
+start = Date.now();
+var retained = build(100000);
+var sampled = Date.now() - start;
+
+start = Date.now();
+var file = process.writeHeapSnapshot();
+var snapshotTime = Date.now() - start;
+var profile = process.stopHeapSampling();
+
+console.log('without sampling ' + plain + ' ms, with sampling ' + sampled + ' ms ('
+    + ((sampled - plain) * 100 / plain).toFixed(1) + '% overhead)');
+console.log('snapshot ' + file + ': ' + (fs.statSync(file).size / 1024 / 1024).toFixed(1)
+    + ' MB in ' + snapshotTime + ' ms');
+fs.unlinkSync(file);
+
+var sites = [];
+function walk(node) {
+    if (node.selfSize)
+        sites.push(node);
+    for (var i = 0; i < node.children.length; i++)
+        walk(node.children[i]);
+}
+walk(profile.head);
+sites.sort(function (a, b) { return b.selfSize - a.selfSize; });
+console.log(profile.samples.length + ' live samples, ' + retained.length + ' items retained');
+for (var i = 0; i < sites.length && i < 5; i++)
+    console.log('  ' + (sites[i].selfSize / 1024).toFixed(0) + ' KB  '
+        + sites[i].callFrame.functionName + ' ' + sites[i].callFrame.url + ':'
+        + (sites[i].callFrame.lineNumber + 1));
@@ -0,0 +1,60 @@
+// Outbound requests through http.Agent: a new connection per request, then
+// keep-alive connections of the native pool, with more requests in flight
+// than maxSockets, so they queue for a connection
+//
+//     low test/bench/bench-http-agent.js [seconds] [maxSockets]
+
+var http = require('http');
+
+var PORT = 8130;
+
+var seconds = parseInt(process.argv[2]) || 3;
+var maxSockets = parseInt(process.argv[3]) || 10;
+var inFlight = maxSockets * 4;
+
+function run(name, agent, done) {
+    var count = 0, errors = 0, end = Date.now() + seconds * 1000, active = 0;
+
+    function next() {
+        if (Date.now() >= end) {
+            if (--active == 0) {
+                console.log(name + ': ' + Math.round(count / seconds) + ' requests/s' +
+                            (errors ? ', ' + errors + ' errors' : ''));
+                if (agent)
+                    agent.destroy();
+                done();
+            }
+            return;
+        }
+
+        var req = http.get({ host: '127.0.0.1', port: PORT, path: '/', agent: agent }, function (res) {
+            res.on('data', function () { });
+            res.on('end', function () {
+                count++;
+                next();
+            });
+        });
+        req.on('error', function () {
+            errors++;
+            next();
+        });
+    }
+
+    for (var i = 0; i < inFlight; i++) {
+        active++;
+        next();
+    }
+}
+
+var srv = http.createServer(function (req, res) {
+    res.setHeader('Content-Type', 'text/plain');
+    res.end('hello');
+});
+srv.listen(PORT, function () {
+    run('new connection per request', false, function () {
+        var agent = new http.Agent({ keepAlive: true, maxSockets: maxSockets });
+        run('keep-alive pool, ' + maxSockets + ' sockets', agent, function () {
+            srv.close();
+        });
+    });
+});
@@ -0,0 +1,69 @@
+// Small JSON responses with a few headers over keep-alive connections, where
+// building the response head is a large part of the work per request
+//
+//     low test/bench/bench-http-head.js [seconds]
+
+var http = require('http');
+var net = require('net');
+
+var PORT = 8125;
+var CONCURRENCY = 16;
+
+var seconds = parseInt(process.argv[2]) || 3;
+var body = JSON.stringify({ ok: true, id: 12345, name: 'low.js' });
+
+var server = http.createServer({ httpKeepAlive: true }, function (req, res) {
+    res.setHeader('Content-Type', 'application/json');
+    res.setHeader('Content-Length', body.length);
+    res.setHeader('Cache-Control', 'no-store');
+    res.setHeader('X-Request-Id', req.url);
+    res.setHeader('Set-Cookie', ['a=1; Path=/', 'b=2; Path=/']);
+    res.end(body);
+});
+
+function load(callback) {
+    var end = Date.now() + seconds * 1000;
+    var done = 0, running = 0, sample = null;
+
+    function connection() {
+        running++;
+        var text = '';
+        var socket = net.connect(PORT, '127.0.0.1', function () {
+            socket.write('GET /1 HTTP/1.1\r\nHost: localhost\r\n\r\n');
+        });
+        socket.setEncoding('latin1');
+        socket.on('data', function (data) {
+            text += data;
+            while (true) {
+                var pos = text.indexOf('\r\n\r\n' + body);
+                if (pos < 0)
+                    break;
+                if (!sample)
+                    sample = text.slice(0, pos);
+                text = text.slice(pos + 4 + body.length);
+                done++;
+
+                if (Date.now() < end)
+                    socket.write('GET /' + done + ' HTTP/1.1\r\nHost: localhost\r\n\r\n');
+                else
+                    socket.end();
+            }
+        });
+        socket.on('error', function () { });
+        socket.on('close', function () {
+            if (--running == 0)
+                callback(done / seconds, sample);
+        });
+    }
+    for (var i = 0; i < CONCURRENCY; i++)
+        connection();
+}
+
+server.listen(PORT, function () {
+    load(function (rps, sample) {
+        console.log(sample);
+        console.log();
+        console.log(Math.round(rps) + ' req/s');
+        server.close();
+    });
+});
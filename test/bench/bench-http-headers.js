@@ -0,0 +1,106 @@
+// Requests with many headers, as browsers behind a proxy send them. Prints
+// requests per second and, with low.js, allocations of the JavaScript heap
+// per request, once for a handler which does not look at the headers and
+// once for one which does
+//
+//     low test/bench/bench-http-headers.js [seconds]
+
+var http = require('http');
+var net = require('net');
+
+var PORT = 8126;
+var CONCURRENCY = 16;
+
+var seconds = parseInt(process.argv[2]) || 3;
+
+var request = [
+    'Host: localhost:' + PORT,
+    'User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0',
+    'Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8',
+    'Accept-Language: en-US,en;q=0.5',
+    'Accept-Encoding: gzip, deflate, br',
+    'Referer: https://www.example.com/some/page',
+    'Connection: keep-alive',
+    'Cookie: session=0123456789abcdef; theme=dark; consent=yes',
+    'Upgrade-Insecure-Requests: 1',
+    'Sec-Fetch-Dest: document',
+    'Sec-Fetch-Mode: navigate',
+    'Sec-Fetch-Site: same-origin',
+    'Sec-Fetch-User: ?1',
+    'Cache-Control: max-age=0',
+    'If-None-Match: "5f2b-17a4c3e2"',
+    'If-Modified-Since: Tue, 15 Aug 2023 10:00:00 GMT',
+    'DNT: 1',
+    'X-Forwarded-For: 203.0.113.7, 10.0.0.1',
+    'X-Forwarded-Proto: https',
+    'X-Forwarded-Host: www.example.com',
+    'X-Real-IP: 203.0.113.7',
+    'X-Request-ID: 5c1d2e3f-aaaa-bbbb-cccc-0123456789ab',
+    'X-Custom-Tracing: span=1234; parent=5678'
+].join('\r\n');
+
+var server = http.createServer({ httpKeepAlive: true }, function (req, res) {
+    var body = req.url == '/headers' ? req.headers['host'] : 'ok';
+    res.writeHead(200, { 'Content-Length': body.length });
+    res.end(body);
+});
+
+function load(path, callback) {
+    var end = Date.now() + seconds * 1000;
+    var done = 0, running = 0;
+    var line = 'GET ' + path + ' HTTP/1.1\r\n' + request + '\r\n\r\n';
+    var stats = process.heapStats ? process.heapStats() : null;
+    var allocations = stats ? stats.allocations : 0;
+
+    function connection() {
+        running++;
+        var text = '';
+        var socket = net.connect(PORT, '127.0.0.1', function () {
+            socket.write(line);
+        });
+        socket.setEncoding('latin1');
+        socket.on('data', function (data) {
+            text += data;
+            while (true) {
+                var pos = text.indexOf('\r\n\r\n');
+                if (pos < 0)
+                    break;
+                var len = parseInt(text.slice(0, pos).match(/content-length: *(\d+)/i)[1]);
+                if (text.length < pos + 4 + len)
+                    break;
+                text = text.slice(pos + 4 + len);
+                done++;
+
+                if (Date.now() < end)
+                    socket.write(line);
+                else
+                    socket.end();
+            }
+        });
+        socket.on('error', function () { });
+        socket.on('close', function () {
+            if (--running)
+                return;
+
+            var result = Math.round(done / seconds) + ' req/s';
+            // Client and server run in this process, so this is per
+            // request and response, both sides
+            if (stats)
+                result += ', ' + ((process.heapStats().allocations - allocations) / done).toFixed(1)
+                    + ' allocations per request';
+            callback(result);
+        });
+    }
+    for (var i = 0; i < CONCURRENCY; i++)
+        connection();
+}
+
+server.listen(PORT, function () {
+    load('/lazy', function (result) {
+        console.log('headers not used: ' + result);
+        load('/headers', function (result) {
+            console.log('headers used:     ' + result);
+            server.close();
+        });
+    });
+});
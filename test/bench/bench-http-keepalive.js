@@ -0,0 +1,125 @@
+// HTTP requests per second with a new connection per request and with
+// keep-alive connections, then checks that idle keep-alive connections are
+// closed by the server after keepAliveTimeout
+//
+//     low test/bench/bench-http-keepalive.js [seconds] [idle connections]
+
+var http = require('http');
+var net = require('net');
+
+var PORT = 8124;
+var CONCURRENCY = 32;
+var KEEP_ALIVE_TIMEOUT = 1000;
+
+var seconds = parseInt(process.argv[2]) || 3;
+var numIdle = parseInt(process.argv[3]) || 1000;
+
+var server = http.createServer({
+    httpKeepAlive: true,
+    keepAliveTimeout: KEEP_ALIVE_TIMEOUT
+}, function (req, res) {
+    res.writeHead(200, { 'Content-Length': 2 });
+    res.end('ok');
+});
+
+function loadClose(callback) {
+    var end = Date.now() + seconds * 1000;
+    var done = 0, running = 0;
+
+    function request() {
+        running++;
+        var socket = net.connect(PORT, '127.0.0.1', function () {
+            socket.write('GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n');
+        });
+        socket.on('data', function () { });
+        socket.on('error', function () { });
+        socket.on('close', function (hadError) {
+            running--;
+            if (!hadError)
+                done++;
+            if (Date.now() < end)
+                request();
+            else if (running == 0)
+                callback(done / seconds);
+        });
+    }
+    for (var i = 0; i < CONCURRENCY; i++)
+        request();
+}
+
+function loadKeepAlive(callback) {
+    var end = Date.now() + seconds * 1000;
+    var done = 0, running = 0;
+
+    function connection() {
+        running++;
+        var text = '';
+        var socket = net.connect(PORT, '127.0.0.1', function () {
+            socket.write('GET / HTTP/1.1\r\nHost: localhost\r\n\r\n');
+        });
+        socket.setEncoding('latin1');
+        socket.on('data', function (data) {
+            text += data;
+            // Every response ends with its body, "ok"
+            while (true) {
+                var pos = text.indexOf('\r\n\r\nok');
+                if (pos < 0)
+                    break;
+                text = text.slice(pos + 6);
+                done++;
+
+                if (Date.now() < end)
+                    socket.write('GET / HTTP/1.1\r\nHost: localhost\r\n\r\n');
+                else
+                    socket.end();
+            }
+        });
+        socket.on('error', function () { });
+        socket.on('close', function () {
+            if (--running == 0)
+                callback(done / seconds);
+        });
+    }
+    for (var i = 0; i < CONCURRENCY; i++)
+        connection();
+}
+
+function idle(callback) {
+    var start = Date.now();
+    var open = 0, closed = 0, maxTime = 0;
+
+    for (var i = 0; i < numIdle; i++) {
+        (function () {
+            var socket = net.connect(PORT, '127.0.0.1', function () {
+                socket.write('GET / HTTP/1.1\r\nHost: localhost\r\n\r\n');
+            });
+            socket.on('data', function () { });
+            socket.on('error', function () { });
+            socket.on('connect', function () {
+                open++;
+            });
+            socket.on('close', function () {
+                maxTime = Math.max(maxTime, Date.now() - start);
+                if (++closed == numIdle)
+                    callback(open, maxTime);
+            });
+        })();
+    }
+}
+
+server.listen(PORT, function () {
+    loadClose(function (rpsClose) {
+        console.log('connection per request: ' + Math.round(rpsClose) + ' req/s');
+
+        loadKeepAlive(function (rpsKeepAlive) {
+            console.log('keep-alive:             ' + Math.round(rpsKeepAlive) + ' req/s, speedup '
+                + (rpsKeepAlive / rpsClose).toFixed(2));
+
+            idle(function (open, maxTime) {
+                console.log(open + ' idle connections closed by the server after ' + maxTime
+                    + ' ms (keepAliveTimeout ' + KEEP_ALIVE_TIMEOUT + ' ms)');
+                server.close();
+            });
+        });
+    });
+});
@@ -0,0 +1,110 @@
+// Health check, small static file and 404 over keep-alive connections, once
+// routed by a 'request' listener in JavaScript, once with JavaScript routes
+// and once with native routes, which the web thread answers by itself
+//
+//     low test/bench/bench-http-router.js [seconds]
+
+var http = require('http');
+var net = require('net');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+var PORT = 8127;
+var CONCURRENCY = 16;
+
+var seconds = parseInt(process.argv[2]) || 3;
+
+var file = path.join(os.tmpdir(), 'bench-http-router.css');
+var css = new Array(200).join('body { margin: 0; }\n');
+fs.writeFileSync(file, css);
+
+var paths = ['/health', '/static/app.css', '/missing'];
+
+function listener(req, res) {
+    if (req.url == '/health') {
+        res.writeHead(200, { 'Content-Type': 'text/plain', 'Content-Length': 2 });
+        res.end('ok');
+    } else if (req.url.indexOf('/static/') == 0) {
+        res.writeHead(200, { 'Content-Type': 'text/css', 'Content-Length': css.length });
+        res.end(css);
+    } else {
+        res.writeHead(404, { 'Content-Length': 9 });
+        res.end('not found');
+    }
+}
+
+var setups = {
+    'request listener': function (server) {
+        server.on('request', listener);
+    },
+    'JavaScript routes': function (server) {
+        server.route('GET', '/health', listener);
+        server.route('GET', '/static/*', listener);
+        server.route('*', '/*', listener);
+    },
+    'native routes': function (server) {
+        server.route('GET', '/health', { headers: { 'Content-Type': 'text/plain' }, body: 'ok' });
+        server.route('GET', '/static/*', { headers: { 'Content-Type': 'text/css' }, file: file });
+        server.route('*', '/*', { status: 404, body: 'not found' });
+    }
+};
+
+function load(callback) {
+    var end = Date.now() + seconds * 1000;
+    var done = 0, running = 0;
+
+    function connection() {
+        running++;
+        var text = '';
+        var next = running;
+        var socket = net.connect(PORT, '127.0.0.1', function () {
+            socket.write('GET ' + paths[next % paths.length] + ' HTTP/1.1\r\nHost: localhost\r\n\r\n');
+        });
+        socket.setEncoding('latin1');
+        socket.on('data', function (data) {
+            text += data;
+            while (true) {
+                var pos = text.indexOf('\r\n\r\n');
+                if (pos < 0)
+                    break;
+                var len = parseInt(text.slice(0, pos).match(/content-length: *(\d+)/i)[1]);
+                if (text.length < pos + 4 + len)
+                    break;
+                text = text.slice(pos + 4 + len);
+                done++;
+
+                if (Date.now() < end)
+                    socket.write('GET ' + paths[++next % paths.length] + ' HTTP/1.1\r\nHost: localhost\r\n\r\n');
+                else
+                    socket.end();
+            }
+        });
+        socket.on('error', function () { });
+        socket.on('close', function () {
+            if (--running == 0)
+                callback(done / seconds);
+        });
+    }
+    for (var i = 0; i < CONCURRENCY; i++)
+        connection();
+}
+
+var names = Object.keys(setups);
+function run(i) {
+    if (i == names.length) {
+        fs.unlinkSync(file);
+        return;
+    }
+
+    var server = http.createServer({ httpKeepAlive: true });
+    setups[names[i]](server);
+    server.listen(PORT, function () {
+        load(function (rps) {
+            console.log(names[i] + ': ' + Math.round(rps) + ' req/s');
+            server.close();
+            setTimeout(function () { run(i + 1); }, 100);
+        });
+    });
+}
+run(0);
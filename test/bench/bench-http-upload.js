@@ -0,0 +1,96 @@
+// Chunked uploads stored in a file: the body piped through a write stream,
+// then with req.pipeToFile, which writes it natively without JavaScript
+// seeing the data (low.js only)
+//
+//     low test/bench/bench-http-upload.js [megabytes] [uploads]
+
+var http = require('http');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+var PORT = 8131;
+
+var megabytes = parseInt(process.argv[2]) || 16;
+var uploads = parseInt(process.argv[3]) || 5;
+var file = path.join(os.tmpdir(), 'bench-http-upload.tmp');
+
+var chunk = Buffer.alloc(64 * 1024, 'x');
+
+function store(req, res) {
+    function done(err, len) {
+        res.end(err ? 'error ' + err.message : String(len));
+    }
+
+    if (req.url == '/native') {
+        fs.open(file, 'w', function (err, fd) {
+            if (err)
+                return done(err);
+            req.pipeToFile(fd, function (err, len) {
+                fs.close(fd, function () {
+                    done(err, len);
+                });
+            });
+        });
+    } else {
+        var out = fs.createWriteStream(file);
+        req.pipe(out);
+        out.on('finish', function () {
+            done(null, out.bytesWritten);
+        });
+        out.on('error', done);
+    }
+}
+
+function upload(url, done) {
+    var req = http.request({ host: '127.0.0.1', port: PORT, path: url, method: 'POST' }, function (res) {
+        var text = '';
+        res.on('data', function (data) { text += data; });
+        res.on('end', function () {
+            done(text);
+        });
+    });
+
+    // No content-length, so it is sent chunked
+    var left = megabytes * 1024 * 1024 / chunk.length;
+    function write() {
+        while (left > 0) {
+            left--;
+            if (!req.write(chunk))
+                return req.once('drain', write);
+        }
+        req.end();
+    }
+    write();
+}
+
+function run(name, url, done) {
+    var count = 0, start = Date.now();
+
+    function next(text) {
+        if (text !== undefined && text != String(megabytes * 1024 * 1024))
+            console.log(name + ': unexpected answer ' + text);
+        if (count++ == uploads) {
+            var secs = (Date.now() - start) / 1000;
+            console.log(name + ': ' + (megabytes * uploads / secs).toFixed(1) + ' MB/s');
+            return done();
+        }
+        upload(url, next);
+    }
+    next();
+}
+
+var srv = http.createServer(store);
+srv.listen(PORT, function () {
+    run('request piped to write stream', '/stream', function () {
+        var done = function () {
+            fs.unlink(file, function () {
+                srv.close();
+            });
+        };
+        if (http.IncomingMessage.prototype.pipeToFile)
+            run('request.pipeToFile', '/native', done);
+        else
+            done();
+    });
+});
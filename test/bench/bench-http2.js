@@ -0,0 +1,135 @@
+// Many small requests over TLS: HTTP/1.1 with one request at a time on each
+// of [streams] keep-alive connections, then HTTP/2 with [streams] concurrent
+// streams on a single connection, multiplexed by the web thread
+//
+//     low test/bench/bench-http2.js [seconds] [streams]
+
+var fs = require('fs');
+var path = require('path');
+var tls = require('tls');
+var https = require('https');
+var http2 = require('http2');
+
+var PORT = 8129;
+
+var seconds = parseInt(process.argv[2]) || 3;
+var streams = parseInt(process.argv[3]) || 100;
+
+var dir = path.join(__dirname, '../../examples/chat_ws_webserver');
+var serverOptions = {
+    key: fs.readFileSync(path.join(dir, 'server.key')),
+    cert: fs.readFileSync(path.join(dir, 'server.crt'))
+};
+// No CA, so the self-signed certificate is not verified
+var clientOptions = { host: '127.0.0.1', port: PORT, ca: [], rejectUnauthorized: false, ALPNProtocols: ['h2'] };
+
+function handler(req, res) {
+    res.setHeader('Content-Type', 'text/plain');
+    res.end('hello');
+}
+
+function report(name, count, srv, sockets, done) {
+    console.log(name + ': ' + Math.round(count / seconds) + ' requests/s');
+    for (var i = 0; i < sockets.length; i++)
+        sockets[i].destroy();
+    srv.close();
+    setTimeout(done, 100);
+}
+
+function http1(done) {
+    var srv = https.createServer(serverOptions, handler);
+    srv.listen(PORT, function () {
+        var count = 0, sockets = [], end = Date.now() + seconds * 1000;
+        var request = 'GET / HTTP/1.1\r\nHost: localhost\r\n\r\n';
+
+        for (var i = 0; i < streams; i++) {
+            (function () {
+                var socket = tls.connect({ host: '127.0.0.1', port: PORT, ca: [], rejectUnauthorized: false }, function () {
+                    socket.write(request);
+                });
+                var data = '';
+                socket.on('data', function (chunk) {
+                    // One request at a time, so the body ends the response
+                    data += chunk;
+                    if (data.slice(-5) != 'hello')
+                        return;
+                    data = '';
+                    count++;
+                    if (Date.now() < end)
+                        socket.write(request);
+                });
+                socket.on('error', function () { });
+                sockets.push(socket);
+            })();
+        }
+        setTimeout(function () {
+            report('HTTP/1.1, ' + streams + ' connections', count, srv, sockets, done);
+        }, seconds * 1000 + 200);
+    });
+}
+
+// Request on a new stream: GET https://localhost/ as HPACK block, indexed
+// :method, :scheme, :path and :authority as literal
+var authority = 'localhost';
+var block = Buffer.concat([Buffer.from([0x82, 0x87, 0x84, 0x01, authority.length]), Buffer.from(authority)]);
+
+function frame(type, flags, id, payload) {
+    var head = Buffer.alloc(9);
+    head.writeUInt32BE((payload.length << 8 | type) >>> 0, 0);
+    head[4] = flags;
+    head.writeUInt32BE(id, 5);
+    return Buffer.concat([head, payload]);
+}
+
+function http2Bench(done) {
+    var srv = http2.createSecureServer(serverOptions, handler);
+    srv.listen(PORT, function () {
+        var count = 0, nextID = 1, end = Date.now() + seconds * 1000;
+        var socket = tls.connect(clientOptions, function () {
+            var out = [Buffer.from('PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n'), frame(4, 0, 0, Buffer.alloc(0))];
+            for (var i = 0; i < streams; i++)
+                out.push(request());
+            socket.write(Buffer.concat(out));
+        });
+
+        function request() {
+            var id = nextID;
+            nextID += 2;
+            return frame(1, 0x05, id, block);   // END_STREAM | END_HEADERS
+        }
+
+        var data = null;
+        socket.on('data', function (chunk) {
+            data = data ? Buffer.concat([data, chunk]) : chunk;
+
+            var out = [], pos = 0;
+            while (data.length - pos >= 9) {
+                var len = data.readUInt32BE(pos) >>> 8, type = data[pos + 3], flags = data[pos + 4];
+                if (data.length - pos < 9 + len)
+                    break;
+
+                if (type == 4 && !(flags & 1))
+                    out.push(frame(4, 1, 0, Buffer.alloc(0)));  // SETTINGS ACK
+                else if ((type == 0 || type == 1) && (flags & 1)) {
+                    // END_STREAM, the response is complete
+                    count++;
+                    if (Date.now() < end)
+                        out.push(request());
+                }
+                pos += 9 + len;
+            }
+            data = data.slice(pos);
+            if (out.length)
+                socket.write(Buffer.concat(out));
+        });
+        socket.on('error', function () { });
+
+        setTimeout(function () {
+            report('HTTP/2, ' + streams + ' streams on 1 connection', count, srv, [socket], done);
+        }, seconds * 1000 + 200);
+    });
+}
+
+http1(function () {
+    http2Bench(function () { });
+});
@@ -0,0 +1,65 @@
+// Mixed timer, nextTick and file system load, prints what process.metrics
+// reports about it and how much polling the metrics costs
+//
+//     low test/bench/bench-metrics.js [seconds]
+
+var fs = require('fs');
+
+var seconds = parseInt(process.argv[2]) || 3;
+var end = Date.now() + seconds * 1000;
+
+function spin(ms) {
+    var until = Date.now() + ms;
+    while (Date.now() < until)
+        ;
+}
+
+// Timers which sometimes block the loop, so lag shows up in the histogram
+var ticks = 0;
+var timer = setInterval(function () {
+    ticks++;
+    if ((ticks & 15) == 0)
+        spin(20);
+    process.nextTick(function () { });
+}, 1);
+
+// Keep the data threads busy
+var reads = 0;
+function read() {
+    if (Date.now() >= end)
+        return;
+    fs.stat(__filename, function () {
+        reads++;
+        read();
+    });
+}
+for (var i = 0; i < 8; i++)
+    read();
+
+setTimeout(function () {
+    clearInterval(timer);
+    if (!process.metrics) {
+        console.log('process.metrics not available');
+        return;
+    }
+
+    var n = 100000;
+    var start = Date.now();
+    for (var i = 0; i < n; i++)
+        process.metrics();
+    var cost = (Date.now() - start) * 1000 / n;
+
+    var m = process.metrics();
+    console.log(ticks + ' timer ticks, ' + reads + ' stats in ' + seconds + ' s');
+    console.log('loop: ' + (m.loop.utilization * 100).toFixed(1) + '% busy, '
+        + m.loop.turns + ' turns, ' + m.loop.callbacksPerTurn.toFixed(2) + ' callbacks per turn');
+    console.log('lag: mean ' + m.lag.mean.toFixed(3) + ' ms, p50 ' + m.lag.p50.toFixed(3)
+        + ' ms, p99 ' + m.lag.p99.toFixed(3) + ' ms, max ' + m.lag.max.toFixed(3) + ' ms');
+    console.log('timers: ' + m.timers.meanLate.toFixed(2) + ' ms late on average, '
+        + m.timers.maxLate + ' ms max');
+    console.log('data threads: ' + m.dataThreads.jobs + ' jobs, wait mean '
+        + m.dataThreads.meanWait.toFixed(3) + ' ms, max ' + m.dataThreads.maxWait.toFixed(3) + ' ms');
+    console.log('handles: ' + JSON.stringify(m.handles));
+    console.log('memoryUsage: ' + JSON.stringify(process.memoryUsage()));
+    console.log('process.metrics() takes ' + cost.toFixed(2) + ' us');
+}, seconds * 1000 + 100);
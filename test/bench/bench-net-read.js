@@ -0,0 +1,62 @@
+// Socket read throughput: the server writes a block over and over, the
+// client counts what arrives. Prints the throughput and, with low.js, how
+// many blocks the JavaScript heap allocated per MB received
+//
+//     low test/bench/bench-net-read.js [megabytes] [rounds]
+
+var net = require('net');
+
+var PORT = 8134;
+
+var megabytes = parseInt(process.argv[2]) || 64;
+var rounds = parseInt(process.argv[3]) || 5;
+
+var block = Buffer.alloc(16 * 1024, 'x');
+
+var srv = net.createServer(function (socket) {
+    var left = megabytes * 1024 * 1024 / block.length;
+    function write() {
+        while (left > 0) {
+            left--;
+            if (!socket.write(block))
+                return socket.once('drain', write);
+        }
+        socket.end();
+    }
+    write();
+});
+
+function allocations() {
+    return process.heapStats ? process.heapStats().allocations : 0;
+}
+
+function round(left, start, allocStart, chunks) {
+    if (!left) {
+        var secs = (Date.now() - start) / 1000;
+        var mb = megabytes * rounds;
+        console.log('read: ' + (mb / secs).toFixed(1) + ' MB/s, '
+            + (chunks / mb).toFixed(0) + ' chunks/MB');
+        if (process.heapStats)
+            console.log('  ' + ((allocations() - allocStart) / mb).toFixed(0)
+                + ' heap allocations/MB');
+        srv.close();
+        return;
+    }
+
+    var bytes = 0;
+    var client = net.connect(PORT, '127.0.0.1');
+    client.on('data', function (data) {
+        bytes += data.length;
+        chunks++;
+    });
+    client.on('end', function () {
+        if (bytes != megabytes * 1024 * 1024)
+            console.log('unexpected length ' + bytes);
+        client.end();
+        round(left - 1, start, allocStart, chunks);
+    });
+}
+
+srv.listen(PORT, function () {
+    round(rounds, Date.now(), allocations(), 0);
+});
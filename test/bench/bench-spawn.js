@@ -0,0 +1,49 @@
+// Time to spawn /bin/true and see it exit, with a growing heap. As the
+// children are started with posix_spawn, the time should not depend on the
+// size of the heap
+//
+//     low test/bench/bench-spawn.js [spawns per step]
+
+var childProcess = require('child_process');
+
+var COUNT = parseInt(process.argv[2]) || 200;
+var STEPS = 4;
+
+var ballast = [];
+
+function grow(megabytes) {
+    for (var i = 0; i < megabytes; i++)
+        ballast.push(Buffer.alloc(1024 * 1024, i));
+}
+
+function run(callback) {
+    var start = Date.now();
+    var left = COUNT;
+
+    function next() {
+        childProcess.spawn('/bin/true', [], { stdio: 'ignore' }).on('close', function () {
+            if (--left)
+                next();
+            else
+                callback((Date.now() - start) / COUNT);
+        });
+    }
+    next();
+}
+
+function step(i) {
+    run(function (ms) {
+        var syncStart = Date.now();
+        for (var j = 0; j < COUNT / 10; j++)
+            childProcess.execFileSync('/bin/echo', ['x']);
+        var syncMs = (Date.now() - syncStart) / (COUNT / 10);
+
+        console.log(ballast.length + ' MB heap: spawn ' + ms.toFixed(2) + ' ms, execFileSync '
+            + syncMs.toFixed(2) + ' ms');
+        if (i + 1 < STEPS) {
+            grow(ballast.length ? ballast.length : 16);
+            step(i + 1);
+        }
+    });
+}
+step(0);
@@ -0,0 +1,69 @@
+// File piped into a TCP socket: a file read stream is piped to each accepted
+// connection, the client counts what arrives. Then the same through a proxy,
+// which pipes its sockets into each other. Prints the throughputs
+//
+//     low test/bench/bench-stream-pipe.js [megabytes] [rounds]
+
+var net = require('net');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
+
+var PORT = 8132;
+var PROXY_PORT = 8133;
+
+var megabytes = parseInt(process.argv[2]) || 64;
+var rounds = parseInt(process.argv[3]) || 5;
+var file = path.join(os.tmpdir(), 'bench-stream-pipe.tmp');
+
+// Test file, written in pieces so we do not need it in memory
+var piece = Buffer.alloc(1024 * 1024, 'x');
+var fd = fs.openSync(file, 'w');
+for (var i = 0; i < megabytes; i++)
+    fs.writeSync(fd, piece, 0, piece.length);
+fs.closeSync(fd);
+
+var srv = net.createServer(function (socket) {
+    fs.createReadStream(file).pipe(socket);
+});
+
+var proxy = net.createServer(function (socket) {
+    var upstream = net.connect(PORT, '127.0.0.1');
+    socket.pipe(upstream);
+    upstream.pipe(socket);
+});
+
+function run(name, port, done) {
+    function round(left, start) {
+        if (!left) {
+            var secs = (Date.now() - start) / 1000;
+            console.log(name + ': ' + (megabytes * rounds / secs).toFixed(1) + ' MB/s');
+            return done();
+        }
+
+        var bytes = 0;
+        var client = net.connect(port, '127.0.0.1');
+        client.on('data', function (data) {
+            bytes += data.length;
+        });
+        client.on('end', function () {
+            if (bytes != megabytes * 1024 * 1024)
+                console.log(name + ': unexpected length ' + bytes);
+            client.end();
+            round(left - 1, start);
+        });
+    }
+    round(rounds, Date.now());
+}
+
+srv.listen(PORT, function () {
+    proxy.listen(PROXY_PORT, function () {
+        run('file to socket', PORT, function () {
+            run('socket to socket (proxy)', PROXY_PORT, function () {
+                srv.close();
+                proxy.close();
+                fs.unlinkSync(file);
+            });
+        });
+    });
+});
@@ -0,0 +1,147 @@
+// Push fan-out over WebSockets: a message is sent to all clients, once with
+// ws.send() per client and once with WebSocketGroup.broadcast(), which frames
+// it once and queues it to all sockets natively. Also echo round trips
+//
+//     low test/bench/bench-websocket.js [seconds] [clients]
+
+var http = require('http');
+var net = require('net');
+
+var PORT = 8128;
+var KEY = 'dGhlIHNhbXBsZSBub25jZQ==';
+
+var seconds = parseInt(process.argv[2]) || 3;
+var clients = parseInt(process.argv[3]) || 100;
+
+var message = new Array(65).join('x');
+
+function mask(payload) {
+    var key = [0x12, 0x34, 0x56, 0x78];
+    var head = payload.length < 126 ? Buffer.from([0x81, 0x80 | payload.length])
+                                   : Buffer.from([0x81, 0x80 | 126, payload.length >> 8, payload.length & 0xFF]);
+    var data = Buffer.from(payload);
+    for (var i = 0; i < data.length; i++)
+        data[i] ^= key[i & 3];
+    return Buffer.concat([head, Buffer.from(key), data]);
+}
+
+// Raw client, counts the frames it gets
+function client(onOpen, onFrame) {
+    var socket = net.connect(PORT, '127.0.0.1', function () {
+        socket.write('GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n' +
+                     'Sec-WebSocket-Key: ' + KEY + '\r\nSec-WebSocket-Version: 13\r\n\r\n');
+    });
+    var data = null, open = false;
+    socket.on('data', function (chunk) {
+        data = data ? Buffer.concat([data, chunk]) : chunk;
+        if (!open) {
+            var pos = data.indexOf('\r\n\r\n');
+            if (pos < 0)
+                return;
+            data = data.slice(pos + 4);
+            open = true;
+            onOpen(socket);
+        }
+        while (data.length >= 2) {
+            var len = data[1] & 0x7F, head = 2;
+            if (len == 126) {
+                if (data.length < 4)
+                    break;
+                len = data.readUInt16BE(2);
+                head = 4;
+            }
+            if (data.length < head + len)
+                break;
+            data = data.slice(head + len);
+            onFrame(socket);
+        }
+    });
+    socket.on('error', function () { });
+    return socket;
+}
+
+function server(setup, callback) {
+    var srv = http.createServer();
+    srv.on('upgrade', function (req, socket, head) {
+        setup(http.acceptWebSocket(req, socket, head));
+    });
+    srv.listen(PORT, function () {
+        callback(srv);
+    });
+}
+
+function fanOut(name, send, done) {
+    var sockets = [], group = new http.WebSocketGroup();
+    var sent = 0, received = 0, opened = 0;
+    server(function (ws) {
+        sockets.push(ws);
+        group.add(ws);
+    }, function (srv) {
+        var conns = [];
+        for (var i = 0; i < clients; i++)
+            conns.push(client(function () {
+                if (++opened == clients)
+                    setTimeout(run, 100);
+            }, function () {
+                received++;
+            }));
+
+        function run() {
+            var end = Date.now() + seconds * 1000;
+            (function burst() {
+                // Do not let the queues grow without bounds
+                if (sent - received < clients * 100) {
+                    for (var i = 0; i < 10; i++)
+                        send(sockets, group);
+                    sent += 10 * clients;
+                }
+                if (Date.now() < end)
+                    setImmediate(burst);
+                else
+                    setTimeout(function () {
+                        console.log(name + ': ' + Math.round(received / seconds) + ' messages/s delivered');
+                        for (var i = 0; i < conns.length; i++)
+                            conns[i].destroy();
+                        srv.close();
+                        setTimeout(done, 100);
+                    }, 200);
+            })();
+        }
+    });
+}
+
+function echo(done) {
+    var count = 0;
+    server(function (ws) {
+        ws.on('message', function (data) {
+            ws.send(data);
+        });
+    }, function (srv) {
+        var end = Date.now() + seconds * 1000;
+        var frame = mask(message);
+        client(function (socket) {
+            socket.write(frame);
+        }, function (socket) {
+            count++;
+            if (Date.now() < end)
+                socket.write(frame);
+            else {
+                console.log('echo: ' + Math.round(count / seconds) + ' round trips/s');
+                socket.destroy();
+                srv.close();
+                setTimeout(done, 100);
+            }
+        });
+    });
+}
+
+fanOut('ws.send() per client', function (sockets) {
+    for (var i = 0; i < sockets.length; i++)
+        sockets[i].send(message);
+}, function () {
+    fanOut('WebSocketGroup.broadcast()', function (sockets, group) {
+        group.broadcast(message);
+    }, function () {
+        echo(function () { });
+    });
+});
@@ -0,0 +1,57 @@
+// Sends a large Buffer back and forth between the main thread and a worker,
+// copied and transferred. Prints the round trips per second. A transfer moves
+// the memory instead of copying it, so it should not depend on the size
+//
+//     low test/bench/bench-worker-transfer.js [megabytes] [round trips]
+
+var threads = require('worker_threads');
+
+var megabytes = parseInt(process.argv[2]) || 16;
+var trips = parseInt(process.argv[3]) || 100;
+
+function run(transfer, callback) {
+    // Built from a string, so the memory is a block of its own which can
+    // move. Memory of Buffer.alloc lives inside the Duktape object
+    var buf = Buffer.from(new Array(megabytes * 1024 + 1).join(
+        new Array(1025).join('x')));
+
+    var worker = new threads.Worker(__filename);
+    var left = trips;
+    var start = Date.now();
+
+    worker.on('message', function (data) {
+        if (data.length != buf.length)
+            throw new Error('unexpected length ' + data.length);
+        if (--left == 0) {
+            worker.postMessage(null);
+            callback(Date.now() - start);
+            return;
+        }
+        worker.postMessage(data, transfer ? [data] : undefined);
+        if (transfer && data.length)
+            throw new Error('transferred buffer still usable');
+    });
+    worker.on('error', function (e) {
+        throw e;
+    });
+
+    worker.postMessage(buf, transfer ? [buf] : undefined);
+}
+
+if (threads.isMainThread) {
+    run(false, function (ms) {
+        console.log('copied: ' + (trips * 1000 / ms).toFixed(0)
+            + ' round trips/s with ' + megabytes + ' MB');
+        run(true, function (ms) {
+            console.log('transferred: ' + (trips * 1000 / ms).toFixed(0)
+                + ' round trips/s with ' + megabytes + ' MB');
+        });
+    });
+} else {
+    threads.parentPort.on('message', function (data) {
+        if (data === null)
+            threads.parentPort.close();
+        else
+            threads.parentPort.postMessage(data, [data]);
+    });
+}
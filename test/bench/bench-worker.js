@@ -0,0 +1,87 @@
+// CPU bound JavaScript spread over worker threads, prints the time taken
+// with 1 to n workers. Should scale nearly linear up to the number of cores
+//
+//     low test/bench/bench-worker.js [max workers] [jobs]
+
+var threads = require('worker_threads');
+var os = require('os');
+
+var maxWorkers = parseInt(process.argv[2]) || os.cpus().length;
+var jobs = parseInt(process.argv[3]) || 32;
+var jobSize = 200000;
+
+function work(n) {
+    // Count primes below n, the slow way
+    var count = 0;
+    for (var i = 2; i < n; i++) {
+        var prime = true;
+        for (var j = 2; j * j <= i; j++)
+            if (i % j == 0) {
+                prime = false;
+                break;
+            }
+        if (prime)
+            count++;
+    }
+    return count;
+}
+
+function run(numWorkers, callback) {
+    var start = Date.now();
+    var sent = 0, done = 0;
+    var workers = [];
+
+    function onMessage() {
+        if (++done == jobs) {
+            for (var i = 0; i < workers.length; i++)
+                workers[i].postMessage(null);
+            callback(Date.now() - start);
+        } else if (sent < jobs) {
+            sent++;
+            this.postMessage(jobSize);
+        }
+    }
+    function onError(e) {
+        throw e;
+    }
+
+    for (var i = 0; i < numWorkers; i++) {
+        var worker = new threads.Worker(__filename);
+        worker.on('message', onMessage);
+        worker.on('error', onError);
+        workers.push(worker);
+    }
+    for (var i = 0; i < numWorkers && sent < jobs; i++) {
+        sent++;
+        workers[i].postMessage(jobSize);
+    }
+}
+
+var base;
+function next(numWorkers) {
+    if (numWorkers > maxWorkers)
+        return;
+
+    run(numWorkers, function (ms) {
+        if (!base)
+            base = ms;
+        console.log(numWorkers + ' workers: ' + jobs + ' jobs in ' + ms
+            + ' ms, speedup ' + (base / ms).toFixed(2));
+
+        if (numWorkers < maxWorkers && numWorkers * 2 > maxWorkers)
+            next(maxWorkers);
+        else
+            next(numWorkers * 2);
+    });
+}
+
+if (threads.isMainThread)
+    next(1);
+else {
+    threads.parentPort.on('message', function (n) {
+        if (n === null)
+            threads.parentPort.close();
+        else
+            threads.parentPort.postMessage(work(n));
+    });
+}
@@ -27,6 +27,11 @@ int neoniousGetStackFree()
 void code_print_error() {}
 void code_watchdog_event_loop() {}
 void code_gc() {}
+// Used by the CPU profiler of low.js, see src/low_profiler.cpp
+duk_bool_t low_exec_timeout_check(void *udata)
+{
+    return 0;
+}
 
 int pathStartLen;
 